@@ -63,6 +63,33 @@ typedef uint8_t			psUInt8;
 
 #define vBlock 1024
 
+// Rows per escape group of compressed column index storage
+#define PORESCALE_CCSR_GROUP 64
+
+// Largest subdomain left undivided by nested dissection
+#define PORESCALE_ND_LEAF 64
+
+// Power iterations estimating lambdaMax(D^{-1} A) for the smoothers
+#define PORESCALE_POWER_STEPS 15
+
+// Largest coarsest multigrid level solved by a replicated dense factorization
+#define PORESCALE_MG_DENSE 2048
+
+// Widest supernode grown by merging columns with differing structure
+#define PORESCALE_DIRECT_RELAX 16
+
+// Columns per block of the dense supernodal kernels
+#define PORESCALE_DIRECT_BLOCK 32
+
+// Block inverse iterations approximating the recycle space of GCRO-DR
+#define PORESCALE_RECYCLE_SWEEPS 20
+
+// Default records held by solver telemetry
+#define PORESCALE_TELEMETRY_CAPACITY 4096
+
+// Row length histogram bins of a matrix report, the last bin collects longer rows
+#define PORESCALE_REPORT_BINS 32
+
 // 1d->2d index
 #define idx2(i, j, ldi) ((i * ldi) + j)
 
@@ -7,12 +7,17 @@
 #ifndef _PORESCALE_MATRIX_H_
 #define _PORESCALE_MATRIX_H_
 
+#include <vector>
+
 #include "parameters.hpp"
 #include "types.hpp"
 
 namespace porescale
 {
 
+template <typename T> class vector;
+template <typename T> class blockVector;
+
 /** \brief Abstract base matrix class
  *
  */
@@ -29,7 +34,12 @@ public:
     /** \brief Init from parameters. */
     void init(parameters<T> * par);
 
+    /** \brief Set local extents from a uniform partition of rows and columns across pes. */
+    void partition(psInt globalRows, psInt globalColumns);
+
     // Sets
+    /** \brief Set the current pe and the global number of pes. */
+    void setPes(psInt myPe, psInt nPes);
     /** \brief Set the global number of rows. */
     void setGlobalRows(psInt gRows);
     /** \brief Set the local number of rows. */
@@ -117,6 +127,53 @@ protected:
 
 };
 
+/** \brief Characterization of a sparse matrix, global over all pes.
+ *
+ *  Byte counts are exact footprints of the local arrays summed over pes. CCSR
+ *  counts are bounds without the long offset table, which only lowers them.
+ *  Formats which do not apply, e.g. BSR with rows not divisible by the block
+ *  size, report -1. SpMV traffic counts the matrix, reads of the column window
+ *  of x and a write allocated y; the low bound reads x once, the high bound
+ *  once per nonzero.
+ */
+struct sparseMatrixReport
+{
+    int64_t globalRows;                 /**< Global number of rows. */
+    int64_t globalColumns;              /**< Global number of columns. */
+    int64_t globalNnz;                  /**< Global number of stored entries. */
+    int64_t emptyRows;                  /**< Rows without entries. */
+    int64_t minRowLength;               /**< Shortest row. */
+    int64_t maxRowLength;               /**< Longest row. */
+    double  meanRowLength;              /**< Mean row length. */
+    double  stdRowLength;               /**< Standard deviation of the row length. */
+    std::vector<int64_t> rowLengths;    /**< Rows of each length, the last bin counts longer rows. */
+
+    int64_t lowerBandwidth;             /**< Largest i - j of a stored entry. */
+    int64_t upperBandwidth;             /**< Largest j - i of a stored entry. */
+    int64_t profile;                    /**< Sum over rows of i - first column, lower envelope size. */
+
+    int64_t missingDiagonals;           /**< Rows without a stored or with a zero diagonal. */
+    int64_t dominantRows;               /**< Rows with |a_ii| >= sum |a_ij|, j != i. */
+    int64_t strictlyDominantRows;       /**< Rows with |a_ii| > sum |a_ij|, j != i. */
+    double  minDominance;               /**< Smallest |a_ii| / sum |a_ij| over rows with off diagonals. */
+
+    int64_t symmetryChecked;            /**< Entries whose transpose lies on the same pe and was checked. */
+    int64_t symmetryMissing;            /**< Checked entries without a stored transpose. */
+    double  symmetryError;              /**< Largest |a_ij - a_ji| / max |a_ij| over checked entries. */
+
+    int64_t bytesCOO;                   /**< Footprint in COO format. */
+    int64_t bytesCSR;                   /**< Footprint in CSR format. */
+    int64_t bytesBSR[3];                /**< Footprint in BSR format with block size 2, 3, 4. */
+    int64_t bytesCCSR[2];               /**< Footprint bound in CCSR format with 8 and 16 bit offsets. */
+    int64_t haloBytes;                  /**< Bytes of x read from other pes per SpMV. */
+    int64_t spmvBytesMin;               /**< SpMV traffic of CSR, x read once. */
+    int64_t spmvBytesMax;               /**< SpMV traffic of CSR, x read once per nonzero. */
+    double  spmvIntensity;              /**< Flops per byte of spmvBytesMin. */
+
+    /** \brief Report as a JSON object. */
+    std::string json(void) const;
+};
+
 /** \brief Sparse matrix derived class
  *
  */
@@ -130,7 +187,7 @@ public:
     sparseMatrix(parameters<T> * par);
 
     /** \brief Destructor */
-    ~sparseMatrix(void);
+    virtual ~sparseMatrix(void);
 
     /** \brief Initialize as copy of another matrix. */
     void init(parameters<T> * par);
@@ -148,6 +205,23 @@ public:
                    psInt * colArray,     psInt * rowArray,
                    T     * valueArray,   psSparseFormat format );
 
+    /** \brief Symbolic phase of a split build. Builds the CSR pattern of the local rows from
+     *         stencil entries given as local row and global column, duplicates allowed, and
+     *         records the value slot of every entry for later numeric phases. Collective,
+     *         nothing is built when an entry lies outside the local rows or global columns.
+     */
+    void buildSymbolic( psInt   localRows,     psInt   globalRows,
+                        psInt   localColumns,  psInt   globalColumns,
+                        psInt   nEntries,      const psInt * entryRows,
+                        const psInt * entryColumns );
+
+    /** \brief Numeric phase of a split build. Refills the values from entry values ordered as
+     *         the entries of buildSymbolic, summing duplicates. One streaming pass, no allocation.
+     *         Slots stay valid in CSR and CCSR, which keeps the CSR value order; conversion
+     *         to BSR drops them.
+     */
+    void buildNumeric( const T * entryValues );
+
     /** \brief Build from master pe and distribute. */
     void buildSeq( psInt   globalRows,   psInt   globalColumns,
                    psInt   globalNnz,    psInt * colArray,
@@ -161,6 +235,8 @@ public:
     psInt * rowArray(void);
     /** \brief Pointer to value array. */
     T * valueArray(void);
+    /** \brief Value slot of every entry given to buildSymbolic, NULL without a symbolic phase. */
+    const psInt * entrySlots(void) const;
 
     // Sets
     /** \brief Set the global number of nonzeros. */
@@ -175,16 +251,120 @@ public:
     psInt          globalNnz(void) const;
     /** \brief Return the local number of nonzeros. */
     psInt          localNnz(void) const;
+    /** \brief Return the block size, 1 unless stored in BSR format. */
+    psInt          blockSize(void) const;
+    /** \brief Return the local number of stored blocks in BSR format. */
+    psInt          localBlocks(void) const;
+    /** \brief Return the SpMV kernel. */
+    psSpmvKernel   spmvKernel(void) const;
+    /** \brief Return the first global column referenced by local rows. */
+    psInt          columnBegin(void) const;
+    /** \brief Return one past the last global column referenced by local rows. */
+    psInt          columnEnd(void) const;
 
     // Converts
+    /** \brief Convert CSR storage to BSR with square blocks of size blockSize.
+     *         Local rows, first row and global columns must be multiples of the block size.
+     */
+    void convertToBSR(psInt blockSize);
+    /** \brief Convert CSR storage to CCSR. Each row stores a base column and 8 or 16 bit
+     *         offsets from it. Offsets out of range are coded through a small table of
+     *         frequent long offsets, i.e. the z stride of a voxel stencil, or escape to
+     *         full column indices. deltaBytes of 1 or 2 forces the width, 0 picks the
+     *         smaller footprint.
+     */
+    void convertToCCSR(psInt deltaBytes = 0);
+    /** \brief Convert COO, BSR or CCSR storage to CSR. */
+    void convertToCSR(void);
+
+    // Products
+    /** \brief this = A B with a two phase Gustavson product, a symbolic pass for row sizes
+     *         and a numeric pass, each row accumulated in a hash or dense accumulator.
+     *         A and B must be CSR and the local rows of B must cover the column window of A.
+     */
+    void multiply(const sparseMatrix<T>& A, const sparseMatrix<T>& B);
+    /** \brief this = A^T of a CSR matrix held on one pe. */
+    void transpose(const sparseMatrix<T>& A);
+    /** \brief this = global rows [begin, end) of the distributed CSR matrix A, held on this
+     *         pe with first row begin. Collective, rows owned by other pes are fetched.
+     */
+    void gatherRows(const sparseMatrix<T>& A, psInt begin, psInt end);
+    /** \brief this = R A P, e.g. the Galerkin coarse operator with R = P^T. */
+    void tripleProduct(const sparseMatrix<T>& R, const sparseMatrix<T>& A, const sparseMatrix<T>& P);
+
+    // Reorder
+    /** \brief Reverse Cuthill-McKee ordering of the local rows, perm[new] = old.
+     *         Level synchronous from pseudo-peripheral roots of every component.
+     *         The local pattern is assumed structurally symmetric. CSR only.
+     */
+    void orderRCM(psInt * perm) const;
+    /** \brief Nested dissection ordering of the local rows, perm[new] = old. Level
+     *         structure separators from pseudo-peripheral roots, disconnected parts
+     *         are split into their components first, subdomains of one level are
+     *         split in parallel. The local pattern is assumed structurally
+     *         symmetric. CSR only.
+     */
+    void orderNestedDissection(psInt * perm) const;
+    /** \brief Color of every local row, no two local neighbors share one, returns the
+     *         number of colors. Red-black when the local graph is bipartite, as voxel
+     *         stencils are, first fit in row order otherwise. Neighbors are taken
+     *         in both directions, so unsymmetric local patterns are colored
+     *         safely. CSR only.
+     */
+    psInt colorRows(psInt * colors) const;
+    /** \brief Symmetric permutation of the local rows and columns in place, perm[new] = old.
+     *         Collective, column indices on other pes are renumbered to match. Converts
+     *         to CSR. Slots of a split build follow the permutation, so buildNumeric keeps
+     *         working with entries in the original numbering.
+     */
+    void permute(const psInt * perm);
+
+    // Analysis
+    /** \brief Characterize the matrix, collective. Parallel passes over the local rows,
+     *         no storage proportional to the matrix. CSR only.
+     */
+    void analyze(sparseMatrixReport& report) const;
+
+    // Tuning
+    /** \brief Time SpMV with each candidate format and kernel for iterations products
+     *         and keep the fastest. Candidates are CSR with row or nonzero balanced chunks,
+     *         CCSR with 8 and 16 bit offsets and BSR with blocks of 2, 3 and 4 where the
+     *         partition allows and the fill at most doubles the stored entries. Collective,
+     *         the slowest pe decides. The choice is cached in cacheFile under the pattern
+     *         signature, precision, pes, threads and CPU model, a hit converts without
+     *         timing. An empty name disables the cache.
+     */
+    void autoTune(const std::string& cacheFile = "", psInt iterations = 10);
+    /** \brief Select the SpMV kernel, chunk bounds of SPMV_BALANCED follow the current pattern. */
+    void setSpmvKernel(psSpmvKernel kernel);
+    /** \brief Hash of the global sparsity pattern and sizes, collective. */
+    uint64_t signature(void) const;
+
+    // Kernels
+    /** \brief d = diagonal of the local rows, 0 where none is stored. CSR only. */
+    void diagonal(T * d) const;
+    /** \brief Sparse matrix vector product y = A x on local rows.
+     *         x holds the columns [columnBegin(), columnEnd()), y the local rows.
+     */
+    void spmv(const T * x, T * y) const;
+    /** \brief y = A x for distributed vectors. Exchanges the halo of x, which must
+     *         cover the column window of the local rows (see vector::setHalo).
+     */
+    void apply(vector<T>& x, vector<T>& y) const;
+    /** \brief Y = A X for nRhs interleaved right hand sides, the matrix streams once.
+     *         X and Y are laid out as spmv operands with nRhs entries per row. CSR or CCSR.
+     */
+    void spmm(const T * X, T * Y, psInt nRhs) const;
+    /** \brief Y = A X for distributed block vectors, exchanges the halo of X. */
+    void apply(blockVector<T>& X, blockVector<T>& Y) const;
 
     // Memory
-    /** \brief Allocates memory based on number of nonzeros.
-     *         If memory was already allocated, deletes and re-allocates.
+    /** \brief Allocates memory based on number of nonzeros through the memory policy.
+     *         Storage is reused when its capacity suffices.
      */
     virtual void allocate(void);
     /** \brief Allocates memory based on number of nonzeros and sets all entries to 0.
-     *         If already allocated, deletes and re-allocates.
+     *         Storage is reused when its capacity suffices.
      */
     virtual void allocateZero(void);
     /** \brief Copy memory to device. */
@@ -195,42 +375,330 @@ public:
     virtual void zero(void);
 
     // IO
-    /** Read in MTX file and distribute. */
-    void readMTX(void);
-    /** Coalesce and write MTX file. */
-    void writeMTX(void);
-    /** Read parallel data in poreScale format.  */
-    void parRead(void);
-    /** Parallel write to poreScale format files. */
-    void parWrite(void);
+    /** Read in MTX file, each pe keeps the rows of its partition. Duplicate coordinates are
+     *  summed, malformed or out of range lines and a wrong entry count fail the read.
+     */
+    void readMTX(const std::string& fileName);
+    /** Write MTX file, each pe writes its own rows in place. */
+    void writeMTX(const std::string& fileName);
+    /** Read parallel data in poreScale format. The file may have been written
+     *  by any number of pes, rows are repartitioned across the current pes.
+     */
+    void parRead(const std::string& fileName);
+    /** Parallel write to poreScale format file. Layout is a header with global sizes,
+     *  format and the per-pe row and nonzero offsets, followed by the global CSR row
+     *  offsets, column indices and values, each section 4k aligned.
+     */
+    void parWrite(const std::string& fileName);
 
 protected:
 
     psSparseFormat sparseFormat_;   /**< Tracks the sparse matrix format. */
     psInt          globalNnz_;      /**< Global number of nonzeros. */
     psInt          localNnz_;       /**< Local number of nonzeros. */
+    psInt          blockSize_;      /**< Block size of BSR storage, 1 otherwise. */
+    psInt          localBlocks_;    /**< Local number of stored blocks in BSR format. */
+    psInt          columnBegin_;    /**< First global column referenced by local rows. */
+    psInt          columnEnd_;      /**< One past the last global column referenced by local rows. */
+    psSpmvKernel   spmvKernel_;     /**< SpMV kernel of CSR storage. */
+    std::vector<psInt> chunkRows_;  /**< First row of each chunk of SPMV_BALANCED. */
 
     // host data
     psInt * colArray_;              /**< Host column array. */
     psInt * rowArray_;              /**< Host row array. */
     T     * valueArray_;            /**< Host value array. */
+    size_t  colCapacity_;           /**< Entries allocated for colArray_. */
+    size_t  rowCapacity_;           /**< Entries allocated for rowArray_. */
+    size_t  valueCapacity_;         /**< Entries allocated for valueArray_. */
+
+    // compressed column index data, CCSR format only
+    psInt    deltaBytes_;           /**< Bytes per column offset, 1 or 2. */
+    psInt    nOffsets_;             /**< Number of entries in the long offset table. */
+    psInt    localEscapes_;         /**< Local number of escaped column indices. */
+    psInt  * rowBaseArray_;         /**< Base column of each local row. */
+    psInt8 * deltaArray_;           /**< Coded column offset of each nonzero. */
+    psInt  * offsetTable_;          /**< Table of frequent long column offsets. */
+    psInt  * escapeArray_;          /**< Escaped full column indices in row order. */
+    psInt  * escapeGroupArray_;     /**< First escape of each group of PORESCALE_CCSR_GROUP rows. */
+
+    // split build data
+    psInt    nEntries_;             /**< Number of stencil entries of the symbolic phase. */
+    psInt  * entrySlotArray_;       /**< Value slot of each stencil entry. */
+    psInt  * slotEntryPtr_;         /**< Offsets of each value slot into slotEntryArray_. */
+    psInt  * slotEntryArray_;       /**< Stencil entries grouped by value slot. */
+
+    /** \brief Build local CSR arrays from unsorted coordinate entries with global indices,
+     *         duplicate coordinates are summed.
+     */
+    void buildFromCOO_(arrayCOO<T> * entries, psInt nEntries);
+    /** \brief Recompute the referenced column window from the stored column indices. */
+    void updateColumnWindow_(void);
+    /** \brief Refresh what derives from a new local pattern, the column window and the
+     *         balanced row partition of SPMV_BALANCED.
+     */
+    void updateStructure_(void);
+    /** \brief First touch of the CSR column and value arrays by the row chunks of the SpMV,
+     *         once the row array is set. Without firstTouch in the policy does nothing.
+     */
+    void touchEntries_(void);
+    /** \brief Release compressed column index storage. */
+    void freeCompressed_(void);
+    /** \brief Release split build data. */
+    void freePattern_(void);
 
 };
 
 /** \brief Dense matrix derived class
  *
+ *  Column major storage with rows distributed across pes and all columns local.
+ *  Each column holds [low halo | owned rows | high halo], the owned rows of every
+ *  column start on an aligned boundary of the memory policy.
  */
 template <typename T>
 class denseMatrix : public matrix<T>
 {
+public:
+    /** \brief Default constructor. */
+    denseMatrix(void);
+    /** \brief Construct from parameters. */
+    denseMatrix(parameters<T> * par);
 
+    /** \brief Destructor */
+    virtual ~denseMatrix(void);
+
+    /** \brief Not copyable, the storage is owned. */
+    denseMatrix(const denseMatrix<T>&) = delete;
+    /** \brief Not copyable, the storage is owned. */
+    denseMatrix<T>& operator=(const denseMatrix<T>&) = delete;
+    /** \brief Move constructor, A is left empty. */
+    denseMatrix(denseMatrix<T>&& A) noexcept;
+    /** \brief Move assignment, A is left empty. */
+    denseMatrix<T>& operator=(denseMatrix<T>&& A) noexcept;
+
+    // Build
+    /** \brief Partition rows uniformly across pes and allocate nColumns zeroed columns. */
+    void build(psInt globalRows, psInt nColumns);
+    /** \brief Allocate nColumns zeroed columns with the row partition of A, no halo. */
+    void buildLike(const sparseMatrix<T>& A, psInt nColumns);
+
+    // Accessors
+    /** \brief Pointer to the first owned row of column 0. */
+    T * valueArray(void);
+    /** \brief Pointer to the first owned row of column 0. */
+    const T * valueArray(void) const;
+    /** \brief Pointer to the first owned row of column j. */
+    T * column(psInt j);
+    /** \brief Pointer to the first owned row of column j. */
+    const T * column(psInt j) const;
+    /** \brief Distance between consecutive columns. */
+    psInt leadingDimension(void) const;
+    /** \brief Number of halo rows stored below the owned rows. */
+    psInt haloLow(void) const;
+    /** \brief Number of halo rows stored above the owned rows. */
+    psInt haloHigh(void) const;
+
+    // Columns
+    /** \brief x = column j. */
+    void getColumn(psInt j, vector<T>& x) const;
+    /** \brief column j = alpha * x. */
+    void setColumn(psInt j, const vector<T>& x, T alpha = 1);
+
+    // Level 2 kernels
+    /** \brief y = V^T x over the first nColumns columns, one pass and one reduction.
+     *         With xx given, x.x is returned from the same reduction.
+     */
+    void gemvT(psInt nColumns, const vector<T>& x, T * y, T * xx = NULL) const;
+    /** \brief x += alpha * V y over the first nColumns columns. */
+    void gemv(psInt nColumns, T alpha, const T * y, vector<T>& x) const;
+
+    // Memory
+    /** \brief Allocates memory through the memory policy, reused when capacity suffices. */
+    virtual void allocate(void);
+    /** \brief Allocates memory and sets all entries to 0. */
+    virtual void allocateZero(void);
+    /** \brief Update device data from host. */
+    virtual void copyHostToDevice(void);
+    /** \brief Update host data from device. */
+    virtual void copyDeviceToHost(void);
+    /** \brief Zero all matrix data. */
+    virtual void zero(void);
+
+protected:
+    T      * baseArray_;        /**< Start of the allocation. */
+    size_t   capacity_;         /**< Entries allocated for baseArray_. */
+    psInt    ld_;               /**< Leading dimension. */
+    psInt    lowPad_;           /**< Offset of the owned rows within a column. */
+    psInt    haloLow_;          /**< Halo rows below the owned rows. */
+    psInt    haloHigh_;         /**< Halo rows above the owned rows. */
 };
 
+/** \brief Vector derived class
+ *
+ *  Distributed vector with level 1 kernels for Krylov methods. Reductions are
+ *  global over all pes. The fused kernels stream each operand once.
+ */
 template <typename T>
-/** \brief Vector derived class */
 class vector : public denseMatrix<T>
 {
+public:
+    /** \brief Default constructor. */
+    vector(void);
+    /** \brief Construct from parameters. */
+    vector(parameters<T> * par);
+
+    /** \brief Destructor */
+    virtual ~vector(void);
+
+    /** \brief Move constructor, x is left empty. */
+    vector(vector<T>&& x) noexcept = default;
+    /** \brief Move assignment, x is left empty. */
+    vector<T>& operator=(vector<T>&& x) noexcept = default;
+
+    // Build
+    /** \brief Partition rows uniformly across pes and allocate a zeroed vector. */
+    void build(psInt globalRows);
+    /** \brief Allocate with the layout of x, values are not copied. */
+    void buildLike(const vector<T>& x);
+    /** \brief Allocate a zeroed vector with the row partition of A and a halo covering
+     *         its column window, ready to be the x of A.apply.
+     */
+    void buildLike(const sparseMatrix<T>& A);
+
+    // Halo
+    /** \brief Extend the stored window to global rows [begin, end), owned values are kept. Collective. */
+    void setHalo(psInt begin, psInt end);
+    /** \brief Fetch halo rows from the owning pes. Collective. */
+    void exchangeHalo(void);
+
+    // Level 1 kernels
+    /** \brief this = alpha. */
+    void set(T alpha);
+    /** \brief this = x. */
+    void copy(const vector<T>& x);
+    /** \brief this = alpha * this. */
+    void scale(T alpha);
+    /** \brief this = this + alpha * x. */
+    void axpy(T alpha, const vector<T>& x);
+    /** \brief this = alpha * x + beta * this. */
+    void axpby(T alpha, const vector<T>& x, T beta);
+    /** \brief this = alpha * x + beta * y. */
+    void waxpby(T alpha, const vector<T>& x, T beta, const vector<T>& y);
+    /** \brief this = alpha * x + beta * this, returns the 2-norm of the result. */
+    T axpbyNorm(T alpha, const vector<T>& x, T beta);
+    /** \brief this = x .* y. */
+    void pointwiseMultiply(const vector<T>& x, const vector<T>& y);
+    /** \brief Global dot product with x. */
+    T dot(const vector<T>& x) const;
+    /** \brief Global 2-norm. */
+    T norm2(void) const;
+    /** \brief Global max norm. */
+    T normInf(void) const;
+
+    // Reorder
+    /** \brief Reorder owned rows to a matrix permutation, this[new] = this[perm[new]]. */
+    void permute(const psInt * perm);
+    /** \brief Undo permute, this[perm[new]] = this[new]. */
+    void unpermute(const psInt * perm);
+
+    /** \brief Dot products a.b and c.d in one pass and one reduction. */
+    static void dot2(const vector<T>& a, const vector<T>& b,
+                     const vector<T>& c, const vector<T>& d,
+                     T& ab, T& cd);
+    /** \brief CG update x += alpha * p, r -= alpha * q, returns the 2-norm of r. */
+    static T cgUpdate(T alpha, const vector<T>& p, const vector<T>& q,
+                      vector<T>& x, vector<T>& r);
+    /** \brief results[k] = a[k].b[k] for nPairs pairs in one pass and one reduction. */
+    static void dots(psInt nPairs, const vector<T> * const * a, const vector<T> * const * b, T * results);
+    /** \brief Start dots without waiting for the reduction, sums holds nPairs partial sums
+     *         until dotsFinish. Work issued in between overlaps the reduction.
+     */
+    static void dotsBegin(psInt nPairs, const vector<T> * const * a, const vector<T> * const * b, double * sums);
+    /** \brief Wait for the reduction of dotsBegin, results[k] = a[k].b[k]. */
+    static void dotsFinish(psInt nPairs, double * sums, T * results);
+
+protected:
+    std::vector<int64_t> peOffsets_;    /**< First global row of every pe, nPes + 1 entries. */
+};
+
+/** \brief Block vector derived class
+ *
+ *  nRhs distributed vectors stored interleaved, entry r of row i is at
+ *  valueArray()[i * nRhs() + r], so sparse products stream the matrix once
+ *  for all right hand sides. Reductions are global over all pes.
+ */
+template <typename T>
+class blockVector : public denseMatrix<T>
+{
+public:
+    /** \brief Default constructor. */
+    blockVector(void);
+    /** \brief Construct from parameters. */
+    blockVector(parameters<T> * par);
+
+    /** \brief Destructor */
+    virtual ~blockVector(void);
+
+    /** \brief Move constructor, X is left empty. */
+    blockVector(blockVector<T>&& X) noexcept = default;
+    /** \brief Move assignment, X is left empty. */
+    blockVector<T>& operator=(blockVector<T>&& X) noexcept = default;
+
+    // Build
+    /** \brief Partition rows uniformly across pes and allocate nRhs zeroed vectors. */
+    void build(psInt globalRows, psInt nRhs);
+    /** \brief Allocate with the layout of X, values are not copied. */
+    void buildLike(const blockVector<T>& X);
+    /** \brief Allocate nRhs zeroed vectors with the row partition of A and a halo
+     *         covering its column window.
+     */
+    void buildLike(const sparseMatrix<T>& A, psInt nRhs);
+    /** \brief Number of right hand sides. */
+    psInt nRhs(void) const;
+
+    // Halo
+    /** \brief Extend the stored window to global rows [begin, end), owned values are kept. Collective. */
+    void setHalo(psInt begin, psInt end);
+    /** \brief Fetch halo rows from the owning pes. Collective. */
+    void exchangeHalo(void);
+
+    // Columns
+    /** \brief x = column r. */
+    void getColumn(psInt r, vector<T>& x) const;
+    /** \brief column r = x. */
+    void setColumn(psInt r, const vector<T>& x);
+
+    // Level 1 kernels
+    /** \brief this = alpha. */
+    void set(T alpha);
+    /** \brief this = X. */
+    void copy(const blockVector<T>& X);
+    /** \brief Column r += alpha[r] * X column r. */
+    void axpy(const T * alpha, const blockVector<T>& X);
+    /** \brief Column r = alpha[r] * X column r + beta[r] * column r. */
+    void axpby(const T * alpha, const blockVector<T>& X, const T * beta);
+    /** \brief dots[r] = column r . X column r, one pass and one reduction. */
+    void columnDots(const blockVector<T>& X, T * dots) const;
+    /** \brief norms[r] = 2-norm of column r. */
+    void columnNorms(T * norms) const;
+    /** \brief G = this^T X, row major nRhs x nRhs, one pass and one reduction. */
+    void gram(const blockVector<T>& X, T * G) const;
+    /** \brief this = X M + beta * this with M row major nRhs x nRhs. */
+    void multiplyAdd(const blockVector<T>& X, const T * M, T beta);
+    /** \brief Column r += sum_k coefficients[k * nRhs + r] * V[k] column r over nBlocks blocks. */
+    void combine(psInt nBlocks, const blockVector<T> * const * V, const T * coefficients);
+
+    /** \brief results[k * nRhs + r] = a[k] column r . b[k] column r for nPairs pairs in one
+     *         pass and one reduction.
+     */
+    static void dots(psInt nPairs, const blockVector<T> * const * a, const blockVector<T> * const * b, T * results);
 
+    // Memory
+    /** \brief Allocates interleaved storage through the memory policy. */
+    virtual void allocate(void);
+
+protected:
+    psInt                nRhs_;         /**< Number of right hand sides. */
+    std::vector<int64_t> peOffsets_;    /**< First global row of every pe, nPes + 1 entries. */
 };
 
 }
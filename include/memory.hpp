@@ -0,0 +1,133 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief poreScale storage allocation policy.
+ */
+
+#ifndef _PORESCALE_MEMORY_H_
+#define _PORESCALE_MEMORY_H_
+
+#include "define.hpp"
+#include "parallel.hpp"
+
+namespace porescale
+{
+
+/** \brief Page backing of large allocations. */
+enum psPageMode
+{
+    PAGES_DEFAULT,      /**< Regular pages. */
+    PAGES_TRANSPARENT,  /**< Huge page aligned and advised for transparent huge pages. */
+    PAGES_HUGETLB       /**< Explicit huge pages from the hugetlb pool, regular pages if the pool is empty. */
+};
+
+/** \brief Allocation policy applied to all matrix and vector storage.
+ *
+ * With firstTouch set, new storage is written in parallel using the same
+ * chunk partition as the compute kernels (chunk c of n entries starts at
+ * chunkBegin(n, c, parallelChunks())), so that on NUMA machines the pages
+ * of each chunk land on the node of the thread which streams them. The
+ * column and value arrays of CSR storage follow the row chunks of the SpMV
+ * instead, entries rowPtr[chunkBegin(nRows, c, parallelChunks())] onward.
+ */
+struct memoryPolicy
+{
+    size_t     alignment;       /**< Byte alignment of every allocation, power of two and at least 64. */
+    psPageMode pages;           /**< Page backing of allocations of at least hugeThreshold bytes. */
+    size_t     hugeThreshold;   /**< Smallest allocation backed according to pages. */
+    bool       firstTouch;      /**< Parallel first touch of new storage. */
+};
+
+/** \brief Set the allocation policy, applies to allocations made afterwards. */
+void setMemoryPolicy(const memoryPolicy & policy);
+/** \brief Return the current allocation policy. */
+const memoryPolicy & getMemoryPolicy(void);
+
+/** \brief Allocate bytes according to the policy, without first touch. */
+void * alignedAllocate(size_t bytes);
+/** \brief Release memory from alignedAllocate, NULL is ignored. */
+void alignedFree(void * ptr);
+
+/** \brief Zero ptr[0, n) in parallel with the kernel chunk partition. */
+template <typename T>
+inline void
+firstTouch(T * ptr, size_t n)
+{
+    psInt nChunks = streamChunks(n);
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::fill(ptr + chunkBegin(n, c, nChunks), ptr + chunkBegin(n, c + 1, nChunks), (T)0);
+    });
+}
+
+/** \brief Zero the entries of rows [0, nRows) of rowPtr in parallel with the row chunks of the SpMV. */
+template <typename T>
+inline void
+firstTouchRows(T * ptr, psInt nRows, const psInt * rowPtr)
+{
+    psInt nChunks = parallelChunks();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::fill(ptr + rowPtr[chunkBegin(nRows, c, nChunks)], ptr + rowPtr[chunkBegin(nRows, c + 1, nChunks)], (T)0);
+    });
+}
+
+/** \brief Allocate an array of n entries according to the policy, touch false leaves
+ *         the first touch to the caller.
+ */
+template <typename T>
+inline T *
+allocateArray(size_t n, bool touch = true)
+{
+    T * ptr = (T *)alignedAllocate(std::max(n, (size_t)1) * sizeof(T));
+    if (ptr != NULL && touch && getMemoryPolicy().firstTouch) firstTouch(ptr, n);
+    return ptr;
+}
+
+/** \brief Allocate the rowPtr[nRows] entries of CSR rows according to the policy,
+ *         first touched with the row chunks of the SpMV.
+ */
+template <typename T>
+inline T *
+allocateEntries(psInt nRows, const psInt * rowPtr)
+{
+    T * ptr = allocateArray<T>(rowPtr[nRows], false);
+    if (ptr != NULL && getMemoryPolicy().firstTouch) firstTouchRows(ptr, nRows, rowPtr);
+    return ptr;
+}
+
+/** \brief Release an array from allocateArray and reset the pointer. */
+template <typename T>
+inline void
+freeArray(T *& ptr)
+{
+    alignedFree((void *)ptr);
+    ptr = NULL;
+}
+
+/** \brief Make ptr hold at least n entries, storage is kept when capacity suffices.
+ *
+ * Contents are not preserved when the array grows.
+ */
+template <typename T>
+inline void
+reserveArray(T *& ptr, size_t & capacity, size_t n, bool touch = true)
+{
+    if (ptr != NULL && capacity >= n) return;
+    freeArray(ptr);
+    ptr      = allocateArray<T>(n, touch);
+    capacity = (ptr != NULL) ? n : 0;
+}
+
+/** \brief Release an array from reserveArray and reset its capacity. */
+template <typename T>
+inline void
+releaseArray(T *& ptr, size_t & capacity)
+{
+    freeArray(ptr);
+    capacity = 0;
+}
+
+}
+
+#endif
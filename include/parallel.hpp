@@ -0,0 +1,231 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief poreScale parallel helpers.
+ */
+
+#ifndef _PORESCALE_PARALLEL_H_
+#define _PORESCALE_PARALLEL_H_
+
+#include <algorithm>
+#include <execution>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "define.hpp"
+
+namespace porescale
+{
+
+/** \brief Random access iterator over a range of integers.
+ *
+ * Used to drive index based stdpar algorithms, i.e. parallel loops
+ * over rows or chunks of rows.
+ */
+template <typename I>
+class countingIterator
+{
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef I                               value_type;
+    typedef std::ptrdiff_t                  difference_type;
+    typedef const I *                       pointer;
+    typedef I                               reference;
+
+    countingIterator(void) : i_(0) { }
+    explicit countingIterator(I i) : i_(i) { }
+
+    I operator*(void) const { return i_; }
+    I operator[](difference_type n) const { return i_ + (I)n; }
+
+    countingIterator& operator++(void) { ++i_; return *this; }
+    countingIterator  operator++(int) { countingIterator tmp(*this); ++i_; return tmp; }
+    countingIterator& operator--(void) { --i_; return *this; }
+    countingIterator  operator--(int) { countingIterator tmp(*this); --i_; return tmp; }
+    countingIterator& operator+=(difference_type n) { i_ += (I)n; return *this; }
+    countingIterator& operator-=(difference_type n) { i_ -= (I)n; return *this; }
+
+    friend countingIterator operator+(countingIterator it, difference_type n) { return countingIterator(it.i_ + (I)n); }
+    friend countingIterator operator+(difference_type n, countingIterator it) { return countingIterator(it.i_ + (I)n); }
+    friend countingIterator operator-(countingIterator it, difference_type n) { return countingIterator(it.i_ - (I)n); }
+    friend difference_type  operator-(countingIterator a, countingIterator b) { return (difference_type)a.i_ - (difference_type)b.i_; }
+
+    friend bool operator==(countingIterator a, countingIterator b) { return a.i_ == b.i_; }
+    friend bool operator!=(countingIterator a, countingIterator b) { return a.i_ != b.i_; }
+    friend bool operator<(countingIterator a, countingIterator b)  { return a.i_ < b.i_; }
+    friend bool operator>(countingIterator a, countingIterator b)  { return a.i_ > b.i_; }
+    friend bool operator<=(countingIterator a, countingIterator b) { return a.i_ <= b.i_; }
+    friend bool operator>=(countingIterator a, countingIterator b) { return a.i_ >= b.i_; }
+
+private:
+    I i_;
+};
+
+/** \brief Number of chunks used to partition parallel work on this pe. */
+inline psInt
+parallelChunks(void)
+{
+    static const psInt nChunks = std::max(1u, std::thread::hardware_concurrency());
+    return nChunks;
+}
+
+/** \brief Number of chunks for streaming kernels over n entries, small arrays run as one chunk. */
+template <typename N>
+inline psInt
+streamChunks(N n)
+{
+    return (n < 65536) ? 1 : parallelChunks();
+}
+
+/** \brief Parallel loop f(i) for i in [begin, end). */
+template <typename I, typename F>
+inline void
+parallelFor(I begin, I end, F f)
+{
+    if (end <= begin) return;
+    std::for_each(std::execution::par, countingIterator<I>(begin), countingIterator<I>(end), f);
+}
+
+/** \brief Parallel sum of f(i) for i in [begin, end). */
+template <typename I, typename R, typename F>
+inline R
+parallelReduce(I begin, I end, R init, F f)
+{
+    if (end <= begin) return init;
+    return std::transform_reduce(std::execution::par, countingIterator<I>(begin), countingIterator<I>(end),
+                                 init, std::plus<R>(), f);
+}
+
+/** \brief Parallel max of f(i) for i in [begin, end). */
+template <typename I, typename R, typename F>
+inline R
+parallelMax(I begin, I end, R init, F f)
+{
+    if (end <= begin) return init;
+    return std::transform_reduce(std::execution::par, countingIterator<I>(begin), countingIterator<I>(end),
+                                 init, [](R a, R b) { return (a > b) ? a : b; }, f);
+}
+
+/** \brief Parallel min of f(i) for i in [begin, end). */
+template <typename I, typename R, typename F>
+inline R
+parallelMin(I begin, I end, R init, F f)
+{
+    if (end <= begin) return init;
+    return std::transform_reduce(std::execution::par, countingIterator<I>(begin), countingIterator<I>(end),
+                                 init, [](R a, R b) { return (a < b) ? a : b; }, f);
+}
+
+/** \brief First index of chunk c when [0, n) is split into nChunks equal chunks. */
+template <typename I>
+inline I
+chunkBegin(I n, psInt c, psInt nChunks)
+{
+    return (I)(((int64_t)n * c) / nChunks);
+}
+
+/** \brief Loop f(begin, end) over the stream chunks of [0, n). */
+template <typename F>
+inline void
+streamFor(psInt n, F f)
+{
+    psInt nChunks = streamChunks(n);
+    parallelFor((psInt)0, nChunks, [=](psInt c) { f(chunkBegin(n, c, nChunks), chunkBegin(n, c + 1, nChunks)); });
+}
+
+/** \brief nSums partial sums f(begin, end, out) over the stream chunks of [0, n), reduced into sums. */
+template <typename F>
+inline void
+streamSums(psInt n, psInt nSums, double * sums, F f)
+{
+    psInt               nChunks = streamChunks(n);
+    std::vector<double> partial((size_t)nChunks * nSums, 0.0);
+    double            * partialPtr = partial.data();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        f(chunkBegin(n, c, nChunks), chunkBegin(n, c + 1, nChunks), partialPtr + (size_t)c * nSums);
+    });
+    for (psInt k = 0; k < nSums; k++)
+    {
+        sums[k] = 0;
+        for (psInt c = 0; c < nChunks; c++) sums[k] += partial[(size_t)c * nSums + k];
+    }
+}
+
+/** \brief In place exclusive prefix sum of data[0, n), returns the total.
+ *
+ * Blocked two pass scan: chunk totals are computed in parallel, scanned,
+ * and then each chunk is scanned from its offset in parallel.
+ */
+template <typename I, typename N>
+inline I
+exclusiveScan(I * data, N n)
+{
+    if (n <= 0) return 0;
+    psInt nChunks = streamChunks(n);
+    std::vector<I> totals(nChunks + 1, 0);
+    I * totalPtr = totals.data();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        I sum = 0;
+        for (N i = chunkBegin(n, c, nChunks); i < chunkBegin(n, c + 1, nChunks); i++) sum += data[i];
+        totalPtr[c + 1] = sum;
+    });
+    for (psInt c = 0; c < nChunks; c++) totals[c + 1] += totals[c];
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        I sum = totalPtr[c];
+        for (N i = chunkBegin(n, c, nChunks); i < chunkBegin(n, c + 1, nChunks); i++)
+        {
+            I value = data[i];
+            data[i] = sum;
+            sum += value;
+        }
+    });
+    return totals[nChunks];
+}
+
+//--- Processing element collectives ---//
+// All collectives below return immediately when nPes <= 1, so that
+// objects which were never attached to an NVSHMEM job remain usable.
+
+/** \brief In place global sum over all pes. */
+void globalSum(double * values, psInt n, psInt nPes);
+/** \brief In place global sum over all pes. */
+void globalSum(int64_t * values, psInt n, psInt nPes);
+/** \brief Start an in place global sum over all pes without waiting for it.
+ *
+ * The sum runs on its own stream and team, so kernels and blocking collectives
+ * issued before globalSumFinish overlap it. values must stay alive and untouched
+ * until then. One sum is pending at a time, a sum started while another is
+ * pending completes before globalSumBegin returns.
+ */
+void globalSumBegin(double * values, psInt n, psInt nPes);
+/** \brief Wait for the sum started by globalSumBegin, values then hold the result. */
+void globalSumFinish(double * values);
+/** \brief In place global max over all pes. */
+void globalMax(double * values, psInt n, psInt nPes);
+/** \brief In place global max over all pes. */
+void globalMax(int64_t * values, psInt n, psInt nPes);
+/** \brief In place global min over all pes. */
+void globalMin(int64_t * values, psInt n, psInt nPes);
+/** \brief Gather one value from every pe, out must hold nPes entries. */
+void allGather(int64_t value, int64_t * out, psInt myPe, psInt nPes);
+/** \brief Barrier over all pes. */
+void globalBarrier(psInt nPes);
+/** \brief Copy global entries of an array distributed over pes into local buffers.
+ *
+ * Collective. peOffsets holds nPes + 1 global offsets, owned holds the entries
+ * [peOffsets[myPe], peOffsets[myPe + 1]) of this pe, each elementBytes wide.
+ * Range r covers global entries [ranges[2r], ranges[2r + 1]) and is copied to outs[r].
+ */
+void gatherRanges(const void * owned, size_t elementBytes, const int64_t * peOffsets,
+                  psInt nRanges, const int64_t * ranges, void * const * outs,
+                  psInt myPe, psInt nPes);
+
+}
+
+#endif
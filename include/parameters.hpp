@@ -63,6 +63,8 @@ public:
   T            solverRelativeTolerance(void) const;
   /** \brief Returns verbose level for the iterative solver. */
   psInt      solverVerbose(void) const;
+  /** \brief Returns the strength of connection threshold of algebraic multigrid. */
+  T            amgStrengthThreshold(void) const;
   /** \brief Returns reference to the problem path. */
   std::string& problemPath(void);
   /** \brief Returns id of current pe. */
@@ -116,6 +118,7 @@ private:
   T     solverAbsoluteTolerance_;        /**< Specifies the absolute error tolerance for iterative solvers. */
   T     solverRelativeTolerance_;        /**< Specifies the relative error tolerance for iterative solvers. */
   psInt solverVerbose_;                  /**< Specifies the level of console output produced by iterative solvers. */
+  T     amgStrengthThreshold_;           /**< Specifies the strength of connection threshold of algebraic multigrid. Defaults to 0.08 */
 
   // Save problem folder
   std::string problemPath_;              /**< Path to folder containing Geometry.dat and Parameters.dat input files. */
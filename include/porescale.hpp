@@ -3,6 +3,7 @@
 
 #include "define.hpp"
 #include "types.hpp"
+#include "memory.hpp"
 #include "parameters.hpp"
 #include "mesh.hpp"
 #include "matrix.hpp"
@@ -3,12 +3,95 @@
 #define _PORESCALE_SOLVE_H_
 
 #include "parameters.hpp"
+#include "matrix.hpp"
 
 // system includes
+#include <chrono>
 #include <vector>
 
 namespace porescale
 {
+  /** \brief Per iteration telemetry of iterative solvers.
+   *
+   *  A solver given the telemetry by setTelemetry leaves one record per
+   *  iteration: the residual, the seconds this pe spent in SpMV, the
+   *  preconditioner, reductions and vector updates since the previous record,
+   *  and the bytes these kernels stream by their traffic model. SpMV traffic
+   *  is that of sparseMatrixReport, level 1 kernels count the vectors they read
+   *  and write, fused kernels are charged to the phase they end with, and
+   *  preconditioner bytes are not modeled. Host work between kernels is
+   *  charged to the kernel that follows it. Records go into a ring buffer
+   *  allocated up front and a full buffer overwrites the oldest, so recording
+   *  neither allocates nor locks. stdpar kernels return on completion, so host
+   *  timers measure device work. Block solves record the largest column
+   *  residual, their SpMM streams the matrix once and the vectors of every
+   *  right hand side.
+   */
+  class solverTelemetry
+  {
+  public:
+    /** \brief One iteration of one solve. */
+    struct record
+    {
+      psInt  solve;                         /**< Solve number since the last clear. */
+      psInt  iteration;                     /**< Iteration of the solve, 0 for the initial residual. */
+      double residual;                      /**< Residual norm after the iteration. */
+      double seconds[TELEMETRY_PHASES];     /**< Seconds of each phase. */
+      double bytes[TELEMETRY_PHASES];       /**< Modeled bytes of each phase. */
+    };
+
+    /** \brief Construct with room for capacity records. */
+    solverTelemetry(psInt capacity = PORESCALE_TELEMETRY_CAPACITY);
+
+    /** \brief Reallocate for capacity records, the records are cleared. */
+    void setCapacity(psInt capacity);
+    /** \brief Return the number of records the buffer holds. */
+    psInt capacity(void) const;
+    /** \brief Return the number of records held. */
+    psInt size(void) const;
+    /** \brief Record i of the held records, 0 the oldest. */
+    const record& at(psInt i) const;
+    /** \brief Drop all records and restart the solve count. */
+    void clear(void);
+
+    // Recording, called by solvers
+    /** \brief Start a solve, the clock starts for its initial residual. */
+    void beginSolve(void);
+    /** \brief Restart the clock without charging. */
+    void mark(void);
+    /** \brief Charge the time since the last charge or mark and bytes to phase. */
+    void charge(psTelemetryPhase phase, double bytes);
+    /** \brief Close iteration with its residual into the next slot of the buffer. */
+    void commit(psInt iteration, double residual);
+
+    // Summary
+    /** \brief Mean residual reduction per iteration of the last solve, (r_n / r_0)^(1 / n). */
+    double convergenceRate(void) const;
+    /** \brief Mean reduction over the last window iterations of the last solve. */
+    double asymptoticRate(psInt window = 10) const;
+    /** \brief Text summary of the held solves, rates and the time and bandwidth of every phase. */
+    std::string summary(void) const;
+    /** \brief Records as CSV, one line per iteration. */
+    std::string csv(void) const;
+    /** \brief Records and summary as a JSON object. */
+    std::string json(void) const;
+    /** \brief Write csv() to fileName. */
+    void writeCSV(const std::string& fileName) const;
+    /** \brief Write json() to fileName. */
+    void writeJSON(const std::string& fileName) const;
+
+  protected:
+    std::vector<record>                   ring_;    /**< Records, allocated by setCapacity. */
+    psInt                                 head_;    /**< Slot of the next record. */
+    psInt                                 size_;    /**< Records held. */
+    psInt                                 solves_;  /**< Solves begun since the last clear. */
+    record                                current_; /**< Iteration being charged. */
+    std::chrono::steady_clock::time_point mark_;    /**< Time of the last charge or mark. */
+
+    /** \brief First and one past the last held record of the last solve, as indices of at. */
+    void lastSolve_(psInt& begin, psInt& end) const;
+  };
+
   /** \brief Solver class used by model solve functions.
    * 
    */
@@ -19,15 +102,32 @@ namespace porescale
     /** \brief Default constructor. */
     solver(void);
 
+    /** \brief Destructor. */
+    virtual ~solver(void);
+
     /** \brief Init from parameters. */
     virtual void init(parameters<T> * par) = 0;
 
     /** \brief Abstract solver build function. */
     virtual void build(void) = 0;
 
+    /** \brief Set the operator, the solver keeps the pointer. Call build afterwards. */
+    virtual void setMatrix(sparseMatrix<T> * A);
+
+    /** \brief Solve A x = b, x holds the initial guess. */
+    virtual void solve(vector<T>& b, vector<T>& x) = 0;
+
+    /** \brief z ~ A^{-1} r from a zero initial guess, the action as a preconditioner. */
+    virtual void apply(vector<T>& r, vector<T>& z);
+    /** \brief Column wise apply to block vectors. */
+    virtual void apply(blockVector<T>& R, blockVector<T>& Z);
+
   protected:
 
-    bool built_;                /**< Flag determining if solver has been built. */
+    bool              built_;       /**< Flag determining if solver has been built. */
+    sparseMatrix<T> * A_;           /**< Operator, not owned. */
+    vector<T>         columnIn_;    /**< Column workspace of block apply. */
+    vector<T>         columnOut_;   /**< Column workspace of block apply. */
 
   };
 
@@ -50,6 +150,7 @@ namespace porescale
     virtual void build(void) = 0;
 
     /** Gets */
+    psInt   iterations(void) const;
     bool    checkResidual(void) const;
     psInt   minIterations(void) const;
     psInt   maxIterations(void) const;
@@ -65,7 +166,13 @@ namespace porescale
     void setRelativeTolerance(T relativeTolerance);
     void setAbsoluteTolerance(T absoluteTolerance);
 
+    /** \brief Record every iteration into telemetry, not owned, NULL to stop recording. */
+    void setTelemetry(solverTelemetry * telemetry);
+    /** \brief Return the telemetry, NULL when not recording. */
+    solverTelemetry * telemetry(void) const;
+
   protected:
+    psInt   iterations_;
     bool    checkResidual_;
     psInt   minIterations_;
     psInt   maxIterations_;
@@ -74,6 +181,27 @@ namespace porescale
     T       initialResidual_;
     T       currentResidual_;
 
+    solverTelemetry * telemetry_;   /**< Telemetry, not owned, NULL when not recording. */
+    double            spmvBytes_;   /**< Modeled bytes of one SpMV or SpMM with A_. */
+    double            vectorBytes_; /**< Bytes of the local rows of one vector or block vector. */
+
+    /** \brief Start a solve in the telemetry and model the traffic of A_. For nRhs right
+     *         hand sides the matrix streams once per SpMM with nRhs vector columns and a
+     *         block vector counts as one vector.
+     */
+    void beginTelemetry_(psInt nRhs = 1);
+    /** \brief Charge the time since the last charge to phase, count SpMVs for
+     *         TELEMETRY_SPMV and vectors streamed for reductions and updates.
+     */
+    void charge_(psTelemetryPhase phase, double count = 1);
+    /** \brief Close an iteration in the telemetry. */
+    void commit_(psInt iteration, T residual);
+
+    /** \brief Stopping test after iteration iterations: residual checks enabled, at least
+     *         minIterations_ done and a tolerance met by residual against initial.
+     */
+    bool converged_(psInt iterations, T residual, T initial) const;
+
   };
 
   /** \brief Krylov solver derived class.
@@ -93,6 +221,12 @@ namespace porescale
 
     /** \brief Abstract solver build function. */
     virtual void build(void) = 0;
+
+    /** \brief Set the preconditioner, applied as z = M r through solver::apply. NULL for none. */
+    void setPreconditioner(solver<T> * M);
+
+  protected:
+    solver<T> * M_;             /**< Preconditioner, not owned. */
   };
 
   /** \brief CG solver derived class.
@@ -110,9 +244,39 @@ namespace porescale
     /** \brief Init from parameters. */
     virtual void init(parameters<T> * par);
 
-    /** \brief Solver build function. */
+    /** \brief Allocate the workspace of the variant for the matrix. */
     virtual void build(void);
 
+    /** \brief Solve A x = b with the selected variant. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+
+    /** \brief Solve A X = B for all columns at once. Each column runs its own classic CG,
+     *         the iterations share one SpMM and one reduction per inner product.
+     */
+    void solve(blockVector<T>& B, blockVector<T>& X);
+
+    /** \brief Select the variant, build again afterwards. */
+    void setVariant(psCGVariant variant);
+    /** \brief Return the variant. */
+    psCGVariant variant(void) const;
+
+  protected:
+    psCGVariant variant_;       /**< CG variant. */
+
+    // workspace, the pipelined variant uses all of it
+    vector<T> r_, u_, w_, m_, n_, z_, q_, s_, p_;
+
+    // block workspace, built on first use with the number of right hand sides
+    blockVector<T> R_, Z_, P_, Q_;
+
+    /** \brief Classic preconditioned CG. */
+    void solveClassic_(vector<T>& b, vector<T>& x);
+    /** \brief Pipelined preconditioned CG. The fused reduction of each iteration is started
+     *         without waiting and runs while the preconditioner and SpMV it does not depend
+     *         on are applied.
+     */
+    void solvePipelined_(vector<T>& b, vector<T>& x);
+
   };
 
   /** \brief biCGStab solver derived class
@@ -121,61 +285,964 @@ namespace porescale
   template <typename T>
   class biCGStabSolver : public krylovSolver<T>
   {
+  public:
+    /** \brief Default constructor. */
+    biCGStabSolver(void);
+    /** \brief Construct from parameters. */
+    biCGStabSolver(parameters<T> * par);
+
+    /** \brief Init from parameters. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Allocate the workspace for the matrix and ell. */
+    virtual void build(void);
+
+    /** \brief Solve A x = b, right preconditioned so the residual is the true one. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+
+    /** \brief Solve A X = B for all columns at once. Each column runs its own BiCGStab
+     *         whatever ell, the iterations share one SpMM per operator application and
+     *         one reduction per group of inner products.
+     */
+    void solve(blockVector<T>& B, blockVector<T>& X);
+
+    /** \brief Set the degree of the minimal residual polynomial, 1 is BiCGStab and
+     *         ell > 1 BiCGStab(ell). Build again afterwards.
+     */
+    void setEll(psInt ell);
+    /** \brief Return the degree of the minimal residual polynomial. */
+    psInt ell(void) const;
+
+  protected:
+    psInt ell_;                 /**< Degree of the minimal residual polynomial. */
+
+    // BiCGStab workspace
+    vector<T> r_, rHat_, p_, pHat_, v_, s_, sHat_, t_;
+
+    // BiCGStab(ell) workspace, residuals r_0..r_ell and directions u_0..u_ell
+    std::vector<vector<T>> rs_, us_;
+    vector<T>              xHat_;   /**< Update of x before the preconditioner. */
+
+    // block workspace, built on first use with the number of right hand sides
+    blockVector<T> R_, RHat_, P_, PHat_, V_, S_, SHat_, T_;
+
+    /** \brief BiCGStab with two reductions per iteration. */
+    void solveBiCGStab_(vector<T>& b, vector<T>& x);
+    /** \brief BiCGStab(ell), the minimal residual step uses one Gram matrix reduction. */
+    void solveEll_(vector<T>& b, vector<T>& x);
+    /** \brief out = A M^{-1} in, through pHat_ when preconditioned. */
+    void applyOperator_(vector<T>& in, vector<T>& out);
+  };
+
+  /** \brief Restarted flexible GMRES derived class.
+   *
+   *  Right preconditioned, the preconditioned directions are kept so the
+   *  preconditioner may change between iterations. Arnoldi orthogonalizes
+   *  with classical Gram-Schmidt and one reorthogonalization (CGS2) against
+   *  the basis stored as one denseMatrix, two gemvT reductions per step.
+   */
+  template <typename T>
+  class FGMRESSolver : public krylovSolver<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    FGMRESSolver(void);
+    /** \brief Construct from parameters. */
+    FGMRESSolver(parameters<T> * par);
+
+    /** \brief Init from parameters. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Allocate the bases for the matrix and restart length. */
+    virtual void build(void);
+
+    /** \brief Solve A x = b. */
+    virtual void solve(vector<T>& b, vector<T>& x);
 
+    /** \brief Solve A X = B for all columns at once. Each column runs its own Arnoldi
+     *         process, the steps share one SpMM and each CGS2 pass one reduction.
+     */
+    void solve(blockVector<T>& B, blockVector<T>& X);
+
+    /** \brief Set the restart length, build again afterwards. */
+    void setRestart(psInt restart);
+    /** \brief Return the restart length. */
+    psInt restart(void) const;
+
+  protected:
+    psInt          restart_;    /**< Krylov dimension before restart. */
+    denseMatrix<T> V_;          /**< Orthonormal basis, restart + 1 columns. */
+    denseMatrix<T> Z_;          /**< Preconditioned directions, restart columns. */
+    vector<T>      v_;          /**< Basis column with halo. */
+    vector<T>      z_;          /**< Preconditioned column with halo. */
+    vector<T>      w_;          /**< Arnoldi vector. */
+
+    // block workspace, built on first use with the number of right hand sides
+    std::vector<blockVector<T>> VBlocks_;   /**< Block basis, restart + 1 blocks. */
+    std::vector<blockVector<T>> ZBlocks_;   /**< Preconditioned block directions. */
+    blockVector<T>              W_;         /**< Block Arnoldi vector. */
   };
 
+  /** \brief Recycling GCRO-DR Krylov solver for sequences of related systems.
+   *
+   *  Right preconditioned and flexible as FGMRES. A recycle space U with C = A U
+   *  orthonormal is kept from one solve to the next. Every solve recomputes C from
+   *  the current matrix, so the values or the matrix itself may change between
+   *  solves with the same rows, and starts from the minimal residual correction
+   *  x += U C^T r. In RECYCLE_DEFLATION mode each cycle runs m - k Arnoldi steps
+   *  of (I - C C^T) A M and refreshes U from the augmented space, an approximate
+   *  harmonic Ritz subspace of the smallest eigenvalues found by block inverse
+   *  iteration on the projected problem. In RECYCLE_SOLUTIONS mode U spans the k
+   *  previous solutions, only the initial guess is projected and the cycles are
+   *  plain FGMRES. The recycle space follows one sequence of systems, so block
+   *  right hand sides are not solved together and go through the column wise
+   *  solver::apply.
+   */
+  template <typename T>
+  class GCRODRSolver : public krylovSolver<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    GCRODRSolver(void);
+    /** \brief Construct from parameters. */
+    GCRODRSolver(parameters<T> * par);
+
+    /** \brief Init from parameters. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Allocate the bases, the recycle space is kept while the rows are unchanged. */
+    virtual void build(void);
+
+    /** \brief Solve A x = b, x holds the initial guess. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+
+    /** \brief Set the restart length, build again afterwards. */
+    void setRestart(psInt restart);
+    /** \brief Return the restart length. */
+    psInt restart(void) const;
+    /** \brief Set the dimension k of the recycle space, build again afterwards. */
+    void setRecycle(psInt k);
+    /** \brief Return the requested dimension of the recycle space. */
+    psInt recycle(void) const;
+    /** \brief Set the recycle mode, the recycle space is cleared. */
+    void setRecycleMode(psRecycleMode mode);
+    /** \brief Return the recycle mode. */
+    psRecycleMode recycleMode(void) const;
+    /** \brief Drop the recycle space, e.g. before an unrelated system. */
+    void clearRecycle(void);
+    /** \brief Current dimension of the recycle space. */
+    psInt recycleDimension(void) const;
+
+  protected:
+    psInt          restart_;    /**< Krylov dimension before restart, recycle space included. */
+    psInt          recycle_;    /**< Requested recycle dimension k. */
+    psRecycleMode  mode_;       /**< Recycle mode. */
+    psInt          kr_;         /**< Current recycle dimension. */
+    psInt          next_;       /**< Next column replaced by a solution. */
+    denseMatrix<T> V_;          /**< Orthonormal basis, restart + 1 columns. */
+    denseMatrix<T> Z_;          /**< Preconditioned directions, restart columns. */
+    denseMatrix<T> U_;          /**< Recycle space, A U = C. */
+    denseMatrix<T> Ut_;         /**< Preimage of U under the preconditioner, in the span of V. */
+    denseMatrix<T> C_;          /**< Orthonormal image of the recycle space. */
+    denseMatrix<T> S_;          /**< Scratch columns of a recycle update. */
+    vector<T>      v_;          /**< Basis column with halo. */
+    vector<T>      z_;          /**< Preconditioned column with halo. */
+    vector<T>      w_;          /**< Arnoldi vector. */
+    vector<T>      r_;          /**< Residual. */
+
+    /** \brief C = A U orthonormalized, U and Ut transformed alike, dependent columns dropped. */
+    void orthonormalizeRecycle_(void);
+    /** \brief Recycle space from a cycle of s steps, G the (kr + s + 1) x (kr + s) projection
+     *         A [U, Z] = [C, V] G, column major with leading dimension ld.
+     */
+    void updateRecycle_(psInt s, const T * G, psInt ld);
+  };
+
+  /** \brief Smoother derived class.
+   *
+   *  Relaxation of A x = b for multigrid levels. solve runs maxIterations()
+   *  sweeps, by default a single sweep without residual checks, so a smoother
+   *  is also usable as a preconditioner.
+   */
+  template <typename T>
+  class smoother : public iterativeSolver<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    smoother(void);
+    /** \brief Construct from parameters. */
+    smoother(parameters<T> * par);
+
+    /** \brief Init from parameters, the tolerances apply when residual checks are enabled. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Abstract smoother build function. */
+    virtual void build(void) = 0;
+
+    /** \brief sweeps relaxations of A x = b in place. */
+    virtual void smooth(vector<T>& b, vector<T>& x, psInt sweeps) = 0;
+
+    /** \brief maxIterations() sweeps, stopping early when residual checks are enabled. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+
+  protected:
+    vector<T> invDiagonal_;     /**< Inverse diagonal of A, 1 where the diagonal is 0. */
+    vector<T> r_;               /**< Residual workspace. */
+    vector<T> xHalo_;           /**< x staged with a halo covering the columns of A. */
+
+    /** \brief Allocate the workspace and fill invDiagonal_ for the matrix. */
+    void buildWorkspace_(void);
+    /** \brief x itself when its window covers the columns of A, else x copied into xHalo_. */
+    vector<T>& haloed_(vector<T>& x);
+    /** \brief Gershgorin upper bound of the eigenvalues of D^{-1} A, collective. CSR only. */
+    T lambdaMaxBound_(void);
+    /** \brief Largest eigenvalue of D^{-1} A by steps power iterations, SpMV only. */
+    T estimateLambdaMax_(psInt steps);
+    /** \brief 1.1 times the power estimate of lambdaMax(D^{-1} A), capped by the Gershgorin bound. */
+    T lambdaMaxEstimate_(void);
+  };
+
+  /** \brief Weighted Jacobi smoother, x += omega D^{-1} (b - A x).
+   *
+   *  The default weight 4 / (3 lambdaMax(D^{-1} A)) takes lambdaMax at build from
+   *  1.1 times a power iteration estimate, capped by the Gershgorin bound, and
+   *  damps the upper two thirds of the spectrum. CSR only.
+   */
+  template <typename T>
+  class jacobiSmoother : public smoother<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    jacobiSmoother(void);
+    /** \brief Construct from parameters. */
+    jacobiSmoother(parameters<T> * par);
+
+    /** \brief Inverse diagonal and the weight. */
+    virtual void build(void);
+
+    /** \brief sweeps Jacobi sweeps, one SpMV and one fused update each. */
+    virtual void smooth(vector<T>& b, vector<T>& x, psInt sweeps);
+
+    /** \brief Set the weight, 0 estimates it at build. Build again afterwards. */
+    void setWeight(T weight);
+    /** \brief Return the weight in use. */
+    T weight(void) const;
+
+  protected:
+    T weight_;                  /**< Requested weight, 0 for the estimate. */
+    T omega_;                   /**< Weight in use. */
+  };
+
+  /** \brief Multicolor Gauss-Seidel / SOR smoother.
+   *
+   *  Local rows are colored so no two coupled rows share a color, red-black on a
+   *  voxel stencil, and each color is relaxed in parallel with
+   *  x_i = (1 - omega) x_i + omega (b_i - sum_{j != i} a_ij x_j) / a_ii. Symmetric
+   *  sweeps run the colors forward then backward. Rows on other pes are taken
+   *  from the halo exchanged before every pass, Jacobi between pes. CSR only.
+   */
+  template <typename T>
+  class gaussSeidelSmoother : public smoother<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    gaussSeidelSmoother(void);
+    /** \brief Construct from parameters. */
+    gaussSeidelSmoother(parameters<T> * par);
+
+    /** \brief Color the rows and allocate the workspace. */
+    virtual void build(void);
+
+    /** \brief sweeps Gauss-Seidel sweeps. */
+    virtual void smooth(vector<T>& b, vector<T>& x, psInt sweeps);
+
+    /** \brief Set the relaxation weight, 1 for Gauss-Seidel. */
+    void setWeight(T weight);
+    /** \brief Return the relaxation weight. */
+    T weight(void) const;
+    /** \brief Set forward then backward sweeps, the default, or forward only. */
+    void setSymmetric(bool symmetric);
+    /** \brief Return true for symmetric sweeps. */
+    bool symmetric(void) const;
+    /** \brief Number of colors of the local rows. */
+    psInt colors(void) const;
+
+  protected:
+    T                  weight_;         /**< Relaxation weight. */
+    bool               symmetric_;      /**< Forward and backward passes. */
+    std::vector<psInt> colorPtr_;       /**< Offsets of every color in colorRows_. */
+    std::vector<psInt> colorRows_;      /**< Local rows grouped by color. */
+
+    /** \brief Relax the rows of one color in place, x with a halo covering the columns of A. */
+    void relaxColor_(psInt color, const vector<T>& b, vector<T>& x);
+  };
+
+  /** \brief Chebyshev polynomial smoother.
+   *
+   *  Every sweep applies a Chebyshev polynomial of the given degree in D^{-1} A,
+   *  minimal on [upper / eigenRatio, upper], upper 1.1 times a power iteration
+   *  estimate of lambdaMax at build, capped by the Gershgorin bound. The default
+   *  ratio 4 targets the top three quarters of the spectrum. Sweeps need only
+   *  SpMVs and vector updates. CSR only.
+   */
+  template <typename T>
+  class chebyshevSmoother : public smoother<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    chebyshevSmoother(void);
+    /** \brief Construct from parameters. */
+    chebyshevSmoother(parameters<T> * par);
+
+    /** \brief Eigenvalue bounds and the workspace. */
+    virtual void build(void);
+
+    /** \brief sweeps polynomial applications, degree SpMVs each. */
+    virtual void smooth(vector<T>& b, vector<T>& x, psInt sweeps);
+
+    /** \brief Set the polynomial degree. */
+    void setDegree(psInt degree);
+    /** \brief Return the polynomial degree. */
+    psInt degree(void) const;
+    /** \brief Set the ratio of the upper and lower bounds, build again afterwards. */
+    void setEigenRatio(T ratio);
+    /** \brief Return the ratio of the upper and lower bounds. */
+    T eigenRatio(void) const;
+    /** \brief Return the upper bound in use. */
+    T lambdaMax(void) const;
+
+  protected:
+    psInt     degree_;          /**< Polynomial degree. */
+    T         eigenRatio_;      /**< Upper over lower bound. */
+    T         lambdaMax_;       /**< Upper bound. */
+    vector<T> z_;               /**< Preconditioned residual. */
+    vector<T> d_;               /**< Update direction, with a halo covering the columns of A. */
+  };
+
+  template <typename T> class directSolver;
+
   /** \brief Multigrid Solver derived class
-   * 
+   *
+   *  Cycles over a hierarchy of operators A_l, l = 0 the matrix set by setMatrix,
+   *  with prolongations P_l from level l + 1 to l and restrictions R_l. Derived
+   *  classes build the operators, the base adds smoothers, level vectors and the
+   *  coarsest solve, a dense factorization replicated on every pe up to
+   *  PORESCALE_MG_DENSE rows and a replicated sparse LDL^T beyond, which assumes
+   *  symmetry. solve runs cycles until the tolerances are met, as a
+   *  preconditioner set one iteration without checks.
+   *  The hierarchy is kept across solves until a setting or the matrix changes,
+   *  setup and solve times are kept apart.
    */
   template <typename T>
   class multigridSolver : public iterativeSolver<T>
   {
-    
+  public:
+    /** \brief Default constructor. */
+    multigridSolver(void);
+    /** \brief Construct from parameters. */
+    multigridSolver(parameters<T> * par);
+
+    /** \brief Destructor. */
+    virtual ~multigridSolver(void);
+
+    /** \brief Init from parameters. */
+    virtual void init(parameters<T> * par) = 0;
+
+    /** \brief Abstract hierarchy build function. */
+    virtual void build(void) = 0;
+
+    /** \brief Cycle on A x = b, x holds the initial guess. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+
+    /** \brief Set the cycle. */
+    void setCycle(psMultigridCycle cycle);
+    /** \brief Return the cycle. */
+    psMultigridCycle cycle(void) const;
+    /** \brief Set the smoother of every level, build again afterwards. */
+    void setSmoother(psSmootherType type);
+    /** \brief Return the smoother type. */
+    psSmootherType smootherType(void) const;
+    /** \brief Set the sweeps before and after the coarse correction. */
+    void setSweeps(psInt preSweeps, psInt postSweeps);
+    /** \brief Return the sweeps before the coarse correction. */
+    psInt preSweeps(void) const;
+    /** \brief Return the sweeps after the coarse correction. */
+    psInt postSweeps(void) const;
+    /** \brief Set the largest number of levels including the finest, build again afterwards. */
+    void setMaxLevels(psInt maxLevels);
+    /** \brief Return the largest number of levels. */
+    psInt maxLevels(void) const;
+    /** \brief Coarsening stops at a level of at most coarseSize global rows, build again afterwards. */
+    void setCoarseSize(psInt coarseSize);
+    /** \brief Return the coarse size. */
+    psInt coarseSize(void) const;
+
+    /** \brief Number of levels of the hierarchy. */
+    psInt levels(void) const;
+    /** \brief Operator of a level. */
+    const sparseMatrix<T>& levelMatrix(psInt level) const;
+    /** \brief Global nonzeros of all levels over those of the finest. */
+    double operatorComplexity(void) const;
+    /** \brief Seconds of the last hierarchy build on the slowest pe. */
+    double setupTime(void) const;
+    /** \brief Seconds spent in solve since the last hierarchy build. */
+    double solveTime(void) const;
+
+  protected:
+    psMultigridCycle cycle_;            /**< Cycle type. */
+    psSmootherType   smootherType_;     /**< Smoother of every level. */
+    psInt            preSweeps_;        /**< Sweeps before the coarse correction. */
+    psInt            postSweeps_;       /**< Sweeps after the coarse correction. */
+    psInt            maxLevels_;        /**< Largest number of levels. */
+    psInt            coarseSize_;       /**< Global rows at which coarsening stops. */
+    double           setupTime_;        /**< Seconds of the last build. */
+    double           solveTime_;        /**< Seconds of solves since the last build. */
+
+    std::vector<sparseMatrix<T> *> levelA_;     /**< Operators, levelA_[0] is A_ and not owned. */
+    std::vector<sparseMatrix<T> *> P_;          /**< Prolongation from level l + 1 to l. */
+    std::vector<sparseMatrix<T> *> R_;          /**< Restriction from level l to l + 1. */
+    std::vector<smoother<T> *>     smoothers_;  /**< Smoother of every level. */
+    std::vector<vector<T> *>       x_;          /**< Level solutions, with halos for A_l and P_{l-1}. */
+    std::vector<vector<T> *>       b_;          /**< Level right hand sides, b_[0] is unused. */
+    std::vector<vector<T> *>       r_;          /**< Level residuals, with halos for R_l. */
+
+    // coarsest level
+    bool                coarseDense_;   /**< Coarsest level factored densely. */
+    directSolver<T>   * coarseDirect_;  /**< Sparse factorization of a larger coarsest level. */
+    std::vector<double> coarseLU_;      /**< Row major LU factors with partial pivoting. */
+    std::vector<psInt>  coarsePivots_;  /**< Pivot row of every elimination step. */
+    std::vector<char>   coarseNull_;    /**< Steps with a vanishing pivot, their unknowns are set to 0. */
+    vector<T>           coarseFull_;    /**< Coarsest vector with a halo of all rows. */
+
+    /** \brief Release the hierarchy. */
+    void clearLevels_(void);
+    /** \brief Append a coarser level, ownership of Ac, P and R passes to the solver. */
+    void addLevel_(sparseMatrix<T> * Ac, sparseMatrix<T> * P, sparseMatrix<T> * R);
+    /** \brief Smoothers, level vectors and the coarsest solve once the operators are set,
+     *         the setup time is measured from setupStart.
+     */
+    void finishBuild_(std::chrono::steady_clock::time_point setupStart);
+    /** \brief New smoother of smootherType_. */
+    smoother<T> * newSmoother_(void) const;
+    /** \brief One cycle of the given type on level l. */
+    void cycleLevel_(psInt level, psMultigridCycle type, vector<T>& b);
+    /** \brief Solve on the coarsest level. */
+    void coarseSolve_(vector<T>& b, vector<T>& x);
   };
 
-  /** \brief AMG Solver derived class.
-   * 
+  /** \brief Smoothed aggregation AMG derived class.
+   *
+   *  Every level keeps the connections |a_ij| > theta sqrt(|a_ii a_jj|), theta
+   *  the strength threshold, and aggregates around a distance two maximal
+   *  independent set of that graph, found by parallel random priority rounds.
+   *  Aggregation does not cross pes. The tentative prolongator is piecewise
+   *  constant and orthonormal, smoothed once by weighted Jacobi,
+   *  P = (I - omega D^{-1} A) P_tent with the omega of minimal energy of P_tent
+   *  applied to random signs per aggregate.
+   *  R = P^T and coarse operators are Galerkin, R A P. The matrix must be CSR and
+   *  structurally symmetric.
    */
   template <typename T>
   class AMGSolver : public multigridSolver<T>
   {
+  public:
+    /** \brief Default constructor. */
+    AMGSolver(void);
+    /** \brief Construct from parameters. */
+    AMGSolver(parameters<T> * par);
+
+    /** \brief Init tolerances and the strength threshold from parameters. */
+    virtual void init(parameters<T> * par);
 
+    /** \brief Aggregate and build the hierarchy. */
+    virtual void build(void);
+
+    /** \brief Set the strength of connection threshold, build again afterwards. */
+    void setStrengthThreshold(T theta);
+    /** \brief Return the strength of connection threshold. */
+    T strengthThreshold(void) const;
+
+  protected:
+    T strengthThreshold_;       /**< Strength of connection threshold. */
+
+    /** \brief Aggregate of every local row of A, -1 for rows without strong
+     *         connections. Returns the number of aggregates.
+     */
+    psInt aggregate_(sparseMatrix<T>& A, std::vector<psInt>& aggregates) const;
+    /** \brief Smoothed prolongator P, restriction R and coarse operator Ac of A.
+     *         Returns false when aggregation does not coarsen.
+     */
+    bool coarsen_(sparseMatrix<T>& A, sparseMatrix<T>& P, sparseMatrix<T>& R, sparseMatrix<T>& Ac) const;
+  };
+
+  /** \brief Voxel grid of one multigrid level.
+   *
+   *  Pore voxels are the unknowns, numbered lexicographically with x fastest,
+   *  voxel (x, y, z) at index x + nx (y + ny z).
+   */
+  struct voxelGrid
+  {
+    psInt nx;                   /**< Voxels in x. */
+    psInt ny;                   /**< Voxels in y. */
+    psInt nz;                   /**< Voxels in z. */
+    std::vector<psInt> rank;    /**< Pores before each voxel, nx ny nz + 1 entries. */
   };
 
   /** \brief Geometric multigrid derived class.
-   * 
+   *
+   *  Coarsens the voxel geometry by 2 in every direction with more than one
+   *  voxel, a coarse voxel is pore when any of its children is, so no throat
+   *  closes. Prolongation is cell centered trilinear, 3/4 and 1/4 weights
+   *  along each direction, restricted to pore coarse voxels and renormalized.
+   *  Coarse operators are Galerkin, R A P with R = P^T. The fine matrix must be
+   *  CSR with one row per pore voxel in lexicographic order.
    */
   template <typename T>
   class geometricMultigridSolver : public multigridSolver<T>
   {
+  public:
+    /** \brief Default constructor. */
+    geometricMultigridSolver(void);
+    /** \brief Construct from parameters, takes the voxel geometry. */
+    geometricMultigridSolver(parameters<T> * par);
 
+    /** \brief Init tolerances and the voxel geometry from parameters. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Coarsen the geometry and build the hierarchy. */
+    virtual void build(void);
+
+    /** \brief Set the fine geometry, voxels equal to 1 are solid. Build again afterwards. */
+    void setGeometry(const psUInt8 * voxels, psInt nx, psInt ny, psInt nz);
+
+  protected:
+    std::vector<voxelGrid> grids_;      /**< Grid of every level. */
+
+    /** \brief Grid coarser than grids_.back(). */
+    void coarsenGrid_(void);
+    /** \brief Prolongation rows [rowBegin, rowEnd) from level + 1 to level. */
+    void buildProlongation_(psInt level, psInt rowBegin, psInt rowEnd, sparseMatrix<T>& P) const;
+    /** \brief Restriction rows [rowBegin, rowEnd) from level to level + 1, R = P^T. */
+    void buildRestriction_(psInt level, psInt rowBegin, psInt rowEnd, sparseMatrix<T>& R) const;
   };
 
-  /** \brief Smoother derived class. 
+  /** \brief Preconditioner derived class.
    * 
    */
   template <typename T>
-  class smoother : public iterativeSolver<T>
+  class preconditioner : public solver<T>
   {
+  public:
+    /** \brief Default constructor. */
+    preconditioner(void);
 
+    /** \brief z = M^{-1} r. */
+    virtual void apply(vector<T>& r, vector<T>& z) = 0;
+    using solver<T>::apply;
+
+    /** \brief x = M^{-1} b, the guess in x is ignored. */
+    virtual void solve(vector<T>& b, vector<T>& x);
   };
 
-  /** \brief Preconditioner derived class.
-   * 
+  /** \brief Incomplete LU preconditioner, ILU(k).
+   *
+   *  Factors the block of local rows and columns, couplings to other pes are
+   *  dropped, so across pes it is block Jacobi. The pattern keeps fill up to
+   *  level k, k = 0 the pattern of A. Rows are scheduled by levels of the
+   *  dependency graph of L, rows of one level are factored and forward solved
+   *  in parallel, and by levels of U for the backward solve. The symbolic
+   *  phase for k > 0 runs row by row. CSR only.
    */
   template <typename T>
-  class preconditioner : public solver<T>
+  class ILUPreconditioner : public preconditioner<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    ILUPreconditioner(void);
+
+    /** \brief Init from parameters, nothing is read. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Symbolic and numeric factorization. */
+    virtual void build(void);
+
+    /** \brief z = U^{-1} L^{-1} r. */
+    virtual void apply(vector<T>& r, vector<T>& z);
+    using solver<T>::apply;
+
+    /** \brief Set the fill level k, build again afterwards. */
+    void setFillLevel(psInt k);
+    /** \brief Return the fill level. */
+    psInt fillLevel(void) const;
+    /** \brief Entries of the local factors. */
+    psInt factorNnz(void) const;
+    /** \brief Levels of the forward solve. */
+    psInt lowerLevels(void) const;
+    /** \brief Levels of the backward solve. */
+    psInt upperLevels(void) const;
+
+  protected:
+    psInt              fillLevel_;      /**< Fill level k. */
+    std::vector<psInt> rowPtr_;         /**< Row offsets of L and U stored together. */
+    std::vector<psInt> colArray_;       /**< Local columns, sorted within a row. */
+    std::vector<psInt> diagonal_;       /**< Position of the diagonal of every row. */
+    std::vector<T>     values_;         /**< Unit lower L below, U on and above the diagonal. */
+    std::vector<psInt> lowerPtr_;       /**< Offsets of every level in lowerRows_. */
+    std::vector<psInt> lowerRows_;      /**< Rows grouped by level of L. */
+    std::vector<psInt> upperPtr_;       /**< Offsets of every level in upperRows_. */
+    std::vector<psInt> upperRows_;      /**< Rows grouped by level of U. */
+
+    /** \brief Pattern of the factors with fill up to level k. */
+    void symbolic_(void);
+    /** \brief Rows grouped by levels of L and of U. */
+    void schedule_(void);
+    /** \brief Numeric factorization over the levels of L. */
+    void factor_(void);
+  };
+
+  /** \brief Block preconditioner of the saddle point system K = [A B^T; B 0].
+   *
+   *  A is the velocity block, B the divergence and B^T its transpose, held as
+   *  separate matrices. Vectors of K hold on every pe its velocity rows followed
+   *  by its pressure rows, the layout assemble produces. The velocity block is
+   *  solved by an inner solver, one Gauss-Seidel smoothed AMG V-cycle unless one
+   *  is set, and the Schur complement S = B A^{-1} B^T is approximated by
+   *   - the pressure mass, S^{-1} ~ viscosity Mp^{-1} with Mp lumped, the identity
+   *     unless set, which is the mass of a finite difference scaling,
+   *   - the least squares commutator, S^{-1} ~ L^{-1} B D^{-1} A D^{-1} B^T L^{-1}
+   *     with D = diag(A) and L = B D^{-1} B^T solved by one AMG V-cycle. The
+   *     commutator degrades mildly with h next to walls, the mass does not.
+   *  Inner solves are inexact, so the outer Krylov method should be flexible.
+   */
+  template <typename T>
+  class saddlePointPreconditioner : public preconditioner<T>
   {
+  public:
+    /** \brief Default constructor. */
+    saddlePointPreconditioner(void);
+
+    /** \brief Destructor. */
+    virtual ~saddlePointPreconditioner(void);
+
+    /** \brief Init from parameters, nothing is read. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Inner solvers, Schur approximation and workspace. */
+    virtual void build(void);
+
+    /** \brief z = P^{-1} r in the layout of K. */
+    virtual void apply(vector<T>& r, vector<T>& z);
+    using solver<T>::apply;
+
+    /** \brief Set the blocks, the preconditioner keeps the pointers. Build again afterwards. */
+    void setBlocks(sparseMatrix<T> * A, sparseMatrix<T> * B, sparseMatrix<T> * Bt);
+    /** \brief Assemble K in the layout apply expects. Collective. */
+    void assemble(sparseMatrix<T>& K);
+
+    /** \brief Set the block form. */
+    void setForm(psBlockForm form);
+    /** \brief Return the block form. */
+    psBlockForm form(void) const;
+    /** \brief Set the Schur complement approximation, build again afterwards. */
+    void setSchurApproximation(psSchurApproximation schur);
+    /** \brief Return the Schur complement approximation. */
+    psSchurApproximation schurApproximation(void) const;
+    /** \brief Set the viscosity scaling the pressure mass. */
+    void setViscosity(T viscosity);
+    /** \brief Return the viscosity. */
+    T viscosity(void) const;
+    /** \brief Set the pressure mass, NULL for the identity. Build again afterwards. */
+    void setPressureMass(sparseMatrix<T> * Mp);
+    /** \brief Set the velocity block solver, NULL for one AMG V-cycle. Its matrix is set at build. */
+    void setVelocitySolver(solver<T> * S);
+    /** \brief Set the solver of L for the commutator, NULL for one AMG V-cycle. Its matrix is set at build. */
+    void setPressureSolver(solver<T> * S);
+
+  protected:
+    psBlockForm          form_;             /**< Block form. */
+    psSchurApproximation schur_;            /**< Schur complement approximation. */
+    T                    viscosity_;        /**< Viscosity of the pressure mass approximation. */
+    sparseMatrix<T>    * Au_;               /**< Velocity block, not owned. */
+    sparseMatrix<T>    * B_;                /**< Divergence, not owned. */
+    sparseMatrix<T>    * Bt_;               /**< Transpose of the divergence, not owned. */
+    sparseMatrix<T>    * Mp_;               /**< Pressure mass, not owned, NULL for the identity. */
+    solver<T>          * velocitySolver_;   /**< Velocity block solver. */
+    solver<T>          * pressureSolver_;   /**< Solver of L. */
+    bool                 ownVelocity_;      /**< velocitySolver_ is owned. */
+    bool                 ownPressure_;      /**< pressureSolver_ is owned. */
+    sparseMatrix<T>      L_;                /**< B D^{-1} B^T of the commutator. */
+    vector<T>            invMass_;          /**< viscosity over the lumped pressure mass. */
+    vector<T>            invDiagonal_;      /**< D^{-1} of the velocity block. */
+    vector<T>            ru_;               /**< Velocity residual. */
+    vector<T>            zu_;               /**< Velocity correction, with halos covering A and B. */
+    vector<T>            wu_;               /**< Velocity workspace, with halos covering A and B. */
+    vector<T>            vu_;               /**< Velocity workspace, with halos covering A and B. */
+    vector<T>            rp_;               /**< Pressure residual. */
+    vector<T>            zp_;               /**< Pressure correction, with a halo covering B^T. */
+    vector<T>            wp_;               /**< Pressure workspace, with a halo covering B^T. */
 
+    /** \brief z = S^{-1} r with the Schur approximation. */
+    void schurSolve_(vector<T>& r, vector<T>& z);
   };
 
-  /** \brief Direct solver derived class.
-   * 
+  /** \brief Supernodal sparse Cholesky or LDL^T direct solver of a symmetric matrix.
+   *
+   *  By default all rows are gathered and factored on every pe, a replicated solve
+   *  for coarse grids. setLocal factors the block of local rows and columns alone,
+   *  couplings to other pes dropped, for subdomain problems. The symbolic phase
+   *  orders by nested dissection, postorders the elimination tree and groups its
+   *  chains into supernodes, padding supernodes narrower than PORESCALE_DIRECT_RELAX
+   *  columns. The numeric phase is left looking over levels of the supernodal tree,
+   *  supernodes of one level are factored in parallel, and levels of fewer
+   *  supernodes than chunks run threaded dense kernels on each. Solves follow the
+   *  same levels, the factors are kept for any number of right hand sides and
+   *  buildNumeric refactors new values on the same pattern. Only the lower triangle
+   *  in the new ordering is read and pivots are not exchanged, a pivot below round
+   *  off of the largest diagonal marks a null direction whose unknown is set to 0.
+   *  CSR only.
    */
   template <typename T>
   class directSolver : public solver<T>
   {
+  public:
+    /** \brief Default constructor. */
+    directSolver(void);
+
+    /** \brief Init from parameters, nothing is read. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Set the operator, the symbolic phase is redone at build. */
+    virtual void setMatrix(sparseMatrix<T> * A);
+
+    /** \brief Symbolic phase unless done for this matrix, then the numeric phase. */
+    virtual void build(void);
+    /** \brief Ordering, elimination tree, supernodes and schedule from the pattern of A. */
+    void buildSymbolic(void);
+    /** \brief Factorization with the current values of A on the pattern of buildSymbolic. */
+    void buildNumeric(void);
+
+    /** \brief x = A^{-1} b, the guess in x is ignored. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+    /** \brief z = A^{-1} r. */
+    virtual void apply(vector<T>& r, vector<T>& z);
+    using solver<T>::apply;
+
+    /** \brief Set the factorization, build again afterwards. */
+    void setFactorization(psDirectFactorization factorization);
+    /** \brief Return the factorization. */
+    psDirectFactorization factorization(void) const;
+    /** \brief Factor the local block only rather than all rows, build again afterwards. */
+    void setLocal(bool local);
+    /** \brief Return true if the local block is factored. */
+    bool local(void) const;
+    /** \brief Number of supernodes. */
+    psInt supernodes(void) const;
+    /** \brief Levels of the supernodal elimination tree. */
+    psInt treeLevels(void) const;
+    /** \brief Entries of the supernodal panels of L, padding included. */
+    int64_t factorNnz(void) const;
+    /** \brief Null pivots of the last numeric phase. */
+    psInt nullPivots(void) const;
+
+  protected:
+    psDirectFactorization factorization_;   /**< Cholesky or LDL^T. */
+    bool                  local_;           /**< Factor the local block only. */
+    bool                  analyzed_;        /**< Symbolic phase done for A_. */
+    psInt                 nullPivots_;      /**< Null pivots of the last numeric phase. */
+    sparseMatrix<T>       full_;            /**< All rows of A, unless local or on one pe. */
+    vector<T>             bFull_;           /**< Right hand side with a halo of all rows. */
+
+    std::vector<psInt>   perm_;             /**< Ordering, perm_[new] = old row. */
+    std::vector<psInt>   inverse_;          /**< inverse_[old] = new row. */
+    std::vector<psInt>   lowerPtr_;         /**< Column offsets of the lower triangle of P A P^T. */
+    std::vector<psInt>   lowerRows_;        /**< New row of every lower entry. */
+    std::vector<psInt>   lowerSource_;      /**< Position of every lower entry in the values read. */
+    std::vector<psInt>   nodeBegin_;        /**< First column of every supernode, n at the end. */
+    std::vector<psInt>   structPtr_;        /**< Offsets of the rows of every supernode. */
+    std::vector<psInt>   structRows_;       /**< Rows of every supernode, its columns first, sorted. */
+    std::vector<int64_t> panelPtr_;         /**< Offset of every column major panel. */
+    std::vector<T>       panels_;           /**< Panels of L, D on the diagonal for LDL^T. */
+    std::vector<psInt>   updatePtr_;        /**< Offsets of the descendants updating every supernode. */
+    std::vector<psInt>   updateNode_;       /**< Updating descendant. */
+    std::vector<psInt>   updateBegin_;      /**< First row position of the descendant in the supernode. */
+    std::vector<psInt>   updateEnd_;        /**< Row position of the descendant past the supernode. */
+    std::vector<psInt>   levelPtr_;         /**< Offsets of every tree level in levelNodes_. */
+    std::vector<psInt>   levelNodes_;       /**< Supernodes grouped by level, leaves first. */
+    std::vector<psInt>   scratch_;          /**< Row positions, one slice per chunk. */
+    std::vector<T>       work_;             /**< Dense update blocks, one slice per chunk. */
+    std::vector<char>    null_;             /**< Columns with a null pivot. */
+    std::vector<T>       y_;                /**< Solve workspace in the new ordering. */
+
+    /** \brief Matrix whose values are factored, A_ or full_. */
+    sparseMatrix<T>& source_(void);
+    /** \brief Numeric factorization over the tree levels with the values of source_. */
+    void factor_(void);
+  };
+
+  /** \brief Restricted additive Schwarz preconditioner with a coarse correction.
+   *
+   *  Every pe is a subdomain, or setSubdomains splits its rows into contiguous
+   *  blocks. A subdomain grows by overlap layers, each the range of rows its rows
+   *  reach, which for slab partitions of the voxel ordering are whole planes. Its
+   *  block of A is copied to a matrix held by the pe alone and solved by ILU(0),
+   *  the direct solver or AMG cycles, so the local solves run without
+   *  communication after one halo exchange brings the overlap of the residual.
+   *  Every subdomain keeps its solution on its own rows only. The coarse space is
+   *  a constant per subdomain, its Galerkin operator is replicated and factored on
+   *  every pe, and the coarse correction is applied first with the local solves on
+   *  the residual it leaves. Not symmetric, the outer Krylov method should be
+   *  GMRES or BiCGStab.
+   */
+  template <typename T>
+  class schwarzPreconditioner : public preconditioner<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    schwarzPreconditioner(void);
+
+    /** \brief Destructor. */
+    virtual ~schwarzPreconditioner(void);
+
+    /** \brief Init from parameters, nothing is read. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Subdomains, their factorizations and the coarse operator. Collective. */
+    virtual void build(void);
+
+    /** \brief z = M^{-1} r. Collective for the halo exchange and the coarse residual. */
+    virtual void apply(vector<T>& r, vector<T>& z);
+    using solver<T>::apply;
+
+    /** \brief Set the overlap in layers, build again afterwards. */
+    void setOverlap(psInt overlap);
+    /** \brief Return the overlap. */
+    psInt overlap(void) const;
+    /** \brief Set the subdomains of every pe, build again afterwards. */
+    void setSubdomains(psInt subdomains);
+    /** \brief Return the subdomains of every pe. */
+    psInt subdomains(void) const;
+    /** \brief Set the subdomain solver, build again afterwards. */
+    void setSubdomainSolver(psSubdomainSolver type);
+    /** \brief Return the subdomain solver. */
+    psSubdomainSolver subdomainSolver(void) const;
+    /** \brief Set the AMG cycles of a multigrid subdomain solve. */
+    void setCycles(psInt cycles);
+    /** \brief Return the AMG cycles. */
+    psInt cycles(void) const;
+    /** \brief Enable the coarse correction, build again afterwards. */
+    void setCoarse(bool coarse);
+    /** \brief Return true if the coarse correction is applied. */
+    bool coarse(void) const;
+    /** \brief Rows of the subdomains of this pe, overlap included. */
+    psInt overlapRows(void) const;
+
+  protected:
+    psInt             overlap_;         /**< Overlap layers. */
+    psInt             subdomains_;      /**< Subdomains of every pe. */
+    psSubdomainSolver solverType_;      /**< Subdomain solver. */
+    psInt             cycles_;          /**< AMG cycles of a multigrid subdomain solve. */
+    bool              coarse_;          /**< Coarse correction applied. */
+
+    std::vector<int64_t>           offsets_;        /**< First global row of every subdomain, and the rows. */
+    std::vector<psInt>             windowBegin_;    /**< First global row of every local subdomain with overlap. */
+    std::vector<psInt>             windowEnd_;      /**< Past the last global row with overlap. */
+    std::vector<sparseMatrix<T> *> localA_;         /**< Subdomain blocks, held by this pe alone. */
+    std::vector<solver<T> *>       localSolvers_;   /**< Subdomain solvers. */
+    std::vector<vector<T> *>       localR_;         /**< Subdomain residuals. */
+    std::vector<vector<T> *>       localZ_;         /**< Subdomain corrections. */
+    vector<T>                      window_;         /**< Residual with a halo covering every overlap. */
+
+    // coarse correction
+    sparseMatrix<T>  coarseA_;        /**< Galerkin operator of the subdomain constants, replicated. */
+    directSolver<T>  coarseSolver_;   /**< Factorization of coarseA_. */
+    vector<T>        coarseR_;        /**< Coarse residual. */
+    vector<T>        coarseZ_;        /**< Coarse correction. */
+    vector<T>        zc_;             /**< Coarse correction on the rows, with a halo covering A. */
+    vector<T>        residual_;       /**< Residual after the coarse correction. */
+
+    /** \brief Release the subdomains. */
+    void clear_(void);
+  };
+
+  /** \brief Mixed precision iterative refinement.
+   *
+   *  The outer loop runs in T, each step computes the true residual r = b - A x,
+   *  solves A d = r / |r| in float with an inner Krylov solver and preconditioner
+   *  on a float copy of A, and adds |r| d to x. The inner work, bandwidth bound,
+   *  streams float values with the psInt indices unchanged, about two thirds of the
+   *  SpMV bytes of a solve in double, while the outer residual keeps the
+   *  accuracy of T. The inner solver is FGMRES preconditioned by one Gauss-Seidel
+   *  smoothed AMG V-cycle unless set. A step reducing the residual by less than
+   *  the stagnation ratio twice in a row, or a float overflow, falls back to the
+   *  same solver in T from the current x. The tolerances and maxIterations apply
+   *  to the outer loop.
+   */
+  template <typename T>
+  class mixedPrecisionSolver : public iterativeSolver<T>
+  {
+  public:
+    /** \brief Default constructor. */
+    mixedPrecisionSolver(void);
+    /** \brief Construct from parameters. */
+    mixedPrecisionSolver(parameters<T> * par);
+
+    /** \brief Destructor. */
+    virtual ~mixedPrecisionSolver(void);
+
+    /** \brief Init from parameters. */
+    virtual void init(parameters<T> * par);
+
+    /** \brief Float copy of the matrix, the inner solver and the workspace. Build again
+     *         after the values of the matrix change.
+     */
+    virtual void build(void);
+
+    /** \brief Solve A x = b, x holds the initial guess. */
+    virtual void solve(vector<T>& b, vector<T>& x);
+
+    /** \brief Set the inner solver, NULL for FGMRES. Its matrix is set at build. */
+    void setInnerSolver(krylovSolver<float> * S);
+    /** \brief Set the inner preconditioner, NULL for one AMG V-cycle. Its matrix is set at build. */
+    void setInnerPreconditioner(solver<float> * M);
+    /** \brief Set the relative tolerance of every inner solve. */
+    void setInnerTolerance(float tolerance);
+    /** \brief Return the relative tolerance of inner solves. */
+    float innerTolerance(void) const;
+    /** \brief Set the inner iteration limit of every refinement step. */
+    void setInnerMaxIterations(psInt maxIterations);
+    /** \brief Return the inner iteration limit. */
+    psInt innerMaxIterations(void) const;
+    /** \brief Set the residual ratio of a step counted as stagnation. */
+    void setStagnation(T ratio);
+    /** \brief Return the stagnation ratio. */
+    T stagnation(void) const;
+    /** \brief Inner iterations of the last solve, the fallback solve included. */
+    psInt innerIterations(void) const;
+    /** \brief Return true if the last solve fell back to T. */
+    bool fellBack(void) const;
+
+  protected:
+    float                  innerTolerance_;     /**< Relative tolerance of inner solves. */
+    psInt                  innerMaxIterations_; /**< Inner iteration limit of a step. */
+    T                      stagnation_;         /**< Residual ratio of a stagnating step. */
+    psInt                  innerIterations_;    /**< Inner iterations of the last solve. */
+    bool                   fellBack_;           /**< The last solve fell back to T. */
+    krylovSolver<float>  * inner_;              /**< Inner solver. */
+    solver<float>        * innerM_;             /**< Inner preconditioner. */
+    bool                   ownInner_;           /**< inner_ is owned. */
+    bool                   ownInnerM_;          /**< innerM_ is owned. */
+    sparseMatrix<float>    lowA_;               /**< Float copy of A. */
+    vector<float>          lowR_;               /**< Scaled residual in float. */
+    vector<float>          lowD_;               /**< Inner correction in float. */
+    vector<T>              r_;                  /**< Residual. */
+    vector<T>              xHalo_;              /**< x with a halo covering A. */
+    FGMRESSolver<T>        high_;               /**< Fallback solver in T. */
+    AMGSolver<T>         * highM_;              /**< Preconditioner of the fallback, built on use. */
 
+    /** \brief r_ = b - A x, returns its 2-norm. */
+    T residual_(vector<T>& b, vector<T>& x);
+    /** \brief Finish a solve in T from the current x. */
+    void fallBack_(vector<T>& b, vector<T>& x);
   };
 
 }
@@ -7,6 +7,10 @@
 #ifndef _PORESCALE_TYPES_H_
 #define _PORESCALE_TYPES_H_
 
+#include <limits>
+
+#include "define.hpp"
+
 namespace porescale
 {
 
@@ -81,6 +85,29 @@ struct arrayCOO
   T     value;                                      /**< Double precision value of the array entry. */
 };
 
+/** \brief Offset coding of compressed column index (CCSR) storage.
+ *
+ * A stored code d in [directMin, directMax] is the column offset from the row base,
+ * codes in (escape, directMin) index the table of long offsets, and escape
+ * refers to the next entry of the escaped full column indices.
+ */
+template <typename D>
+struct ccsrCoding
+{
+  static constexpr D     escape    = std::numeric_limits<D>::min();  /**< Escape code. */
+  static constexpr psInt tableSize = (sizeof(D) == 1) ? 16 : 256;   /**< Maximum long offset table size. */
+  static constexpr psInt directMin = (psInt)escape + tableSize + 1;  /**< Smallest directly coded offset. */
+  static constexpr psInt directMax = std::numeric_limits<D>::max();  /**< Largest directly coded offset. */
+};
+
+/** \brief Column offsets of width D that are not directly codable in CCSR. */
+template <typename D>
+inline bool
+ccsrLong(int64_t d)
+{
+  return d < ccsrCoding<D>::directMin || d > ccsrCoding<D>::directMax;
+}
+
 /** \brief Struct for tracking boundary node information.
  *
  */
@@ -104,9 +131,88 @@ enum PORESCALE_INFLOW
 typedef enum
 {
   COO,
-  CSR
+  CSR,
+  BSR,                    /**< Block CSR with square dense blocks, see sparseMatrix::blockSize. */
+  CCSR                    /**< CSR with column indices compressed to 8 or 16 bit offsets from a row base. */
 } psSparseFormat;
 
+/** \brief Enum for sparse matrix vector product kernels. */
+typedef enum
+{
+  SPMV_ROWS,              /**< Chunks of equal row counts, matching the first touch partition. */
+  SPMV_BALANCED           /**< Chunks of equal nonzero counts, for skewed row lengths. CSR only. */
+} psSpmvKernel;
+
+/** \brief Enum for conjugate gradient variants. */
+typedef enum
+{
+  CG_CLASSIC,             /**< Hestenes-Stiefel recurrences, two or three reductions per iteration. */
+  CG_PIPELINED            /**< Ghysels-Vanroose recurrences, one fused reduction per iteration. */
+} psCGVariant;
+
+/** \brief Enum for multigrid cycles. */
+typedef enum
+{
+  MG_V,                   /**< One coarse visit per level. */
+  MG_W,                   /**< Two coarse visits per level. */
+  MG_F                    /**< An F-cycle then a V-cycle on the next coarser level. */
+} psMultigridCycle;
+
+/** \brief Enum for multigrid smoothers. */
+typedef enum
+{
+  SMOOTHER_JACOBI,        /**< Weighted Jacobi, the weight from a power iteration estimate of D^{-1} A. */
+  SMOOTHER_GAUSS_SEIDEL,  /**< Multicolor symmetric Gauss-Seidel, each color updated in parallel. */
+  SMOOTHER_CHEBYSHEV      /**< Chebyshev polynomial in D^{-1} A, interval from a power iteration estimate. */
+} psSmootherType;
+
+/** \brief Enum for block preconditioner forms of the saddle point system [A B^T; B 0]. */
+typedef enum
+{
+  BLOCK_DIAGONAL,         /**< diag(A, S), symmetric positive definite. */
+  BLOCK_UPPER,            /**< [A B^T; 0 -S], back substitution from the pressure. */
+  BLOCK_LOWER             /**< [A 0; B -S], forward substitution from the velocity. */
+} psBlockForm;
+
+/** \brief Enum for Schur complement approximations, S ~ B A^{-1} B^T. */
+typedef enum
+{
+  SCHUR_PRESSURE_MASS,    /**< S^{-1} ~ viscosity times the inverse lumped pressure mass. */
+  SCHUR_LSC               /**< Least squares commutator with the diagonal of A as scaling. */
+} psSchurApproximation;
+
+/** \brief Enum for sparse direct factorizations of a symmetric matrix. */
+typedef enum
+{
+  DIRECT_CHOLESKY,        /**< L L^T, symmetric positive (semi)definite. */
+  DIRECT_LDLT             /**< L D L^T with unit L, symmetric indefinite without pivoting. */
+} psDirectFactorization;
+
+/** \brief Enum for subdomain solvers of domain decomposition preconditioners. */
+typedef enum
+{
+  SUBDOMAIN_ILU,          /**< ILU(0) of the subdomain block. */
+  SUBDOMAIN_DIRECT,       /**< Sparse LDL^T of the subdomain block, symmetric. */
+  SUBDOMAIN_MULTIGRID     /**< A few AMG cycles on the subdomain block. */
+} psSubdomainSolver;
+
+/** \brief Enum for the subspace a recycling Krylov solver carries between solves. */
+typedef enum
+{
+  RECYCLE_DEFLATION,      /**< Approximate harmonic Ritz vectors of small eigenvalues, deflated in every cycle. */
+  RECYCLE_SOLUTIONS       /**< Previous solutions, projected for the initial guess only. */
+} psRecycleMode;
+
+/** \brief Enum for the phases solver telemetry charges time and bytes to. */
+typedef enum
+{
+  TELEMETRY_SPMV,           /**< Sparse matrix vector products. */
+  TELEMETRY_PRECONDITIONER, /**< Preconditioner applications. */
+  TELEMETRY_REDUCTION,      /**< Dot products and norms, global reductions. */
+  TELEMETRY_UPDATE,         /**< Vector updates and copies. */
+  TELEMETRY_PHASES          /**< Number of phases. */
+} psTelemetryPhase;
+
 }
 
 #endif
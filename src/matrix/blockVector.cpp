@@ -0,0 +1,351 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for blockVector class.
+ */
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+//--- Constructors ---//
+template <typename T>
+porescale::blockVector<T>::blockVector(void) : porescale::denseMatrix<T>::denseMatrix(), nRhs_(1) { };
+
+template <typename T>
+porescale::blockVector<T>::blockVector(parameters<T> * par) : porescale::denseMatrix<T>::denseMatrix(par), nRhs_(1) { };
+
+//--- Destructor ---//
+template <typename T>
+porescale::blockVector<T>::~blockVector(void) { }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::blockVector<T>::build(psInt globalRows, psInt nRhs)
+{
+    nRhs_ = nRhs;
+    this->partition(globalRows, nRhs);
+    this->globalColumns_ = nRhs;
+    this->localColumns_  = 1;
+    this->firstColumn_   = 0;
+    this->allocateZero();
+    this->built_ = true;
+
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+    peOffsets_.assign(nPes + 1, 0);
+    allGather(this->firstRow_, peOffsets_.data(), this->myPe_, this->nPes_);
+    peOffsets_[nPes] = globalRows;
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::buildLike(const blockVector<T>& X)
+{
+    this->myPe_          = X.myPe_;
+    this->nPes_          = X.nPes_;
+    this->globalRows_    = X.globalRows_;
+    this->localRows_     = X.localRows_;
+    this->globalColumns_ = X.globalColumns_;
+    this->localColumns_  = X.localColumns_;
+    this->firstRow_      = X.firstRow_;
+    this->firstColumn_   = 0;
+    this->southNeighbor_ = X.southNeighbor_;
+    this->northNeighbor_ = X.northNeighbor_;
+    this->haloLow_       = X.haloLow_;
+    this->haloHigh_      = X.haloHigh_;
+    nRhs_                = X.nRhs_;
+    peOffsets_           = X.peOffsets_;
+
+    this->allocateZero();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::buildLike(const sparseMatrix<T>& A, psInt nRhs)
+{
+    this->myPe_          = A.myPe();
+    this->nPes_          = A.nPes();
+    this->globalRows_    = A.globalRows();
+    this->localRows_     = A.localRows();
+    this->globalColumns_ = nRhs;
+    this->localColumns_  = 1;
+    this->firstRow_      = A.firstRow();
+    this->firstColumn_   = 0;
+    this->southNeighbor_ = A.southNeighbor();
+    this->northNeighbor_ = A.northNeighbor();
+    this->haloLow_       = std::max(A.firstRow() - A.columnBegin(), (psInt)0);
+    this->haloHigh_      = std::max(A.columnEnd() - (A.firstRow() + A.localRows()), (psInt)0);
+    nRhs_                = nRhs;
+
+    this->allocateZero();
+    this->built_ = true;
+
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+    peOffsets_.assign(nPes + 1, 0);
+    allGather(this->firstRow_, peOffsets_.data(), this->myPe_, this->nPes_);
+    peOffsets_[nPes] = this->globalRows_;
+}
+
+template <typename T>
+psInt
+porescale::blockVector<T>::nRhs(void) const { return nRhs_; }
+
+//--- Halo ---//
+template <typename T>
+void
+porescale::blockVector<T>::setHalo(psInt begin, psInt end)
+{
+    psInt haloLow  = std::max(this->firstRow_ - begin, (psInt)0);
+    psInt haloHigh = std::max(end - (this->firstRow_ + this->localRows_), (psInt)0);
+    if (haloLow == this->haloLow_ && haloHigh == this->haloHigh_) return;
+
+    std::vector<T> owned(this->valueArray(), this->valueArray() + (size_t)this->localRows_ * nRhs_);
+    this->haloLow_  = haloLow;
+    this->haloHigh_ = haloHigh;
+    this->allocateZero();
+    std::copy(std::execution::par, owned.begin(), owned.end(), this->valueArray());
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::exchangeHalo(void)
+{
+    // Rows are gathered whole, one element of the gather is one interleaved row.
+    T     * owned     = this->valueArray();
+    int64_t ownedEnd  = (int64_t)this->firstRow_ + this->localRows_;
+    int64_t ranges[4] = { (int64_t)this->firstRow_ - this->haloLow_, (int64_t)this->firstRow_,
+                          ownedEnd, ownedEnd + this->haloHigh_ };
+    void  * outs[2]   = { owned - (size_t)this->haloLow_ * nRhs_, owned + (size_t)this->localRows_ * nRhs_ };
+    gatherRanges(owned, sizeof(T) * nRhs_, peOffsets_.data(), 2, ranges, outs, this->myPe_, this->nPes_);
+}
+
+//--- Columns ---//
+template <typename T>
+void
+porescale::blockVector<T>::getColumn(psInt r, vector<T>& x) const
+{
+    const T * X    = this->valueArray();
+    T       * xp   = x.valueArray();
+    psInt     nRhs = nRhs_;
+    parallelFor((psInt)0, this->localRows_, [=](psInt i) { xp[i] = X[(size_t)i * nRhs + r]; });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::setColumn(psInt r, const vector<T>& x)
+{
+    T       * X    = this->valueArray();
+    const T * xp   = x.valueArray();
+    psInt     nRhs = nRhs_;
+    parallelFor((psInt)0, this->localRows_, [=](psInt i) { X[(size_t)i * nRhs + r] = xp[i]; });
+}
+
+//--- Level 1 kernels ---//
+template <typename T>
+void
+porescale::blockVector<T>::set(T alpha)
+{
+    T   * Y = this->valueArray();
+    psInt R = nRhs_;
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (size_t k = (size_t)begin * R; k < (size_t)end * R; k++) Y[k] = alpha;
+    });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::copy(const blockVector<T>& X)
+{
+    T       * Y  = this->valueArray();
+    const T * Xp = X.valueArray();
+    psInt     R  = nRhs_;
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (size_t k = (size_t)begin * R; k < (size_t)end * R; k++) Y[k] = Xp[k];
+    });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::axpy(const T * alpha, const blockVector<T>& X)
+{
+    T       * Y  = this->valueArray();
+    const T * Xp = X.valueArray();
+    psInt     R  = nRhs_;
+    std::vector<T> a(alpha, alpha + R);
+    const T * ap = a.data();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++)
+            for (psInt r = 0; r < R; r++) Y[(size_t)i * R + r] += ap[r] * Xp[(size_t)i * R + r];
+    });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::axpby(const T * alpha, const blockVector<T>& X, const T * beta)
+{
+    T       * Y  = this->valueArray();
+    const T * Xp = X.valueArray();
+    psInt     R  = nRhs_;
+    std::vector<T> ab(2 * R);
+    std::copy(alpha, alpha + R, ab.begin());
+    std::copy(beta, beta + R, ab.begin() + R);
+    const T * ap = ab.data();
+    const T * bp = ab.data() + R;
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++)
+            for (psInt r = 0; r < R; r++) Y[(size_t)i * R + r] = ap[r] * Xp[(size_t)i * R + r] + bp[r] * Y[(size_t)i * R + r];
+    });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::columnDots(const blockVector<T>& X, T * dots) const
+{
+    const T * Y  = this->valueArray();
+    const T * Xp = X.valueArray();
+    psInt     R  = nRhs_;
+    std::vector<double> sums(R);
+    streamSums(this->localRows_, R, sums.data(), [=](psInt begin, psInt end, double * out)
+    {
+        for (psInt i = begin; i < end; i++)
+            for (psInt r = 0; r < R; r++) out[r] += Y[(size_t)i * R + r] * Xp[(size_t)i * R + r];
+    });
+    globalSum(sums.data(), R, this->nPes_);
+    for (psInt r = 0; r < R; r++) dots[r] = (T)sums[r];
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::columnNorms(T * norms) const
+{
+    columnDots(*this, norms);
+    for (psInt r = 0; r < nRhs_; r++) norms[r] = (T)sqrt(norms[r]);
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::gram(const blockVector<T>& X, T * G) const
+{
+    const T * Y  = this->valueArray();
+    const T * Xp = X.valueArray();
+    psInt     R  = nRhs_;
+    std::vector<double> sums(R * R);
+    streamSums(this->localRows_, R * R, sums.data(), [=](psInt begin, psInt end, double * out)
+    {
+        for (psInt i = begin; i < end; i++)
+        {
+            const T * y = Y + (size_t)i * R;
+            const T * x = Xp + (size_t)i * R;
+            for (psInt r = 0; r < R; r++)
+                for (psInt s = 0; s < R; s++) out[r * R + s] += y[r] * x[s];
+        }
+    });
+    globalSum(sums.data(), R * R, this->nPes_);
+    for (psInt k = 0; k < R * R; k++) G[k] = (T)sums[k];
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::multiplyAdd(const blockVector<T>& X, const T * M, T beta)
+{
+    T       * Y  = this->valueArray();
+    const T * Xp = X.valueArray();
+    psInt     R  = nRhs_;
+    std::vector<T> m(M, M + R * R);
+    const T * mp = m.data();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        // Rows are read whole before writing, so X may be this block.
+        std::vector<T> row(R);
+        for (psInt i = begin; i < end; i++)
+        {
+            const T * x = Xp + (size_t)i * R;
+            T       * y = Y + (size_t)i * R;
+            for (psInt s = 0; s < R; s++)
+            {
+                T sum = 0;
+                for (psInt r = 0; r < R; r++) sum += x[r] * mp[r * R + s];
+                row[s] = sum + beta * y[s];
+            }
+            for (psInt s = 0; s < R; s++) y[s] = row[s];
+        }
+    });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::combine(psInt nBlocks, const blockVector<T> * const * V, const T * coefficients)
+{
+    T   * Y = this->valueArray();
+    psInt R = nRhs_;
+    std::vector<const T *> vp(nBlocks);
+    for (psInt k = 0; k < nBlocks; k++) vp[k] = V[k]->valueArray();
+    std::vector<T> a(coefficients, coefficients + (size_t)nBlocks * R);
+    const T * const * vPtr = vp.data();
+    const T         * ap   = a.data();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        // Block at a time, the chunk of this stays in cache across blocks.
+        for (psInt k = 0; k < nBlocks; k++)
+        {
+            const T * v = vPtr[k];
+            const T * c = ap + (size_t)k * R;
+            for (psInt i = begin; i < end; i++)
+                for (psInt r = 0; r < R; r++) Y[(size_t)i * R + r] += c[r] * v[(size_t)i * R + r];
+        }
+    });
+}
+
+template <typename T>
+void
+porescale::blockVector<T>::dots(psInt nPairs, const blockVector<T> * const * a, const blockVector<T> * const * b, T * results)
+{
+    std::vector<const T *> ap(nPairs), bp(nPairs);
+    for (psInt k = 0; k < nPairs; k++)
+    {
+        ap[k] = a[k]->valueArray();
+        bp[k] = b[k]->valueArray();
+    }
+    const T * const * aPtr = ap.data();
+    const T * const * bPtr = bp.data();
+    psInt             R    = a[0]->nRhs_;
+    std::vector<double> sums((size_t)nPairs * R);
+    streamSums(a[0]->localRows_, nPairs * R, sums.data(), [=](psInt begin, psInt end, double * out)
+    {
+        for (psInt k = 0; k < nPairs; k++)
+        {
+            const T * x = aPtr[k];
+            const T * y = bPtr[k];
+            double  * o = out + (size_t)k * R;
+            for (psInt i = begin; i < end; i++)
+                for (psInt r = 0; r < R; r++) o[r] += x[(size_t)i * R + r] * y[(size_t)i * R + r];
+        }
+    });
+    globalSum(sums.data(), nPairs * R, a[0]->nPes_);
+    for (size_t k = 0; k < sums.size(); k++) results[k] = (T)sums[k];
+}
+
+//--- Memory ---//
+template <typename T>
+void
+porescale::blockVector<T>::allocate(void)
+{
+    // One column of interleaved rows, halos counted in rows.
+    psInt align = (psInt)std::max(getMemoryPolicy().alignment / sizeof(T), (size_t)1);
+    this->lowPad_       = ((this->haloLow_ * nRhs_ + align - 1) / align) * align;
+    this->ld_           = ((this->lowPad_ + (this->localRows_ + this->haloHigh_) * nRhs_ + align - 1) / align) * align;
+    this->localColumns_ = 1;
+
+    reserveArray(this->baseArray_, this->capacity_, (size_t)this->ld_);
+    this->allocated_ = true;
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::blockVector<float>;
+template class porescale::blockVector<double>;
@@ -0,0 +1,244 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for denseMatrix class.
+ */
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+//--- Constructors ---//
+template <typename T>
+porescale::denseMatrix<T>::denseMatrix(void) : porescale::matrix<T>::matrix(),
+    baseArray_(NULL), capacity_(0), ld_(0), lowPad_(0), haloLow_(0), haloHigh_(0) { };
+
+template <typename T>
+porescale::denseMatrix<T>::denseMatrix(parameters<T> * par) : porescale::matrix<T>::matrix(par),
+    baseArray_(NULL), capacity_(0), ld_(0), lowPad_(0), haloLow_(0), haloHigh_(0) { };
+
+template <typename T>
+porescale::denseMatrix<T>::denseMatrix(denseMatrix<T>&& A) noexcept : porescale::matrix<T>::matrix(A),
+    baseArray_(A.baseArray_), capacity_(A.capacity_), ld_(A.ld_), lowPad_(A.lowPad_),
+    haloLow_(A.haloLow_), haloHigh_(A.haloHigh_)
+{
+    A.baseArray_ = NULL;
+    A.capacity_  = 0;
+    A.allocated_ = false;
+    A.built_     = false;
+}
+
+//--- Destructor ---//
+template <typename T>
+porescale::denseMatrix<T>::~denseMatrix(void)
+{
+    releaseArray(baseArray_, capacity_);
+}
+
+//--- Assignment ---//
+template <typename T>
+porescale::denseMatrix<T>&
+porescale::denseMatrix<T>::operator=(denseMatrix<T>&& A) noexcept
+{
+    if (this == &A) return *this;
+    releaseArray(baseArray_, capacity_);
+    matrix<T>::operator=(A);
+    baseArray_   = A.baseArray_;
+    capacity_    = A.capacity_;
+    ld_          = A.ld_;
+    lowPad_      = A.lowPad_;
+    haloLow_     = A.haloLow_;
+    haloHigh_    = A.haloHigh_;
+    A.baseArray_ = NULL;
+    A.capacity_  = 0;
+    A.allocated_ = false;
+    A.built_     = false;
+    return *this;
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::denseMatrix<T>::build(psInt globalRows, psInt nColumns)
+{
+    this->partition(globalRows, nColumns);
+    this->localColumns_ = nColumns;
+    this->firstColumn_  = 0;
+    allocateZero();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::buildLike(const sparseMatrix<T>& A, psInt nColumns)
+{
+    this->myPe_          = A.myPe();
+    this->nPes_          = A.nPes();
+    this->globalRows_    = A.globalRows();
+    this->localRows_     = A.localRows();
+    this->globalColumns_ = nColumns;
+    this->localColumns_  = nColumns;
+    this->firstRow_      = A.firstRow();
+    this->firstColumn_   = 0;
+    this->southNeighbor_ = A.southNeighbor();
+    this->northNeighbor_ = A.northNeighbor();
+    haloLow_             = 0;
+    haloHigh_            = 0;
+    allocateZero();
+    this->built_ = true;
+}
+
+//--- Accessors ---//
+template <typename T>
+T *
+porescale::denseMatrix<T>::valueArray(void) { return baseArray_ + lowPad_; }
+
+template <typename T>
+const T *
+porescale::denseMatrix<T>::valueArray(void) const { return baseArray_ + lowPad_; }
+
+template <typename T>
+T *
+porescale::denseMatrix<T>::column(psInt j) { return baseArray_ + lowPad_ + (size_t)j * ld_; }
+
+template <typename T>
+const T *
+porescale::denseMatrix<T>::column(psInt j) const { return baseArray_ + lowPad_ + (size_t)j * ld_; }
+
+template <typename T>
+psInt
+porescale::denseMatrix<T>::leadingDimension(void) const { return ld_; }
+
+template <typename T>
+psInt
+porescale::denseMatrix<T>::haloLow(void) const { return haloLow_; }
+
+template <typename T>
+psInt
+porescale::denseMatrix<T>::haloHigh(void) const { return haloHigh_; }
+
+//--- Columns ---//
+template <typename T>
+void
+porescale::denseMatrix<T>::getColumn(psInt j, vector<T>& x) const
+{
+    const T * v  = column(j);
+    T       * xp = x.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) xp[i] = v[i];
+    });
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::setColumn(psInt j, const vector<T>& x, T alpha)
+{
+    T       * v  = column(j);
+    const T * xp = x.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) v[i] = alpha * xp[i];
+    });
+}
+
+//--- Level 2 kernels ---//
+template <typename T>
+void
+porescale::denseMatrix<T>::gemvT(psInt nColumns, const vector<T>& x, T * y, T * xx) const
+{
+    const T * V     = valueArray();
+    const T * xp    = x.valueArray();
+    size_t    ld    = ld_;
+    psInt     nSums = nColumns + (xx ? 1 : 0);
+    std::vector<double> sums(nSums);
+    streamSums(this->localRows_, nSums, sums.data(), [=](psInt begin, psInt end, double * out)
+    {
+        // Column at a time, the chunk of x stays in cache across columns.
+        for (psInt j = 0; j < nColumns; j++)
+        {
+            const T * v = V + j * ld;
+            T         s = 0;
+            for (psInt i = begin; i < end; i++) s += v[i] * xp[i];
+            out[j] = s;
+        }
+        if (nSums > nColumns)
+        {
+            T s = 0;
+            for (psInt i = begin; i < end; i++) s += xp[i] * xp[i];
+            out[nColumns] = s;
+        }
+    });
+    globalSum(sums.data(), nSums, this->nPes_);
+    for (psInt j = 0; j < nColumns; j++) y[j] = (T)sums[j];
+    if (xx) *xx = (T)sums[nColumns];
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::gemv(psInt nColumns, T alpha, const T * y, vector<T>& x) const
+{
+    const T * V  = valueArray();
+    T       * xp = x.valueArray();
+    size_t    ld = ld_;
+    std::vector<T> a(y, y + nColumns);
+    for (T& value : a) value *= alpha;
+    const T * ap = a.data();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt j = 0; j < nColumns; j++)
+        {
+            const T * v = V + j * ld;
+            T         c = ap[j];
+            for (psInt i = begin; i < end; i++) xp[i] += c * v[i];
+        }
+    });
+}
+
+//--- Memory ---//
+template <typename T>
+void
+porescale::denseMatrix<T>::allocate(void)
+{
+    // Pad the low halo and the column length to the policy alignment so that
+    // the owned rows of every column start aligned.
+    psInt align = (psInt)std::max(getMemoryPolicy().alignment / sizeof(T), (size_t)1);
+    lowPad_ = ((haloLow_ + align - 1) / align) * align;
+    ld_     = ((lowPad_ + this->localRows_ + haloHigh_ + align - 1) / align) * align;
+
+    reserveArray(baseArray_, capacity_, (size_t)ld_ * std::max(this->localColumns_, (psInt)1));
+    this->allocated_ = true;
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::allocateZero(void)
+{
+    allocate();
+    zero();
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::copyHostToDevice(void)
+{
+
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::copyDeviceToHost(void)
+{
+
+}
+
+template <typename T>
+void
+porescale::denseMatrix<T>::zero(void)
+{
+    firstTouch(baseArray_, (size_t)ld_ * std::max(this->localColumns_, (psInt)1));
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::denseMatrix<float>;
+template class porescale::denseMatrix<double>;
@@ -10,12 +10,14 @@
 template <typename T>
 porescale::matrix<T>::matrix(void) : myPe_(0), nPes_(0),
     globalRows_(0), localRows_(0), globalColumns_(0), localColumns_(0),
-    firstRow_(0), firstColumn_(0), allocated_(false) { };
+    firstRow_(0), firstColumn_(0), northNeighbor_(-1), westNeighbor_(-1),
+    southNeighbor_(-1), eastNeighbor_(-1), allocated_(false), built_(false) { };
 
 template <typename T>
 porescale::matrix<T>::matrix(porescale::parameters<T> * par) :
     globalRows_(0), localRows_(0), globalColumns_(0), localColumns_(0),
-    firstRow_(0), firstColumn_(0), allocated_(false)
+    firstRow_(0), firstColumn_(0), northNeighbor_(-1), westNeighbor_(-1),
+    southNeighbor_(-1), eastNeighbor_(-1), allocated_(false), built_(false)
 {
     myPe_ = par->myPe();
     nPes_ = par->nPes();
@@ -30,7 +32,33 @@ porescale::matrix<T>::init(parameters<T> * par)
     nPes_ = par->nPes();
 }
 
+template <typename T>
+void
+porescale::matrix<T>::partition(psInt globalRows, psInt globalColumns)
+{
+    psInt nPes = (nPes_ > 1) ? nPes_ : 1;
+
+    globalRows_    = globalRows;
+    globalColumns_ = globalColumns;
+
+    firstRow_      = (psInt)(((int64_t)globalRows * myPe_) / nPes);
+    localRows_     = (psInt)(((int64_t)globalRows * (myPe_ + 1)) / nPes) - firstRow_;
+    firstColumn_   = (psInt)(((int64_t)globalColumns * myPe_) / nPes);
+    localColumns_  = (psInt)(((int64_t)globalColumns * (myPe_ + 1)) / nPes) - firstColumn_;
+
+    southNeighbor_ = (myPe_ > 0) ? myPe_ - 1 : -1;
+    northNeighbor_ = (myPe_ < nPes - 1) ? myPe_ + 1 : -1;
+}
+
 //--- Sets ---//
+template <typename T>
+void
+porescale::matrix<T>::setPes(psInt myPe, psInt nPes)
+{
+    myPe_ = myPe;
+    nPes_ = nPes;
+}
+
 template <typename T>
 void
 porescale::matrix<T>::setGlobalRows(psInt gRows) { globalRows_ = gRows; }
@@ -47,6 +75,30 @@ template <typename T>
 void
 porescale::matrix<T>::setLocalColumns(psInt lColumns) { localColumns_ = lColumns; }
 
+template <typename T>
+void
+porescale::matrix<T>::setFirstRow(psInt firstRow) { firstRow_ = firstRow; }
+
+template <typename T>
+void
+porescale::matrix<T>::setFirstColumn(psInt firstColumn) { firstColumn_ = firstColumn; }
+
+template <typename T>
+void
+porescale::matrix<T>::setNorthNeighbor(psInt northNeighbor) { northNeighbor_ = northNeighbor; }
+
+template <typename T>
+void
+porescale::matrix<T>::setWestNeighbor(psInt westNeighbor) { westNeighbor_ = westNeighbor; }
+
+template <typename T>
+void
+porescale::matrix<T>::setSouthNeighbor(psInt southNeighbor) { southNeighbor_ = southNeighbor; }
+
+template <typename T>
+void
+porescale::matrix<T>::setEastNeighbor(psInt eastNeighbor) { eastNeighbor_ = eastNeighbor; }
+
 //--- Gets ---//
 template <typename T>
 psInt
@@ -72,6 +124,30 @@ template <typename T>
 psInt
 porescale::matrix<T>::localColumns(void) const { return localColumns_; }
 
+template <typename T>
+psInt
+porescale::matrix<T>::firstRow(void) const { return firstRow_; }
+
+template <typename T>
+psInt
+porescale::matrix<T>::firstColumn(void) const { return firstColumn_; }
+
+template <typename T>
+psInt
+porescale::matrix<T>::northNeighbor(void) const { return northNeighbor_; }
+
+template <typename T>
+psInt
+porescale::matrix<T>::westNeighbor(void) const { return westNeighbor_; }
+
+template <typename T>
+psInt
+porescale::matrix<T>::southNeighbor(void) const { return southNeighbor_; }
+
+template <typename T>
+psInt
+porescale::matrix<T>::eastNeighbor(void) const { return eastNeighbor_; }
+
 //--- Explicit Instantiations ---//
 template class porescale::matrix<float>;
 template class porescale::matrix<double>;
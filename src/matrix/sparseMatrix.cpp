@@ -5,30 +5,136 @@
  */
 
 #include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Base column of local row r for compressed column indices: the diagonal
+     *         when it lies inside the row's column range, else the first column.
+     */
+    inline psInt
+    ccsrRowBase(const psInt * rowPtr, const psInt * colPtr, psInt r, psInt diagonal)
+    {
+        if (rowPtr[r] == rowPtr[r + 1]) return diagonal;
+        psInt lo = colPtr[rowPtr[r]], hi = lo;
+        for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+        {
+            lo = std::min(lo, colPtr[k]);
+            hi = std::max(hi, colPtr[k]);
+        }
+        return (diagonal >= lo && diagonal <= hi) ? diagonal : lo;
+    }
+
+    /** \brief Most frequent values of a sorted list, at most maxSize, returned sorted.
+     *         covered returns how many list entries the chosen values account for.
+     */
+    std::vector<psInt>
+    frequentOffsets(const std::vector<psInt>& sorted, psInt maxSize, int64_t& covered)
+    {
+        std::vector<std::pair<int64_t, psInt>> runs;
+        for (size_t k = 0; k < sorted.size();)
+        {
+            size_t e = k;
+            while (e < sorted.size() && sorted[e] == sorted[k]) e++;
+            runs.push_back(std::make_pair((int64_t)(e - k), sorted[k]));
+            k = e;
+        }
+        std::sort(runs.begin(), runs.end(), [](const std::pair<int64_t, psInt>& a, const std::pair<int64_t, psInt>& b)
+                  { return a.first > b.first; });
+        if ((psInt)runs.size() > maxSize) runs.resize(maxSize);
+
+        std::vector<psInt> table;
+        covered = 0;
+        for (auto& run : runs)
+        {
+            table.push_back(run.second);
+            covered += run.first;
+        }
+        std::sort(table.begin(), table.end());
+        return table;
+    }
+
+    /** \brief Code the offsets of one group of rows. Escaped columns are written from escape onward. */
+    template <typename D>
+    void
+    ccsrEncodeGroup(psInt rBegin, psInt rEnd, const psInt * rowPtr, const psInt * colPtr, const psInt * rowBase,
+                    const psInt * table, psInt nTable, D * delta, psInt * escape)
+    {
+        typedef porescale::ccsrCoding<D> coding;
+        for (psInt r = rBegin; r < rEnd; r++)
+        {
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            {
+                int64_t d = (int64_t)colPtr[k] - rowBase[r];
+                if (!porescale::ccsrLong<D>(d))
+                {
+                    delta[k] = (D)d;
+                    continue;
+                }
+                const psInt * t = std::lower_bound(table, table + nTable, (psInt)d);
+                if (t != table + nTable && *t == d) delta[k] = (D)(coding::escape + 1 + (t - table));
+                else
+                {
+                    delta[k]    = coding::escape;
+                    *escape++   = colPtr[k];
+                }
+            }
+        }
+    }
+
+    /** \brief Decode the column indices of one group of rows. */
+    template <typename D>
+    void
+    ccsrDecodeGroup(psInt rBegin, psInt rEnd, const psInt * rowPtr, const psInt * rowBase, const D * delta,
+                    const psInt * table, const psInt * escape, psInt * colPtr)
+    {
+        typedef porescale::ccsrCoding<D> coding;
+        for (psInt r = rBegin; r < rEnd; r++)
+        {
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            {
+                psInt d = delta[k];
+                if (d >= coding::directMin) colPtr[k] = rowBase[r] + d;
+                else if (d == coding::escape) colPtr[k] = *escape++;
+                else colPtr[k] = rowBase[r] + table[d - coding::escape - 1];
+            }
+        }
+    }
+}
 
 //--- Constructors ---//
 template <typename T>
 porescale::sparseMatrix<T>::sparseMatrix(void) :
     porescale::matrix<T>::matrix(), sparseFormat_(CSR),
-    globalNnz_(0), localNnz_(0), colArray_(NULL),
-    rowArray_(NULL), valueArray_(NULL) { };
+    globalNnz_(0), localNnz_(0), blockSize_(1), localBlocks_(0),
+    columnBegin_(0), columnEnd_(0), spmvKernel_(SPMV_ROWS), colArray_(NULL),
+    rowArray_(NULL), valueArray_(NULL), colCapacity_(0), rowCapacity_(0),
+    valueCapacity_(0), deltaBytes_(0), nOffsets_(0),
+    localEscapes_(0), rowBaseArray_(NULL), deltaArray_(NULL), offsetTable_(NULL),
+    escapeArray_(NULL), escapeGroupArray_(NULL), nEntries_(0), entrySlotArray_(NULL),
+    slotEntryPtr_(NULL), slotEntryArray_(NULL) { };
 
 template <typename T>
 porescale::sparseMatrix<T>::sparseMatrix(parameters<T> * par) :
     porescale::matrix<T>::matrix(par), sparseFormat_(CSR),
-    globalNnz_(0), localNnz_(0), colArray_(NULL),
-    rowArray_(NULL), valueArray_(NULL) { };
+    globalNnz_(0), localNnz_(0), blockSize_(1), localBlocks_(0),
+    columnBegin_(0), columnEnd_(0), spmvKernel_(SPMV_ROWS), colArray_(NULL),
+    rowArray_(NULL), valueArray_(NULL), colCapacity_(0), rowCapacity_(0),
+    valueCapacity_(0), deltaBytes_(0), nOffsets_(0),
+    localEscapes_(0), rowBaseArray_(NULL), deltaArray_(NULL), offsetTable_(NULL),
+    escapeArray_(NULL), escapeGroupArray_(NULL), nEntries_(0), entrySlotArray_(NULL),
+    slotEntryPtr_(NULL), slotEntryArray_(NULL) { };
 
 //--- Destructor ---//
 template <typename T>
 porescale::sparseMatrix<T>::~sparseMatrix(void)
 {
-    if (this->allocated_)
-    {
-        delete[] colArray_;
-        delete[] rowArray_;
-        delete[] valueArray_;
-    }
+    freeCompressed_();
+    freePattern_();
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
 }
 
 //--- Initiation and build ---//
@@ -55,8 +161,11 @@ porescale::sparseMatrix<T>::buildZero(
     this->setGlobalColumns(globalColumns);
     this->setLocalNnz(localNnz);
     this->setGlobalNnz(globalNnz);
+    sparseFormat_ = format;
+    blockSize_    = 1;
 
     allocateZero();
+    updateStructure_();
 }
 
 template <typename T>
@@ -75,15 +184,137 @@ porescale::sparseMatrix<T>::buildPar(
     this->setGlobalColumns(globalColumns);
     this->setLocalNnz(localNnz);
     this->setGlobalNnz(globalNnz);
+    sparseFormat_ = format;
+    blockSize_    = 1;
 
     allocate();
 
-    std::copy(colArray, colArray+localNnz, colArray_);
     if (format == porescale::COO)
         std::copy(rowArray, rowArray+localNnz, rowArray_);
     else if (format == porescale::CSR)
         std::copy(rowArray, rowArray+localRows+1, rowArray_);
+    touchEntries_();
+    std::copy(colArray, colArray+localNnz, colArray_);
     std::copy(valueArray, valueArray+localNnz, valueArray_);
+
+    updateStructure_();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::buildSymbolic(
+    psInt         localRows,      psInt         globalRows,
+    psInt         localColumns,   psInt         globalColumns,
+    psInt         nEntries,       const psInt * entryRows,
+    const psInt * entryColumns
+)
+{
+    this->setLocalRows(localRows);
+    this->setGlobalRows(globalRows);
+    this->setLocalColumns(localColumns);
+    this->setGlobalColumns(globalColumns);
+
+    // Entries must lie in the local rows and the global columns, checked on every pe
+    // so that all of them return together.
+    int64_t bad = parallelReduce((psInt)0, nEntries, (int64_t)0, [=](psInt e)
+    {
+        return (int64_t)(entryRows[e] < 0 || entryRows[e] >= localRows
+                         || entryColumns[e] < 0 || entryColumns[e] >= globalColumns);
+    });
+    globalSum(&bad, 1, this->nPes_);
+    if (bad > 0)
+    {
+        std::cout << "\nPORESCALE Error :: buildSymbolic given " << bad
+                  << " entries outside the local rows or the global columns\n";
+        return;
+    }
+
+    // Order entries by row, column and entry, duplicates end up adjacent.
+    psInt * order = allocateArray<psInt>(nEntries);
+    parallelFor((psInt)0, nEntries, [=](psInt e) { order[e] = e; });
+    std::sort(std::execution::par, order, order + nEntries, [=](psInt a, psInt b)
+    {
+        if (entryRows[a] != entryRows[b]) return entryRows[a] < entryRows[b];
+        if (entryColumns[a] != entryColumns[b]) return entryColumns[a] < entryColumns[b];
+        return a < b;
+    });
+
+    // Slot of each sorted entry from the heads of runs of equal (row, column).
+    psInt * slotOfSorted = allocateArray<psInt>(nEntries + 1);
+    parallelFor((psInt)0, nEntries, [=](psInt k)
+    {
+        slotOfSorted[k] = (k == 0 || entryRows[order[k]] != entryRows[order[k - 1]]
+                           || entryColumns[order[k]] != entryColumns[order[k - 1]]) ? 1 : 0;
+    });
+    psInt nSlots = exclusiveScan(slotOfSorted, nEntries);
+    slotOfSorted[nEntries] = nSlots;
+
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localNnz_     = nSlots;
+    allocate();
+
+    nEntries_       = nEntries;
+    entrySlotArray_ = allocateArray<psInt>(nEntries);
+    slotEntryPtr_   = allocateArray<psInt>(nSlots + 1);
+    slotEntryArray_ = order;
+
+    psInt * entrySlot = entrySlotArray_;
+    psInt * slotPtr   = slotEntryPtr_;
+    parallelFor((psInt)0, nEntries, [=](psInt k)
+    {
+        // heads counted up to and including k
+        psInt slot = slotOfSorted[k + 1] - 1;
+        entrySlot[order[k]] = slot;
+        if (slotOfSorted[k] == slot) slotPtr[slot] = k;
+    });
+    slotEntryPtr_[nSlots] = nEntries;
+    freeArray(slotOfSorted);
+
+    // Row offsets from the first slot of each row.
+    psInt * rowPtr = rowArray_;
+    parallelFor((psInt)0, localRows + 1, [=](psInt r)
+    {
+        const psInt * first = std::lower_bound(order, order + nEntries, r,
+                                               [=](psInt e, psInt row) { return entryRows[e] < row; });
+        rowPtr[r] = (first == order + nEntries) ? nSlots : entrySlot[*first];
+    });
+
+    // Entries are first touched by the SpMV row chunks before they are written.
+    touchEntries_();
+    psInt * colPtr = colArray_;
+    parallelFor((psInt)0, nSlots, [=](psInt s) { colPtr[s] = entryColumns[order[slotPtr[s]]]; });
+    std::fill(std::execution::par, valueArray_, valueArray_ + nSlots, (T)0);
+
+    int64_t nnz = localNnz_;
+    globalSum(&nnz, 1, this->nPes_);
+    globalNnz_ = (psInt)nnz;
+
+    updateStructure_();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::buildNumeric(const T * entryValues)
+{
+    if (slotEntryPtr_ == NULL || (sparseFormat_ != CSR && sparseFormat_ != CCSR))
+    {
+        std::cout << "\nPORESCALE Error :: buildNumeric requires a symbolic phase and CSR or CCSR storage\n";
+        return;
+    }
+
+    // CSR and CCSR share the value order, so slots stay valid after compression.
+    const psInt * slotPtr   = slotEntryPtr_;
+    const psInt * slotEntry = slotEntryArray_;
+    T           * valPtr    = valueArray_;
+    parallelFor((psInt)0, localNnz_, [=](psInt s)
+    {
+        T sum = 0;
+        for (psInt k = slotPtr[s]; k < slotPtr[s + 1]; k++) sum += entryValues[slotEntry[k]];
+        valPtr[s] = sum;
+    });
 }
 
 template <typename T>
@@ -107,6 +338,105 @@ porescale::sparseMatrix<T>::buildSeq(
 
 }
 
+template <typename T>
+void
+porescale::sparseMatrix<T>::buildFromCOO_(
+    porescale::arrayCOO<T> * entries,
+    psInt                    nEntries
+)
+{
+    // Order entries by row and then column.
+    std::sort(std::execution::par, entries, entries + nEntries,
+              [](const arrayCOO<T>& a, const arrayCOO<T>& b)
+              { return (a.i_index < b.i_index) || (a.i_index == b.i_index && a.j_index < b.j_index); });
+
+    // Slot of each entry from the heads of runs of equal (row, column), so that
+    // duplicate coordinates are summed into one entry.
+    psInt * slotOf = allocateArray<psInt>(nEntries + 1);
+    parallelFor((psInt)0, nEntries, [=](psInt k)
+    {
+        slotOf[k] = (k == 0 || entries[k].i_index != entries[k - 1].i_index
+                     || entries[k].j_index != entries[k - 1].j_index) ? 1 : 0;
+    });
+    psInt nSlots = exclusiveScan(slotOf, nEntries);
+    slotOf[nEntries] = nSlots;
+    psInt * headOf = allocateArray<psInt>(nSlots + 1);
+    parallelFor((psInt)0, nEntries, [=](psInt k) { if (slotOf[k + 1] != slotOf[k]) headOf[slotOf[k]] = k; });
+    headOf[nSlots] = nEntries;
+
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localNnz_     = nSlots;
+    allocate();
+
+    psInt   firstRow = this->firstRow_;
+    psInt * rowPtr   = rowArray_;
+    psInt * colPtr   = colArray_;
+    T     * valPtr   = valueArray_;
+
+    parallelFor((psInt)0, this->localRows_ + 1, [=](psInt r)
+    {
+        rowPtr[r] = slotOf[std::lower_bound(entries, entries + nEntries, firstRow + r,
+                                            [](const arrayCOO<T>& a, psInt row) { return a.i_index < row; })
+                           - entries];
+    });
+    touchEntries_();
+    parallelFor((psInt)0, nSlots, [=](psInt s)
+    {
+        T sum = 0;
+        for (psInt k = headOf[s]; k < headOf[s + 1]; k++) sum += entries[k].value;
+        colPtr[s] = entries[headOf[s]].j_index;
+        valPtr[s] = sum;
+    });
+    freeArray(slotOf);
+    freeArray(headOf);
+
+    updateStructure_();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::touchEntries_(void)
+{
+    if (sparseFormat_ != CSR || !getMemoryPolicy().firstTouch) return;
+    firstTouchRows(colArray_, this->localRows_, rowArray_);
+    firstTouchRows(valueArray_, this->localRows_, rowArray_);
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::updateStructure_(void)
+{
+    updateColumnWindow_();
+    // Balanced chunk bounds follow the row offsets, stale bounds would unbalance csrSpmv.
+    if (spmvKernel_ == SPMV_BALANCED && sparseFormat_ == CSR) setSpmvKernel(SPMV_BALANCED);
+    else chunkRows_.clear();
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::updateColumnWindow_(void)
+{
+    // Compressed indices keep the window recorded before compression.
+    if (sparseFormat_ == CCSR) return;
+
+    psInt nIndices = (sparseFormat_ == BSR) ? localBlocks_ : localNnz_;
+    if (nIndices == 0)
+    {
+        columnBegin_ = this->firstColumn_;
+        columnEnd_   = this->firstColumn_;
+        return;
+    }
+
+    const psInt * colPtr = colArray_;
+    psInt lo = parallelMin((psInt)0, nIndices, (psInt)PORESCALE_INTMAX, [=](psInt k) { return colPtr[k]; });
+    psInt hi = parallelMax((psInt)0, nIndices, (psInt)0, [=](psInt k) { return colPtr[k]; });
+
+    columnBegin_ = lo * blockSize_;
+    columnEnd_   = (hi + 1) * blockSize_;
+}
+
 //--- Accessors ---//
 template <typename T>
 psInt *
@@ -120,6 +450,10 @@ template <typename T>
 T *
 porescale::sparseMatrix<T>::valueArray(void) { return valueArray_; }
 
+template <typename T>
+const psInt *
+porescale::sparseMatrix<T>::entrySlots(void) const { return entrySlotArray_; }
+
 //--- Sets ---//
 template <typename T>
 void
@@ -139,31 +473,377 @@ psInt porescale::sparseMatrix<T>::globalNnz(void) const { return globalNnz_; }
 template <typename T>
 psInt porescale::sparseMatrix<T>::localNnz(void) const { return localNnz_; }
 
+template <typename T>
+psInt porescale::sparseMatrix<T>::blockSize(void) const { return blockSize_; }
+
+template <typename T>
+psInt porescale::sparseMatrix<T>::localBlocks(void) const { return localBlocks_; }
+
+template <typename T>
+porescale::psSpmvKernel porescale::sparseMatrix<T>::spmvKernel(void) const { return spmvKernel_; }
+
+template <typename T>
+psInt porescale::sparseMatrix<T>::columnBegin(void) const { return columnBegin_; }
+
+template <typename T>
+psInt porescale::sparseMatrix<T>::columnEnd(void) const { return columnEnd_; }
+
 //--- Converts ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::convertToBSR(psInt blockSize)
+{
+    if (sparseFormat_ == BSR && blockSize_ == blockSize) return;
+    if (sparseFormat_ != CSR) convertToCSR();
+
+    psInt B = blockSize;
+    if (B < 1 || this->localRows_ % B || this->firstRow_ % B || this->globalColumns_ % B)
+    {
+        std::cout << "\nPORESCALE Error :: matrix extents are not divisible by block size " << B << "\n";
+        return;
+    }
+
+    psInt         nBlockRows = this->localRows_ / B;
+    psInt         nChunks    = std::min(4 * parallelChunks(), std::max(nBlockRows, (psInt)1));
+    const psInt * rowPtr     = rowArray_;
+    const psInt * colPtr     = colArray_;
+    const T     * valPtr     = valueArray_;
+
+    // Sorted unique block columns of block row br, gathered into scratch.
+    auto blockColumns = [=](psInt br, std::vector<psInt>& scratch)
+    {
+        scratch.clear();
+        for (psInt k = rowPtr[br * B]; k < rowPtr[(br + 1) * B]; k++) scratch.push_back(colPtr[k] / B);
+        std::sort(scratch.begin(), scratch.end());
+        scratch.erase(std::unique(scratch.begin(), scratch.end()), scratch.end());
+    };
+
+    // Pass 1: count blocks per block row.
+    psInt * blockRowPtr = allocateArray<psInt>(nBlockRows + 1);
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::vector<psInt> scratch;
+        for (psInt br = chunkBegin(nBlockRows, c, nChunks); br < chunkBegin(nBlockRows, c + 1, nChunks); br++)
+        {
+            blockColumns(br, scratch);
+            blockRowPtr[br] = (psInt)scratch.size();
+        }
+    });
+    psInt nBlocks = exclusiveScan(blockRowPtr, nBlockRows);
+    blockRowPtr[nBlockRows] = nBlocks;
+
+    // Pass 2: place block columns and scatter scalar entries into their blocks.
+    psInt * blockColPtr = allocateArray<psInt>(nBlocks);
+    T     * blockValPtr = allocateArray<T>((size_t)nBlocks * B * B);
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::vector<psInt> scratch;
+        for (psInt br = chunkBegin(nBlockRows, c, nChunks); br < chunkBegin(nBlockRows, c + 1, nChunks); br++)
+        {
+            blockColumns(br, scratch);
+            psInt first = blockRowPtr[br];
+            std::copy(scratch.begin(), scratch.end(), blockColPtr + first);
+            std::fill(blockValPtr + (size_t)first * B * B, blockValPtr + (size_t)(first + scratch.size()) * B * B, (T)0);
+            for (psInt i = 0; i < B; i++)
+            {
+                psInt r = br * B + i;
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+                {
+                    psInt pos = (psInt)(std::lower_bound(scratch.begin(), scratch.end(), colPtr[k] / B) - scratch.begin());
+                    blockValPtr[((size_t)(first + pos) * B + i) * B + colPtr[k] % B] += valPtr[k];
+                }
+            }
+        }
+    });
+
+    // Value slots of a split build index CSR values, blocks drop them.
+    freePattern_();
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
+    colArray_      = blockColPtr;
+    rowArray_      = blockRowPtr;
+    valueArray_    = blockValPtr;
+    colCapacity_   = nBlocks;
+    rowCapacity_   = nBlockRows + 1;
+    valueCapacity_ = (size_t)nBlocks * B * B;
+
+    sparseFormat_ = BSR;
+    blockSize_    = B;
+    localBlocks_  = nBlocks;
+    localNnz_     = nBlocks * B * B;
+
+    int64_t nnz = localNnz_;
+    globalSum(&nnz, 1, this->nPes_);
+    globalNnz_ = (psInt)nnz;
+    updateStructure_();
+}
 
-//--- Memory ---//
 template <typename T>
 void
-porescale::sparseMatrix<T>::allocate(void)
+porescale::sparseMatrix<T>::convertToCCSR(psInt deltaBytes)
 {
+    if (sparseFormat_ == CCSR && (deltaBytes == 0 || deltaBytes == deltaBytes_)) return;
+    if (sparseFormat_ != CSR) convertToCSR();
+
+    psInt         nRows    = this->localRows_;
+    psInt         nGroups  = (nRows + PORESCALE_CCSR_GROUP - 1) / PORESCALE_CCSR_GROUP;
+    psInt         firstRow = this->firstRow_;
+    const psInt * rowPtr   = rowArray_;
+    const psInt * colPtr   = colArray_;
+
+    psInt * rowBase = allocateArray<psInt>(nRows);
+    parallelFor((psInt)0, nRows, [=](psInt r) { rowBase[r] = ccsrRowBase(rowPtr, colPtr, r, firstRow + r); });
+
+    // Gather offsets which do not fit 8 bits, the 16 bit candidates are a subset.
+    psInt nChunks = std::min(4 * parallelChunks(), std::max(nRows, (psInt)1));
+    std::vector<psInt> chunkLong(nChunks + 1, 0);
+    psInt * chunkLongPtr = chunkLong.data();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        psInt n = 0;
+        for (psInt r = chunkBegin(nRows, c, nChunks); r < chunkBegin(nRows, c + 1, nChunks); r++)
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++) n += ccsrLong<int8_t>((int64_t)colPtr[k] - rowBase[r]);
+        chunkLongPtr[c] = n;
+    });
+    psInt nLong8 = exclusiveScan(chunkLongPtr, nChunks);
+    std::vector<psInt> long8(nLong8);
+    psInt * long8Ptr = long8.data();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        psInt * out = long8Ptr + chunkLongPtr[c];
+        for (psInt r = chunkBegin(nRows, c, nChunks); r < chunkBegin(nRows, c + 1, nChunks); r++)
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            {
+                int64_t d = (int64_t)colPtr[k] - rowBase[r];
+                if (ccsrLong<int8_t>(d)) *out++ = (psInt)std::max(std::min(d, (int64_t)PORESCALE_INTMAX), (int64_t)PORESCALE_INTMIN);
+            }
+    });
+    std::sort(std::execution::par, long8.begin(), long8.end());
+    std::vector<psInt> long16;
+    std::copy_if(long8.begin(), long8.end(), std::back_inserter(long16), [](psInt d) { return ccsrLong<int16_t>(d); });
+
+    int64_t covered8, covered16;
+    std::vector<psInt> table8  = frequentOffsets(long8, ccsrCoding<int8_t>::tableSize, covered8);
+    std::vector<psInt> table16 = frequentOffsets(long16, ccsrCoding<int16_t>::tableSize, covered16);
+    int64_t bytes8  = (int64_t)localNnz_     + (int64_t)sizeof(psInt) * (long8.size() - covered8);
+    int64_t bytes16 = (int64_t)localNnz_ * 2 + (int64_t)sizeof(psInt) * (long16.size() - covered16);
+
+    if (deltaBytes != 1 && deltaBytes != 2) deltaBytes = (bytes8 <= bytes16) ? 1 : 2;
+    std::vector<psInt>& table = (deltaBytes == 1) ? table8 : table16;
+    psInt               nTable = (psInt)table.size();
+    psInt             * offsets = allocateArray<psInt>(nTable);
+    std::copy(table.begin(), table.end(), offsets);
+
+    // Escape counts per group of rows, then code every group in parallel.
+    psInt * escapeGroup = allocateArray<psInt>(nGroups + 1);
+    parallelFor((psInt)0, nGroups, [=](psInt g)
+    {
+        psInt         n      = 0;
+        psInt         rEnd   = std::min(nRows, (g + 1) * PORESCALE_CCSR_GROUP);
+        const psInt * tBegin = offsets;
+        const psInt * tEnd   = offsets + nTable;
+        for (psInt r = g * PORESCALE_CCSR_GROUP; r < rEnd; r++)
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            {
+                int64_t d = (int64_t)colPtr[k] - rowBase[r];
+                bool isLong = (deltaBytes == 1) ? ccsrLong<int8_t>(d) : ccsrLong<int16_t>(d);
+                if (isLong && !std::binary_search(tBegin, tEnd, d)) n++;
+            }
+        escapeGroup[g] = n;
+    });
+    psInt nEscapes = exclusiveScan(escapeGroup, nGroups);
+    escapeGroup[nGroups] = nEscapes;
+
+    psInt  * escape = allocateArray<psInt>(nEscapes);
+    psInt8 * delta  = allocateArray<psInt8>((size_t)localNnz_ * deltaBytes);
+
+    parallelFor((psInt)0, nGroups, [=](psInt g)
+    {
+        psInt rBegin = g * PORESCALE_CCSR_GROUP;
+        psInt rEnd   = std::min(nRows, rBegin + PORESCALE_CCSR_GROUP);
+        if (deltaBytes == 1)
+            ccsrEncodeGroup<int8_t>(rBegin, rEnd, rowPtr, colPtr, rowBase, offsets, nTable,
+                                    (int8_t *)delta, escape + escapeGroup[g]);
+        else
+            ccsrEncodeGroup<int16_t>(rBegin, rEnd, rowPtr, colPtr, rowBase, offsets, nTable,
+                                     (int16_t *)delta, escape + escapeGroup[g]);
+    });
+
+    freeCompressed_();
+    releaseArray(colArray_, colCapacity_);
+    rowBaseArray_     = rowBase;
+    deltaArray_       = delta;
+    offsetTable_      = offsets;
+    escapeArray_      = escape;
+    escapeGroupArray_ = escapeGroup;
+    nOffsets_         = nTable;
+    localEscapes_     = nEscapes;
+    deltaBytes_       = deltaBytes;
+    sparseFormat_     = CCSR;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::convertToCSR(void)
+{
+    if (sparseFormat_ == CSR) return;
+
+    if (sparseFormat_ == CCSR)
+    {
+        psInt nRows   = this->localRows_;
+        psInt nGroups = (nRows + PORESCALE_CCSR_GROUP - 1) / PORESCALE_CCSR_GROUP;
+        psInt * colPtr = allocateEntries<psInt>(nRows, rowArray_);
+
+        const psInt  * rowPtr      = rowArray_;
+        const psInt  * rowBase     = rowBaseArray_;
+        const psInt8 * delta       = deltaArray_;
+        const psInt  * table       = offsetTable_;
+        const psInt  * escape      = escapeArray_;
+        const psInt  * escapeGroup = escapeGroupArray_;
+        psInt          bytes       = deltaBytes_;
+        parallelFor((psInt)0, nGroups, [=](psInt g)
+        {
+            psInt rBegin = g * PORESCALE_CCSR_GROUP;
+            psInt rEnd   = std::min(nRows, rBegin + PORESCALE_CCSR_GROUP);
+            if (bytes == 1)
+                ccsrDecodeGroup<int8_t>(rBegin, rEnd, rowPtr, rowBase, (const int8_t *)delta, table,
+                                        escape + escapeGroup[g], colPtr);
+            else
+                ccsrDecodeGroup<int16_t>(rBegin, rEnd, rowPtr, rowBase, (const int16_t *)delta, table,
+                                         escape + escapeGroup[g], colPtr);
+        });
+
+        freeCompressed_();
+        colArray_     = colPtr;
+        colCapacity_  = localNnz_;
+        sparseFormat_ = CSR;
+        updateStructure_();
+        return;
+    }
 
-    if (this->allocated_)
+    if (sparseFormat_ == COO)
     {
-        delete[] colArray_;
-        delete[] rowArray_;
-        delete[] valueArray_;
+        // COO row indices are global.
+        psInt         n       = localNnz_;
+        arrayCOO<T> * entries = new arrayCOO<T>[n];
+        const psInt * rowPtr  = rowArray_;
+        const psInt * colPtr  = colArray_;
+        const T     * valPtr  = valueArray_;
+        parallelFor((psInt)0, n, [=](psInt k)
+        {
+            entries[k].i_index = rowPtr[k];
+            entries[k].j_index = colPtr[k];
+            entries[k].value   = valPtr[k];
+        });
+        buildFromCOO_(entries, n);
+        delete[] entries;
+        return;
     }
+
+    // BSR: every stored block entry becomes a scalar entry, rows stay column sorted.
+    psInt         B           = blockSize_;
+    psInt         nBlockRows  = this->localRows_ / B;
+    const psInt * blockRowPtr = rowArray_;
+    const psInt * blockColPtr = colArray_;
+    const T     * blockValPtr = valueArray_;
+
+    psInt * rowPtr = allocateArray<psInt>(this->localRows_ + 1);
+
+    psInt nnz = localNnz_;
+    parallelFor((psInt)0, this->localRows_ + 1, [=](psInt r)
+    {
+        if (r == nBlockRows * B)
+        {
+            rowPtr[r] = nnz;
+            return;
+        }
+        psInt br = r / B;
+        rowPtr[r] = (blockRowPtr[br] * B + (r - br * B) * (blockRowPtr[br + 1] - blockRowPtr[br])) * B;
+    });
+    psInt * colPtr = allocateEntries<psInt>(this->localRows_, rowPtr);
+    T     * valPtr = allocateEntries<T>(this->localRows_, rowPtr);
+    parallelFor((psInt)0, nBlockRows, [=](psInt br)
+    {
+        for (psInt i = 0; i < B; i++)
+        {
+            psInt k = rowPtr[br * B + i];
+            for (psInt kb = blockRowPtr[br]; kb < blockRowPtr[br + 1]; kb++)
+                for (psInt j = 0; j < B; j++, k++)
+                {
+                    colPtr[k] = blockColPtr[kb] * B + j;
+                    valPtr[k] = blockValPtr[((size_t)kb * B + i) * B + j];
+                }
+        }
+    });
+
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
+    colArray_      = colPtr;
+    rowArray_      = rowPtr;
+    valueArray_    = valPtr;
+    colCapacity_   = localNnz_;
+    rowCapacity_   = this->localRows_ + 1;
+    valueCapacity_ = localNnz_;
+
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localBlocks_  = 0;
+    updateStructure_();
+}
+
+//--- Memory ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::freeCompressed_(void)
+{
+    freeArray(rowBaseArray_);
+    freeArray(deltaArray_);
+    freeArray(offsetTable_);
+    freeArray(escapeArray_);
+    freeArray(escapeGroupArray_);
+    nOffsets_         = 0;
+    localEscapes_     = 0;
+    deltaBytes_       = 0;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::freePattern_(void)
+{
+    freeArray(entrySlotArray_);
+    freeArray(slotEntryPtr_);
+    freeArray(slotEntryArray_);
+    nEntries_       = 0;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::allocate(void)
+{
+
+    freeCompressed_();
+    freePattern_();
+    // Storage is reused when its capacity already suffices. CSR entries are first
+    // touched by touchEntries_ once the rows are known.
     if (sparseFormat_ == CSR)
     {
-        colArray_ = new psInt[localNnz_];
-        rowArray_ = new psInt[this->localRows_+1];
-        valueArray_ = new T[localNnz_];
+        reserveArray(colArray_, colCapacity_, localNnz_, false);
+        reserveArray(rowArray_, rowCapacity_, this->localRows_+1);
+        reserveArray(valueArray_, valueCapacity_, localNnz_, false);
     }
     else if (sparseFormat_ == COO)
     {
-        colArray_ = new psInt[localNnz_];
-        rowArray_ = new psInt[localNnz_];
-        valueArray_ = new T[localNnz_];
+        reserveArray(colArray_, colCapacity_, localNnz_);
+        reserveArray(rowArray_, rowCapacity_, localNnz_);
+        reserveArray(valueArray_, valueCapacity_, localNnz_);
+    }
+    else if (sparseFormat_ == BSR)
+    {
+        reserveArray(colArray_, colCapacity_, localBlocks_);
+        reserveArray(rowArray_, rowCapacity_, this->localRows_/blockSize_+1);
+        reserveArray(valueArray_, valueCapacity_, localNnz_);
     }
 
     this->allocated_ = true;
@@ -196,17 +876,24 @@ template <typename T>
 void
 porescale::sparseMatrix<T>::zero(void)
 {
+    // Parallel with the kernel chunk partition, so rewriting keeps pages local.
     if (sparseFormat_ == CSR)
     {
-        for (int i = 0; i < localNnz_; i++) colArray_[i] = 0;
-        for (int i = 0; i < this->localRows_+1; i++) rowArray_[i] = 0;
-        for (int i = 0; i < localNnz_; i++) valueArray_[i] = 0.0;
+        firstTouch(colArray_, localNnz_);
+        firstTouch(rowArray_, this->localRows_+1);
+        firstTouch(valueArray_, localNnz_);
     }
     else if (sparseFormat_ == COO)
     {
-        for (int i = 0; i < localNnz_; i++) colArray_[i] = 0;
-        for (int i = 0; i < localNnz_; i++) rowArray_[i] = 0;
-        for (int i = 0; i < localNnz_; i++) valueArray_[i] = 0.0;
+        firstTouch(colArray_, localNnz_);
+        firstTouch(rowArray_, localNnz_);
+        firstTouch(valueArray_, localNnz_);
+    }
+    else if (sparseFormat_ == BSR)
+    {
+        firstTouch(colArray_, localBlocks_);
+        firstTouch(rowArray_, this->localRows_/blockSize_+1);
+        firstTouch(valueArray_, localNnz_);
     }
 }
 
@@ -0,0 +1,324 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for sparseMatrix characterization.
+ */
+
+#include <iomanip>
+#include <limits>
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Partial statistics of one chunk of rows. */
+    struct rowStats
+    {
+        int64_t emptyRows        = 0;
+        int64_t minRowLength     = std::numeric_limits<int64_t>::max();
+        int64_t maxRowLength     = 0;
+        int64_t lowerBandwidth   = 0;
+        int64_t upperBandwidth   = 0;
+        int64_t profile          = 0;
+        int64_t missingDiagonals = 0;
+        int64_t dominant         = 0;
+        int64_t strict           = 0;
+        int64_t checked          = 0;
+        int64_t missing          = 0;
+        int64_t long8            = 0;
+        int64_t long16           = 0;
+        double  sumLength2       = 0.0;
+        double  minDominance     = std::numeric_limits<double>::infinity();
+        double  maxAbs           = 0.0;
+        double  symmetryDiff     = 0.0;
+    };
+
+    /** \brief JSON number, null when not finite. */
+    void
+    jsonNumber(std::ostream& os, double value)
+    {
+        if (std::isfinite(value)) os << value;
+        else os << "null";
+    }
+}
+
+//--- Report ---//
+std::string
+porescale::sparseMatrixReport::json(void) const
+{
+    std::ostringstream os;
+    os << std::setprecision(17);
+    os << "{\n";
+    os << "  \"globalRows\": "           << globalRows           << ",\n";
+    os << "  \"globalColumns\": "        << globalColumns        << ",\n";
+    os << "  \"globalNnz\": "            << globalNnz            << ",\n";
+    os << "  \"rows\": {\n";
+    os << "    \"empty\": "              << emptyRows            << ",\n";
+    os << "    \"minLength\": "          << minRowLength         << ",\n";
+    os << "    \"maxLength\": "          << maxRowLength         << ",\n";
+    os << "    \"meanLength\": ";        jsonNumber(os, meanRowLength); os << ",\n";
+    os << "    \"stdLength\": ";         jsonNumber(os, stdRowLength);  os << ",\n";
+    os << "    \"lengthHistogram\": [";
+    for (size_t b = 0; b < rowLengths.size(); b++) os << (b ? ", " : "") << rowLengths[b];
+    os << "]\n";
+    os << "  },\n";
+    os << "  \"band\": {\n";
+    os << "    \"lower\": "              << lowerBandwidth       << ",\n";
+    os << "    \"upper\": "              << upperBandwidth       << ",\n";
+    os << "    \"profile\": "            << profile              << "\n";
+    os << "  },\n";
+    os << "  \"diagonal\": {\n";
+    os << "    \"missing\": "            << missingDiagonals     << ",\n";
+    os << "    \"dominantRows\": "       << dominantRows         << ",\n";
+    os << "    \"strictlyDominantRows\": " << strictlyDominantRows << ",\n";
+    os << "    \"minDominance\": ";      jsonNumber(os, minDominance); os << "\n";
+    os << "  },\n";
+    os << "  \"symmetry\": {\n";
+    os << "    \"checked\": "            << symmetryChecked      << ",\n";
+    os << "    \"missing\": "            << symmetryMissing      << ",\n";
+    os << "    \"error\": ";             jsonNumber(os, symmetryError); os << "\n";
+    os << "  },\n";
+    os << "  \"bytes\": {\n";
+    os << "    \"COO\": "                << bytesCOO             << ",\n";
+    os << "    \"CSR\": "                << bytesCSR             << ",\n";
+    os << "    \"BSR2\": "               << bytesBSR[0]          << ",\n";
+    os << "    \"BSR3\": "               << bytesBSR[1]          << ",\n";
+    os << "    \"BSR4\": "               << bytesBSR[2]          << ",\n";
+    os << "    \"CCSR8\": "              << bytesCCSR[0]         << ",\n";
+    os << "    \"CCSR16\": "             << bytesCCSR[1]         << "\n";
+    os << "  },\n";
+    os << "  \"spmv\": {\n";
+    os << "    \"haloBytes\": "          << haloBytes            << ",\n";
+    os << "    \"bytesMin\": "           << spmvBytesMin         << ",\n";
+    os << "    \"bytesMax\": "           << spmvBytesMax         << ",\n";
+    os << "    \"flopsPerByte\": ";      jsonNumber(os, spmvIntensity); os << "\n";
+    os << "  }\n";
+    os << "}\n";
+    return os.str();
+}
+
+//--- Analysis ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::analyze(sparseMatrixReport& report) const
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: sparseMatrix analyze requires CSR storage.\n";
+        return;
+    }
+
+    psInt         nRows    = this->localRows_;
+    psInt         firstRow = this->firstRow_;
+    psInt         nBins    = PORESCALE_REPORT_BINS;
+    const psInt * rowPtr   = rowArray_;
+    const psInt * colPtr   = colArray_;
+    const T     * valPtr   = valueArray_;
+
+    // Row statistics, one partial per chunk. buildPar keeps the column order it is
+    // given, the transpose of an entry with a local column is found by bisection
+    // when every row is sorted and by a linear search otherwise.
+    bool sorted = parallelMin((psInt)0, nRows, 1, [=](psInt r)
+    {
+        for (psInt k = rowPtr[r] + 1; k < rowPtr[r + 1]; k++)
+            if (colPtr[k] < colPtr[k - 1]) return 0;
+        return 1;
+    });
+    psInt nChunks = std::min(4 * parallelChunks(), std::max(nRows, (psInt)1));
+    std::vector<rowStats> stats(nChunks);
+    std::vector<int64_t>  bins((size_t)nChunks * nBins, 0);
+    rowStats * statsPtr = stats.data();
+    int64_t  * binsPtr  = bins.data();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        rowStats  s;
+        int64_t * hist = binsPtr + (size_t)c * nBins;
+        for (psInt r = chunkBegin(nRows, c, nChunks); r < chunkBegin(nRows, c + 1, nChunks); r++)
+        {
+            int64_t i      = (int64_t)firstRow + r;
+            int64_t length = rowPtr[r + 1] - rowPtr[r];
+            hist[std::min(length, (int64_t)nBins - 1)]++;
+            s.emptyRows    += (length == 0);
+            s.minRowLength  = std::min(s.minRowLength, length);
+            s.maxRowLength  = std::max(s.maxRowLength, length);
+            s.sumLength2   += (double)length * length;
+            if (length == 0)
+            {
+                s.missingDiagonals++;
+                continue;
+            }
+
+            int64_t lo = colPtr[rowPtr[r]], hi = lo;
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            {
+                lo = std::min(lo, (int64_t)colPtr[k]);
+                hi = std::max(hi, (int64_t)colPtr[k]);
+            }
+            int64_t base = (i >= lo && i <= hi) ? i : lo;
+            double  diagonal = 0.0, offDiagonal = 0.0;
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            {
+                int64_t j = colPtr[k];
+                double  a = fabs((double)valPtr[k]);
+                s.maxAbs  = std::max(s.maxAbs, a);
+                s.lowerBandwidth = std::max(s.lowerBandwidth, i - j);
+                s.upperBandwidth = std::max(s.upperBandwidth, j - i);
+                s.long8  += ccsrLong<int8_t>(j - base);
+                s.long16 += ccsrLong<int16_t>(j - base);
+                if (j == i) diagonal += a;
+                else offDiagonal += a;
+
+                int64_t lj = j - firstRow;
+                if (lj < 0 || lj >= nRows) continue;
+                const psInt * b = colPtr + rowPtr[lj];
+                const psInt * e = colPtr + rowPtr[lj + 1];
+                const psInt * t = sorted ? std::lower_bound(b, e, (psInt)i) : std::find(b, e, (psInt)i);
+                s.checked++;
+                if (t == e || *t != i) s.missing++;
+                else s.symmetryDiff = std::max(s.symmetryDiff, fabs((double)valPtr[k] - (double)valPtr[t - colPtr]));
+            }
+            s.profile          += std::max(i - lo, (int64_t)0);
+            s.missingDiagonals += (diagonal == 0.0);
+            s.dominant         += (diagonal >= offDiagonal);
+            s.strict           += (diagonal > offDiagonal);
+            if (offDiagonal > 0.0) s.minDominance = std::min(s.minDominance, diagonal / offDiagonal);
+        }
+        statsPtr[c] = s;
+    });
+
+    rowStats total;
+    for (const rowStats& s : stats)
+    {
+        total.emptyRows        += s.emptyRows;
+        total.minRowLength      = std::min(total.minRowLength, s.minRowLength);
+        total.maxRowLength      = std::max(total.maxRowLength, s.maxRowLength);
+        total.lowerBandwidth    = std::max(total.lowerBandwidth, s.lowerBandwidth);
+        total.upperBandwidth    = std::max(total.upperBandwidth, s.upperBandwidth);
+        total.profile          += s.profile;
+        total.missingDiagonals += s.missingDiagonals;
+        total.dominant         += s.dominant;
+        total.strict           += s.strict;
+        total.checked          += s.checked;
+        total.missing          += s.missing;
+        total.long8            += s.long8;
+        total.long16           += s.long16;
+        total.sumLength2       += s.sumLength2;
+        total.minDominance      = std::min(total.minDominance, s.minDominance);
+        total.maxAbs            = std::max(total.maxAbs, s.maxAbs);
+        total.symmetryDiff      = std::max(total.symmetryDiff, s.symmetryDiff);
+    }
+    if (nRows == 0) total.minRowLength = std::numeric_limits<int64_t>::max();
+
+    // Stored blocks of each BSR block size, counted per block row.
+    int64_t blocks[3] = { 0, 0, 0 };
+    int64_t bsrValid[3];
+    for (psInt b = 0; b < 3; b++)
+    {
+        psInt B = b + 2;
+        bsrValid[b] = (nRows % B == 0 && firstRow % B == 0 && this->globalColumns_ % B == 0);
+        if (!bsrValid[b]) continue;
+
+        psInt nBlockRows = nRows / B;
+        psInt nBlockChunks = std::min(4 * parallelChunks(), std::max(nBlockRows, (psInt)1));
+        std::vector<int64_t> chunkBlocks(nBlockChunks, 0);
+        int64_t * chunkBlocksPtr = chunkBlocks.data();
+        parallelFor((psInt)0, nBlockChunks, [=](psInt c)
+        {
+            std::vector<psInt> scratch;
+            int64_t n = 0;
+            for (psInt br = chunkBegin(nBlockRows, c, nBlockChunks); br < chunkBegin(nBlockRows, c + 1, nBlockChunks); br++)
+            {
+                scratch.clear();
+                for (psInt k = rowPtr[br * B]; k < rowPtr[(br + 1) * B]; k++) scratch.push_back(colPtr[k] / B);
+                std::sort(scratch.begin(), scratch.end());
+                n += std::unique(scratch.begin(), scratch.end()) - scratch.begin();
+            }
+            chunkBlocksPtr[c] = n;
+        });
+        for (int64_t n : chunkBlocks) blocks[b] += n;
+    }
+
+    // Local footprints and traffic, then global reductions.
+    int64_t iBytes   = sizeof(psInt);
+    int64_t vBytes   = sizeof(T);
+    int64_t nnz      = localNnz_;
+    int64_t groups   = (nRows + PORESCALE_CCSR_GROUP - 1) / PORESCALE_CCSR_GROUP;
+    int64_t window   = (int64_t)columnEnd_ - columnBegin_;
+    int64_t owned    = std::max(std::min((int64_t)columnEnd_, (int64_t)firstRow + nRows)
+                                - std::max((int64_t)columnBegin_, (int64_t)firstRow), (int64_t)0);
+    int64_t rowBytes = ((int64_t)nRows + 1) * iBytes;
+    int64_t bytesCSR = rowBytes + nnz * (iBytes + vBytes);
+    int64_t ccsrBase = rowBytes + (int64_t)nRows * iBytes + (groups + 1) * iBytes + nnz * vBytes;
+    int64_t yBytes   = 2 * (int64_t)nRows * vBytes;
+
+    const psInt nSums = 19;
+    int64_t sums[nSums] =
+    {
+        total.emptyRows, total.profile, total.missingDiagonals, total.dominant, total.strict,
+        total.checked, total.missing, nnz * (2 * iBytes + vBytes), bytesCSR,
+        0, 0, 0,
+        ccsrBase + nnz     + total.long8  * iBytes + ccsrCoding<int8_t>::tableSize  * iBytes,
+        ccsrBase + 2 * nnz + total.long16 * iBytes + ccsrCoding<int16_t>::tableSize * iBytes,
+        (window - owned) * vBytes,
+        bytesCSR + window * vBytes + yBytes,
+        bytesCSR + nnz * vBytes + yBytes,
+        nRows, nnz
+    };
+    for (psInt b = 0; b < 3; b++)
+    {
+        int64_t B = b + 2;
+        sums[9 + b] = ((int64_t)nRows / B + 1) * iBytes + blocks[b] * (iBytes + B * B * vBytes);
+    }
+    globalSum(sums, nSums, this->nPes_);
+
+    std::vector<int64_t> hist(nBins, 0);
+    for (psInt c = 0; c < nChunks; c++)
+        for (psInt b = 0; b < nBins; b++) hist[b] += binsPtr[(size_t)c * nBins + b];
+    globalSum(hist.data(), nBins, this->nPes_);
+
+    int64_t maxs[3]  = { total.maxRowLength, total.lowerBandwidth, total.upperBandwidth };
+    globalMax(maxs, 3, this->nPes_);
+    int64_t mins[4]  = { total.minRowLength, bsrValid[0], bsrValid[1], bsrValid[2] };
+    globalMin(mins, 4, this->nPes_);
+    double  dmaxs[3] = { total.maxAbs, total.symmetryDiff, -total.minDominance };
+    globalMax(dmaxs, 3, this->nPes_);
+    double  length2  = total.sumLength2;
+    globalSum(&length2, 1, this->nPes_);
+
+    int64_t rows = std::max(sums[17], (int64_t)1);
+    double  mean = (double)sums[18] / rows;
+
+    report.globalRows           = this->globalRows_;
+    report.globalColumns        = this->globalColumns_;
+    report.globalNnz            = sums[18];
+    report.emptyRows            = sums[0];
+    report.minRowLength         = (sums[17] > 0) ? mins[0] : 0;
+    report.maxRowLength         = maxs[0];
+    report.meanRowLength        = mean;
+    report.stdRowLength         = sqrt(std::max(length2 / rows - mean * mean, 0.0));
+    report.rowLengths           = hist;
+    report.lowerBandwidth       = maxs[1];
+    report.upperBandwidth       = maxs[2];
+    report.profile              = sums[1];
+    report.missingDiagonals     = sums[2];
+    report.dominantRows         = sums[3];
+    report.strictlyDominantRows = sums[4];
+    report.minDominance         = -dmaxs[2];
+    report.symmetryChecked      = sums[5];
+    report.symmetryMissing      = sums[6];
+    report.symmetryError        = (dmaxs[0] > 0.0) ? dmaxs[1] / dmaxs[0] : 0.0;
+    report.bytesCOO             = sums[7];
+    report.bytesCSR             = sums[8];
+    for (psInt b = 0; b < 3; b++) report.bytesBSR[b] = mins[1 + b] ? sums[9 + b] : -1;
+    report.bytesCCSR[0]         = sums[12];
+    report.bytesCCSR[1]         = sums[13];
+    report.haloBytes            = sums[14];
+    report.spmvBytesMin         = sums[15];
+    report.spmvBytesMax         = sums[16];
+    report.spmvIntensity        = (sums[15] > 0) ? 2.0 * sums[18] / sums[15] : 0.0;
+}
+
+//--- Explicit Instantiations ---//
+template void porescale::sparseMatrix<float>::analyze(sparseMatrixReport&) const;
+template void porescale::sparseMatrix<double>::analyze(sparseMatrixReport&) const;
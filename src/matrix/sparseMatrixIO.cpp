@@ -0,0 +1,681 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for sparseMatrix file IO.
+ */
+
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Matrix market symmetry types. */
+    enum mtxSymmetry
+    {
+        MTX_GENERAL,
+        MTX_SYMMETRIC,
+        MTX_SKEW_SYMMETRIC
+    };
+
+    /** \brief Kind of a coordinate line. */
+    enum mtxLine
+    {
+        MTX_SKIP,
+        MTX_ENTRY,
+        MTX_MALFORMED
+    };
+
+    /** \brief Line counts of a part of the coordinate section. */
+    struct mtxCounts
+    {
+        int64_t stored    = 0;     // valid coordinate lines
+        int64_t mirrored  = 0;     // entries added by symmetry
+        int64_t malformed = 0;     // unparsable or out of range lines
+    };
+
+    /** \brief Matrix market banner and size line. */
+    struct mtxHeader
+    {
+        bool        pattern;
+        mtxSymmetry symmetry;
+        int64_t     rows;
+        int64_t     columns;
+        int64_t     entries;
+        size_t      dataOffset;    // byte offset of the first coordinate line
+    };
+
+    inline const char *
+    skipBlanks(const char * p, const char * end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        return p;
+    }
+
+    inline const char *
+    nextLine(const char * p, const char * end)
+    {
+        const char * nl = (const char *)memchr(p, '\n', end - p);
+        return (nl == NULL) ? end : nl + 1;
+    }
+
+    inline std::string
+    lowerCase(std::string str)
+    {
+        for (auto& c : str) c = (char)tolower(c);
+        return str;
+    }
+
+    /** \brief Parse banner, comments and size line. Returns false on unsupported files. */
+    bool
+    parseHeader(const char * data, size_t size, mtxHeader& h)
+    {
+        const char * end = data + size;
+        const char * p   = data;
+        const char * eol = nextLine(p, end);
+
+        std::istringstream banner(std::string(p, eol));
+        std::string tag, object, layout, field, symmetry;
+        banner >> tag >> object >> layout >> field >> symmetry;
+        if (tag != "%%MatrixMarket" || lowerCase(object) != "matrix" || lowerCase(layout) != "coordinate")
+        {
+            std::cout << "\nPORESCALE Error :: only coordinate matrix market files are supported\n";
+            return false;
+        }
+
+        field = lowerCase(field);
+        if (field == "pattern") h.pattern = true;
+        else if (field == "real" || field == "double" || field == "integer") h.pattern = false;
+        else
+        {
+            std::cout << "\nPORESCALE Error :: matrix market field " << field << " is not supported\n";
+            return false;
+        }
+
+        symmetry = lowerCase(symmetry);
+        if (symmetry == "general") h.symmetry = MTX_GENERAL;
+        else if (symmetry == "symmetric") h.symmetry = MTX_SYMMETRIC;
+        else if (symmetry == "skew-symmetric") h.symmetry = MTX_SKEW_SYMMETRIC;
+        else
+        {
+            std::cout << "\nPORESCALE Error :: matrix market symmetry " << symmetry << " is not supported\n";
+            return false;
+        }
+
+        // skip comments and blank lines up to the size line
+        p = eol;
+        while (p < end)
+        {
+            const char * q = skipBlanks(p, end);
+            if (q < end && *q != '%' && *q != '\n') break;
+            p = nextLine(p, end);
+        }
+        eol = nextLine(p, end);
+
+        std::istringstream sizes(std::string(p, eol));
+        if (!(sizes >> h.rows >> h.columns >> h.entries))
+        {
+            std::cout << "\nPORESCALE Error :: matrix market size line is malformed\n";
+            return false;
+        }
+        h.dataOffset = eol - data;
+        return true;
+    }
+
+    /** \brief Parse one coordinate line. Returns pointer past the line and its kind,
+     *         blank and comment lines are skipped.
+     */
+    template <typename T>
+    inline const char *
+    parseEntry(const char * p, const char * end, bool pattern, psInt& i, psInt& j, T& v, mtxLine& line)
+    {
+        line = MTX_SKIP;
+        p = skipBlanks(p, end);
+        if (p >= end) return end;
+        if (*p == '%' || *p == '\n') return nextLine(p, end);
+
+        line = MTX_MALFORMED;
+        auto ri = std::from_chars(p, end, i);
+        p = skipBlanks(ri.ptr, end);
+        auto rj = std::from_chars(p, end, j);
+        p = rj.ptr;
+        if (ri.ec != std::errc() || rj.ec != std::errc()) return nextLine(p, end);
+
+        if (pattern) v = (T)1;
+        else
+        {
+            p = skipBlanks(p, end);
+            if (p < end && *p == '+') p++;
+            auto rv = std::from_chars(p, end, v);
+            if (rv.ec != std::errc()) return nextLine(p, end);
+            p = rv.ptr;
+        }
+        // matrix market indices are 1 based
+        i--;
+        j--;
+        line = MTX_ENTRY;
+        return nextLine(p, end);
+    }
+
+    /** \brief Apply f(row, column, value) to every stored entry of the lines starting in [begin, stop),
+     *         mirroring entries of symmetric files. Malformed and out of range lines are counted, not applied.
+     */
+    template <typename T, typename F>
+    void
+    forEachEntry(const char * begin, const char * stop, const char * end, const mtxHeader& h, mtxCounts& counts, F f)
+    {
+        const char * p = begin;
+        psInt   i, j;
+        T       v;
+        mtxLine line;
+        while (p < stop)
+        {
+            p = parseEntry(p, end, h.pattern, i, j, v, line);
+            if (line == MTX_SKIP) continue;
+            if (line == MTX_MALFORMED || i < 0 || i >= h.rows || j < 0 || j >= h.columns)
+            {
+                counts.malformed++;
+                continue;
+            }
+            counts.stored++;
+            f(i, j, v);
+            if (h.symmetry != MTX_GENERAL && i != j)
+            {
+                counts.mirrored++;
+                f(j, i, (h.symmetry == MTX_SKEW_SYMMETRIC) ? -v : v);
+            }
+        }
+    }
+
+    /** \brief Positional write of a full buffer. */
+    bool
+    writeAll(int fd, const char * buf, size_t bytes, off_t offset)
+    {
+        while (bytes > 0)
+        {
+            ssize_t written = pwrite(fd, buf, bytes, offset);
+            if (written <= 0) return false;
+            buf    += written;
+            bytes  -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    /** \brief Positional read of a full buffer. */
+    bool
+    readAll(int fd, char * buf, size_t bytes, off_t offset)
+    {
+        while (bytes > 0)
+        {
+            ssize_t got = pread(fd, buf, bytes, offset);
+            if (got <= 0) return false;
+            buf    += got;
+            bytes  -= got;
+            offset += got;
+        }
+        return true;
+    }
+
+    //--- poreScale binary format ---//
+
+    /** \brief Leading header of a poreScale binary matrix file. It is followed by
+     *         nPes {firstRow, localRows, nnzOffset} triples of the writing pes.
+     */
+    struct psMatrixFileHeader
+    {
+        char    magic[8];          // "PSMATRIX"
+        int32_t version;
+        int32_t indexBytes;        // bytes per stored column index
+        int32_t valueBytes;        // bytes per stored value
+        int32_t format;            // psSparseFormat of the stored arrays
+        int64_t globalRows;
+        int64_t globalColumns;
+        int64_t globalNnz;
+        int64_t nPes;              // number of pes that wrote the file
+    };
+
+    const char    psMatrixMagic[8]  = { 'P', 'S', 'M', 'A', 'T', 'R', 'I', 'X' };
+    const int32_t psMatrixVersion   = 1;
+    const int64_t psMatrixAlignment = 4096;
+    const int64_t psIOChunk         = 32 << 20;
+
+    inline int64_t
+    alignUp(int64_t offset) { return ((offset + psMatrixAlignment - 1) / psMatrixAlignment) * psMatrixAlignment; }
+
+    /** \brief Byte offsets of the sections of a poreScale binary file. */
+    struct psMatrixFileLayout
+    {
+        int64_t rowOffset;
+        int64_t columnOffset;
+        int64_t valueOffset;
+        int64_t size;
+
+        psMatrixFileLayout(const psMatrixFileHeader& h)
+        {
+            rowOffset    = alignUp(sizeof(psMatrixFileHeader) + 3 * sizeof(int64_t) * h.nPes);
+            columnOffset = alignUp(rowOffset + sizeof(int64_t) * (h.globalRows + 1));
+            valueOffset  = alignUp(columnOffset + h.indexBytes * h.globalNnz);
+            size         = valueOffset + h.valueBytes * h.globalNnz;
+        }
+    };
+
+    /** \brief Parallel positional IO of a contiguous buffer in large chunks. */
+    bool
+    parallelIO(int fd, char * buf, int64_t bytes, int64_t offset, bool write)
+    {
+        psInt nChunks = (psInt)((bytes + psIOChunk - 1) / psIOChunk);
+        std::vector<char> ok(nChunks, 1);
+        char * okPtr = ok.data();
+        porescale::parallelFor((psInt)0, nChunks, [=](psInt c)
+        {
+            int64_t begin = c * psIOChunk;
+            int64_t count = std::min(psIOChunk, bytes - begin);
+            okPtr[c] = write ? writeAll(fd, buf + begin, count, offset + begin)
+                             : readAll(fd, buf + begin, count, offset + begin);
+        });
+        return std::all_of(ok.begin(), ok.end(), [](char c) { return c != 0; });
+    }
+
+    /** \brief Read count stored values of type S at offset into dst, converting to D. */
+    template <typename D, typename S>
+    bool
+    readConverted(int fd, D * dst, int64_t count, int64_t offset)
+    {
+        if (std::is_same<D, S>::value) return parallelIO(fd, (char *)dst, count * sizeof(D), offset, false);
+
+        // psIOChunk is in bytes, the scratch holds one chunk of stored values.
+        std::vector<S> tmp(std::min(count, psIOChunk / (int64_t)sizeof(S)));
+        for (int64_t begin = 0; begin < count; begin += tmp.size())
+        {
+            int64_t n = std::min((int64_t)tmp.size(), count - begin);
+            if (!parallelIO(fd, (char *)tmp.data(), n * sizeof(S), offset + begin * sizeof(S), false)) return false;
+            S * src = tmp.data();
+            porescale::parallelFor((int64_t)0, n, [=](int64_t k) { dst[begin + k] = (D)src[k]; });
+        }
+        return true;
+    }
+}
+
+//--- Matrix market ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::readMTX(const std::string& fileName)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "\nPORESCALE Error :: unable to open " << fileName << "\n";
+        return;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+
+    void * map = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        std::cout << "\nPORESCALE Error :: unable to map " << fileName << "\n";
+        return;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char * data = (const char *)map;
+    const char * end  = data + size;
+
+    mtxHeader h;
+    if (!parseHeader(data, size, h))
+    {
+        munmap(map, size);
+        return;
+    }
+
+    this->partition((psInt)h.rows, (psInt)h.columns);
+    psInt firstRow = this->firstRow_;
+    psInt lastRow  = this->firstRow_ + this->localRows_;
+
+    // Split the coordinate section into chunks starting on line boundaries.
+    psInt nChunks = 4 * parallelChunks();
+    std::vector<const char *> starts(nChunks + 1);
+    const char * body  = data + h.dataOffset;
+    size_t       bytes = end - body;
+    for (psInt c = 0; c <= nChunks; c++)
+    {
+        const char * p = body + chunkBegin(bytes, c, nChunks);
+        if (c > 0 && c < nChunks && *(p - 1) != '\n') p = nextLine(p, end);
+        starts[c] = p;
+    }
+
+    // Pass 1: count entries that fall in the local row range. Every pe parses all
+    // lines, so the line counts agree across pes.
+    std::vector<psInt>     counts(nChunks + 1, 0);
+    std::vector<mtxCounts> lines(nChunks);
+    const char ** startPtr = starts.data();
+    psInt       * countPtr = counts.data();
+    mtxCounts   * linePtr  = lines.data();
+    parallelFor((psInt)0, nChunks, [=, &h](psInt c)
+    {
+        psInt n = 0;
+        forEachEntry<T>(startPtr[c], startPtr[c + 1], end, h, linePtr[c], [&](psInt i, psInt, T)
+        {
+            if (i >= firstRow && i < lastRow) n++;
+        });
+        countPtr[c] = n;
+    });
+    std::exclusive_scan(counts.begin(), counts.end(), counts.begin(), (psInt)0);
+    psInt nLocal = counts[nChunks];
+
+    mtxCounts total;
+    for (const mtxCounts& l : lines)
+    {
+        total.stored    += l.stored;
+        total.mirrored  += l.mirrored;
+        total.malformed += l.malformed;
+    }
+    int64_t nParsed = nLocal;
+    globalSum(&nParsed, 1, this->nPes_);
+    if (total.malformed > 0 || total.stored != h.entries || nParsed != h.entries + total.mirrored)
+    {
+        std::cout << "\nPORESCALE Error :: " << fileName << " has " << total.malformed
+                  << " malformed or out of range lines and " << total.stored << " of "
+                  << h.entries << " entries\n";
+        munmap(map, size);
+        return;
+    }
+
+    // Pass 2: parse the local entries directly into their slots.
+    arrayCOO<T> * entries = new arrayCOO<T>[nLocal];
+    parallelFor((psInt)0, nChunks, [=, &h](psInt c)
+    {
+        arrayCOO<T> * out = entries + countPtr[c];
+        mtxCounts     unused;
+        forEachEntry<T>(startPtr[c], startPtr[c + 1], end, h, unused, [&](psInt i, psInt j, T v)
+        {
+            if (i >= firstRow && i < lastRow)
+            {
+                out->i_index = i;
+                out->j_index = j;
+                out->value   = v;
+                out++;
+            }
+        });
+    });
+    munmap(map, size);
+
+    buildFromCOO_(entries, nLocal);
+    delete[] entries;
+
+    int64_t nnz = localNnz_;
+    globalSum(&nnz, 1, this->nPes_);
+    globalNnz_ = (psInt)nnz;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::writeMTX(const std::string& fileName)
+{
+    if (sparseFormat_ != CSR && sparseFormat_ != COO)
+    {
+        std::cout << "\nPORESCALE Error :: writeMTX requires CSR or COO storage\n";
+        return;
+    }
+
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+
+    int64_t nnz = localNnz_;
+    globalSum(&nnz, 1, this->nPes_);
+
+    // Every pe builds the same header, so each knows where the body starts.
+    std::string header = "%%MatrixMarket matrix coordinate real general\n"
+                         + std::to_string(this->globalRows_) + " "
+                         + std::to_string(this->globalColumns_) + " "
+                         + std::to_string(nnz) + "\n";
+
+    // Format local rows in parallel, one buffer per chunk.
+    psInt nItems  = (sparseFormat_ == CSR) ? this->localRows_ : localNnz_;
+    psInt nChunks = std::min(4 * parallelChunks(), std::max(nItems, (psInt)1));
+    std::vector<std::string> buffers(nChunks);
+    std::string * bufPtr = buffers.data();
+
+    psSparseFormat format   = sparseFormat_;
+    psInt          firstRow = this->firstRow_;
+    const psInt  * rowPtr   = rowArray_;
+    const psInt  * colPtr   = colArray_;
+    const T      * valPtr   = valueArray_;
+
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        psInt begin = chunkBegin(nItems, c, nChunks);
+        psInt stop  = chunkBegin(nItems, c + 1, nChunks);
+        psInt kBegin = (format == CSR) ? rowPtr[begin] : begin;
+        psInt kEnd   = (format == CSR) ? rowPtr[stop]  : stop;
+
+        std::string& buf = bufPtr[c];
+        buf.resize((size_t)(kEnd - kBegin) * 64);
+        char * p    = &buf[0];
+        char * pEnd = p + buf.size();
+
+        auto emit = [&](psInt i, psInt j, T v)
+        {
+            p = std::to_chars(p, pEnd, (int64_t)i + 1).ptr;
+            *p++ = ' ';
+            p = std::to_chars(p, pEnd, (int64_t)j + 1).ptr;
+            *p++ = ' ';
+            p = std::to_chars(p, pEnd, v).ptr;
+            *p++ = '\n';
+        };
+
+        if (format == CSR)
+        {
+            for (psInt r = begin; r < stop; r++)
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++) emit(firstRow + r, colPtr[k], valPtr[k]);
+        }
+        else
+        {
+            for (psInt k = begin; k < stop; k++) emit(rowPtr[k], colPtr[k], valPtr[k]);
+        }
+        buf.resize(p - &buf[0]);
+    });
+
+    // Byte offsets of each chunk within the file.
+    std::vector<int64_t> offsets(nChunks + 1, 0);
+    for (psInt c = 0; c < nChunks; c++) offsets[c + 1] = offsets[c] + buffers[c].size();
+
+    std::vector<int64_t> peBytes(nPes);
+    allGather(offsets[nChunks], peBytes.data(), this->myPe_, this->nPes_);
+    int64_t peOffset = header.size();
+    for (psInt pe = 0; pe < this->myPe_; pe++) peOffset += peBytes[pe];
+
+    // Control pe creates the file, then every pe writes its block in place.
+    int fd = -1;
+    if (this->myPe_ == CONTROL_PE)
+    {
+        fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) writeAll(fd, header.data(), header.size(), 0);
+    }
+    globalBarrier(this->nPes_);
+    if (this->myPe_ != CONTROL_PE) fd = open(fileName.c_str(), O_WRONLY);
+    if (fd < 0)
+    {
+        std::cout << "\nPORESCALE Error :: unable to open " << fileName << " for writing\n";
+        globalBarrier(this->nPes_);
+        return;
+    }
+
+    const int64_t * offPtr = offsets.data();
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        if (!writeAll(fd, bufPtr[c].data(), bufPtr[c].size(), peOffset + offPtr[c]))
+            std::cout << "\nPORESCALE Error :: write to " << fileName << " failed\n";
+    });
+    close(fd);
+    globalBarrier(this->nPes_);
+}
+
+//--- poreScale binary ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::parRead(const std::string& fileName)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "\nPORESCALE Error :: unable to open " << fileName << "\n";
+        return;
+    }
+
+    psMatrixFileHeader h;
+    if (!readAll(fd, (char *)&h, sizeof(h), 0) || memcmp(h.magic, psMatrixMagic, 8) != 0
+        || h.version != psMatrixVersion || h.format != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: " << fileName << " is not a poreScale CSR matrix file\n";
+        close(fd);
+        return;
+    }
+    if ((h.indexBytes != 4 && h.indexBytes != 8) || (h.valueBytes != 4 && h.valueBytes != 8))
+    {
+        std::cout << "\nPORESCALE Error :: unsupported index or value width in " << fileName << "\n";
+        close(fd);
+        return;
+    }
+    psMatrixFileLayout layout(h);
+
+    // Rows are repartitioned for the current pes, the global row offsets give the nonzero range.
+    this->partition((psInt)h.globalRows, (psInt)h.globalColumns);
+    std::vector<int64_t> rowOffsets(this->localRows_ + 1);
+    bool ok = parallelIO(fd, (char *)rowOffsets.data(), rowOffsets.size() * sizeof(int64_t),
+                         layout.rowOffset + this->firstRow_ * sizeof(int64_t), false);
+    if (!ok || rowOffsets[this->localRows_] < rowOffsets[0])
+    {
+        std::cout << "\nPORESCALE Error :: read of row offsets from " << fileName << " failed\n";
+        close(fd);
+        return;
+    }
+
+    int64_t nnzBegin = rowOffsets[0];
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localNnz_     = (psInt)(rowOffsets[this->localRows_] - nnzBegin);
+    globalNnz_    = (psInt)h.globalNnz;
+    allocate();
+
+    psInt         * rowPtr = rowArray_;
+    const int64_t * offPtr = rowOffsets.data();
+    parallelFor((psInt)0, this->localRows_ + 1, [=](psInt r) { rowPtr[r] = (psInt)(offPtr[r] - nnzBegin); });
+    touchEntries_();
+
+    int64_t columnAt = layout.columnOffset + nnzBegin * h.indexBytes;
+    if (h.indexBytes == 4) ok = ok && readConverted<psInt, int32_t>(fd, colArray_, localNnz_, columnAt);
+    else                   ok = ok && readConverted<psInt, int64_t>(fd, colArray_, localNnz_, columnAt);
+
+    int64_t valueAt = layout.valueOffset + nnzBegin * h.valueBytes;
+    if (h.valueBytes == 4) ok = ok && readConverted<T, float>(fd, valueArray_, localNnz_, valueAt);
+    else                   ok = ok && readConverted<T, double>(fd, valueArray_, localNnz_, valueAt);
+
+    close(fd);
+    if (!ok) std::cout << "\nPORESCALE Error :: read from " << fileName << " failed\n";
+    updateStructure_();
+    this->built_ = ok;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::parWrite(const std::string& fileName)
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: parWrite requires CSR storage\n";
+        return;
+    }
+
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+
+    // Per pe row and nonzero extents, known on every pe.
+    std::vector<int64_t> peFirstRow(nPes), peLocalRows(nPes), peNnz(nPes);
+    allGather(this->firstRow_, peFirstRow.data(), this->myPe_, this->nPes_);
+    allGather(this->localRows_, peLocalRows.data(), this->myPe_, this->nPes_);
+    allGather(localNnz_, peNnz.data(), this->myPe_, this->nPes_);
+
+    std::vector<int64_t> table(3 * nPes);
+    int64_t nnzOffset = 0;
+    for (psInt pe = 0; pe < nPes; pe++)
+    {
+        table[3 * pe]     = peFirstRow[pe];
+        table[3 * pe + 1] = peLocalRows[pe];
+        table[3 * pe + 2] = nnzOffset;
+        nnzOffset += peNnz[pe];
+    }
+    int64_t myNnzOffset = table[3 * this->myPe_ + 2];
+
+    psMatrixFileHeader h;
+    memcpy(h.magic, psMatrixMagic, 8);
+    h.version       = psMatrixVersion;
+    h.indexBytes    = sizeof(psInt);
+    h.valueBytes    = sizeof(T);
+    h.format        = CSR;
+    h.globalRows    = this->globalRows_;
+    h.globalColumns = this->globalColumns_;
+    h.globalNnz     = nnzOffset;
+    h.nPes          = nPes;
+    psMatrixFileLayout layout(h);
+
+    // Control pe creates and sizes the file, then every pe writes its own slices.
+    int fd = -1;
+    if (this->myPe_ == CONTROL_PE)
+    {
+        fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0)
+        {
+            if (ftruncate(fd, layout.size) != 0
+                || !writeAll(fd, (const char *)&h, sizeof(h), 0)
+                || !writeAll(fd, (const char *)table.data(), table.size() * sizeof(int64_t), sizeof(h)))
+                std::cout << "\nPORESCALE Error :: write to " << fileName << " failed\n";
+        }
+    }
+    globalBarrier(this->nPes_);
+    if (this->myPe_ != CONTROL_PE) fd = open(fileName.c_str(), O_WRONLY);
+    if (fd < 0)
+    {
+        std::cout << "\nPORESCALE Error :: unable to open " << fileName << " for writing\n";
+        globalBarrier(this->nPes_);
+        return;
+    }
+
+    // Global row offsets, the last pe also writes the closing offset.
+    psInt nRowOffsets = this->localRows_ + ((this->myPe_ == nPes - 1) ? 1 : 0);
+    std::vector<int64_t> rowOffsets(nRowOffsets);
+    int64_t     * offPtr = rowOffsets.data();
+    const psInt * rowPtr = rowArray_;
+    parallelFor((psInt)0, nRowOffsets, [=](psInt r) { offPtr[r] = myNnzOffset + rowPtr[r]; });
+
+    bool ok = parallelIO(fd, (char *)offPtr, nRowOffsets * sizeof(int64_t),
+                         layout.rowOffset + this->firstRow_ * sizeof(int64_t), true);
+    ok = ok && parallelIO(fd, (char *)colArray_, (int64_t)localNnz_ * sizeof(psInt),
+                          layout.columnOffset + myNnzOffset * sizeof(psInt), true);
+    ok = ok && parallelIO(fd, (char *)valueArray_, (int64_t)localNnz_ * sizeof(T),
+                          layout.valueOffset + myNnzOffset * sizeof(T), true);
+    if (!ok) std::cout << "\nPORESCALE Error :: write to " << fileName << " failed\n";
+
+    close(fd);
+    globalBarrier(this->nPes_);
+}
+
+//--- Explicit Instantiations ---//
+template void porescale::sparseMatrix<float>::readMTX(const std::string&);
+template void porescale::sparseMatrix<double>::readMTX(const std::string&);
+template void porescale::sparseMatrix<float>::writeMTX(const std::string&);
+template void porescale::sparseMatrix<double>::writeMTX(const std::string&);
+template void porescale::sparseMatrix<float>::parRead(const std::string&);
+template void porescale::sparseMatrix<double>::parRead(const std::string&);
+template void porescale::sparseMatrix<float>::parWrite(const std::string&);
+template void porescale::sparseMatrix<double>::parWrite(const std::string&);
@@ -0,0 +1,323 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for sparseMatrix compute kernels.
+ */
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief CSR product of local rows, one contiguous row chunk per thread to match
+     *         the first touch partition of the memory policy. Chunks start at chunkRows
+     *         when given, e.g. bounds balanced by nonzeros.
+     */
+    template <typename T>
+    void
+    csrSpmv(psInt nRows, const psInt * rowPtr, const psInt * colPtr, const T * valPtr,
+            psInt columnBegin, const psInt * chunkRows, const T * x, T * y)
+    {
+        psInt nChunks = porescale::parallelChunks();
+        porescale::parallelFor((psInt)0, nChunks, [=](psInt c)
+        {
+            psInt rBegin = chunkRows ? chunkRows[c] : porescale::chunkBegin(nRows, c, nChunks);
+            psInt rEnd   = chunkRows ? chunkRows[c + 1] : porescale::chunkBegin(nRows, c + 1, nChunks);
+            for (psInt r = rBegin; r < rEnd; r++)
+            {
+                T sum = 0;
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++) sum += valPtr[k] * x[colPtr[k] - columnBegin];
+                y[r] = sum;
+            }
+        });
+    }
+
+    /** \brief BSR product with compile time block size, block loops unroll into vector code. */
+    template <typename T, psInt B>
+    void
+    bsrSpmv(psInt nBlockRows, const psInt * rowPtr, const psInt * colPtr, const T * valPtr,
+            psInt columnBegin, const T * x, T * y)
+    {
+        porescale::parallelFor((psInt)0, nBlockRows, [=](psInt br)
+        {
+            T acc[B];
+            for (psInt i = 0; i < B; i++) acc[i] = 0;
+            for (psInt kb = rowPtr[br]; kb < rowPtr[br + 1]; kb++)
+            {
+                const T * a  = valPtr + (size_t)kb * B * B;
+                const T * xb = x + (colPtr[kb] * B - columnBegin);
+                for (psInt i = 0; i < B; i++)
+                    for (psInt j = 0; j < B; j++) acc[i] += a[i * B + j] * xb[j];
+            }
+            for (psInt i = 0; i < B; i++) y[br * B + i] = acc[i];
+        });
+    }
+
+    /** \brief BSR product for block sizes without a specialized kernel. */
+    template <typename T>
+    void
+    bsrSpmv(psInt B, psInt nBlockRows, const psInt * rowPtr, const psInt * colPtr, const T * valPtr,
+            psInt columnBegin, const T * x, T * y)
+    {
+        porescale::parallelFor((psInt)0, nBlockRows, [=](psInt br)
+        {
+            T * yb = y + br * B;
+            for (psInt i = 0; i < B; i++) yb[i] = 0;
+            for (psInt kb = rowPtr[br]; kb < rowPtr[br + 1]; kb++)
+            {
+                const T * a  = valPtr + (size_t)kb * B * B;
+                const T * xb = x + (colPtr[kb] * B - columnBegin);
+                for (psInt i = 0; i < B; i++)
+                    for (psInt j = 0; j < B; j++) yb[i] += a[i * B + j] * xb[j];
+            }
+        });
+    }
+
+    /** \brief CCSR product, each group of rows walks its own escape stream. */
+    template <typename T, typename D>
+    void
+    ccsrSpmv(psInt nRows, const psInt * rowPtr, const psInt * rowBase, const D * delta,
+             const psInt * table, const psInt * escape, const psInt * escapeGroup, const T * valPtr,
+             psInt columnBegin, const T * x, T * y)
+    {
+        typedef porescale::ccsrCoding<D> coding;
+        psInt nGroups = (nRows + PORESCALE_CCSR_GROUP - 1) / PORESCALE_CCSR_GROUP;
+        porescale::parallelFor((psInt)0, nGroups, [=](psInt g)
+        {
+            const psInt * esc  = escape + escapeGroup[g];
+            psInt         rEnd = std::min(nRows, (g + 1) * PORESCALE_CCSR_GROUP);
+            for (psInt r = g * PORESCALE_CCSR_GROUP; r < rEnd; r++)
+            {
+                const T * xr  = x + (rowBase[r] - columnBegin);
+                T         sum = 0;
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+                {
+                    psInt d = delta[k];
+                    if (d >= coding::directMin) sum += valPtr[k] * xr[d];
+                    else if (d == coding::escape) sum += valPtr[k] * x[*esc++ - columnBegin];
+                    else sum += valPtr[k] * xr[table[d - coding::escape - 1]];
+                }
+                y[r] = sum;
+            }
+        });
+    }
+
+    /** \brief CSR product with R interleaved right hand sides, compile time R. */
+    template <typename T, psInt R>
+    void
+    csrSpmm(psInt nRows, const psInt * rowPtr, const psInt * colPtr, const T * valPtr,
+            psInt columnBegin, const T * X, T * Y)
+    {
+        psInt nChunks = porescale::parallelChunks();
+        porescale::parallelFor((psInt)0, nChunks, [=](psInt c)
+        {
+            psInt rEnd = porescale::chunkBegin(nRows, c + 1, nChunks);
+            for (psInt r = porescale::chunkBegin(nRows, c, nChunks); r < rEnd; r++)
+            {
+                T acc[R];
+                for (psInt j = 0; j < R; j++) acc[j] = 0;
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+                {
+                    const T * x = X + (size_t)(colPtr[k] - columnBegin) * R;
+                    for (psInt j = 0; j < R; j++) acc[j] += valPtr[k] * x[j];
+                }
+                for (psInt j = 0; j < R; j++) Y[(size_t)r * R + j] = acc[j];
+            }
+        });
+    }
+
+    /** \brief CSR product for numbers of right hand sides without a specialized kernel. */
+    template <typename T>
+    void
+    csrSpmm(psInt R, psInt nRows, const psInt * rowPtr, const psInt * colPtr, const T * valPtr,
+            psInt columnBegin, const T * X, T * Y)
+    {
+        psInt nChunks = porescale::parallelChunks();
+        porescale::parallelFor((psInt)0, nChunks, [=](psInt c)
+        {
+            psInt rEnd = porescale::chunkBegin(nRows, c + 1, nChunks);
+            for (psInt r = porescale::chunkBegin(nRows, c, nChunks); r < rEnd; r++)
+            {
+                T * y = Y + (size_t)r * R;
+                for (psInt j = 0; j < R; j++) y[j] = 0;
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+                {
+                    const T * x = X + (size_t)(colPtr[k] - columnBegin) * R;
+                    for (psInt j = 0; j < R; j++) y[j] += valPtr[k] * x[j];
+                }
+            }
+        });
+    }
+
+    /** \brief CCSR product with nRhs interleaved right hand sides. */
+    template <typename T, typename D>
+    void
+    ccsrSpmm(psInt R, psInt nRows, const psInt * rowPtr, const psInt * rowBase, const D * delta,
+             const psInt * table, const psInt * escape, const psInt * escapeGroup, const T * valPtr,
+             psInt columnBegin, const T * X, T * Y)
+    {
+        typedef porescale::ccsrCoding<D> coding;
+        psInt nGroups = (nRows + PORESCALE_CCSR_GROUP - 1) / PORESCALE_CCSR_GROUP;
+        porescale::parallelFor((psInt)0, nGroups, [=](psInt g)
+        {
+            const psInt * esc  = escape + escapeGroup[g];
+            psInt         rEnd = std::min(nRows, (g + 1) * PORESCALE_CCSR_GROUP);
+            for (psInt r = g * PORESCALE_CCSR_GROUP; r < rEnd; r++)
+            {
+                T * y = Y + (size_t)r * R;
+                for (psInt j = 0; j < R; j++) y[j] = 0;
+                for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+                {
+                    psInt d = delta[k], col;
+                    if (d >= coding::directMin) col = rowBase[r] + d;
+                    else if (d == coding::escape) col = *esc++;
+                    else col = rowBase[r] + table[d - coding::escape - 1];
+                    const T * x = X + (size_t)(col - columnBegin) * R;
+                    for (psInt j = 0; j < R; j++) y[j] += valPtr[k] * x[j];
+                }
+            }
+        });
+    }
+}
+
+//--- Kernels ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::diagonal(T * d) const
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: sparseMatrix diagonal requires CSR storage.\n";
+        return;
+    }
+
+    psInt         firstRow = this->firstRow_;
+    const psInt * rowPtr   = rowArray_;
+    const psInt * colPtr   = colArray_;
+    const T     * valPtr   = valueArray_;
+    parallelFor((psInt)0, this->localRows_, [=](psInt r)
+    {
+        T value = 0;
+        for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++)
+            if (colPtr[k] == firstRow + r) value += valPtr[k];
+        d[r] = value;
+    });
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::spmv(const T * x, T * y) const
+{
+    if (sparseFormat_ == CSR)
+    {
+        // Balanced bounds are used while they still partition the local rows.
+        bool balanced = spmvKernel_ == SPMV_BALANCED && (psInt)chunkRows_.size() == parallelChunks() + 1 &&
+                        chunkRows_.back() == this->localRows_;
+        csrSpmv(this->localRows_, rowArray_, colArray_, valueArray_, columnBegin_,
+                balanced ? chunkRows_.data() : (const psInt *)NULL, x, y);
+    }
+    else if (sparseFormat_ == BSR)
+    {
+        psInt nBlockRows = this->localRows_ / blockSize_;
+        switch (blockSize_)
+        {
+            case 2:  bsrSpmv<T, 2>(nBlockRows, rowArray_, colArray_, valueArray_, columnBegin_, x, y); break;
+            case 3:  bsrSpmv<T, 3>(nBlockRows, rowArray_, colArray_, valueArray_, columnBegin_, x, y); break;
+            case 4:  bsrSpmv<T, 4>(nBlockRows, rowArray_, colArray_, valueArray_, columnBegin_, x, y); break;
+            default: bsrSpmv<T>(blockSize_, nBlockRows, rowArray_, colArray_, valueArray_, columnBegin_, x, y); break;
+        }
+    }
+    else if (sparseFormat_ == CCSR)
+    {
+        if (deltaBytes_ == 1)
+            ccsrSpmv(this->localRows_, rowArray_, rowBaseArray_, (const int8_t *)deltaArray_, offsetTable_,
+                     escapeArray_, escapeGroupArray_, valueArray_, columnBegin_, x, y);
+        else
+            ccsrSpmv(this->localRows_, rowArray_, rowBaseArray_, (const int16_t *)deltaArray_, offsetTable_,
+                     escapeArray_, escapeGroupArray_, valueArray_, columnBegin_, x, y);
+    }
+    else
+    {
+        std::cout << "\nPORESCALE Error :: spmv is not available for COO storage, convert to CSR\n";
+    }
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::apply(vector<T>& x, vector<T>& y) const
+{
+    psInt windowBegin = x.firstRow() - x.haloLow();
+    psInt windowEnd   = x.firstRow() + x.localRows() + x.haloHigh();
+    if (columnEnd_ > columnBegin_ && (columnBegin_ < windowBegin || columnEnd_ > windowEnd))
+    {
+        std::cout << "\nPORESCALE Error :: vector window [" << windowBegin << ", " << windowEnd
+                  << ") does not cover matrix columns [" << columnBegin_ << ", " << columnEnd_ << "), see setHalo\n";
+        return;
+    }
+
+    x.exchangeHalo();
+    spmv(x.valueArray() + (columnBegin_ - x.firstRow()), y.valueArray());
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::spmm(const T * X, T * Y, psInt nRhs) const
+{
+    if (nRhs == 1)
+    {
+        spmv(X, Y);
+    }
+    else if (sparseFormat_ == CSR)
+    {
+        psInt n = this->localRows_;
+        switch (nRhs)
+        {
+            case 2:  csrSpmm<T, 2>(n, rowArray_, colArray_, valueArray_, columnBegin_, X, Y); break;
+            case 3:  csrSpmm<T, 3>(n, rowArray_, colArray_, valueArray_, columnBegin_, X, Y); break;
+            case 4:  csrSpmm<T, 4>(n, rowArray_, colArray_, valueArray_, columnBegin_, X, Y); break;
+            default: csrSpmm<T>(nRhs, n, rowArray_, colArray_, valueArray_, columnBegin_, X, Y); break;
+        }
+    }
+    else if (sparseFormat_ == CCSR)
+    {
+        if (deltaBytes_ == 1)
+            ccsrSpmm(nRhs, this->localRows_, rowArray_, rowBaseArray_, (const int8_t *)deltaArray_, offsetTable_,
+                     escapeArray_, escapeGroupArray_, valueArray_, columnBegin_, X, Y);
+        else
+            ccsrSpmm(nRhs, this->localRows_, rowArray_, rowBaseArray_, (const int16_t *)deltaArray_, offsetTable_,
+                     escapeArray_, escapeGroupArray_, valueArray_, columnBegin_, X, Y);
+    }
+    else
+    {
+        std::cout << "\nPORESCALE Error :: spmm requires CSR or CCSR storage\n";
+    }
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::apply(blockVector<T>& X, blockVector<T>& Y) const
+{
+    psInt windowBegin = X.firstRow() - X.haloLow();
+    psInt windowEnd   = X.firstRow() + X.localRows() + X.haloHigh();
+    if (columnEnd_ > columnBegin_ && (columnBegin_ < windowBegin || columnEnd_ > windowEnd))
+    {
+        std::cout << "\nPORESCALE Error :: block vector window [" << windowBegin << ", " << windowEnd
+                  << ") does not cover matrix columns [" << columnBegin_ << ", " << columnEnd_ << "), see setHalo\n";
+        return;
+    }
+
+    X.exchangeHalo();
+    spmm(X.valueArray() + (size_t)(columnBegin_ - X.firstRow()) * X.nRhs(), Y.valueArray(), X.nRhs());
+}
+
+//--- Explicit Instantiations ---//
+template void porescale::sparseMatrix<float>::diagonal(float *) const;
+template void porescale::sparseMatrix<double>::diagonal(double *) const;
+template void porescale::sparseMatrix<float>::spmv(const float *, float *) const;
+template void porescale::sparseMatrix<double>::spmv(const double *, double *) const;
+template void porescale::sparseMatrix<float>::apply(vector<float>&, vector<float>&) const;
+template void porescale::sparseMatrix<double>::apply(vector<double>&, vector<double>&) const;
+template void porescale::sparseMatrix<float>::spmm(const float *, float *, psInt) const;
+template void porescale::sparseMatrix<double>::spmm(const double *, double *, psInt) const;
+template void porescale::sparseMatrix<float>::apply(blockVector<float>&, blockVector<float>&) const;
+template void porescale::sparseMatrix<double>::apply(blockVector<double>&, blockVector<double>&) const;
@@ -0,0 +1,437 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for sparseMatrix products and transpose.
+ */
+
+#include <atomic>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Accumulator for one row of a sparse product.
+     *
+     * Rows whose flop bound is a sizable fraction of the column range are
+     * accumulated densely, other rows in an open addressing hash table sized
+     * from the bound. Storage is kept across rows of a chunk.
+     */
+    template <typename T>
+    class rowAccumulator
+    {
+    public:
+        rowAccumulator(psInt columnBegin, psInt nColumns) :
+            columnBegin_(columnBegin), nColumns_(nColumns), dense_(false), mask_(0) { }
+
+        /** \brief Start a row touching at most bound entries. */
+        void
+        begin(psInt bound)
+        {
+            cols_.clear();
+            dense_ = (int64_t)bound * 16 > nColumns_;
+            if (dense_)
+            {
+                if (mark_.empty())
+                {
+                    mark_.assign(nColumns_, false);
+                    denseValues_.assign(nColumns_, (T)0);
+                }
+                return;
+            }
+            size_t size = 16;
+            while (size < 2 * (size_t)bound) size *= 2;
+            if (keys_.size() < size)
+            {
+                keys_.resize(size);
+                values_.resize(size);
+            }
+            std::fill(keys_.begin(), keys_.begin() + size, -1);
+            mask_ = size - 1;
+        }
+
+        /** \brief Add value to column col. */
+        inline void
+        add(psInt col, T value)
+        {
+            if (dense_)
+            {
+                psInt j = col - columnBegin_;
+                if (!mark_[j])
+                {
+                    mark_[j]        = true;
+                    denseValues_[j] = value;
+                    cols_.push_back(col);
+                }
+                else denseValues_[j] += value;
+                return;
+            }
+            size_t h = slot_(col);
+            if (keys_[h] < 0)
+            {
+                keys_[h]   = col;
+                values_[h] = value;
+                cols_.push_back(col);
+            }
+            else values_[h] += value;
+        }
+
+        /** \brief Number of distinct columns of the row. */
+        psInt size(void) const { return (psInt)cols_.size(); }
+
+        /** \brief Write the row sorted by column, colOut or valOut may be NULL, and reset. */
+        void
+        extract(psInt * colOut, T * valOut)
+        {
+            if (colOut != NULL || valOut != NULL) std::sort(cols_.begin(), cols_.end());
+            for (size_t k = 0; k < cols_.size(); k++)
+            {
+                psInt col = cols_[k];
+                T     value;
+                if (dense_)
+                {
+                    psInt j  = col - columnBegin_;
+                    value    = denseValues_[j];
+                    mark_[j] = false;
+                }
+                else value = values_[slot_(col)];
+                if (colOut != NULL) colOut[k] = col;
+                if (valOut != NULL) valOut[k] = value;
+            }
+        }
+
+    private:
+        /** \brief Hash slot holding col, or the empty slot it belongs in. */
+        inline size_t
+        slot_(psInt col) const
+        {
+            size_t h = ((size_t)col * 2654435761u) & mask_;
+            while (keys_[h] >= 0 && keys_[h] != col) h = (h + 1) & mask_;
+            return h;
+        }
+
+        psInt              columnBegin_;
+        psInt              nColumns_;
+        bool               dense_;
+        size_t             mask_;
+        std::vector<psInt> cols_;
+        std::vector<bool>  mark_;
+        std::vector<T>     denseValues_;
+        std::vector<psInt> keys_;
+        std::vector<T>     values_;
+    };
+}
+
+//--- Products ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::multiply(const sparseMatrix<T>& A, const sparseMatrix<T>& B)
+{
+    if (A.sparseFormat_ != CSR || B.sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: multiply requires CSR operands\n";
+        return;
+    }
+    if (A.localNnz_ > 0 && (A.columnBegin_ < B.firstRow_ || A.columnEnd_ > B.firstRow_ + B.localRows_))
+    {
+        std::cout << "\nPORESCALE Error :: local rows of B do not cover the columns of A, products are local to a pe\n";
+        return;
+    }
+
+    psInt         n           = A.localRows_;
+    psInt         bFirst      = B.firstRow_;
+    psInt         columnBegin = B.columnBegin_;
+    psInt         nColumns    = B.columnEnd_ - B.columnBegin_;
+    const psInt * aRowPtr     = A.rowArray_;
+    const psInt * aColPtr     = A.colArray_;
+    const T     * aValPtr     = A.valueArray_;
+    const psInt * bRowPtr     = B.rowArray_;
+    const psInt * bColPtr     = B.colArray_;
+    const T     * bValPtr     = B.valueArray_;
+    psInt         nChunks     = std::min(4 * parallelChunks(), std::max(n, (psInt)1));
+
+    // Symbolic: distinct columns of every row.
+    psInt * rowPtr = allocateArray<psInt>(n + 1);
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        rowAccumulator<T> acc(columnBegin, nColumns);
+        for (psInt i = chunkBegin(n, c, nChunks); i < chunkBegin(n, c + 1, nChunks); i++)
+        {
+            psInt bound = 0;
+            for (psInt k = aRowPtr[i]; k < aRowPtr[i + 1]; k++)
+            {
+                psInt r = aColPtr[k] - bFirst;
+                bound += bRowPtr[r + 1] - bRowPtr[r];
+            }
+            acc.begin(bound);
+            for (psInt k = aRowPtr[i]; k < aRowPtr[i + 1]; k++)
+            {
+                psInt r = aColPtr[k] - bFirst;
+                for (psInt kb = bRowPtr[r]; kb < bRowPtr[r + 1]; kb++) acc.add(bColPtr[kb], (T)0);
+            }
+            rowPtr[i] = acc.size();
+            acc.extract(NULL, NULL);
+        }
+    });
+    psInt nnz = exclusiveScan(rowPtr, n);
+    rowPtr[n] = nnz;
+
+    // Numeric: accumulate and write sorted rows.
+    psInt * colPtr = allocateEntries<psInt>(n, rowPtr);
+    T     * valPtr = allocateEntries<T>(n, rowPtr);
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        rowAccumulator<T> acc(columnBegin, nColumns);
+        for (psInt i = chunkBegin(n, c, nChunks); i < chunkBegin(n, c + 1, nChunks); i++)
+        {
+            acc.begin(rowPtr[i + 1] - rowPtr[i]);
+            for (psInt k = aRowPtr[i]; k < aRowPtr[i + 1]; k++)
+            {
+                psInt r = aColPtr[k] - bFirst;
+                T     a = aValPtr[k];
+                for (psInt kb = bRowPtr[r]; kb < bRowPtr[r + 1]; kb++) acc.add(bColPtr[kb], a * bValPtr[kb]);
+            }
+            acc.extract(colPtr + rowPtr[i], valPtr + rowPtr[i]);
+        }
+    });
+
+    this->myPe_          = A.myPe_;
+    this->nPes_          = A.nPes_;
+    this->globalRows_    = A.globalRows_;
+    this->localRows_     = n;
+    this->firstRow_      = A.firstRow_;
+    this->globalColumns_ = B.globalColumns_;
+    this->localColumns_  = B.localColumns_;
+    this->firstColumn_   = B.firstColumn_;
+    this->southNeighbor_ = A.southNeighbor_;
+    this->northNeighbor_ = A.northNeighbor_;
+
+    freeCompressed_();
+    freePattern_();
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
+    colArray_      = colPtr;
+    rowArray_      = rowPtr;
+    valueArray_    = valPtr;
+    colCapacity_   = nnz;
+    rowCapacity_   = n + 1;
+    valueCapacity_ = nnz;
+
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localBlocks_  = 0;
+    localNnz_     = nnz;
+
+    int64_t globalNnz = nnz;
+    globalSum(&globalNnz, 1, this->nPes_);
+    globalNnz_ = (psInt)globalNnz;
+    updateStructure_();
+    this->allocated_ = true;
+    this->built_     = true;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::transpose(const sparseMatrix<T>& A)
+{
+    if (A.sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: transpose requires CSR storage\n";
+        return;
+    }
+    if (A.nPes_ > 1)
+    {
+        std::cout << "\nPORESCALE Error :: transpose is only available for matrices held on one pe\n";
+        return;
+    }
+
+    psInt         nRows    = A.globalColumns_;
+    psInt         n        = A.localRows_;
+    psInt         nnz      = A.localNnz_;
+    psInt         firstRow = A.firstRow_;
+    const psInt * aRowPtr  = A.rowArray_;
+    const psInt * aColPtr  = A.colArray_;
+    const T     * aValPtr  = A.valueArray_;
+
+    // Column counts and placement cursors, rows of the result are sorted afterwards.
+    std::atomic<psInt> * cursor = new std::atomic<psInt>[std::max(nRows, (psInt)1)];
+    parallelFor((psInt)0, nRows, [=](psInt c) { cursor[c].store(0, std::memory_order_relaxed); });
+    parallelFor((psInt)0, nnz, [=](psInt k) { cursor[aColPtr[k]].fetch_add(1, std::memory_order_relaxed); });
+
+    psInt * rowPtr = allocateArray<psInt>(nRows + 1);
+    parallelFor((psInt)0, nRows, [=](psInt c) { rowPtr[c] = cursor[c].load(std::memory_order_relaxed); });
+    rowPtr[nRows] = exclusiveScan(rowPtr, nRows);
+    parallelFor((psInt)0, nRows, [=](psInt c) { cursor[c].store(rowPtr[c], std::memory_order_relaxed); });
+
+    psInt * colPtr = allocateEntries<psInt>(nRows, rowPtr);
+    T     * valPtr = allocateEntries<T>(nRows, rowPtr);
+    parallelFor((psInt)0, n, [=](psInt r)
+    {
+        for (psInt k = aRowPtr[r]; k < aRowPtr[r + 1]; k++)
+        {
+            psInt pos   = cursor[aColPtr[k]].fetch_add(1, std::memory_order_relaxed);
+            colPtr[pos] = firstRow + r;
+            valPtr[pos] = aValPtr[k];
+        }
+    });
+    delete[] cursor;
+
+    psInt nChunks = std::min(4 * parallelChunks(), std::max(nRows, (psInt)1));
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::vector<std::pair<psInt, T>> row;
+        for (psInt i = chunkBegin(nRows, c, nChunks); i < chunkBegin(nRows, c + 1, nChunks); i++)
+        {
+            row.clear();
+            for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++) row.emplace_back(colPtr[k], valPtr[k]);
+            std::sort(row.begin(), row.end(), [](const std::pair<psInt, T>& a, const std::pair<psInt, T>& b)
+                      { return a.first < b.first; });
+            for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++)
+            {
+                colPtr[k] = row[k - rowPtr[i]].first;
+                valPtr[k] = row[k - rowPtr[i]].second;
+            }
+        }
+    });
+
+    this->myPe_          = A.myPe_;
+    this->nPes_          = A.nPes_;
+    this->globalRows_    = nRows;
+    this->localRows_     = nRows;
+    this->firstRow_      = 0;
+    this->globalColumns_ = A.globalRows_;
+    this->localColumns_  = A.globalRows_;
+    this->firstColumn_   = 0;
+    this->southNeighbor_ = -1;
+    this->northNeighbor_ = -1;
+
+    freeCompressed_();
+    freePattern_();
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
+    colArray_      = colPtr;
+    rowArray_      = rowPtr;
+    valueArray_    = valPtr;
+    colCapacity_   = nnz;
+    rowCapacity_   = nRows + 1;
+    valueCapacity_ = nnz;
+
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localBlocks_  = 0;
+    localNnz_     = nnz;
+    globalNnz_    = nnz;
+    updateStructure_();
+    this->allocated_ = true;
+    this->built_     = true;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::gatherRows(const sparseMatrix<T>& A, psInt begin, psInt end)
+{
+    if (A.sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: gatherRows requires CSR storage\n";
+        return;
+    }
+
+    psInt myPe = A.myPe_;
+    psInt nPes = A.nPes_;
+    psInt nP   = (nPes > 1) ? nPes : 1;
+    begin      = std::max(begin, (psInt)0);
+    end        = std::min(end, A.globalRows_);
+    psInt n    = std::max(end - begin, (psInt)0);
+    psInt nA   = A.localRows_;
+
+    // Row and nonzero offsets of every pe, nonzeros are numbered in global row order.
+    std::vector<int64_t> rowOffsets(nP + 1), nnzOffsets(nP + 1);
+    allGather(A.firstRow_, rowOffsets.data(), myPe, nPes);
+    allGather(A.localNnz_, nnzOffsets.data(), myPe, nPes);
+    rowOffsets[nP] = A.globalRows_;
+    nnzOffsets[nP] = exclusiveScan(nnzOffsets.data(), nP);
+
+    // Global position of the first nonzero of every row, plus the one following row end - 1.
+    std::vector<int64_t> starts(std::max(nA, (psInt)1)), gathered(n + 1);
+    int64_t       nnzFirst = nnzOffsets[myPe];
+    const psInt * aRowPtr  = A.rowArray_;
+    int64_t     * startPtr = starts.data();
+    parallelFor((psInt)0, nA, [=](psInt r) { startPtr[r] = nnzFirst + aRowPtr[r]; });
+    int64_t ranges[4] = { begin, begin + n, begin + n, std::min((int64_t)begin + n + 1, rowOffsets[nP]) };
+    void  * outs[2]   = { gathered.data(), gathered.data() + n };
+    gatherRanges(starts.data(), sizeof(int64_t), rowOffsets.data(), 2, ranges, outs, myPe, nPes);
+    if (ranges[3] == ranges[2]) gathered[n] = nnzOffsets[nP];
+
+    int64_t nnzBegin = gathered[0];
+    psInt   nnz      = (n > 0) ? (psInt)(gathered[n] - nnzBegin) : 0;
+    psInt * rowPtr   = allocateArray<psInt>(n + 1);
+    const int64_t * gatheredPtr = gathered.data();
+    parallelFor((psInt)0, n + 1, [=](psInt r) { rowPtr[r] = (psInt)(gatheredPtr[r] - nnzBegin); });
+    if (n == 0) rowPtr[0] = 0;
+    psInt * colPtr   = allocateEntries<psInt>(n, rowPtr);
+    T     * valPtr   = allocateEntries<T>(n, rowPtr);
+
+    int64_t nnzRange[2] = { nnzBegin, nnzBegin + nnz };
+    void  * colOut[1]   = { colPtr };
+    void  * valOut[1]   = { valPtr };
+    gatherRanges(A.colArray_, sizeof(psInt), nnzOffsets.data(), 1, nnzRange, colOut, myPe, nPes);
+    gatherRanges(A.valueArray_, sizeof(T), nnzOffsets.data(), 1, nnzRange, valOut, myPe, nPes);
+
+    this->myPe_          = myPe;
+    this->nPes_          = nPes;
+    this->globalRows_    = A.globalRows_;
+    this->localRows_     = n;
+    this->firstRow_      = begin;
+    this->globalColumns_ = A.globalColumns_;
+    this->localColumns_  = A.localColumns_;
+    this->firstColumn_   = A.firstColumn_;
+
+    freeCompressed_();
+    freePattern_();
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
+    colArray_      = colPtr;
+    rowArray_      = rowPtr;
+    valueArray_    = valPtr;
+    colCapacity_   = nnz;
+    rowCapacity_   = n + 1;
+    valueCapacity_ = nnz;
+
+    sparseFormat_ = CSR;
+    blockSize_    = 1;
+    localBlocks_  = 0;
+    localNnz_     = nnz;
+    globalNnz_    = A.globalNnz_;
+    updateStructure_();
+    this->allocated_ = true;
+    this->built_     = true;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::tripleProduct(
+    const sparseMatrix<T>& R,
+    const sparseMatrix<T>& A,
+    const sparseMatrix<T>& P
+)
+{
+    sparseMatrix<T> AP;
+    AP.multiply(A, P);
+    multiply(R, AP);
+}
+
+//--- Explicit Instantiations ---//
+template void porescale::sparseMatrix<float>::multiply(const sparseMatrix<float>&, const sparseMatrix<float>&);
+template void porescale::sparseMatrix<double>::multiply(const sparseMatrix<double>&, const sparseMatrix<double>&);
+template void porescale::sparseMatrix<float>::transpose(const sparseMatrix<float>&);
+template void porescale::sparseMatrix<double>::transpose(const sparseMatrix<double>&);
+template void porescale::sparseMatrix<float>::gatherRows(const sparseMatrix<float>&, psInt, psInt);
+template void porescale::sparseMatrix<double>::gatherRows(const sparseMatrix<double>&, psInt, psInt);
+template void porescale::sparseMatrix<float>::tripleProduct(const sparseMatrix<float>&, const sparseMatrix<float>&,
+                                                            const sparseMatrix<float>&);
+template void porescale::sparseMatrix<double>::tripleProduct(const sparseMatrix<double>&, const sparseMatrix<double>&,
+                                                             const sparseMatrix<double>&);
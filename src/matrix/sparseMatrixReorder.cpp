@@ -0,0 +1,513 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for sparseMatrix reordering.
+ */
+
+#include <atomic>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Graph of the local block of a CSR matrix, self loops and off pe columns dropped. */
+    struct localGraph
+    {
+        psInt         n;        /**< Number of local rows. */
+        psInt         first;    /**< Global index of the first local row. */
+        const psInt * rowPtr;   /**< CSR row offsets. */
+        const psInt * colPtr;   /**< CSR global column indices. */
+
+        /** \brief Call f(u) for every local neighbor u of v. */
+        template <typename F>
+        inline void
+        forNeighbors(psInt v, F f) const
+        {
+            for (psInt k = rowPtr[v]; k < rowPtr[v + 1]; k++)
+            {
+                psInt u = colPtr[k] - first;
+                if (u >= 0 && u < n && u != v) f(u);
+            }
+        }
+    };
+
+    inline void
+    atomicMin(std::atomic<psInt> * a, psInt value)
+    {
+        psInt current = a->load(std::memory_order_relaxed);
+        while (value < current && !a->compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+    }
+
+    /** \brief Cuthill-McKee labels of the component of root, level synchronous.
+     *
+     * Every level is expanded in parallel: unlabeled neighbors are claimed by the
+     * earliest labeled parent, grouped by parent and sorted by degree within each
+     * group. order[next, return) receives the component, label[v] its position.
+     * nLevels and lastLevel report the level structure for root selection.
+     */
+    psInt
+    cuthillMcKee(const localGraph & g, psInt root, psInt next, const psInt * degree,
+                 psInt * label, psInt * order, std::atomic<psInt> * parent, psInt * counts,
+                 psInt & nLevels, psInt & lastLevel)
+    {
+        order[next] = root;
+        label[root] = next;
+        psInt begin = next, end = next + 1;
+        nLevels     = 0;
+        lastLevel   = begin;
+        while (begin < end)
+        {
+            nLevels++;
+            lastLevel = begin;
+            porescale::parallelFor(begin, end, [=, &g](psInt f)
+            {
+                g.forNeighbors(order[f], [=](psInt u) { if (label[u] < 0) atomicMin(parent + u, f); });
+            });
+            porescale::parallelFor(begin, end, [=, &g](psInt f)
+            {
+                psInt c = 0;
+                g.forNeighbors(order[f], [&](psInt u) { if (label[u] < 0 && parent[u].load(std::memory_order_relaxed) == f) c++; });
+                counts[f - begin] = c;
+            });
+            psInt nNext = porescale::exclusiveScan(counts, end - begin);
+            porescale::parallelFor(begin, end, [=, &g](psInt f)
+            {
+                psInt pos = end + counts[f - begin];
+                g.forNeighbors(order[f], [&](psInt u) { if (label[u] < 0 && parent[u].load(std::memory_order_relaxed) == f) order[pos++] = u; });
+            });
+            std::sort(std::execution::par, order + end, order + end + nNext, [=](psInt a, psInt b)
+            {
+                psInt pa = parent[a].load(std::memory_order_relaxed), pb = parent[b].load(std::memory_order_relaxed);
+                if (pa != pb) return pa < pb;
+                if (degree[a] != degree[b]) return degree[a] < degree[b];
+                return a < b;
+            });
+            porescale::parallelFor(end, end + nNext, [=](psInt k)
+            {
+                label[order[k]] = k;
+                parent[order[k]].store(PORESCALE_INTMAX, std::memory_order_relaxed);
+            });
+            begin = end;
+            end  += nNext;
+        }
+        return end;
+    }
+
+    /** \brief Level of every vertex of part from a breadth first search restricted to the part.
+     *
+     * Returns the number of levels, level[v] is -1 for vertices not reached.
+     * queue receives the reached vertices in search order.
+     */
+    psInt
+    partLevels(const localGraph & g, psInt root, psInt part, const psInt * owner,
+               psInt * level, psInt * queue, psInt & nReached)
+    {
+        psInt head = 0, tail = 0, nLevels = 0;
+        queue[tail++] = root;
+        level[root]   = 0;
+        while (head < tail)
+        {
+            psInt v = queue[head++];
+            nLevels = std::max(nLevels, level[v] + 1);
+            g.forNeighbors(v, [&](psInt u)
+            {
+                if (owner[u] == part && level[u] < 0)
+                {
+                    level[u]      = level[v] + 1;
+                    queue[tail++] = u;
+                }
+            });
+        }
+        nReached = tail;
+        return nLevels;
+    }
+}
+
+//--- Reorder ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::orderRCM(psInt * perm) const
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: orderRCM requires CSR storage\n";
+        return;
+    }
+
+    psInt      n = this->localRows_;
+    localGraph g = { n, this->firstRow_, rowArray_, colArray_ };
+    if (n == 0) return;
+
+    std::vector<psInt> degree(n), label(n, -1), order(n), counts(n + 1), byDegree(n);
+    std::atomic<psInt> * parent = new std::atomic<psInt>[n];
+    psInt * degreePtr   = degree.data();
+    psInt * byDegreePtr = byDegree.data();
+    parallelFor((psInt)0, n, [=, &g](psInt v)
+    {
+        psInt d = 0;
+        g.forNeighbors(v, [&](psInt) { d++; });
+        degreePtr[v]   = d;
+        byDegreePtr[v] = v;
+        parent[v].store(PORESCALE_INTMAX, std::memory_order_relaxed);
+    });
+    std::sort(std::execution::par, byDegree.begin(), byDegree.end(),
+              [=](psInt a, psInt b) { return (degreePtr[a] != degreePtr[b]) ? degreePtr[a] < degreePtr[b] : a < b; });
+
+    psInt * labelPtr = label.data();
+    psInt * orderPtr = order.data();
+    psInt   next = 0, cursor = 0;
+    while (next < n)
+    {
+        while (label[byDegree[cursor]] >= 0) cursor++;
+
+        // Pseudo-peripheral root: restart from a minimum degree vertex of the
+        // last level until the number of levels stops growing.
+        psInt root = byDegree[cursor], best = root, nLevels = 0;
+        for (psInt sweep = 0; sweep < 8; sweep++)
+        {
+            psInt levels, lastLevel;
+            psInt end = cuthillMcKee(g, root, next, degreePtr, labelPtr, orderPtr, parent, counts.data(), levels, lastLevel);
+            psInt candidate = *std::min_element(order.begin() + lastLevel, order.begin() + end,
+                                                [=](psInt a, psInt b) { return degreePtr[a] < degreePtr[b]; });
+            parallelFor(next, end, [=](psInt k) { labelPtr[orderPtr[k]] = -1; });
+            if (levels <= nLevels) break;
+            nLevels = levels;
+            best    = root;
+            if (candidate == root) break;
+            root    = candidate;
+        }
+
+        psInt levels, lastLevel;
+        next = cuthillMcKee(g, best, next, degreePtr, labelPtr, orderPtr, parent, counts.data(), levels, lastLevel);
+    }
+    delete[] parent;
+
+    parallelFor((psInt)0, n, [=](psInt k) { perm[k] = orderPtr[n - 1 - k]; });
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::orderNestedDissection(psInt * perm) const
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: orderNestedDissection requires CSR storage\n";
+        return;
+    }
+
+    psInt      n = this->localRows_;
+    localGraph g = { n, this->firstRow_, rowArray_, colArray_ };
+    if (n == 0) return;
+
+    // Parts are contiguous ranges of perm, owner[v] is the first position of the
+    // part holding v, or -1 once v is placed in a separator or a leaf.
+    std::vector<psInt> owner(n, 0), level(n, -1), scratch(n);
+    psInt * ownerPtr   = owner.data();
+    psInt * levelPtr   = level.data();
+    psInt * scratchPtr = scratch.data();
+    parallelFor((psInt)0, n, [=](psInt v) { perm[v] = v; });
+
+    std::vector<psInt> parts = { 0, n };
+    while (!parts.empty())
+    {
+        psInt nParts = (psInt)parts.size() / 2;
+        std::vector<std::vector<psInt>> children(nParts);
+        const psInt        * partPtr  = parts.data();
+        std::vector<psInt> * childPtr = children.data();
+        parallelFor((psInt)0, nParts, [=, &g](psInt p)
+        {
+            psInt begin = partPtr[2 * p], end = partPtr[2 * p + 1], m = end - begin;
+            psInt * queue = scratchPtr + begin;
+            auto leaf = [&](void) { for (psInt k = begin; k < end; k++) ownerPtr[perm[k]] = -1; };
+            if (m <= PORESCALE_ND_LEAF)
+            {
+                leaf();
+                return;
+            }
+
+            // Connected components of the part, e.g. isolated pores. Each becomes a part of
+            // its own, so a small component cannot turn the whole part into a leaf.
+            psInt reached, found = 0;
+            std::vector<psInt> componentEnds;
+            for (psInt k = begin; k < end; k++)
+            {
+                if (levelPtr[perm[k]] >= 0) continue;
+                partLevels(g, perm[k], begin, ownerPtr, levelPtr, queue + found, reached);
+                found += reached;
+                componentEnds.push_back(begin + found);
+            }
+            for (psInt k = 0; k < m; k++) levelPtr[queue[k]] = -1;
+            if (componentEnds.size() > 1)
+            {
+                psInt first = begin;
+                for (psInt last : componentEnds)
+                {
+                    for (psInt k = first; k < last; k++)
+                    {
+                        perm[k]           = queue[k - begin];
+                        ownerPtr[perm[k]] = first;
+                    }
+                    childPtr[p].push_back(first);
+                    childPtr[p].push_back(last);
+                    first = last;
+                }
+                return;
+            }
+
+            // Pseudo-peripheral root: restart from a minimum degree vertex of the last
+            // level until the number of levels stops growing, then keep its levels.
+            auto degree = [&](psInt v)
+            {
+                psInt d = 0;
+                g.forNeighbors(v, [&](psInt u) { if (ownerPtr[u] == begin) d++; });
+                return d;
+            };
+            psInt root = queue[m - 1], best = root, nLevels = 0;
+            for (psInt sweep = 0; sweep < 8; sweep++)
+            {
+                psInt levels    = partLevels(g, root, begin, ownerPtr, levelPtr, queue, reached);
+                psInt candidate = queue[reached - 1];
+                for (psInt k = reached - 1; k >= 0 && levelPtr[queue[k]] == levels - 1; k--)
+                    if (degree(queue[k]) < degree(candidate)) candidate = queue[k];
+                for (psInt k = 0; k < reached; k++) levelPtr[queue[k]] = -1;
+                if (levels <= nLevels) break;
+                nLevels = levels;
+                best    = root;
+                if (candidate == root) break;
+                root    = candidate;
+            }
+            nLevels = partLevels(g, best, begin, ownerPtr, levelPtr, queue, reached);
+            if (nLevels < 3)
+            {
+                for (psInt k = 0; k < reached; k++) levelPtr[queue[k]] = -1;
+                leaf();
+                return;
+            }
+
+            // Separator is the level of the median reached vertex, the queue is level ordered.
+            psInt separator = levelPtr[queue[(reached - 1) / 2]];
+            separator = std::max((psInt)1, std::min(separator, nLevels - 2));
+
+            // [levels below | levels above | separator]
+            psInt nLow = 0, nHigh = 0, nSep = 0;
+            for (psInt k = begin; k < end; k++)
+            {
+                psInt l = levelPtr[perm[k]];
+                if (l < separator) nLow++;
+                else if (l == separator) nSep++;
+                else nHigh++;
+            }
+            psInt low = begin, high = begin + nLow, sep = begin + nLow + nHigh;
+            for (psInt k = begin; k < end; k++)
+            {
+                psInt v = perm[k], l = levelPtr[v];
+                if (l < separator) queue[low++ - begin] = v;
+                else if (l == separator) queue[sep++ - begin] = v;
+                else queue[high++ - begin] = v;
+            }
+            for (psInt k = begin; k < end; k++)
+            {
+                psInt v = queue[k - begin];
+                perm[k]     = v;
+                levelPtr[v] = -1;
+                ownerPtr[v] = (k < begin + nLow) ? begin : (k < begin + nLow + nHigh) ? begin + nLow : -1;
+            }
+
+            childPtr[p] = { begin, begin + nLow, begin + nLow, begin + nLow + nHigh };
+        });
+
+        parts.clear();
+        for (const std::vector<psInt>& list : children)
+            for (size_t c = 0; c < list.size(); c += 2)
+                if (list[c + 1] > list[c])
+                {
+                    parts.push_back(list[c]);
+                    parts.push_back(list[c + 1]);
+                }
+    }
+}
+
+template <typename T>
+psInt
+porescale::sparseMatrix<T>::colorRows(psInt * colors) const
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: colorRows requires CSR storage\n";
+        return 0;
+    }
+
+    psInt      n = this->localRows_;
+    localGraph g = { n, this->firstRow_, rowArray_, colArray_ };
+    std::fill(colors, colors + n, (psInt)-1);
+
+    // Two colors by breadth first search when the graph is bipartite, e.g. any voxel
+    // stencil of face neighbors, whatever the solid voxels.
+    std::vector<psInt> queue(n);
+    bool               bipartite = true;
+    for (psInt root = 0; root < n && bipartite; root++)
+    {
+        if (colors[root] >= 0) continue;
+        psInt head = 0, tail = 0;
+        queue[tail++] = root;
+        colors[root]  = 0;
+        while (head < tail && bipartite)
+        {
+            psInt v = queue[head++];
+            g.forNeighbors(v, [&](psInt u)
+            {
+                if (colors[u] < 0)
+                {
+                    colors[u]     = 1 - colors[v];
+                    queue[tail++] = u;
+                }
+                else if (colors[u] == colors[v]) bipartite = false;
+            });
+        }
+    }
+    if (bipartite) return (n > 0) ? 1 + *std::max_element(colors, colors + n) : 0;
+
+    // First fit in row order otherwise, over the symmetrized graph: rows listing v as a
+    // column are gathered once into transpose offsets, so an unsymmetric pattern cannot
+    // give v the color of a row that reads it. stamp[c] == v marks color c as taken.
+    std::vector<psInt> inPtr(n + 1, 0), inRows;
+    for (psInt v = 0; v < n; v++) g.forNeighbors(v, [&](psInt u) { inPtr[u + 1]++; });
+    for (psInt v = 0; v < n; v++) inPtr[v + 1] += inPtr[v];
+    inRows.resize(std::max(inPtr[n], (psInt)1));
+    std::vector<psInt> cursor(inPtr.begin(), inPtr.end() - 1);
+    for (psInt v = 0; v < n; v++) g.forNeighbors(v, [&](psInt u) { inRows[cursor[u]++] = v; });
+
+    std::vector<psInt> stamp;
+    psInt              nColors = 0;
+    std::fill(colors, colors + n, (psInt)-1);
+    for (psInt v = 0; v < n; v++)
+    {
+        g.forNeighbors(v, [&](psInt u)
+        {
+            if (colors[u] >= 0) stamp[colors[u]] = v;
+        });
+        for (psInt k = inPtr[v]; k < inPtr[v + 1]; k++)
+            if (colors[inRows[k]] >= 0) stamp[colors[inRows[k]]] = v;
+        psInt c = 0;
+        while (c < nColors && stamp[c] == v) c++;
+        if (c == nColors)
+        {
+            stamp.push_back(-1);
+            nColors++;
+        }
+        colors[v] = c;
+    }
+    return nColors;
+}
+
+template <typename T>
+void
+porescale::sparseMatrix<T>::permute(const psInt * perm)
+{
+    if (sparseFormat_ != CSR) convertToCSR();
+
+    psInt n        = this->localRows_;
+    psInt firstRow = this->firstRow_;
+    psInt nPes     = (this->nPes_ > 1) ? this->nPes_ : 1;
+
+    // New global index of every owned row, gathered over the column window so
+    // that columns owned by other pes are renumbered as well.
+    std::vector<psInt> ownedNew(std::max(n, (psInt)1));
+    psInt * ownedNewPtr = ownedNew.data();
+    parallelFor((psInt)0, n, [=](psInt i) { ownedNewPtr[perm[i]] = firstRow + i; });
+
+    std::vector<int64_t> peOffsets(nPes + 1);
+    allGather(firstRow, peOffsets.data(), this->myPe_, this->nPes_);
+    peOffsets[nPes] = this->globalRows_;
+
+    psInt   columnBegin = columnBegin_;
+    std::vector<psInt> window(std::max(columnEnd_ - columnBegin_, (psInt)1));
+    int64_t range[2]    = { columnBegin_, columnEnd_ };
+    void  * out[1]      = { window.data() };
+    gatherRanges(ownedNew.data(), sizeof(psInt), peOffsets.data(), 1, range, out, this->myPe_, this->nPes_);
+    const psInt * windowPtr = window.data();
+
+    const psInt * rowPtr = rowArray_;
+    const psInt * colPtr = colArray_;
+    const T     * valPtr = valueArray_;
+    psInt       * newRowPtr = allocateArray<psInt>(n + 1);
+    psInt       * slotMap   = allocateArray<psInt>(localNnz_);
+
+    parallelFor((psInt)0, n, [=](psInt i) { newRowPtr[i] = rowPtr[perm[i] + 1] - rowPtr[perm[i]]; });
+    newRowPtr[n] = exclusiveScan(newRowPtr, n);
+    psInt       * newColPtr = allocateEntries<psInt>(n, newRowPtr);
+    T           * newValPtr = allocateEntries<T>(n, newRowPtr);
+
+    // Renumber and sort every row, slotMap records the new position of each old slot.
+    psInt nChunks = std::min(4 * parallelChunks(), std::max(n, (psInt)1));
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::vector<std::pair<psInt, psInt>> row;
+        for (psInt i = chunkBegin(n, c, nChunks); i < chunkBegin(n, c + 1, nChunks); i++)
+        {
+            psInt r = perm[i];
+            row.clear();
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++) row.emplace_back(windowPtr[colPtr[k] - columnBegin], k);
+            std::sort(row.begin(), row.end());
+            psInt k = newRowPtr[i];
+            for (const std::pair<psInt, psInt>& entry : row)
+            {
+                newColPtr[k]          = entry.first;
+                newValPtr[k]          = valPtr[entry.second];
+                slotMap[entry.second] = k;
+                k++;
+            }
+        }
+    });
+
+    // Carry a split build along.
+    if (slotEntryPtr_ != NULL)
+    {
+        psInt   nnz        = localNnz_;
+        psInt   nEntries   = nEntries_;
+        psInt * oldSlotPtr = slotEntryPtr_;
+        psInt * oldEntries = slotEntryArray_;
+        psInt * entrySlot  = entrySlotArray_;
+        psInt * oldOf      = allocateArray<psInt>(nnz);
+        psInt * slotPtr    = allocateArray<psInt>(nnz + 1);
+        psInt * entries    = allocateArray<psInt>(nEntries);
+        parallelFor((psInt)0, nnz, [=](psInt k) { oldOf[slotMap[k]] = k; });
+        parallelFor((psInt)0, nnz, [=](psInt s) { slotPtr[s] = oldSlotPtr[oldOf[s] + 1] - oldSlotPtr[oldOf[s]]; });
+        slotPtr[nnz] = exclusiveScan(slotPtr, nnz);
+        parallelFor((psInt)0, nnz, [=](psInt s)
+        {
+            std::copy(oldEntries + oldSlotPtr[oldOf[s]], oldEntries + oldSlotPtr[oldOf[s] + 1], entries + slotPtr[s]);
+        });
+        parallelFor((psInt)0, nEntries, [=](psInt e) { entrySlot[e] = slotMap[entrySlot[e]]; });
+        freeArray(oldOf);
+        freeArray(slotEntryPtr_);
+        freeArray(slotEntryArray_);
+        slotEntryPtr_   = slotPtr;
+        slotEntryArray_ = entries;
+    }
+    freeArray(slotMap);
+
+    releaseArray(colArray_, colCapacity_);
+    releaseArray(rowArray_, rowCapacity_);
+    releaseArray(valueArray_, valueCapacity_);
+    colArray_      = newColPtr;
+    rowArray_      = newRowPtr;
+    valueArray_    = newValPtr;
+    colCapacity_   = localNnz_;
+    rowCapacity_   = n + 1;
+    valueCapacity_ = localNnz_;
+
+    updateStructure_();
+}
+
+//--- Explicit Instantiations ---//
+template void porescale::sparseMatrix<float>::orderRCM(psInt *) const;
+template void porescale::sparseMatrix<double>::orderRCM(psInt *) const;
+template void porescale::sparseMatrix<float>::orderNestedDissection(psInt *) const;
+template void porescale::sparseMatrix<double>::orderNestedDissection(psInt *) const;
+template psInt porescale::sparseMatrix<float>::colorRows(psInt *) const;
+template psInt porescale::sparseMatrix<double>::colorRows(psInt *) const;
+template void porescale::sparseMatrix<float>::permute(const psInt *);
+template void porescale::sparseMatrix<double>::permute(const psInt *);
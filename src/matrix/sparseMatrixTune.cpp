@@ -0,0 +1,247 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for sparseMatrix SpMV format and kernel tuning.
+ */
+
+#include <chrono>
+#include <limits>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief One tuning candidate. */
+    struct spmvChoice
+    {
+        porescale::psSparseFormat format;
+        psInt                     deltaBytes;
+        psInt                     blockSize;
+        porescale::psSpmvKernel   kernel;
+    };
+
+    /** \brief Bit mixer of splitmix64. */
+    inline uint64_t
+    mix64(uint64_t h)
+    {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /** \brief CPU model from /proc/cpuinfo, "unknown" elsewhere. */
+    std::string
+    cpuModel(void)
+    {
+        std::ifstream file("/proc/cpuinfo");
+        std::string   line;
+        while (std::getline(file, line))
+        {
+            if (line.compare(0, 10, "model name") != 0) continue;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) break;
+            size_t begin = line.find_first_not_of(" \t", colon + 1);
+            return (begin == std::string::npos) ? std::string("unknown") : line.substr(begin);
+        }
+        return "unknown";
+    }
+
+    /** \brief Seconds per product of spmv on the slowest pe. */
+    template <typename T>
+    double
+    timeSpmv(const porescale::sparseMatrix<T>& A, psInt iterations)
+    {
+        size_t window = (size_t)std::max(A.columnEnd() - A.columnBegin(), (psInt)0);
+        T    * x      = porescale::allocateArray<T>(window);
+        T    * y      = porescale::allocateArray<T>(A.localRows());
+        std::fill(x, x + window, (T)1);
+
+        A.spmv(x, y);
+        porescale::globalBarrier(A.nPes());
+        auto start = std::chrono::steady_clock::now();
+        for (psInt it = 0; it < iterations; it++) A.spmv(x, y);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+        porescale::globalMax(&seconds, 1, A.nPes());
+
+        porescale::freeArray(x);
+        porescale::freeArray(y);
+        return seconds;
+    }
+}
+
+//--- Kernel selection ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::setSpmvKernel(psSpmvKernel kernel)
+{
+    spmvKernel_ = kernel;
+    chunkRows_.clear();
+    if (kernel != SPMV_BALANCED) return;
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Warning :: balanced spmv applies to CSR storage only, using row chunks.\n";
+        return;
+    }
+
+    // Chunk c starts at the first row holding nonzero c * nnz / nChunks.
+    psInt         nRows   = this->localRows_;
+    psInt         nnz     = localNnz_;
+    psInt         nChunks = parallelChunks();
+    const psInt * rowPtr  = rowArray_;
+    chunkRows_.resize(nChunks + 1);
+    psInt * bounds = chunkRows_.data();
+    parallelFor((psInt)0, nChunks + 1, [=](psInt c)
+    {
+        int64_t target = ((int64_t)nnz * c) / nChunks;
+        bounds[c] = (psInt)(std::lower_bound(rowPtr, rowPtr + nRows, target) - rowPtr);
+    });
+    bounds[0]       = 0;
+    bounds[nChunks] = nRows;
+}
+
+//--- Signature ---//
+template <typename T>
+uint64_t
+porescale::sparseMatrix<T>::signature(void) const
+{
+    if (sparseFormat_ != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: sparseMatrix signature requires CSR storage.\n";
+        return 0;
+    }
+
+    // Row hashes are truncated to 32 bits so the global sum cannot overflow.
+    psInt         nRows    = this->localRows_;
+    psInt         firstRow = this->firstRow_;
+    const psInt * rowPtr   = rowArray_;
+    const psInt * colPtr   = colArray_;
+    psInt         nChunks  = std::min(4 * parallelChunks(), std::max(nRows, (psInt)1));
+    int64_t       sum      = parallelReduce((psInt)0, nChunks, (int64_t)0, [=](psInt c)
+    {
+        int64_t s = 0;
+        for (psInt r = chunkBegin(nRows, c, nChunks); r < chunkBegin(nRows, c + 1, nChunks); r++)
+        {
+            uint64_t h = mix64((uint64_t)(firstRow + r));
+            for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++) h = mix64(h + (uint64_t)(int64_t)(colPtr[k] - (firstRow + r)));
+            s += (int64_t)(h & 0xffffffffULL);
+        }
+        return s;
+    });
+    int64_t values[2] = { sum, localNnz_ };
+    globalSum(values, 2, this->nPes_);
+
+    uint64_t h = mix64((uint64_t)values[0]);
+    h = mix64(h ^ (uint64_t)values[1]);
+    h = mix64(h ^ (uint64_t)this->globalRows_);
+    h = mix64(h ^ (uint64_t)this->globalColumns_);
+    return h;
+}
+
+//--- Tuning ---//
+template <typename T>
+void
+porescale::sparseMatrix<T>::autoTune(const std::string& cacheFile, psInt iterations)
+{
+    if (sparseFormat_ != CSR) convertToCSR();
+    iterations = std::max(iterations, (psInt)1);
+
+    // Timings depend on the precision, pes and threads as well as the pattern.
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+    std::ostringstream key;
+    key << std::hex << signature() << std::dec << " " << sizeof(T) << " " << nPes << " " << parallelChunks();
+    std::string cpu = cpuModel();
+
+    spmvChoice best = { CSR, 0, 1, SPMV_ROWS };
+    int64_t    hit  = 0;
+    if (!cacheFile.empty())
+    {
+        std::ifstream file(cacheFile);
+        std::string   line;
+        while (std::getline(file, line))
+        {
+            std::istringstream in(line);
+            std::string hash, model;
+            size_t      bytes;
+            psInt       pes, threads, format, deltaBytes, blockSize, kernel;
+            if (!(in >> hash >> bytes >> pes >> threads >> format >> deltaBytes >> blockSize >> kernel)) continue;
+            std::getline(in >> std::ws, model);
+
+            std::ostringstream lineKey;
+            lineKey << hash << " " << bytes << " " << pes << " " << threads;
+            if (lineKey.str() != key.str() || model != cpu) continue;
+            best = { (psSparseFormat)format, deltaBytes, blockSize, (psSpmvKernel)kernel };
+            hit  = 1;
+        }
+    }
+    globalMin(&hit, 1, this->nPes_);
+
+    if (!hit)
+    {
+        std::vector<spmvChoice> candidates;
+        std::vector<double>     seconds;
+
+        // CSR kernels and CCSR widths are timed in place, CCSR converts back exactly.
+        for (psSpmvKernel kernel : { SPMV_ROWS, SPMV_BALANCED })
+        {
+            setSpmvKernel(kernel);
+            candidates.push_back({ CSR, 0, 1, kernel });
+            seconds.push_back(timeSpmv(*this, iterations));
+        }
+        setSpmvKernel(SPMV_ROWS);
+        for (psInt deltaBytes = 1; deltaBytes <= 2; deltaBytes++)
+        {
+            convertToCCSR(deltaBytes);
+            candidates.push_back({ CCSR, deltaBytes, 1, SPMV_ROWS });
+            seconds.push_back(timeSpmv(*this, iterations));
+            convertToCSR();
+        }
+
+        // BSR fills blocks with explicit zeros, so it is timed on a scratch copy.
+        for (psInt B = 2; B <= 4; B++)
+        {
+            int64_t valid = (this->localRows_ % B == 0 && this->firstRow_ % B == 0 && this->globalColumns_ % B == 0);
+            globalMin(&valid, 1, this->nPes_);
+            if (!valid) continue;
+
+            sparseMatrix<T> trial;
+            trial.myPe_ = this->myPe_;
+            trial.nPes_ = this->nPes_;
+            trial.buildPar(this->localRows_, this->globalRows_, this->localColumns_, this->globalColumns_,
+                           localNnz_, globalNnz_, colArray_, rowArray_, valueArray_, CSR);
+            trial.setFirstRow(this->firstRow_);
+            trial.setFirstColumn(this->firstColumn_);
+            trial.convertToBSR(B);
+
+            int64_t fill = (trial.localNnz_ <= 2 * (int64_t)localNnz_);
+            globalMin(&fill, 1, this->nPes_);
+            candidates.push_back({ BSR, 0, B, SPMV_ROWS });
+            seconds.push_back(fill ? timeSpmv(trial, iterations) : std::numeric_limits<double>::infinity());
+        }
+
+        best = candidates[std::min_element(seconds.begin(), seconds.end()) - seconds.begin()];
+
+        if (!cacheFile.empty() && this->myPe_ == CONTROL_PE)
+        {
+            std::ofstream file(cacheFile, std::ios::app);
+            file << key.str() << " " << (psInt)best.format << " " << best.deltaBytes << " "
+                 << best.blockSize << " " << (psInt)best.kernel << " " << cpu << "\n";
+        }
+    }
+
+    if (best.format == CCSR) convertToCCSR(best.deltaBytes);
+    else if (best.format == BSR) convertToBSR(best.blockSize);
+    setSpmvKernel(best.format == CSR ? best.kernel : SPMV_ROWS);
+}
+
+//--- Explicit Instantiations ---//
+template void porescale::sparseMatrix<float>::setSpmvKernel(psSpmvKernel);
+template void porescale::sparseMatrix<double>::setSpmvKernel(psSpmvKernel);
+template uint64_t porescale::sparseMatrix<float>::signature(void) const;
+template uint64_t porescale::sparseMatrix<double>::signature(void) const;
+template void porescale::sparseMatrix<float>::autoTune(const std::string&, psInt);
+template void porescale::sparseMatrix<double>::autoTune(const std::string&, psInt);
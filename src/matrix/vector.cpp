@@ -0,0 +1,377 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for vector class.
+ */
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+
+//--- Constructors ---//
+template <typename T>
+porescale::vector<T>::vector(void) : porescale::denseMatrix<T>::denseMatrix() { };
+
+template <typename T>
+porescale::vector<T>::vector(parameters<T> * par) : porescale::denseMatrix<T>::denseMatrix(par) { };
+
+//--- Destructor ---//
+template <typename T>
+porescale::vector<T>::~vector(void) { }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::vector<T>::build(psInt globalRows)
+{
+    denseMatrix<T>::build(globalRows, 1);
+
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+    peOffsets_.assign(nPes + 1, 0);
+    allGather(this->firstRow_, peOffsets_.data(), this->myPe_, this->nPes_);
+    peOffsets_[nPes] = globalRows;
+}
+
+template <typename T>
+void
+porescale::vector<T>::buildLike(const vector<T>& x)
+{
+    this->myPe_          = x.myPe_;
+    this->nPes_          = x.nPes_;
+    this->globalRows_    = x.globalRows_;
+    this->localRows_     = x.localRows_;
+    this->globalColumns_ = 1;
+    this->localColumns_  = 1;
+    this->firstRow_      = x.firstRow_;
+    this->firstColumn_   = 0;
+    this->southNeighbor_ = x.southNeighbor_;
+    this->northNeighbor_ = x.northNeighbor_;
+    this->haloLow_       = x.haloLow_;
+    this->haloHigh_      = x.haloHigh_;
+    peOffsets_           = x.peOffsets_;
+
+    this->allocateZero();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::vector<T>::buildLike(const sparseMatrix<T>& A)
+{
+    this->myPe_          = A.myPe();
+    this->nPes_          = A.nPes();
+    this->globalRows_    = A.globalRows();
+    this->localRows_     = A.localRows();
+    this->globalColumns_ = 1;
+    this->localColumns_  = 1;
+    this->firstRow_      = A.firstRow();
+    this->firstColumn_   = 0;
+    this->southNeighbor_ = A.southNeighbor();
+    this->northNeighbor_ = A.northNeighbor();
+    this->haloLow_       = std::max(A.firstRow() - A.columnBegin(), (psInt)0);
+    this->haloHigh_      = std::max(A.columnEnd() - (A.firstRow() + A.localRows()), (psInt)0);
+
+    this->allocateZero();
+    this->built_ = true;
+
+    psInt nPes = (this->nPes_ > 1) ? this->nPes_ : 1;
+    peOffsets_.assign(nPes + 1, 0);
+    allGather(this->firstRow_, peOffsets_.data(), this->myPe_, this->nPes_);
+    peOffsets_[nPes] = this->globalRows_;
+}
+
+//--- Halo ---//
+template <typename T>
+void
+porescale::vector<T>::setHalo(psInt begin, psInt end)
+{
+    psInt haloLow  = std::max(this->firstRow_ - begin, (psInt)0);
+    psInt haloHigh = std::max(end - (this->firstRow_ + this->localRows_), (psInt)0);
+    if (haloLow == this->haloLow_ && haloHigh == this->haloHigh_) return;
+
+    std::vector<T> owned(this->valueArray(), this->valueArray() + this->localRows_);
+    this->haloLow_  = haloLow;
+    this->haloHigh_ = haloHigh;
+    this->allocateZero();
+    std::copy(std::execution::par, owned.begin(), owned.end(), this->valueArray());
+}
+
+template <typename T>
+void
+porescale::vector<T>::exchangeHalo(void)
+{
+    T     * owned     = this->valueArray();
+    int64_t ownedEnd  = (int64_t)this->firstRow_ + this->localRows_;
+    int64_t ranges[4] = { (int64_t)this->firstRow_ - this->haloLow_, (int64_t)this->firstRow_,
+                          ownedEnd, ownedEnd + this->haloHigh_ };
+    void  * outs[2]   = { owned - this->haloLow_, owned + this->localRows_ };
+    gatherRanges(owned, sizeof(T), peOffsets_.data(), 2, ranges, outs, this->myPe_, this->nPes_);
+}
+
+//--- Level 1 kernels ---//
+template <typename T>
+void
+porescale::vector<T>::set(T alpha)
+{
+    T * y = this->valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) y[i] = alpha;
+    });
+}
+
+template <typename T>
+void
+porescale::vector<T>::copy(const vector<T>& x)
+{
+    T       * y  = this->valueArray();
+    const T * xp = x.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) y[i] = xp[i];
+    });
+}
+
+template <typename T>
+void
+porescale::vector<T>::scale(T alpha)
+{
+    T * y = this->valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) y[i] *= alpha;
+    });
+}
+
+template <typename T>
+void
+porescale::vector<T>::axpy(T alpha, const vector<T>& x)
+{
+    T       * y  = this->valueArray();
+    const T * xp = x.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) y[i] += alpha * xp[i];
+    });
+}
+
+template <typename T>
+void
+porescale::vector<T>::axpby(T alpha, const vector<T>& x, T beta)
+{
+    T       * y  = this->valueArray();
+    const T * xp = x.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) y[i] = alpha * xp[i] + beta * y[i];
+    });
+}
+
+template <typename T>
+void
+porescale::vector<T>::waxpby(T alpha, const vector<T>& x, T beta, const vector<T>& y)
+{
+    T       * w  = this->valueArray();
+    const T * xp = x.valueArray();
+    const T * yp = y.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) w[i] = alpha * xp[i] + beta * yp[i];
+    });
+}
+
+template <typename T>
+T
+porescale::vector<T>::axpbyNorm(T alpha, const vector<T>& x, T beta)
+{
+    T       * y  = this->valueArray();
+    const T * xp = x.valueArray();
+    double    sum;
+    streamSums(this->localRows_, 1, &sum, [=](psInt begin, psInt end, double * out)
+    {
+        T s = 0;
+        for (psInt i = begin; i < end; i++)
+        {
+            T v  = alpha * xp[i] + beta * y[i];
+            y[i] = v;
+            s   += v * v;
+        }
+        out[0] = s;
+    });
+    globalSum(&sum, 1, this->nPes_);
+    return (T)sqrt(sum);
+}
+
+template <typename T>
+void
+porescale::vector<T>::pointwiseMultiply(const vector<T>& x, const vector<T>& y)
+{
+    T       * z  = this->valueArray();
+    const T * xp = x.valueArray();
+    const T * yp = y.valueArray();
+    streamFor(this->localRows_, [=](psInt begin, psInt end)
+    {
+        for (psInt i = begin; i < end; i++) z[i] = xp[i] * yp[i];
+    });
+}
+
+template <typename T>
+T
+porescale::vector<T>::dot(const vector<T>& x) const
+{
+    const T * y  = this->valueArray();
+    const T * xp = x.valueArray();
+    double    sum;
+    streamSums(this->localRows_, 1, &sum, [=](psInt begin, psInt end, double * out)
+    {
+        T s = 0;
+        for (psInt i = begin; i < end; i++) s += y[i] * xp[i];
+        out[0] = s;
+    });
+    globalSum(&sum, 1, this->nPes_);
+    return (T)sum;
+}
+
+template <typename T>
+T
+porescale::vector<T>::norm2(void) const
+{
+    return (T)sqrt(dot(*this));
+}
+
+template <typename T>
+T
+porescale::vector<T>::normInf(void) const
+{
+    const T * y       = this->valueArray();
+    psInt     n       = this->localRows_;
+    psInt     nChunks = streamChunks(n);
+    double    norm    = parallelMax((psInt)0, nChunks, 0.0, [=](psInt c)
+    {
+        T m = 0;
+        for (psInt i = chunkBegin(n, c, nChunks); i < chunkBegin(n, c + 1, nChunks); i++) m = std::max(m, (T)fabs(y[i]));
+        return (double)m;
+    });
+    globalMax(&norm, 1, this->nPes_);
+    return (T)norm;
+}
+
+template <typename T>
+void
+porescale::vector<T>::dot2(
+    const vector<T>& a,  const vector<T>& b,
+    const vector<T>& c,  const vector<T>& d,
+    T&               ab, T&               cd
+)
+{
+    const T * ap = a.valueArray();
+    const T * bp = b.valueArray();
+    const T * cp = c.valueArray();
+    const T * dp = d.valueArray();
+    double    sums[2];
+    streamSums(a.localRows_, 2, sums, [=](psInt begin, psInt end, double * out)
+    {
+        T s0 = 0, s1 = 0;
+        for (psInt i = begin; i < end; i++)
+        {
+            s0 += ap[i] * bp[i];
+            s1 += cp[i] * dp[i];
+        }
+        out[0] = s0;
+        out[1] = s1;
+    });
+    globalSum(sums, 2, a.nPes_);
+    ab = (T)sums[0];
+    cd = (T)sums[1];
+}
+
+template <typename T>
+T
+porescale::vector<T>::cgUpdate(
+    T                alpha, const vector<T>& p,
+    const vector<T>& q,     vector<T>&       x,
+    vector<T>&       r
+)
+{
+    const T * pp = p.valueArray();
+    const T * qp = q.valueArray();
+    T       * xp = x.valueArray();
+    T       * rp = r.valueArray();
+    double    sum;
+    streamSums(r.localRows_, 1, &sum, [=](psInt begin, psInt end, double * out)
+    {
+        T s = 0;
+        for (psInt i = begin; i < end; i++)
+        {
+            xp[i] += alpha * pp[i];
+            T v    = rp[i] - alpha * qp[i];
+            rp[i]  = v;
+            s     += v * v;
+        }
+        out[0] = s;
+    });
+    globalSum(&sum, 1, r.nPes_);
+    return (T)sqrt(sum);
+}
+
+template <typename T>
+void
+porescale::vector<T>::dots(psInt nPairs, const vector<T> * const * a, const vector<T> * const * b, T * results)
+{
+    std::vector<double> sums(nPairs);
+    dotsBegin(nPairs, a, b, sums.data());
+    dotsFinish(nPairs, sums.data(), results);
+}
+
+template <typename T>
+void
+porescale::vector<T>::dotsBegin(psInt nPairs, const vector<T> * const * a, const vector<T> * const * b, double * sums)
+{
+    std::vector<const T *> ap(nPairs), bp(nPairs);
+    for (psInt k = 0; k < nPairs; k++)
+    {
+        ap[k] = a[k]->valueArray();
+        bp[k] = b[k]->valueArray();
+    }
+    const T * const * aPtr = ap.data();
+    const T * const * bPtr = bp.data();
+    streamSums(a[0]->localRows_, nPairs, sums, [=](psInt begin, psInt end, double * out)
+    {
+        for (psInt i = begin; i < end; i++)
+            for (psInt k = 0; k < nPairs; k++) out[k] += aPtr[k][i] * bPtr[k][i];
+    });
+    globalSumBegin(sums, nPairs, a[0]->nPes_);
+}
+
+template <typename T>
+void
+porescale::vector<T>::dotsFinish(psInt nPairs, double * sums, T * results)
+{
+    globalSumFinish(sums);
+    for (psInt k = 0; k < nPairs; k++) results[k] = (T)sums[k];
+}
+
+//--- Reorder ---//
+template <typename T>
+void
+porescale::vector<T>::permute(const psInt * perm)
+{
+    std::vector<T> old(this->valueArray(), this->valueArray() + this->localRows_);
+    T       * y  = this->valueArray();
+    const T * yo = old.data();
+    parallelFor((psInt)0, this->localRows_, [=](psInt i) { y[i] = yo[perm[i]]; });
+}
+
+template <typename T>
+void
+porescale::vector<T>::unpermute(const psInt * perm)
+{
+    std::vector<T> old(this->valueArray(), this->valueArray() + this->localRows_);
+    T       * y  = this->valueArray();
+    const T * yo = old.data();
+    parallelFor((psInt)0, this->localRows_, [=](psInt i) { y[perm[i]] = yo[i]; });
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::vector<float>;
+template class porescale::vector<double>;
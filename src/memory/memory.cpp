@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for the storage allocation policy.
+ */
+
+#include <sys/mman.h>
+#include <cstdlib>
+#include <iostream>
+
+#include "memory.hpp"
+
+// Huge page size assumed for rounding and alignment of large allocations.
+#define PORESCALE_HUGE_PAGE (2 * 1024 * 1024)
+
+namespace
+{
+    porescale::memoryPolicy policy_ = { 64, porescale::PAGES_DEFAULT, 4 * 1024 * 1024, true };
+
+    /** \brief Bookkeeping stored in front of every allocation. */
+    struct allocationHeader
+    {
+        void   * base;      /**< Start of the underlying allocation. */
+        size_t   bytes;     /**< Bytes mapped, 0 for heap allocations. */
+    };
+
+    bool hugeWarned_ = false;
+}
+
+void
+porescale::setMemoryPolicy(const memoryPolicy & policy)
+{
+    policy_ = policy;
+    if (policy_.alignment < 64 || (policy_.alignment & (policy_.alignment - 1)))
+    {
+        std::cout << "\nPORESCALE Warning :: memory alignment must be a power of two of at least 64, using 64\n";
+        policy_.alignment = 64;
+    }
+}
+
+const porescale::memoryPolicy &
+porescale::getMemoryPolicy(void) { return policy_; }
+
+void *
+porescale::alignedAllocate(size_t bytes)
+{
+    // The header occupies one alignment unit in front of the returned pointer.
+    size_t pad  = policy_.alignment;
+    bool   huge = bytes >= policy_.hugeThreshold;
+
+    if (huge && policy_.pages == PAGES_HUGETLB)
+    {
+        size_t mapped = ((bytes + pad + PORESCALE_HUGE_PAGE - 1) / PORESCALE_HUGE_PAGE) * PORESCALE_HUGE_PAGE;
+        void * base   = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            allocationHeader * h = (allocationHeader *)((char *)base + pad) - 1;
+            h->base  = base;
+            h->bytes = mapped;
+            return (char *)base + pad;
+        }
+        if (!hugeWarned_)
+        {
+            std::cout << "\nPORESCALE Warning :: hugetlb allocation failed, falling back to regular pages\n";
+            hugeWarned_ = true;
+        }
+    }
+
+    size_t align = (huge && policy_.pages == PAGES_TRANSPARENT) ? PORESCALE_HUGE_PAGE : policy_.alignment;
+    void * base  = NULL;
+    if (posix_memalign(&base, align, bytes + pad) != 0)
+    {
+        std::cout << "\nPORESCALE Error :: failed to allocate " << bytes << " bytes\n";
+        return NULL;
+    }
+    if (huge && policy_.pages == PAGES_TRANSPARENT) madvise(base, bytes + pad, MADV_HUGEPAGE);
+
+    allocationHeader * h = (allocationHeader *)((char *)base + pad) - 1;
+    h->base  = base;
+    h->bytes = 0;
+    return (char *)base + pad;
+}
+
+void
+porescale::alignedFree(void * ptr)
+{
+    if (ptr == NULL) return;
+    allocationHeader * h = (allocationHeader *)ptr - 1;
+    if (h->bytes > 0) munmap(h->base, h->bytes);
+    else free(h->base);
+}
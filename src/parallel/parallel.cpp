@@ -0,0 +1,209 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for pe collectives.
+ */
+
+#include <nvshmem.h>
+#include <nvshmemx.h>
+#include <cstring>
+
+#include "parallel.hpp"
+
+// Symmetric scratch used by the collectives. NVSHMEM reductions require
+// symmetric source and destination buffers, values are staged through
+// these with puts and gets to the local pe.
+#define PORESCALE_SCRATCH 512
+
+namespace
+{
+    double  * symDouble_    = NULL;
+    double  * symDoubleOut_ = NULL;
+    int64_t * symInt_       = NULL;
+    int64_t * symIntOut_    = NULL;
+
+    // Split global sum, reduced on its own stream over a team split from the world so that
+    // it can be in flight while kernels run and blocking collectives use the world team.
+    double       * symPending_    = NULL;
+    double       * symPendingOut_ = NULL;
+    cudaStream_t   pendingStream_ = NULL;
+    nvshmem_team_t pendingTeam_   = NVSHMEM_TEAM_INVALID;
+    double       * pendingValues_ = NULL;
+    psInt          pendingCount_  = 0;
+
+    // Symmetric staging of owned entries for gatherRanges, grown collectively.
+    char    * symStage_     = NULL;
+    int64_t   stageBytes_   = 0;
+
+    void
+    allocateScratch(void)
+    {
+        if (symDouble_ != NULL) return;
+        symDouble_    = (double *)  nvshmem_malloc(PORESCALE_SCRATCH * sizeof(double));
+        symDoubleOut_ = (double *)  nvshmem_malloc(PORESCALE_SCRATCH * sizeof(double));
+        symInt_       = (int64_t *) nvshmem_malloc(PORESCALE_SCRATCH * sizeof(int64_t));
+        symIntOut_    = (int64_t *) nvshmem_malloc(PORESCALE_SCRATCH * sizeof(int64_t));
+    }
+
+    void
+    allocatePending(void)
+    {
+        if (symPending_ != NULL) return;
+        symPending_    = (double *) nvshmem_malloc(PORESCALE_SCRATCH * sizeof(double));
+        symPendingOut_ = (double *) nvshmem_malloc(PORESCALE_SCRATCH * sizeof(double));
+        nvshmem_team_split_strided(NVSHMEM_TEAM_WORLD, 0, 1, nvshmem_n_pes(), NULL, 0, &pendingTeam_);
+        cudaStreamCreateWithFlags(&pendingStream_, cudaStreamNonBlocking);
+    }
+
+    template <typename T, typename R>
+    void
+    reduce(T * values, psInt n, T * sym, T * symOut, R op)
+    {
+        int me = nvshmem_my_pe();
+        for (psInt offset = 0; offset < n; offset += PORESCALE_SCRATCH)
+        {
+            psInt count = std::min((psInt)PORESCALE_SCRATCH, n - offset);
+            nvshmem_putmem(sym, values + offset, count * sizeof(T), me);
+            nvshmem_quiet();
+            op(symOut, sym, count);
+            nvshmem_getmem(values + offset, symOut, count * sizeof(T), me);
+        }
+    }
+}
+
+void
+porescale::globalSum(double * values, psInt n, psInt nPes)
+{
+    if (nPes <= 1 || n <= 0) return;
+    allocateScratch();
+    reduce(values, n, symDouble_, symDoubleOut_, [](double * d, const double * s, psInt c)
+           { nvshmem_double_sum_reduce(NVSHMEM_TEAM_WORLD, d, s, c); });
+}
+
+void
+porescale::globalSumBegin(double * values, psInt n, psInt nPes)
+{
+    if (nPes <= 1 || n <= 0) return;
+    // A nested sum, e.g. from a preconditioner applied while one is pending, blocks.
+    if (n > PORESCALE_SCRATCH || pendingValues_ != NULL)
+    {
+        globalSum(values, n, nPes);
+        return;
+    }
+    allocatePending();
+    cudaMemcpyAsync(symPending_, values, n * sizeof(double), cudaMemcpyDefault, pendingStream_);
+    nvshmemx_double_sum_reduce_on_stream(pendingTeam_, symPendingOut_, symPending_, n, pendingStream_);
+    pendingValues_ = values;
+    pendingCount_  = n;
+}
+
+void
+porescale::globalSumFinish(double * values)
+{
+    if (values != pendingValues_) return;
+    cudaStreamSynchronize(pendingStream_);
+    cudaMemcpy(values, symPendingOut_, pendingCount_ * sizeof(double), cudaMemcpyDefault);
+    pendingValues_ = NULL;
+    pendingCount_  = 0;
+}
+
+void
+porescale::globalSum(int64_t * values, psInt n, psInt nPes)
+{
+    if (nPes <= 1 || n <= 0) return;
+    allocateScratch();
+    reduce(values, n, symInt_, symIntOut_, [](int64_t * d, const int64_t * s, psInt c)
+           { nvshmem_int64_sum_reduce(NVSHMEM_TEAM_WORLD, d, s, c); });
+}
+
+void
+porescale::globalMax(double * values, psInt n, psInt nPes)
+{
+    if (nPes <= 1 || n <= 0) return;
+    allocateScratch();
+    reduce(values, n, symDouble_, symDoubleOut_, [](double * d, const double * s, psInt c)
+           { nvshmem_double_max_reduce(NVSHMEM_TEAM_WORLD, d, s, c); });
+}
+
+void
+porescale::globalMax(int64_t * values, psInt n, psInt nPes)
+{
+    if (nPes <= 1 || n <= 0) return;
+    allocateScratch();
+    reduce(values, n, symInt_, symIntOut_, [](int64_t * d, const int64_t * s, psInt c)
+           { nvshmem_int64_max_reduce(NVSHMEM_TEAM_WORLD, d, s, c); });
+}
+
+void
+porescale::globalMin(int64_t * values, psInt n, psInt nPes)
+{
+    if (nPes <= 1 || n <= 0) return;
+    allocateScratch();
+    reduce(values, n, symInt_, symIntOut_, [](int64_t * d, const int64_t * s, psInt c)
+           { nvshmem_int64_min_reduce(NVSHMEM_TEAM_WORLD, d, s, c); });
+}
+
+void
+porescale::allGather(int64_t value, int64_t * out, psInt myPe, psInt nPes)
+{
+    if (nPes <= 1)
+    {
+        out[0] = value;
+        return;
+    }
+    // Each pe contributes at its own slot, a sum reduction completes the gather.
+    for (psInt pe = 0; pe < nPes; pe++) out[pe] = (pe == myPe) ? value : 0;
+    globalSum(out, nPes, nPes);
+}
+
+void
+porescale::globalBarrier(psInt nPes)
+{
+    if (nPes <= 1) return;
+    nvshmem_barrier_all();
+}
+
+void
+porescale::gatherRanges(
+    const void    * owned,     size_t         elementBytes,
+    const int64_t * peOffsets, psInt          nRanges,
+    const int64_t * ranges,    void * const * outs,
+    psInt           myPe,      psInt          nPes
+)
+{
+    psInt   nP         = (nPes > 1) ? nPes : 1;
+    int64_t ownedBytes = (peOffsets[myPe + 1] - peOffsets[myPe]) * (int64_t)elementBytes;
+
+    if (nPes > 1)
+    {
+        int64_t need = ownedBytes;
+        globalMax(&need, 1, nPes);
+        if (need > stageBytes_)
+        {
+            if (symStage_ != NULL) nvshmem_free(symStage_);
+            symStage_   = (char *) nvshmem_malloc(need);
+            stageBytes_ = need;
+        }
+        std::memcpy(symStage_, owned, ownedBytes);
+        nvshmem_barrier_all();
+    }
+
+    for (psInt r = 0; r < nRanges; r++)
+    {
+        int64_t begin = ranges[2 * r], end = ranges[2 * r + 1];
+        char  * out   = (char *)outs[r];
+        for (psInt pe = 0; pe < nP && begin < end; pe++)
+        {
+            int64_t lo = std::max(begin, peOffsets[pe]);
+            int64_t hi = std::min(end, peOffsets[pe + 1]);
+            if (lo >= hi) continue;
+            size_t bytes  = (hi - lo) * elementBytes;
+            size_t source = (lo - peOffsets[pe]) * elementBytes;
+            if (pe == myPe) std::memcpy(out + (lo - begin) * elementBytes, (const char *)owned + source, bytes);
+            else nvshmem_getmem(out + (lo - begin) * elementBytes, symStage_ + source, bytes, pe);
+        }
+    }
+
+    // Staging must not be overwritten before every pe finished reading.
+    if (nPes > 1) nvshmem_barrier_all();
+}
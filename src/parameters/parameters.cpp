@@ -16,6 +16,7 @@ porescale::parameters<T>::parameters(void) : dimension_(0), length_(0), width_(0
                                                              solverAbsoluteTolerance_(1e-4),
                                                              solverRelativeTolerance_(1e-4),
                                                              solverVerbose_(1),
+                                                             amgStrengthThreshold_(0.08),
                                                              nPes_(0), myPe_(0) {}
 
 template <typename T>
@@ -27,6 +28,7 @@ porescale::parameters<T>::parameters( std::string& problemPath ) : dimension_(0)
                                                              solverAbsoluteTolerance_(1e-4),
                                                              solverRelativeTolerance_(1e-4),
                                                              solverVerbose_(1),
+                                                             amgStrengthThreshold_(0.08),
                                                              nPes_(0), myPe_(0)
 {
   initParameters_( problemPath );
@@ -103,6 +105,10 @@ template <typename T>
 psInt
 porescale::parameters<T>::solverVerbose(void) const { return solverVerbose_; }
 
+template <typename T>
+T
+porescale::parameters<T>::amgStrengthThreshold(void) const { return amgStrengthThreshold_; }
+
 template <typename T>
 std::string&
 porescale::parameters<T>::problemPath(void) { return problemPath_; }
@@ -128,6 +134,7 @@ porescale::parameters<T>::printParameters(void)
   std::cout << "Solver absolute tolerance= " << solverAbsoluteTolerance_ << "\n";
   std::cout << "Solver relative tolerance= " << solverRelativeTolerance_ << "\n";
   std::cout << "Solver verbose= " << solverVerbose_ << "\n";
+  std::cout << "AMG strength threshold= " << amgStrengthThreshold_ << "\n";
   std::cout << "Problem path= " << problemPath_ << "\n";
 }
 
@@ -185,6 +192,7 @@ porescale::parameters<T>::loadParameters_(
     else if (!str.compare("solverAbsoluteTolerance") || !str.compare("solverAbsoluteTolerance=")) iss >> solverAbsoluteTolerance_;
     else if (!str.compare("solverRelativeTolerance") || !str.compare("solverRelativeTolerance=")) iss >> solverRelativeTolerance_;
     else if (!str.compare("solverVerbose") || !str.compare("solverVerbose=")) iss >> solverVerbose_;
+    else if (!str.compare("amgStrengthThreshold") || !str.compare("amgStrengthThreshold=")) iss >> amgStrengthThreshold_;
     else {
       std::cout << "\nPORESCALE Warning :: input token " << str << " in Parameters.dat is undefined\n";
     }
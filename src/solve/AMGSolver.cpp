@@ -0,0 +1,433 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for smoothed aggregation AMG solver class.
+ */
+
+#include <atomic>
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Independent set states, the top bits of a priority key. */
+    const int64_t MIS_OUT       = 0;
+    const int64_t MIS_UNDECIDED = 1;
+    const int64_t MIS_IN        = 2;
+    const int     MIS_SHIFT     = 61;
+
+    /** \brief Bit mixer of splitmix64. */
+    inline uint64_t
+    mix64(uint64_t h)
+    {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /** \brief Key of local row i, the state above a random priority of the global row
+     *         above the local index, so keys are distinct and ordered by state first.
+     */
+    inline int64_t
+    misKey(int64_t state, psInt globalRow, psInt i)
+    {
+        return (state << MIS_SHIFT) | ((int64_t)(mix64((uint64_t)globalRow) & 0x3fffffffULL) << 31) | i;
+    }
+
+    inline int64_t
+    misState(int64_t key) { return key >> MIS_SHIFT; }
+
+    /** \brief Jacobi weight of the prolongator smoothing, the omega minimizing the energy
+     *         |(I - omega D^{-1} A) p|_A of p = P_tent s, s random signs per aggregate:
+     *         omega = (z, D z) / (z, A z) with z = D^{-1} A p. The signs decouple the
+     *         aggregates, so p samples the columns of P_tent together.
+     */
+    template <typename T>
+    T
+    prolongatorWeight(const porescale::sparseMatrix<T>& A, const T * d, const psInt * agg,
+                      const T * tValue, int64_t cFirst)
+    {
+        porescale::vector<T> v, r;
+        v.buildLike(A);
+        r.buildLike(A);
+        T * vp = v.valueArray();
+        T * rp = r.valueArray();
+        porescale::parallelFor((psInt)0, v.localRows(), [=](psInt i)
+        {
+            if (agg[i] < 0) vp[i] = 0;
+            else vp[i] = (mix64((uint64_t)(cFirst + agg[i])) & 1) ? tValue[agg[i]] : -tValue[agg[i]];
+        });
+        A.apply(v, r);
+        porescale::parallelFor((psInt)0, v.localRows(), [=](psInt i) { vp[i] = (d[i] == 0) ? 0 : rp[i] / d[i]; });
+        T zDz = r.dot(v);
+        A.apply(v, r);
+        T zAz = r.dot(v);
+        return (zAz > 0 && zDz > 0) ? zDz / zAz : (T)2 / 3;
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::AMGSolver<T>::AMGSolver(void) : multigridSolver<T>::multigridSolver(), strengthThreshold_(0.08) { }
+
+template <typename T>
+porescale::AMGSolver<T>::AMGSolver(parameters<T> * par) : multigridSolver<T>::multigridSolver(par),
+    strengthThreshold_(par->amgStrengthThreshold()) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::AMGSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+    strengthThreshold_       = par->amgStrengthThreshold();
+}
+
+//--- Strength threshold ---//
+template <typename T>
+void
+porescale::AMGSolver<T>::setStrengthThreshold(T theta)
+{
+    strengthThreshold_ = std::max(theta, (T)0);
+    this->built_       = false;
+}
+
+template <typename T>
+T
+porescale::AMGSolver<T>::strengthThreshold(void) const { return strengthThreshold_; }
+
+//--- Aggregation ---//
+template <typename T>
+psInt
+porescale::AMGSolver<T>::aggregate_(sparseMatrix<T>& A, std::vector<psInt>& aggregates) const
+{
+    psInt         n      = A.localRows();
+    psInt         first  = A.firstRow();
+    const psInt * rowPtr = A.rowArray();
+    const psInt * colPtr = A.columnArray();
+    const T     * valPtr = A.valueArray();
+    double        theta  = strengthThreshold_;
+
+    std::vector<T> diagonal(n);
+    A.diagonal(diagonal.data());
+    const T * d = diagonal.data();
+
+    // Strong connections to local rows, symmetric when the pattern is.
+    std::vector<psInt> strongRow(n + 1, 0);
+    psInt            * sRow   = strongRow.data();
+    auto               strong = [=](psInt i, psInt k)
+    {
+        psInt j = colPtr[k] - first;
+        if (j < 0 || j >= n || j == i) return false;
+        return fabs((double)valPtr[k]) > theta * sqrt(fabs((double)d[i] * d[j]));
+    };
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        psInt count = 0;
+        for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++) count += strong(i, k);
+        sRow[i] = count;
+    });
+    sRow[n] = exclusiveScan(sRow, n);
+    std::vector<psInt> strongCol(std::max(sRow[n], (psInt)1));
+    psInt            * sCol = strongCol.data();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        psInt pos = sRow[i];
+        for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++)
+            if (strong(i, k)) sCol[pos++] = colPtr[k] - first;
+    });
+
+    // Distance two maximal independent set, an undecided row whose key is the largest
+    // within two hops joins, one with a member within two hops leaves. Rows without
+    // strong connections are out from the start.
+    std::vector<int64_t> keys(n), hop1(n), hop2(n);
+    int64_t            * key = keys.data();
+    int64_t            * h1  = hop1.data();
+    int64_t            * h2  = hop2.data();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        key[i] = misKey((sRow[i + 1] > sRow[i]) ? MIS_UNDECIDED : MIS_OUT, first + i, i);
+    });
+    const int64_t low = ((int64_t)1 << MIS_SHIFT) - 1;
+    for (;;)
+    {
+        parallelFor((psInt)0, n, [=](psInt i)
+        {
+            int64_t m = key[i];
+            for (psInt k = sRow[i]; k < sRow[i + 1]; k++) m = std::max(m, key[sCol[k]]);
+            h1[i] = m;
+        });
+        parallelFor((psInt)0, n, [=](psInt i)
+        {
+            int64_t m = h1[i];
+            for (psInt k = sRow[i]; k < sRow[i + 1]; k++) m = std::max(m, h1[sCol[k]]);
+            h2[i] = m;
+        });
+        parallelFor((psInt)0, n, [=](psInt i)
+        {
+            if (misState(key[i]) != MIS_UNDECIDED) return;
+            if (h2[i] == key[i]) key[i] = (key[i] & low) | (MIS_IN << MIS_SHIFT);
+            else if (misState(h2[i]) == MIS_IN) key[i] = key[i] & low;
+        });
+        psInt undecided = parallelReduce((psInt)0, n, (psInt)0, [=](psInt i)
+        {
+            return (psInt)(misState(key[i]) == MIS_UNDECIDED);
+        });
+        if (undecided == 0) break;
+    }
+
+    // Members are roots, their neighbors join them, at most one root lies within one hop.
+    // The remaining rows within two hops join the neighbor of largest key.
+    std::vector<psInt> rootIds(n), first1(n);
+    psInt            * root = rootIds.data();
+    psInt            * agg1 = first1.data();
+    parallelFor((psInt)0, n, [=](psInt i) { root[i] = (misState(key[i]) == MIS_IN); });
+    psInt nAggregates = exclusiveScan(root, n);
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        agg1[i] = -1;
+        if (misState(key[i]) == MIS_IN)
+        {
+            agg1[i] = root[i];
+            return;
+        }
+        for (psInt k = sRow[i]; k < sRow[i + 1]; k++)
+            if (misState(key[sCol[k]]) == MIS_IN) agg1[i] = root[sCol[k]];
+    });
+
+    aggregates.assign(n, -1);
+    psInt * agg = aggregates.data();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        if (agg1[i] >= 0)
+        {
+            agg[i] = agg1[i];
+            return;
+        }
+        int64_t best = -1;
+        for (psInt k = sRow[i]; k < sRow[i + 1]; k++)
+        {
+            psInt j = sCol[k];
+            if (agg1[j] < 0 || key[j] <= best) continue;
+            best   = key[j];
+            agg[i] = agg1[j];
+        }
+    });
+    return nAggregates;
+}
+
+//--- Coarsening ---//
+template <typename T>
+bool
+porescale::AMGSolver<T>::coarsen_(sparseMatrix<T>& A, sparseMatrix<T>& P, sparseMatrix<T>& R, sparseMatrix<T>& Ac) const
+{
+    psInt myPe  = A.myPe();
+    psInt nPes  = A.nPes();
+    psInt nP    = (nPes > 1) ? nPes : 1;
+    psInt n     = A.localRows();
+    psInt first = A.firstRow();
+
+    std::vector<psInt> aggregates;
+    psInt              nAggregates = aggregate_(A, aggregates);
+
+    // Coarse rows of a pe follow those of lower pes.
+    std::vector<int64_t> counts(nP);
+    allGather(nAggregates, counts.data(), myPe, nPes);
+    int64_t cFirst = 0, nCoarse = 0;
+    for (psInt p = 0; p < nP; p++)
+    {
+        if (p < myPe) cFirst += counts[p];
+        nCoarse += counts[p];
+    }
+
+    // Aggregation which removes under a tenth of the rows ends the hierarchy.
+    if (nCoarse == 0 || 10 * nCoarse > 9 * (int64_t)A.globalRows()) return false;
+
+    // Tentative prolongator, one entry 1 / sqrt(|aggregate|) in every aggregated row.
+    const psInt        * agg    = aggregates.data();
+    std::atomic<psInt> * sizes  = new std::atomic<psInt>[std::max(nAggregates, (psInt)1)];
+    parallelFor((psInt)0, nAggregates, [=](psInt a) { sizes[a].store(0, std::memory_order_relaxed); });
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        if (agg[i] >= 0) sizes[agg[i]].fetch_add(1, std::memory_order_relaxed);
+    });
+    std::vector<T> tentative(std::max(nAggregates, (psInt)1));
+    T            * tValue = tentative.data();
+    parallelFor((psInt)0, nAggregates, [=](psInt a)
+    {
+        tValue[a] = (T)(1 / sqrt((double)sizes[a].load(std::memory_order_relaxed)));
+    });
+    delete[] sizes;
+
+    std::vector<psInt> tRow(n + 1);
+    psInt            * tRowPtr = tRow.data();
+    parallelFor((psInt)0, n, [=](psInt i) { tRowPtr[i] = (agg[i] >= 0); });
+    psInt tNnz = exclusiveScan(tRowPtr, n);
+    tRowPtr[n] = tNnz;
+    std::vector<psInt> tCol(std::max(tNnz, (psInt)1));
+    std::vector<T>     tVal(std::max(tNnz, (psInt)1));
+    psInt            * tColPtr = tCol.data();
+    T                * tValPtr = tVal.data();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        if (agg[i] < 0) return;
+        tColPtr[tRowPtr[i]] = (psInt)cFirst + agg[i];
+        tValPtr[tRowPtr[i]] = tValue[agg[i]];
+    });
+    int64_t tGlobalNnz = tNnz;
+    globalSum(&tGlobalNnz, 1, nPes);
+
+    sparseMatrix<T> Ptent;
+    Ptent.setPes(myPe, nPes);
+    Ptent.setFirstRow(first);
+    Ptent.setFirstColumn((psInt)cFirst);
+    Ptent.buildPar(n, A.globalRows(), nAggregates, (psInt)nCoarse, tNnz, (psInt)tGlobalNnz,
+                   tColPtr, tRowPtr, tValPtr, CSR);
+
+    // Smoothed prolongator P = Ptent - omega D^{-1} A Ptent, omega of minimal energy.
+    std::vector<T> diagonal(n);
+    A.diagonal(diagonal.data());
+    const T     * d     = diagonal.data();
+    T             omega = prolongatorWeight(A, d, agg, tValue, cFirst);
+
+    psInt windowBegin = std::min(A.columnBegin(), first);
+    psInt windowEnd   = std::max(A.columnEnd(), first + n);
+    sparseMatrix<T> PtentExt;
+    PtentExt.gatherRows(Ptent, windowBegin, windowEnd);
+    P.multiply(A, PtentExt);
+
+    const psInt * pRowPtr = P.rowArray();
+    const psInt * pColPtr = P.columnArray();
+    T           * pValPtr = P.valueArray();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        T scale = (d[i] == 0) ? 0 : -omega / d[i];
+        for (psInt k = pRowPtr[i]; k < pRowPtr[i + 1]; k++) pValPtr[k] *= scale;
+        if (agg[i] < 0) return;
+        psInt         column = (psInt)cFirst + agg[i];
+        const psInt * found  = std::lower_bound(pColPtr + pRowPtr[i], pColPtr + pRowPtr[i + 1], column);
+        if (found != pColPtr + pRowPtr[i + 1] && *found == column) pValPtr[found - pColPtr] += tValue[agg[i]];
+    });
+
+    // R = P^T from the P rows of the window, by symmetry of the pattern they hold every
+    // entry in a local coarse column.
+    sparseMatrix<T> Pext;
+    Pext.gatherRows(P, windowBegin, windowEnd);
+    psInt         nExt     = Pext.localRows();
+    psInt         extFirst = Pext.firstRow();
+    const psInt * eRowPtr  = Pext.rowArray();
+    const psInt * eColPtr  = Pext.columnArray();
+    const T     * eValPtr  = Pext.valueArray();
+    psInt         cBegin   = (psInt)cFirst;
+    psInt         cEnd     = cBegin + nAggregates;
+
+    std::atomic<psInt> * cursor = new std::atomic<psInt>[std::max(nAggregates, (psInt)1)];
+    parallelFor((psInt)0, nAggregates, [=](psInt a) { cursor[a].store(0, std::memory_order_relaxed); });
+    parallelFor((psInt)0, nExt, [=](psInt r)
+    {
+        for (psInt k = eRowPtr[r]; k < eRowPtr[r + 1]; k++)
+            if (eColPtr[k] >= cBegin && eColPtr[k] < cEnd) cursor[eColPtr[k] - cBegin].fetch_add(1, std::memory_order_relaxed);
+    });
+    std::vector<psInt> rRow(nAggregates + 1);
+    psInt            * rRowPtr = rRow.data();
+    parallelFor((psInt)0, nAggregates, [=](psInt a) { rRowPtr[a] = cursor[a].load(std::memory_order_relaxed); });
+    psInt rNnz = exclusiveScan(rRowPtr, nAggregates);
+    rRowPtr[nAggregates] = rNnz;
+    parallelFor((psInt)0, nAggregates, [=](psInt a) { cursor[a].store(rRowPtr[a], std::memory_order_relaxed); });
+
+    std::vector<psInt> rCol(std::max(rNnz, (psInt)1));
+    std::vector<T>     rVal(std::max(rNnz, (psInt)1));
+    psInt            * rColPtr = rCol.data();
+    T                * rValPtr = rVal.data();
+    parallelFor((psInt)0, nExt, [=](psInt r)
+    {
+        for (psInt k = eRowPtr[r]; k < eRowPtr[r + 1]; k++)
+        {
+            if (eColPtr[k] < cBegin || eColPtr[k] >= cEnd) continue;
+            psInt pos    = cursor[eColPtr[k] - cBegin].fetch_add(1, std::memory_order_relaxed);
+            rColPtr[pos] = extFirst + r;
+            rValPtr[pos] = eValPtr[k];
+        }
+    });
+    delete[] cursor;
+
+    psInt nChunks = std::min(4 * parallelChunks(), std::max(nAggregates, (psInt)1));
+    parallelFor((psInt)0, nChunks, [=](psInt c)
+    {
+        std::vector<std::pair<psInt, T>> row;
+        for (psInt a = chunkBegin(nAggregates, c, nChunks); a < chunkBegin(nAggregates, c + 1, nChunks); a++)
+        {
+            row.clear();
+            for (psInt k = rRowPtr[a]; k < rRowPtr[a + 1]; k++) row.emplace_back(rColPtr[k], rValPtr[k]);
+            std::sort(row.begin(), row.end(), [](const std::pair<psInt, T>& x, const std::pair<psInt, T>& y)
+                      { return x.first < y.first; });
+            for (psInt k = rRowPtr[a]; k < rRowPtr[a + 1]; k++)
+            {
+                rColPtr[k] = row[k - rRowPtr[a]].first;
+                rValPtr[k] = row[k - rRowPtr[a]].second;
+            }
+        }
+    });
+    int64_t rGlobalNnz = rNnz;
+    globalSum(&rGlobalNnz, 1, nPes);
+
+    R.setPes(myPe, nPes);
+    R.setFirstRow(cBegin);
+    R.setFirstColumn(first);
+    R.buildPar(nAggregates, (psInt)nCoarse, n, A.globalRows(), rNnz, (psInt)rGlobalNnz,
+               rColPtr, rRowPtr, rValPtr, CSR);
+
+    // Galerkin R A P, A P from the gathered P rows and R from the A P rows it touches.
+    sparseMatrix<T> AP, APext;
+    AP.multiply(A, Pext);
+    APext.gatherRows(AP, R.columnBegin(), R.columnEnd());
+    Ac.multiply(R, APext);
+    return true;
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::AMGSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: AMGSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: AMGSolver requires a CSR matrix.\n";
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    this->clearLevels_();
+    this->levelA_.push_back(this->A_);
+    while ((psInt)this->levelA_.size() < this->maxLevels_ && this->levelA_.back()->globalRows() > this->coarseSize_)
+    {
+        sparseMatrix<T> * P  = new sparseMatrix<T>();
+        sparseMatrix<T> * R  = new sparseMatrix<T>();
+        sparseMatrix<T> * Ac = new sparseMatrix<T>();
+        if (!coarsen_(*this->levelA_.back(), *P, *R, *Ac))
+        {
+            delete P;
+            delete R;
+            delete Ac;
+            break;
+        }
+        this->addLevel_(Ac, P, R);
+    }
+
+    this->finishBuild_(start);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::AMGSolver<float>;
+template class porescale::AMGSolver<double>;
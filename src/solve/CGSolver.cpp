@@ -0,0 +1,393 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for conjugate gradient solver class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Vector recurrences of one pipelined CG iteration in one sweep.
+     *
+     * z = n + beta z, s = w + beta s, p = u + beta p, x += alpha p, r -= alpha s,
+     * w -= alpha z and, when preconditioned, q = m + beta q, u -= alpha q. Without a
+     * preconditioner u is r and q is s, so u and q are passed NULL and u reads r.
+     */
+    template <typename T>
+    void
+    pipelinedUpdate(psInt n, T alpha, T beta, const T * nv, const T * m, T * z, T * q,
+                    T * s, T * p, T * x, T * r, T * u, T * w)
+    {
+        const T * uRead = u ? u : r;
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++)
+            {
+                T zi = nv[i] + beta * z[i];
+                T si = w[i] + beta * s[i];
+                T pi = uRead[i] + beta * p[i];
+                z[i] = zi;
+                s[i] = si;
+                p[i] = pi;
+                if (q)
+                {
+                    T qi = m[i] + beta * q[i];
+                    q[i]  = qi;
+                    u[i] -= alpha * qi;
+                }
+                x[i] += alpha * pi;
+                r[i] -= alpha * si;
+                w[i] -= alpha * zi;
+            }
+        });
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::CGSolver<T>::CGSolver(void) : krylovSolver<T>::krylovSolver(), variant_(CG_CLASSIC) { }
+
+template <typename T>
+porescale::CGSolver<T>::CGSolver(parameters<T> * par) : krylovSolver<T>::krylovSolver(par), variant_(CG_CLASSIC) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::CGSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::CGSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: CGSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    // Every workspace vector carries the halo of the matrix, so any of them can be applied.
+    const sparseMatrix<T>& A = *this->A_;
+    r_.buildLike(A);
+    z_.buildLike(A);
+    q_.buildLike(A);
+    p_.buildLike(A);
+    if (variant_ == CG_PIPELINED)
+    {
+        u_.buildLike(A);
+        w_.buildLike(A);
+        m_.buildLike(A);
+        n_.buildLike(A);
+        s_.buildLike(A);
+    }
+    this->built_ = true;
+}
+
+//--- Variant ---//
+template <typename T>
+void
+porescale::CGSolver<T>::setVariant(psCGVariant variant)
+{
+    variant_     = variant;
+    this->built_ = false;
+}
+
+template <typename T>
+porescale::psCGVariant
+porescale::CGSolver<T>::variant(void) const { return variant_; }
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::CGSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    if (variant_ == CG_PIPELINED) solvePipelined_(b, x);
+    else solveClassic_(b, x);
+}
+
+template <typename T>
+void
+porescale::CGSolver<T>::solveClassic_(vector<T>& b, vector<T>& x)
+{
+    const sparseMatrix<T>& A = *this->A_;
+    solver<T>            * M = this->M_;
+    vector<T>            & z = M ? z_ : r_;
+
+    // r = b - A x, x is staged through p for its halo.
+    this->beginTelemetry_();
+    p_.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(p_, q_);
+    this->charge_(TELEMETRY_SPMV);
+    r_.copy(q_);
+    T rNorm = r_.axpbyNorm(1, b, -1);
+    this->charge_(TELEMETRY_REDUCTION, 5);
+
+    this->iterations_      = 0;
+    this->initialResidual_ = rNorm;
+    this->currentResidual_ = rNorm;
+    this->commit_(0, rNorm);
+    if (rNorm == 0 || this->converged_(0, rNorm, rNorm)) return;
+
+    if (M)
+    {
+        M->apply(r_, z_);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+    }
+    p_.copy(z);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    T rz = M ? r_.dot(z_) : rNorm * rNorm;
+    if (M) this->charge_(TELEMETRY_REDUCTION, 2);
+
+    for (psInt it = 1; it <= this->maxIterations_; it++)
+    {
+        A.apply(p_, q_);
+        this->charge_(TELEMETRY_SPMV);
+        T pq = p_.dot(q_);
+        this->charge_(TELEMETRY_REDUCTION, 2);
+        if (pq == 0)
+        {
+            std::cout << "\nPORESCALE Warning :: CG breakdown, p.Ap = 0 at iteration " << it << ".\n";
+            break;
+        }
+
+        T alpha = rz / pq;
+        rNorm   = vector<T>::cgUpdate(alpha, p_, q_, x, r_);
+        this->charge_(TELEMETRY_REDUCTION, 6);
+        this->iterations_      = it;
+        this->currentResidual_ = rNorm;
+        this->commit_(it, rNorm);
+        if (this->converged_(it, rNorm, this->initialResidual_)) break;
+
+        T rzNew;
+        if (M)
+        {
+            M->apply(r_, z_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+            rzNew = r_.dot(z_);
+            this->charge_(TELEMETRY_REDUCTION, 2);
+        }
+        else rzNew = rNorm * rNorm;
+        p_.axpby(1, z, rzNew / rz);
+        this->charge_(TELEMETRY_UPDATE, 3);
+        rz = rzNew;
+    }
+}
+
+template <typename T>
+void
+porescale::CGSolver<T>::solvePipelined_(vector<T>& b, vector<T>& x)
+{
+    const sparseMatrix<T>& A = *this->A_;
+    solver<T>            * M = this->M_;
+    vector<T>            & u = M ? u_ : r_;
+    vector<T>            & m = M ? m_ : w_;
+
+    // r = b - A x, u = M r, w = A u.
+    this->beginTelemetry_();
+    p_.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(p_, s_);
+    this->charge_(TELEMETRY_SPMV);
+    r_.copy(s_);
+    T rNorm = r_.axpbyNorm(1, b, -1);
+    this->charge_(TELEMETRY_REDUCTION, 5);
+
+    this->iterations_      = 0;
+    this->initialResidual_ = rNorm;
+    this->currentResidual_ = rNorm;
+    this->commit_(0, rNorm);
+    if (rNorm == 0 || this->converged_(0, rNorm, rNorm)) return;
+
+    if (M)
+    {
+        M->apply(r_, u_);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+    }
+    A.apply(u, w_);
+    this->charge_(TELEMETRY_SPMV);
+
+    const vector<T> * left[3]  = { &r_, &w_, &r_ };
+    const vector<T> * right[3] = { &u,  &u,  &r_ };
+    T    gammaOld  = 1, alphaOld = 1;
+    bool converged = false;
+    for (psInt it = 1; it <= this->maxIterations_; it++)
+    {
+        // gamma = (r, u), delta = (w, u) and |r| of the previous iterate in one reduction,
+        // in flight while m = M w and n = A m are computed.
+        double partial[3];
+        T      sums[3];
+        vector<T>::dotsBegin(3, left, right, partial);
+        this->charge_(TELEMETRY_REDUCTION, 3);
+        if (M)
+        {
+            M->apply(w_, m_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+        }
+        A.apply(m, n_);
+        this->charge_(TELEMETRY_SPMV);
+        vector<T>::dotsFinish(3, partial, sums);
+        this->charge_(TELEMETRY_REDUCTION, 0);
+
+        T gamma = sums[0], delta = sums[1];
+        this->currentResidual_ = sqrt(sums[2]);
+        if (it > 1) this->commit_(it - 1, this->currentResidual_);
+        if (it > 1 && this->converged_(it - 1, this->currentResidual_, this->initialResidual_))
+        {
+            converged = true;
+            break;
+        }
+
+        T beta  = (it > 1) ? gamma / gammaOld : 0;
+        T denom = (it > 1) ? delta - beta * gamma / alphaOld : delta;
+        if (denom == 0)
+        {
+            std::cout << "\nPORESCALE Warning :: pipelined CG breakdown at iteration " << it << ".\n";
+            break;
+        }
+        T alpha = gamma / denom;
+
+        pipelinedUpdate(r_.localRows(), alpha, beta, n_.valueArray(), m.valueArray(), z_.valueArray(),
+                        M ? q_.valueArray() : (T *)NULL, s_.valueArray(), p_.valueArray(), x.valueArray(),
+                        r_.valueArray(), M ? u_.valueArray() : (T *)NULL, w_.valueArray());
+        this->charge_(TELEMETRY_UPDATE, M ? 18 : 13);
+        gammaOld          = gamma;
+        alphaOld          = alpha;
+        this->iterations_ = it;
+    }
+
+    // The loop reports the residual one iteration late, finish with the final one,
+    // also after a breakdown.
+    if (!converged)
+    {
+        this->currentResidual_ = r_.norm2();
+        this->charge_(TELEMETRY_REDUCTION, 1);
+        this->commit_(this->iterations_, this->currentResidual_);
+    }
+}
+
+template <typename T>
+void
+porescale::CGSolver<T>::solve(blockVector<T>& B, blockVector<T>& X)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: CGSolver solve requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    const sparseMatrix<T>& A    = *this->A_;
+    solver<T>            * M    = this->M_;
+    psInt                  nRhs = B.nRhs();
+    if (R_.nRhs() != nRhs || R_.localRows() != A.localRows() || R_.globalRows() != A.globalRows())
+    {
+        R_.buildLike(A, nRhs);
+        Z_.buildLike(A, nRhs);
+        P_.buildLike(A, nRhs);
+        Q_.buildLike(A, nRhs);
+    }
+    blockVector<T>& Z = M ? Z_ : R_;
+
+    std::vector<T> initial(nRhs), residual(nRhs), rz(nRhs), rzNew(nRhs), pq(nRhs);
+    std::vector<T> alpha(nRhs), minusAlpha(nRhs), beta(nRhs), ones(nRhs, 1);
+    std::vector<T> minusOnes(nRhs, -1);
+    std::vector<char> done(nRhs);
+
+    // R = B - A X, X is staged through P for its halo.
+    this->beginTelemetry_(nRhs);
+    P_.copy(X);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(P_, Q_);
+    this->charge_(TELEMETRY_SPMV);
+    R_.copy(B);
+    R_.axpy(minusOnes.data(), Q_);
+    this->charge_(TELEMETRY_UPDATE, 5);
+    R_.columnNorms(initial.data());
+    this->charge_(TELEMETRY_REDUCTION, 1);
+
+    bool allDone = true;
+    for (psInt c = 0; c < nRhs; c++)
+    {
+        done[c]  = initial[c] == 0 || this->converged_(0, initial[c], initial[c]);
+        allDone &= (bool)done[c];
+    }
+    this->iterations_      = 0;
+    this->initialResidual_ = *std::max_element(initial.begin(), initial.end());
+    this->currentResidual_ = this->initialResidual_;
+    this->commit_(0, this->currentResidual_);
+    if (allDone) return;
+
+    if (M)
+    {
+        M->apply(R_, Z_);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+    }
+    P_.copy(Z);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    if (M)
+    {
+        R_.columnDots(Z_, rz.data());
+        this->charge_(TELEMETRY_REDUCTION, 2);
+    }
+    else for (psInt c = 0; c < nRhs; c++) rz[c] = initial[c] * initial[c];
+
+    for (psInt it = 1; it <= this->maxIterations_; it++)
+    {
+        // Converged columns freeze with zero steps.
+        A.apply(P_, Q_);
+        this->charge_(TELEMETRY_SPMV);
+        P_.columnDots(Q_, pq.data());
+        this->charge_(TELEMETRY_REDUCTION, 2);
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            alpha[c]      = (done[c] || pq[c] == 0) ? 0 : rz[c] / pq[c];
+            minusAlpha[c] = -alpha[c];
+        }
+        X.axpy(alpha.data(), P_);
+        R_.axpy(minusAlpha.data(), Q_);
+        this->charge_(TELEMETRY_UPDATE, 6);
+        R_.columnNorms(residual.data());
+        this->charge_(TELEMETRY_REDUCTION, 1);
+
+        allDone = true;
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            done[c]  = done[c] || this->converged_(it, residual[c], initial[c]);
+            allDone &= (bool)done[c];
+        }
+        this->iterations_      = it;
+        this->currentResidual_ = *std::max_element(residual.begin(), residual.end());
+        this->commit_(it, this->currentResidual_);
+        if (allDone) break;
+
+        if (M)
+        {
+            M->apply(R_, Z_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+            R_.columnDots(Z_, rzNew.data());
+            this->charge_(TELEMETRY_REDUCTION, 2);
+        }
+        else for (psInt c = 0; c < nRhs; c++) rzNew[c] = residual[c] * residual[c];
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            beta[c] = (done[c] || rz[c] == 0) ? 0 : rzNew[c] / rz[c];
+            rz[c]   = rzNew[c];
+        }
+        P_.axpby(ones.data(), Z, beta.data());
+        this->charge_(TELEMETRY_UPDATE, 3);
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::CGSolver<float>;
+template class porescale::CGSolver<double>;
@@ -0,0 +1,360 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for flexible GMRES solver class.
+ */
+
+#include "solve.hpp"
+
+#include <algorithm>
+
+//--- Constructors ---//
+template <typename T>
+porescale::FGMRESSolver<T>::FGMRESSolver(void) : krylovSolver<T>::krylovSolver(), restart_(30) { }
+
+template <typename T>
+porescale::FGMRESSolver<T>::FGMRESSolver(parameters<T> * par) : krylovSolver<T>::krylovSolver(par), restart_(30) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::FGMRESSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::FGMRESSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: FGMRESSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    const sparseMatrix<T>& A = *this->A_;
+    V_.buildLike(A, restart_ + 1);
+    Z_.buildLike(A, this->M_ ? restart_ : 0);
+    v_.buildLike(A);
+    z_.buildLike(A);
+    w_.buildLike(A);
+    this->built_ = true;
+}
+
+//--- Restart ---//
+template <typename T>
+void
+porescale::FGMRESSolver<T>::setRestart(psInt restart)
+{
+    restart_     = std::max(restart, (psInt)1);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::FGMRESSolver<T>::restart(void) const { return restart_; }
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::FGMRESSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_ || (this->M_ && Z_.localColumns() < restart_)) build();
+    if (!this->built_) return;
+
+    const sparseMatrix<T>& A = *this->A_;
+    solver<T>            * M = this->M_;
+    psInt                  m = restart_;
+
+    // Hessenberg matrix column major with m + 1 rows, Givens rotations and rotated rhs.
+    std::vector<T> H((size_t)(m + 1) * m), cs(m), sn(m), g(m + 1), h(m + 1), h2(m + 1);
+
+    this->iterations_ = 0;
+    this->beginTelemetry_();
+    for (psInt cycle = 0; ; cycle++)
+    {
+        // True residual at every restart, x is staged through v for its halo.
+        v_.copy(x);
+        this->charge_(TELEMETRY_UPDATE, 2);
+        A.apply(v_, w_);
+        this->charge_(TELEMETRY_SPMV);
+        T beta = w_.axpbyNorm(1, b, -1);
+        this->charge_(TELEMETRY_REDUCTION, 3);
+        if (cycle == 0)
+        {
+            this->initialResidual_ = beta;
+            this->commit_(0, beta);
+        }
+        this->currentResidual_ = beta;
+        if (beta == 0 || this->converged_(this->iterations_, beta, this->initialResidual_)) return;
+        if (this->iterations_ >= this->maxIterations_) return;
+
+        V_.setColumn(0, w_, 1 / beta);
+        this->charge_(TELEMETRY_UPDATE, 2);
+        std::fill(g.begin(), g.end(), (T)0);
+        g[0] = beta;
+
+        psInt k = 0;
+        while (k < m && this->iterations_ < this->maxIterations_)
+        {
+            psInt j = k++;
+            V_.getColumn(j, v_);
+            this->charge_(TELEMETRY_UPDATE, 2);
+            if (M)
+            {
+                M->apply(v_, z_);
+                this->charge_(TELEMETRY_PRECONDITIONER);
+                Z_.setColumn(j, z_);
+                this->charge_(TELEMETRY_UPDATE, 2);
+                A.apply(z_, w_);
+            }
+            else A.apply(v_, w_);
+            this->charge_(TELEMETRY_SPMV);
+
+            // CGS2, the second pass returns |w|^2 before its correction, and
+            // |w_final|^2 = |w|^2 - |h2|^2 by orthogonality of the basis.
+            T ww, hh = 0;
+            V_.gemvT(j + 1, w_, h.data());
+            this->charge_(TELEMETRY_REDUCTION, j + 2);
+            V_.gemv(j + 1, -1, h.data(), w_);
+            this->charge_(TELEMETRY_UPDATE, j + 3);
+            V_.gemvT(j + 1, w_, h2.data(), &ww);
+            this->charge_(TELEMETRY_REDUCTION, j + 2);
+            V_.gemv(j + 1, -1, h2.data(), w_);
+            this->charge_(TELEMETRY_UPDATE, j + 3);
+            for (psInt i = 0; i <= j; i++)
+            {
+                h[i] += h2[i];
+                hh   += h2[i] * h2[i];
+            }
+            T hNext = (T)sqrt(std::max(ww - hh, (T)0));
+            if (ww - hh < (T)1e-4 * ww)
+            {
+                hNext = w_.norm2();
+                this->charge_(TELEMETRY_REDUCTION, 1);
+            }
+
+            // Previous rotations, then a new one eliminating the subdiagonal.
+            T * Hj = H.data() + (size_t)j * (m + 1);
+            for (psInt i = 0; i <= j; i++) Hj[i] = h[i];
+            Hj[j + 1] = hNext;
+            for (psInt i = 0; i < j; i++)
+            {
+                T t       =  cs[i] * Hj[i] + sn[i] * Hj[i + 1];
+                Hj[i + 1] = -sn[i] * Hj[i] + cs[i] * Hj[i + 1];
+                Hj[i]     = t;
+            }
+            T r   = (T)sqrt(Hj[j] * Hj[j] + Hj[j + 1] * Hj[j + 1]);
+            cs[j] = (r == 0) ? 1 : Hj[j] / r;
+            sn[j] = (r == 0) ? 0 : Hj[j + 1] / r;
+            Hj[j]     = r;
+            Hj[j + 1] = 0;
+            g[j + 1]  = -sn[j] * g[j];
+            g[j]      =  cs[j] * g[j];
+
+            this->iterations_++;
+            this->currentResidual_ = fabs(g[j + 1]);
+            this->commit_(this->iterations_, this->currentResidual_);
+            if (hNext == 0 || this->converged_(this->iterations_, this->currentResidual_, this->initialResidual_)) break;
+            V_.setColumn(j + 1, w_, 1 / hNext);
+        }
+
+        // y = R^{-1} g, x += Z y (V y without a preconditioner).
+        for (psInt i = k - 1; i >= 0; i--)
+        {
+            T sum = g[i];
+            for (psInt c = i + 1; c < k; c++) sum -= H[(size_t)c * (m + 1) + i] * g[c];
+            g[i] = (H[(size_t)i * (m + 1) + i] == 0) ? 0 : sum / H[(size_t)i * (m + 1) + i];
+        }
+        if (M) Z_.gemv(k, 1, g.data(), x);
+        else V_.gemv(k, 1, g.data(), x);
+        this->charge_(TELEMETRY_UPDATE, k + 2);
+    }
+}
+
+template <typename T>
+void
+porescale::FGMRESSolver<T>::solve(blockVector<T>& B, blockVector<T>& X)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: FGMRESSolver solve requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    const sparseMatrix<T>& A    = *this->A_;
+    solver<T>            * M    = this->M_;
+    psInt                  m    = restart_;
+    psInt                  nRhs = B.nRhs();
+    if ((psInt)VBlocks_.size() != m + 1 || (M && (psInt)ZBlocks_.size() != m) || W_.nRhs() != nRhs
+        || W_.localRows() != A.localRows() || W_.globalRows() != A.globalRows())
+    {
+        VBlocks_.resize(m + 1);
+        ZBlocks_.resize(M ? m : 0);
+        for (blockVector<T>& V : VBlocks_) V.buildLike(A, nRhs);
+        for (blockVector<T>& Z : ZBlocks_) Z.buildLike(A, nRhs);
+        W_.buildLike(A, nRhs);
+    }
+
+    // Column c keeps its own Hessenberg matrix, rotations and rotated rhs, with the
+    // layouts of solve. Coefficients of the basis are interleaved, entry j * nRhs + c.
+    size_t         ldH = (size_t)(m + 1) * m;
+    std::vector<T> H(ldH * nRhs), cs((size_t)m * nRhs), sn((size_t)m * nRhs), g((size_t)(m + 1) * nRhs);
+    std::vector<T> h((size_t)(m + 1) * nRhs), h2((size_t)(m + 2) * nRhs), y((size_t)m * nRhs);
+    std::vector<T> initial(nRhs), residual(nRhs), hNext(nRhs), scale(nRhs), norms(nRhs);
+    std::vector<T> ones(nRhs, 1), minusOnes(nRhs, -1), zeros(nRhs, 0);
+    std::vector<psInt> steps(nRhs);
+    std::vector<char>  done(nRhs), active(nRhs), cancel(nRhs);
+
+    std::vector<const blockVector<T> *> basis(m + 1), directions(m + 1), right(m + 2, &W_);
+    for (psInt j = 0; j <= m; j++) basis[j] = &VBlocks_[j];
+    for (psInt j = 0; j < (psInt)ZBlocks_.size(); j++) directions[j] = &ZBlocks_[j];
+
+    this->iterations_ = 0;
+    this->beginTelemetry_(nRhs);
+    for (psInt cycle = 0; ; cycle++)
+    {
+        // True residuals at every restart, X is staged through the first block for its halo.
+        VBlocks_[0].copy(X);
+        this->charge_(TELEMETRY_UPDATE, 2);
+        A.apply(VBlocks_[0], W_);
+        this->charge_(TELEMETRY_SPMV);
+        W_.axpby(ones.data(), B, minusOnes.data());
+        this->charge_(TELEMETRY_UPDATE, 3);
+        W_.columnNorms(residual.data());
+        this->charge_(TELEMETRY_REDUCTION, 1);
+        if (cycle == 0)
+        {
+            initial                = residual;
+            this->initialResidual_ = *std::max_element(initial.begin(), initial.end());
+        }
+        this->currentResidual_ = *std::max_element(residual.begin(), residual.end());
+        if (cycle == 0) this->commit_(0, this->currentResidual_);
+
+        bool allDone = true;
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            done[c]   = done[c] || residual[c] == 0 || this->converged_(this->iterations_, residual[c], initial[c]);
+            active[c] = !done[c];
+            steps[c]  = 0;
+            scale[c]  = done[c] ? 0 : 1 / residual[c];
+            allDone  &= (bool)done[c];
+        }
+        if (allDone || this->iterations_ >= this->maxIterations_) return;
+
+        VBlocks_[0].axpby(scale.data(), W_, zeros.data());
+        this->charge_(TELEMETRY_UPDATE, 2);
+        std::fill(g.begin(), g.end(), (T)0);
+        for (psInt c = 0; c < nRhs; c++) g[c] = residual[c];
+
+        psInt k = 0;
+        while (k < m && this->iterations_ < this->maxIterations_)
+        {
+            psInt j = k++;
+            if (M)
+            {
+                M->apply(VBlocks_[j], ZBlocks_[j]);
+                this->charge_(TELEMETRY_PRECONDITIONER);
+                A.apply(ZBlocks_[j], W_);
+            }
+            else A.apply(VBlocks_[j], W_);
+            this->charge_(TELEMETRY_SPMV);
+
+            // CGS2 as in solve, the second pass also returns the column norms of W.
+            blockVector<T>::dots(j + 1, basis.data(), right.data(), h.data());
+            this->charge_(TELEMETRY_REDUCTION, j + 2);
+            for (psInt i = 0; i < (j + 1) * nRhs; i++) h2[i] = -h[i];
+            W_.combine(j + 1, basis.data(), h2.data());
+            this->charge_(TELEMETRY_UPDATE, j + 3);
+            basis[j + 1] = &W_;
+            blockVector<T>::dots(j + 2, basis.data(), right.data(), h2.data());
+            this->charge_(TELEMETRY_REDUCTION, j + 2);
+            basis[j + 1] = &VBlocks_[j + 1];
+            for (psInt i = 0; i < (j + 1) * nRhs; i++) y[i] = -h2[i];
+            W_.combine(j + 1, basis.data(), y.data());
+            this->charge_(TELEMETRY_UPDATE, j + 3);
+
+            bool recompute = false;
+            for (psInt c = 0; c < nRhs; c++)
+            {
+                T ww = h2[(size_t)(j + 1) * nRhs + c], hh = 0;
+                for (psInt i = 0; i <= j; i++)
+                {
+                    h[(size_t)i * nRhs + c] += h2[(size_t)i * nRhs + c];
+                    hh                      += h2[(size_t)i * nRhs + c] * h2[(size_t)i * nRhs + c];
+                }
+                hNext[c]   = (T)sqrt(std::max(ww - hh, (T)0));
+                cancel[c]  = active[c] && ww - hh < (T)1e-4 * ww;
+                recompute |= (bool)cancel[c];
+            }
+            if (recompute)
+            {
+                W_.columnNorms(norms.data());
+                this->charge_(TELEMETRY_REDUCTION, 1);
+                for (psInt c = 0; c < nRhs; c++) if (cancel[c]) hNext[c] = norms[c];
+            }
+
+            this->iterations_++;
+            bool anyActive = false;
+            for (psInt c = 0; c < nRhs; c++)
+            {
+                scale[c] = 0;
+                if (!active[c]) continue;
+
+                // Previous rotations, then a new one eliminating the subdiagonal.
+                T * Hj = H.data() + (size_t)c * ldH + (size_t)j * (m + 1);
+                T * cc = cs.data() + (size_t)c * m;
+                T * ss = sn.data() + (size_t)c * m;
+                for (psInt i = 0; i <= j; i++) Hj[i] = h[(size_t)i * nRhs + c];
+                Hj[j + 1] = hNext[c];
+                for (psInt i = 0; i < j; i++)
+                {
+                    T t       =  cc[i] * Hj[i] + ss[i] * Hj[i + 1];
+                    Hj[i + 1] = -ss[i] * Hj[i] + cc[i] * Hj[i + 1];
+                    Hj[i]     = t;
+                }
+                T r   = (T)sqrt(Hj[j] * Hj[j] + Hj[j + 1] * Hj[j + 1]);
+                cc[j] = (r == 0) ? 1 : Hj[j] / r;
+                ss[j] = (r == 0) ? 0 : Hj[j + 1] / r;
+                Hj[j]     = r;
+                Hj[j + 1] = 0;
+                g[(size_t)(j + 1) * nRhs + c] = -ss[j] * g[(size_t)j * nRhs + c];
+                g[(size_t)j * nRhs + c]       =  cc[j] * g[(size_t)j * nRhs + c];
+
+                steps[c]    = j + 1;
+                residual[c] = fabs(g[(size_t)(j + 1) * nRhs + c]);
+                active[c]   = hNext[c] != 0 && !this->converged_(this->iterations_, residual[c], initial[c]);
+                scale[c]    = active[c] ? 1 / hNext[c] : 0;
+                anyActive  |= (bool)active[c];
+            }
+            this->currentResidual_ = *std::max_element(residual.begin(), residual.end());
+            this->commit_(this->iterations_, this->currentResidual_);
+            if (!anyActive) break;
+            VBlocks_[j + 1].axpby(scale.data(), W_, zeros.data());
+            this->charge_(TELEMETRY_UPDATE, 2);
+        }
+
+        // Per column y = R^{-1} g over its own steps, X += Z Y (V Y without a preconditioner).
+        std::fill(y.begin(), y.end(), (T)0);
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            const T * Hc = H.data() + (size_t)c * ldH;
+            for (psInt i = steps[c] - 1; i >= 0; i--)
+            {
+                T sum = g[(size_t)i * nRhs + c];
+                for (psInt l = i + 1; l < steps[c]; l++) sum -= Hc[(size_t)l * (m + 1) + i] * y[(size_t)l * nRhs + c];
+                y[(size_t)i * nRhs + c] = (Hc[(size_t)i * (m + 1) + i] == 0) ? 0 : sum / Hc[(size_t)i * (m + 1) + i];
+            }
+        }
+        X.combine(k, M ? directions.data() : basis.data(), y.data());
+        this->charge_(TELEMETRY_UPDATE, k + 2);
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::FGMRESSolver<float>;
+template class porescale::FGMRESSolver<double>;
@@ -0,0 +1,555 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for recycling GCRO-DR solver class.
+ */
+
+#include "solve.hpp"
+
+#include <limits>
+
+namespace
+{
+    /** \brief LU factorization of the column major n x n matrix a in place, partial pivoting.
+     *         Returns false on a zero pivot.
+     */
+    template <typename T>
+    bool
+    luFactor(psInt n, T * a, psInt * piv)
+    {
+        for (psInt j = 0; j < n; j++)
+        {
+            psInt p = j;
+            for (psInt i = j + 1; i < n; i++)
+                if (fabs(a[i + j * n]) > fabs(a[p + j * n])) p = i;
+            piv[j] = p;
+            if (a[p + j * n] == 0) return false;
+            if (p != j)
+                for (psInt c = 0; c < n; c++) std::swap(a[j + c * n], a[p + c * n]);
+            for (psInt i = j + 1; i < n; i++)
+            {
+                T l = (a[i + j * n] /= a[j + j * n]);
+                for (psInt c = j + 1; c < n; c++) a[i + c * n] -= l * a[j + c * n];
+            }
+        }
+        return true;
+    }
+
+    /** \brief Solve with the factors of luFactor for nrhs column major right hand sides in place. */
+    template <typename T>
+    void
+    luSolve(psInt n, const T * a, const psInt * piv, T * b, psInt nrhs)
+    {
+        for (psInt r = 0; r < nrhs; r++)
+        {
+            T * x = b + (size_t)r * n;
+            for (psInt j = 0; j < n; j++) std::swap(x[j], x[piv[j]]);
+            for (psInt j = 0; j < n; j++)
+                for (psInt i = j + 1; i < n; i++) x[i] -= a[i + j * n] * x[j];
+            for (psInt j = n - 1; j >= 0; j--)
+            {
+                x[j] /= a[j + j * n];
+                for (psInt i = 0; i < j; i++) x[i] -= a[i + j * n] * x[j];
+            }
+        }
+    }
+
+    /** \brief Orthonormalize the k columns of the column major rows x k matrix q in place by
+     *         modified Gram-Schmidt twice. Dependent columns are dropped and the kept ones
+     *         compacted, kept[c] the original index of column c and r the c x c upper factor
+     *         with leading dimension k. Returns the number of columns kept.
+     */
+    template <typename T>
+    psInt
+    orthonormalize(psInt rows, psInt k, T * q, T * r, std::vector<psInt>& kept)
+    {
+        kept.clear();
+        std::fill(r, r + (size_t)k * k, (T)0);
+        for (psInt j = 0; j < k; j++)
+        {
+            psInt c   = (psInt)kept.size();
+            T   * col = q + (size_t)c * rows;
+            if (c != j) std::copy(q + (size_t)j * rows, q + (size_t)(j + 1) * rows, col);
+            T norm0 = 0;
+            for (psInt i = 0; i < rows; i++) norm0 += col[i] * col[i];
+            for (psInt pass = 0; pass < 2; pass++)
+            {
+                for (psInt p = 0; p < c; p++)
+                {
+                    T dot = 0;
+                    for (psInt i = 0; i < rows; i++) dot += q[i + (size_t)p * rows] * col[i];
+                    for (psInt i = 0; i < rows; i++) col[i] -= dot * q[i + (size_t)p * rows];
+                    r[p + (size_t)c * k] += dot;
+                }
+            }
+            T norm = 0;
+            for (psInt i = 0; i < rows; i++) norm += col[i] * col[i];
+            if (norm == 0 || norm <= std::numeric_limits<T>::epsilon() * norm0)
+            {
+                for (psInt p = 0; p < c; p++) r[p + (size_t)c * k] = 0;
+                continue;
+            }
+            norm = (T)sqrt(norm);
+            for (psInt i = 0; i < rows; i++) col[i] /= norm;
+            r[c + (size_t)c * k] = norm;
+            kept.push_back(j);
+        }
+        return (psInt)kept.size();
+    }
+
+    /** \brief Orthonormal basis x, n x k, of the dominant invariant subspace of F^{-1} E by block
+     *         inverse iteration, the eigenvectors of F z = theta E z of smallest |theta|.
+     *         Returns the columns of x, 0 if F is singular.
+     */
+    template <typename T>
+    psInt
+    smallestSubspace(psInt n, std::vector<T> F, const std::vector<T>& E, psInt k, std::vector<T>& x)
+    {
+        std::vector<psInt> piv(n), kept;
+        if (!luFactor(n, F.data(), piv.data())) return 0;
+
+        std::vector<T> y((size_t)n * k), r((size_t)k * k);
+        x.resize((size_t)n * k);
+        for (psInt j = 0; j < k; j++)
+            for (psInt i = 0; i < n; i++) x[i + (size_t)j * n] = (T)sin(1.0 + 0.7 * i + 2.3 * j * i + j);
+        k = orthonormalize(n, k, x.data(), r.data(), kept);
+        for (psInt sweep = 0; sweep < PORESCALE_RECYCLE_SWEEPS && k > 0; sweep++)
+        {
+            for (psInt j = 0; j < k; j++)
+                for (psInt i = 0; i < n; i++)
+                {
+                    T sum = 0;
+                    for (psInt c = 0; c < n; c++) sum += E[i + (size_t)c * n] * x[c + (size_t)j * n];
+                    y[i + (size_t)j * n] = sum;
+                }
+            luSolve(n, F.data(), piv.data(), y.data(), k);
+            k = orthonormalize(n, k, y.data(), r.data(), kept);
+            std::copy(y.begin(), y.begin() + (size_t)n * k, x.begin());
+        }
+        return k;
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::GCRODRSolver<T>::GCRODRSolver(void) : krylovSolver<T>::krylovSolver(),
+    restart_(30), recycle_(10), mode_(RECYCLE_DEFLATION), kr_(0), next_(0) { }
+
+template <typename T>
+porescale::GCRODRSolver<T>::GCRODRSolver(parameters<T> * par) : krylovSolver<T>::krylovSolver(par),
+    restart_(30), recycle_(10), mode_(RECYCLE_DEFLATION), kr_(0), next_(0) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::GCRODRSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+}
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::GCRODRSolver<T>::setRestart(psInt restart)
+{
+    restart_     = std::max(restart, (psInt)2);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::GCRODRSolver<T>::restart(void) const { return restart_; }
+
+template <typename T>
+void
+porescale::GCRODRSolver<T>::setRecycle(psInt k)
+{
+    recycle_     = std::max(k, (psInt)0);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::GCRODRSolver<T>::recycle(void) const { return recycle_; }
+
+template <typename T>
+void
+porescale::GCRODRSolver<T>::setRecycleMode(psRecycleMode mode)
+{
+    mode_ = mode;
+    clearRecycle();
+}
+
+template <typename T>
+porescale::psRecycleMode
+porescale::GCRODRSolver<T>::recycleMode(void) const { return mode_; }
+
+template <typename T>
+void
+porescale::GCRODRSolver<T>::clearRecycle(void)
+{
+    kr_   = 0;
+    next_ = 0;
+}
+
+template <typename T>
+psInt
+porescale::GCRODRSolver<T>::recycleDimension(void) const { return kr_; }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::GCRODRSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: GCRODRSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    // The recycle space survives a new matrix with the same rows.
+    const sparseMatrix<T>& A = *this->A_;
+    psInt                  k = std::max(std::min(recycle_, restart_ - 1), (psInt)1);
+    if (U_.localRows() != A.localRows() || U_.globalRows() != A.globalRows() || U_.localColumns() != k)
+    {
+        U_.buildLike(A, k);
+        Ut_.buildLike(A, k);
+        C_.buildLike(A, k);
+        S_.buildLike(A, k);
+        clearRecycle();
+    }
+    V_.buildLike(A, restart_ + 1);
+    Z_.buildLike(A, this->M_ ? restart_ : 0);
+    v_.buildLike(A);
+    z_.buildLike(A);
+    w_.buildLike(A);
+    r_.buildLike(A);
+    this->built_ = true;
+}
+
+//--- Recycle space ---//
+template <typename T>
+void
+porescale::GCRODRSolver<T>::orthonormalizeRecycle_(void)
+{
+    // CGS2 of A u_j against the kept columns of C, u_j and its preimage follow the same
+    // coefficients so A U = C holds for the kept columns.
+    const sparseMatrix<T>& A        = *this->A_;
+    bool                   preimage = (mode_ == RECYCLE_DEFLATION);
+    std::vector<T>         h(kr_), h2(kr_);
+    psInt                  kept     = 0;
+    for (psInt j = 0; j < kr_; j++)
+    {
+        U_.getColumn(j, z_);
+        A.apply(z_, w_);
+        T ww = 0;
+        if (kept > 0)
+        {
+            C_.gemvT(kept, w_, h.data(), &ww);
+            C_.gemv(kept, -1, h.data(), w_);
+            C_.gemvT(kept, w_, h2.data());
+            C_.gemv(kept, -1, h2.data(), w_);
+            for (psInt i = 0; i < kept; i++) h[i] += h2[i];
+        }
+        else ww = w_.dot(w_);
+        T norm = w_.norm2();
+        if (norm == 0 || norm * norm <= std::numeric_limits<T>::epsilon() * ww) continue;
+
+        C_.setColumn(kept, w_, 1 / norm);
+        if (kept > 0) U_.gemv(kept, -1, h.data(), z_);
+        U_.setColumn(kept, z_, 1 / norm);
+        if (preimage)
+        {
+            Ut_.getColumn(j, v_);
+            if (kept > 0) Ut_.gemv(kept, -1, h.data(), v_);
+            Ut_.setColumn(kept, v_, 1 / norm);
+        }
+        kept++;
+    }
+    kr_ = kept;
+}
+
+template <typename T>
+void
+porescale::GCRODRSolver<T>::updateRecycle_(psInt s, const T * G, psInt ld)
+{
+    psInt p    = kr_;
+    psInt cols = p + s;
+    psInt rows = cols + 1;
+    psInt k    = std::min(U_.localColumns(), cols - 1);
+    if (k < 1) return;
+
+    // Harmonic Ritz problem G^T G z = theta G^T [C, V]^T [Ut, V] z. C is orthogonal to V, so
+    // [C, V]^T [Ut, V] = [C^T Ut, 0; V^T Ut, I] with V^T V the identity over s columns.
+    std::vector<T> W((size_t)rows * cols, (T)0);
+    for (psInt a = 0; a < p; a++)
+    {
+        Ut_.getColumn(a, v_);
+        C_.gemvT(p, v_, W.data() + (size_t)a * rows);
+        V_.gemvT(s + 1, v_, W.data() + (size_t)a * rows + p);
+    }
+    for (psInt c = 0; c < s; c++) W[(p + c) + (size_t)(p + c) * rows] = 1;
+
+    std::vector<T> F((size_t)cols * cols), E((size_t)cols * cols);
+    for (psInt j = 0; j < cols; j++)
+        for (psInt i = 0; i < cols; i++)
+        {
+            T f = 0, e = 0;
+            for (psInt l = 0; l < rows; l++)
+            {
+                f += G[l + (size_t)i * ld] * G[l + (size_t)j * ld];
+                e += G[l + (size_t)i * ld] * W[l + (size_t)j * rows];
+            }
+            F[i + (size_t)j * cols] = f;
+            E[i + (size_t)j * cols] = e;
+        }
+    std::vector<T> P;
+    k = smallestSubspace(cols, F, E, k, P);
+    if (k < 1) return;
+
+    // C = [C, V] Q and U = [U, Z] P R^{-1} from G P = Q R, columns G P drops are dropped.
+    std::vector<T> Q((size_t)rows * k), R((size_t)k * k);
+    for (psInt c = 0; c < k; c++)
+        for (psInt i = 0; i < rows; i++)
+        {
+            T sum = 0;
+            for (psInt l = 0; l < cols; l++) sum += G[i + (size_t)l * ld] * P[l + (size_t)c * cols];
+            Q[i + (size_t)c * rows] = sum;
+        }
+    std::vector<psInt> kept;
+    psInt              kNew = orthonormalize(rows, k, Q.data(), R.data(), kept);
+    if (kNew < 1) return;
+    std::vector<T> X((size_t)cols * kNew);
+    for (psInt c = 0; c < kNew; c++)
+        for (psInt i = 0; i < cols; i++)
+        {
+            T sum = P[i + (size_t)kept[c] * cols];
+            for (psInt l = 0; l < c; l++) sum -= X[i + (size_t)l * cols] * R[l + (size_t)c * k];
+            X[i + (size_t)c * cols] = sum / R[c + (size_t)c * k];
+        }
+
+    // Each new space is formed in S_ from the old one before it is overwritten.
+    const denseMatrix<T>& Zb     = this->M_ ? Z_ : V_;
+    auto                  update = [&](denseMatrix<T>& Y, const denseMatrix<T>& B, const T * coef, psInt ldc, psInt nB)
+    {
+        for (psInt c = 0; c < kNew; c++)
+        {
+            w_.set(0);
+            if (p > 0) Y.gemv(p, 1, coef + (size_t)c * ldc, w_);
+            B.gemv(nB, 1, coef + (size_t)c * ldc + p, w_);
+            S_.setColumn(c, w_);
+        }
+        for (psInt c = 0; c < kNew; c++)
+        {
+            S_.getColumn(c, w_);
+            Y.setColumn(c, w_);
+        }
+    };
+    update(C_, V_, Q.data(), rows, s + 1);
+    update(U_, Zb, X.data(), cols, s);
+    update(Ut_, V_, X.data(), cols, s);
+    kr_ = kNew;
+}
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::GCRODRSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_ || (this->M_ && Z_.localColumns() < restart_)) build();
+    if (!this->built_) return;
+
+    const sparseMatrix<T>& A  = *this->A_;
+    solver<T>            * M  = this->M_;
+    const denseMatrix<T>&  Zb = M ? Z_ : V_;
+    psInt                  m  = restart_;
+    bool                   deflation = (mode_ == RECYCLE_DEFLATION && recycle_ > 0);
+
+    // Hessenberg matrix rotated as in FGMRES, and the unrotated projection G of the
+    // augmented cycle with leading dimension ld.
+    psInt          kMax = U_.localColumns();
+    psInt          ld   = kMax + m + 1;
+    std::vector<T> H((size_t)(m + 1) * m), G((size_t)ld * (kMax + m)), cs(m), sn(m), g(m + 1), h(m + 1), h2(m + 1);
+    std::vector<T> y(std::max(kMax, (psInt)1));
+
+    // Minimal residual correction from the recycle space of the current matrix.
+    // Recycle space maintenance is timed as update, its bytes are not modeled.
+    this->iterations_ = 0;
+    this->beginTelemetry_();
+    v_.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(v_, r_);
+    this->charge_(TELEMETRY_SPMV);
+    T beta                 = r_.axpbyNorm(1, b, -1);
+    this->charge_(TELEMETRY_REDUCTION, 3);
+    this->initialResidual_ = beta;
+    this->currentResidual_ = beta;
+    this->commit_(0, beta);
+    if (kr_ > 0 && beta > 0)
+    {
+        orthonormalizeRecycle_();
+        this->charge_(TELEMETRY_UPDATE, 0);
+        if (kr_ > 0)
+        {
+            C_.gemvT(kr_, r_, y.data());
+            this->charge_(TELEMETRY_REDUCTION, kr_ + 1);
+            U_.gemv(kr_, 1, y.data(), x);
+            this->charge_(TELEMETRY_UPDATE, kr_ + 2);
+        }
+    }
+
+    for (psInt cycle = 0; ; cycle++)
+    {
+        // True residual at every restart, kept orthogonal to C when deflating.
+        v_.copy(x);
+        this->charge_(TELEMETRY_UPDATE, 2);
+        A.apply(v_, w_);
+        this->charge_(TELEMETRY_SPMV);
+        beta = w_.axpbyNorm(1, b, -1);
+        this->charge_(TELEMETRY_REDUCTION, 3);
+        this->currentResidual_ = beta;
+        if (beta == 0 || this->converged_(this->iterations_, beta, this->initialResidual_)) break;
+        if (this->iterations_ >= this->maxIterations_) break;
+
+        psInt p = (deflation && kr_ > 0) ? kr_ : 0;
+        if (p > 0)
+        {
+            C_.gemvT(p, w_, y.data());
+            this->charge_(TELEMETRY_REDUCTION, p + 1);
+            C_.gemv(p, -1, y.data(), w_);
+            U_.gemv(p, 1, y.data(), x);
+            this->charge_(TELEMETRY_UPDATE, 2 * p + 4);
+            beta = w_.norm2();
+            this->charge_(TELEMETRY_REDUCTION, 1);
+        }
+        psInt steps = m - p;
+
+        std::fill(G.begin(), G.end(), (T)0);
+        for (psInt i = 0; i < p; i++) G[i + (size_t)i * ld] = 1;
+        V_.setColumn(0, w_, 1 / beta);
+        this->charge_(TELEMETRY_UPDATE, 2);
+        std::fill(g.begin(), g.end(), (T)0);
+        g[0] = beta;
+
+        psInt k = 0;
+        while (k < steps && this->iterations_ < this->maxIterations_)
+        {
+            psInt j = k++;
+            V_.getColumn(j, v_);
+            this->charge_(TELEMETRY_UPDATE, 2);
+            if (M)
+            {
+                M->apply(v_, z_);
+                this->charge_(TELEMETRY_PRECONDITIONER);
+                Z_.setColumn(j, z_);
+                this->charge_(TELEMETRY_UPDATE, 2);
+                A.apply(z_, w_);
+            }
+            else A.apply(v_, w_);
+            this->charge_(TELEMETRY_SPMV);
+
+            // Against C first, the coefficients are column j of B in G.
+            T * Gj = G.data() + (size_t)(p + j) * ld;
+            if (p > 0)
+            {
+                C_.gemvT(p, w_, Gj);
+                C_.gemv(p, -1, Gj, w_);
+                C_.gemvT(p, w_, h2.data());
+                C_.gemv(p, -1, h2.data(), w_);
+                this->charge_(TELEMETRY_REDUCTION, 2 * (p + 1));
+                this->charge_(TELEMETRY_UPDATE, 2 * (p + 2));
+                for (psInt i = 0; i < p; i++) Gj[i] += h2[i];
+            }
+
+            // CGS2 against V as in FGMRES.
+            T ww, hh = 0;
+            V_.gemvT(j + 1, w_, h.data());
+            this->charge_(TELEMETRY_REDUCTION, j + 2);
+            V_.gemv(j + 1, -1, h.data(), w_);
+            this->charge_(TELEMETRY_UPDATE, j + 3);
+            V_.gemvT(j + 1, w_, h2.data(), &ww);
+            this->charge_(TELEMETRY_REDUCTION, j + 2);
+            V_.gemv(j + 1, -1, h2.data(), w_);
+            this->charge_(TELEMETRY_UPDATE, j + 3);
+            for (psInt i = 0; i <= j; i++)
+            {
+                h[i] += h2[i];
+                hh   += h2[i] * h2[i];
+            }
+            T hNext = (T)sqrt(std::max(ww - hh, (T)0));
+            if (ww - hh < (T)1e-4 * ww)
+            {
+                hNext = w_.norm2();
+                this->charge_(TELEMETRY_REDUCTION, 1);
+            }
+            for (psInt i = 0; i <= j; i++) Gj[p + i] = h[i];
+            Gj[p + j + 1] = hNext;
+
+            T * Hj = H.data() + (size_t)j * (m + 1);
+            for (psInt i = 0; i <= j; i++) Hj[i] = h[i];
+            Hj[j + 1] = hNext;
+            for (psInt i = 0; i < j; i++)
+            {
+                T t       =  cs[i] * Hj[i] + sn[i] * Hj[i + 1];
+                Hj[i + 1] = -sn[i] * Hj[i] + cs[i] * Hj[i + 1];
+                Hj[i]     = t;
+            }
+            T r   = (T)sqrt(Hj[j] * Hj[j] + Hj[j + 1] * Hj[j + 1]);
+            cs[j] = (r == 0) ? 1 : Hj[j] / r;
+            sn[j] = (r == 0) ? 0 : Hj[j + 1] / r;
+            Hj[j]     = r;
+            Hj[j + 1] = 0;
+            g[j + 1]  = -sn[j] * g[j];
+            g[j]      =  cs[j] * g[j];
+
+            this->iterations_++;
+            this->currentResidual_ = fabs(g[j + 1]);
+            if (hNext != 0) V_.setColumn(j + 1, w_, 1 / hNext);
+            this->charge_(TELEMETRY_UPDATE, 2);
+            this->commit_(this->iterations_, this->currentResidual_);
+            if (hNext == 0 || this->converged_(this->iterations_, this->currentResidual_, this->initialResidual_)) break;
+        }
+
+        // The V block is the GMRES least squares problem, the C block is zeroed by
+        // y_U = -B y_V. x += Z y_V + U y_U.
+        for (psInt i = k - 1; i >= 0; i--)
+        {
+            T sum = g[i];
+            for (psInt c = i + 1; c < k; c++) sum -= H[(size_t)c * (m + 1) + i] * g[c];
+            g[i] = (H[(size_t)i * (m + 1) + i] == 0) ? 0 : sum / H[(size_t)i * (m + 1) + i];
+        }
+        Zb.gemv(k, 1, g.data(), x);
+        this->charge_(TELEMETRY_UPDATE, k + 2);
+        if (p > 0)
+        {
+            for (psInt i = 0; i < p; i++)
+            {
+                T sum = 0;
+                for (psInt c = 0; c < k; c++) sum += G[i + (size_t)(p + c) * ld] * g[c];
+                y[i] = -sum;
+            }
+            U_.gemv(p, 1, y.data(), x);
+            this->charge_(TELEMETRY_UPDATE, p + 2);
+        }
+
+        // The residual is orthogonal to the range of [C, V] G, which holds the new C.
+        if (deflation)
+        {
+            updateRecycle_(k, G.data(), ld);
+            this->charge_(TELEMETRY_UPDATE, 0);
+        }
+    }
+
+    // Solutions replace the oldest column once the space is full.
+    if (mode_ == RECYCLE_SOLUTIONS && recycle_ > 0)
+    {
+        psInt slot = (kr_ < U_.localColumns()) ? kr_++ : (next_++ % U_.localColumns());
+        U_.setColumn(slot, x);
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::GCRODRSolver<float>;
+template class porescale::GCRODRSolver<double>;
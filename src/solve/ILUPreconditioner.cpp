@@ -0,0 +1,313 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for incomplete LU preconditioner class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Rows grouped by level, offsets in ptr. Returns the number of levels. */
+    psInt
+    groupByLevel(const std::vector<psInt>& level, std::vector<psInt>& ptr, std::vector<psInt>& rows)
+    {
+        psInt n       = (psInt)level.size();
+        psInt nLevels = (n > 0) ? 1 + *std::max_element(level.begin(), level.end()) : 0;
+        ptr.assign(nLevels + 1, 0);
+        for (psInt i = 0; i < n; i++) ptr[level[i] + 1]++;
+        for (psInt l = 0; l < nLevels; l++) ptr[l + 1] += ptr[l];
+        rows.resize(n);
+        std::vector<psInt> cursor(ptr.begin(), ptr.end() - 1);
+        for (psInt i = 0; i < n; i++) rows[cursor[level[i]]++] = i;
+        return nLevels;
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::ILUPreconditioner<T>::ILUPreconditioner(void) : preconditioner<T>::preconditioner(), fillLevel_(0) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::init(parameters<T> *) { }
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::setFillLevel(psInt k)
+{
+    fillLevel_   = std::max(k, (psInt)0);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::ILUPreconditioner<T>::fillLevel(void) const { return fillLevel_; }
+
+template <typename T>
+psInt
+porescale::ILUPreconditioner<T>::factorNnz(void) const { return (psInt)colArray_.size(); }
+
+template <typename T>
+psInt
+porescale::ILUPreconditioner<T>::lowerLevels(void) const { return lowerPtr_.empty() ? 0 : (psInt)lowerPtr_.size() - 1; }
+
+template <typename T>
+psInt
+porescale::ILUPreconditioner<T>::upperLevels(void) const { return upperPtr_.empty() ? 0 : (psInt)upperPtr_.size() - 1; }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: ILUPreconditioner build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: ILUPreconditioner requires a CSR matrix.\n";
+        return;
+    }
+
+    symbolic_();
+    schedule_();
+    factor_();
+    this->built_ = true;
+}
+
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::symbolic_(void)
+{
+    sparseMatrix<T>& A      = *this->A_;
+    psInt            n      = A.localRows();
+    psInt            first  = A.firstRow();
+    const psInt    * aRow   = A.rowArray();
+    const psInt    * aCol   = A.columnArray();
+    auto             local  = [=](psInt k) { return aCol[k] >= first && aCol[k] < first + n; };
+
+    rowPtr_.assign(n + 1, 0);
+    diagonal_.resize(n);
+    if (fillLevel_ == 0)
+    {
+        // The local pattern of A with the diagonal, rows sorted independently.
+        psInt * rowPtr = rowPtr_.data();
+        parallelFor((psInt)0, n, [=](psInt i)
+        {
+            psInt count   = 0;
+            bool  hasDiag = false;
+            for (psInt k = aRow[i]; k < aRow[i + 1]; k++)
+            {
+                if (!local(k)) continue;
+                hasDiag |= (aCol[k] == first + i);
+                count++;
+            }
+            rowPtr[i] = count + !hasDiag;
+        });
+        psInt nnz = exclusiveScan(rowPtr, n);
+        rowPtr[n] = nnz;
+        colArray_.resize(nnz);
+        psInt * colPtr  = colArray_.data();
+        psInt * diagPtr = diagonal_.data();
+        parallelFor((psInt)0, n, [=](psInt i)
+        {
+            psInt pos     = rowPtr[i];
+            bool  hasDiag = false;
+            for (psInt k = aRow[i]; k < aRow[i + 1]; k++)
+            {
+                if (!local(k)) continue;
+                hasDiag |= (aCol[k] == first + i);
+                colPtr[pos++] = aCol[k] - first;
+            }
+            if (!hasDiag) colPtr[pos++] = i;
+            std::sort(colPtr + rowPtr[i], colPtr + rowPtr[i + 1]);
+            diagPtr[i] = (psInt)(std::lower_bound(colPtr + rowPtr[i], colPtr + rowPtr[i + 1], i) - colPtr);
+        });
+        return;
+    }
+
+    // Level of fill row by row, Saad 10.3.3. Columns of the current row are a sorted
+    // linked list, next[c] its successor and n the end. Fill c from pivot j takes level
+    // lev(i, j) + lev(j, c) + 1 and is kept up to fillLevel_.
+    const psInt        none = PORESCALE_INTMAX;
+    std::vector<psInt> next(n + 1), lev(n, none), levels, row;
+    colArray_.clear();
+    for (psInt i = 0; i < n; i++)
+    {
+        row.clear();
+        for (psInt k = aRow[i]; k < aRow[i + 1]; k++)
+            if (local(k)) row.push_back(aCol[k] - first);
+        row.push_back(i);
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+        for (size_t k = 0; k < row.size(); k++)
+        {
+            next[row[k]] = (k + 1 < row.size()) ? row[k + 1] : n;
+            lev[row[k]]  = 0;
+        }
+
+        for (psInt j = row[0]; j < i; j = next[j])
+        {
+            psInt p = j;
+            for (psInt kk = diagonal_[j] + 1; kk < rowPtr_[j + 1]; kk++)
+            {
+                psInt c        = colArray_[kk];
+                psInt newLevel = lev[j] + levels[kk] + 1;
+                if (newLevel > fillLevel_) continue;
+                while (next[p] < c) p = next[p];
+                if (next[p] != c)
+                {
+                    next[c] = next[p];
+                    next[p] = c;
+                    lev[c]  = newLevel;
+                }
+                else lev[c] = std::min(lev[c], newLevel);
+                p = c;
+            }
+        }
+
+        for (psInt c = row[0]; c < n; c = next[c])
+        {
+            if (c == i) diagonal_[i] = (psInt)colArray_.size();
+            colArray_.push_back(c);
+            levels.push_back(lev[c]);
+            lev[c] = none;
+        }
+        rowPtr_[i + 1] = (psInt)colArray_.size();
+    }
+}
+
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::schedule_(void)
+{
+    // A row waits for the rows its L part references, and for U those after it.
+    psInt              n = (psInt)diagonal_.size();
+    std::vector<psInt> level(n);
+    for (psInt i = 0; i < n; i++)
+    {
+        psInt l = 0;
+        for (psInt k = rowPtr_[i]; k < diagonal_[i]; k++) l = std::max(l, level[colArray_[k]] + 1);
+        level[i] = l;
+    }
+    groupByLevel(level, lowerPtr_, lowerRows_);
+
+    for (psInt i = n - 1; i >= 0; i--)
+    {
+        psInt l = 0;
+        for (psInt k = diagonal_[i] + 1; k < rowPtr_[i + 1]; k++) l = std::max(l, level[colArray_[k]] + 1);
+        level[i] = l;
+    }
+    groupByLevel(level, upperPtr_, upperRows_);
+}
+
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::factor_(void)
+{
+    sparseMatrix<T>& A      = *this->A_;
+    psInt            n      = A.localRows();
+    psInt            first  = A.firstRow();
+    const psInt    * aRow   = A.rowArray();
+    const psInt    * aCol   = A.columnArray();
+    const T        * aVal   = A.valueArray();
+    const psInt    * rowPtr = rowPtr_.data();
+    const psInt    * colPtr = colArray_.data();
+    const psInt    * diag   = diagonal_.data();
+
+    // Local entries of A into the factor pattern, fill starts at 0.
+    values_.assign(colArray_.size(), (T)0);
+    T * val = values_.data();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        for (psInt k = aRow[i]; k < aRow[i + 1]; k++)
+        {
+            psInt c = aCol[k] - first;
+            if (c < 0 || c >= n) continue;
+            val[std::lower_bound(colPtr + rowPtr[i], colPtr + rowPtr[i + 1], c) - colPtr] += aVal[k];
+        }
+    });
+
+    // IKJ elimination, rows of one level only read rows of earlier levels. Row j of U
+    // and the rest of row i are both sorted, so the update is a merge.
+    const psInt * rows       = lowerRows_.data();
+    int64_t       zeroPivots = 0;
+    for (psInt l = 0; l + 1 < (psInt)lowerPtr_.size(); l++)
+    {
+        zeroPivots += parallelReduce(lowerPtr_[l], lowerPtr_[l + 1], (int64_t)0, [=](psInt r)
+        {
+            psInt i   = rows[r];
+            psInt end = rowPtr[i + 1];
+            for (psInt k = rowPtr[i]; k < diag[i]; k++)
+            {
+                psInt j      = colPtr[k];
+                T     factor = val[k] / val[diag[j]];
+                val[k]       = factor;
+                psInt q      = k + 1;
+                for (psInt kk = diag[j] + 1; kk < rowPtr[j + 1]; kk++)
+                {
+                    while (q < end && colPtr[q] < colPtr[kk]) q++;
+                    if (q == end) break;
+                    if (colPtr[q] == colPtr[kk]) val[q] -= factor * val[kk];
+                }
+            }
+            if (val[diag[i]] != 0) return (int64_t)0;
+            val[diag[i]] = 1;
+            return (int64_t)1;
+        });
+    }
+    if (zeroPivots > 0)
+        std::cout << "\nPORESCALE Warning :: ILU replaced " << zeroPivots << " zero pivots by 1 on pe " << A.myPe() << ".\n";
+}
+
+//--- Apply ---//
+template <typename T>
+void
+porescale::ILUPreconditioner<T>::apply(vector<T>& r, vector<T>& z)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    const psInt * rowPtr = rowPtr_.data();
+    const psInt * colPtr = colArray_.data();
+    const psInt * diag   = diagonal_.data();
+    const T     * val    = values_.data();
+    const T     * rp     = r.valueArray();
+    T           * zp     = z.valueArray();
+
+    // L y = r, unit diagonal, y held in z.
+    const psInt * lower = lowerRows_.data();
+    for (psInt l = 0; l + 1 < (psInt)lowerPtr_.size(); l++)
+    {
+        parallelFor(lowerPtr_[l], lowerPtr_[l + 1], [=](psInt k)
+        {
+            psInt i   = lower[k];
+            T     sum = rp[i];
+            for (psInt kk = rowPtr[i]; kk < diag[i]; kk++) sum -= val[kk] * zp[colPtr[kk]];
+            zp[i] = sum;
+        });
+    }
+
+    // U z = y in place.
+    const psInt * upper = upperRows_.data();
+    for (psInt l = 0; l + 1 < (psInt)upperPtr_.size(); l++)
+    {
+        parallelFor(upperPtr_[l], upperPtr_[l + 1], [=](psInt k)
+        {
+            psInt i   = upper[k];
+            T     sum = zp[i];
+            for (psInt kk = diag[i] + 1; kk < rowPtr[i + 1]; kk++) sum -= val[kk] * zp[colPtr[kk]];
+            zp[i] = sum / val[diag[i]];
+        });
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::ILUPreconditioner<float>;
+template class porescale::ILUPreconditioner<double>;
@@ -0,0 +1,680 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for BiCGStab and BiCGStab(ell) solver class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief p = r + beta * (p - omega * v) in one sweep. */
+    template <typename T>
+    void
+    directionUpdate(psInt n, T beta, T omega, const T * r, const T * v, T * p)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) p[i] = r[i] + beta * (p[i] - omega * v[i]);
+        });
+    }
+
+    /** \brief x += alpha * pHat + omega * sHat, r = s - omega * t in one sweep. */
+    template <typename T>
+    void
+    solutionUpdate(psInt n, T alpha, T omega, const T * pHat, const T * sHat, const T * s,
+                   const T * t, T * x, T * r)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++)
+            {
+                x[i] += alpha * pHat[i] + omega * sHat[i];
+                r[i]  = s[i] - omega * t[i];
+            }
+        });
+    }
+
+    /** \brief u_i = r_i - beta * u_i for i = 0..j in one sweep. */
+    template <typename T>
+    void
+    ellDirections(psInt n, psInt j, T beta, T * const * r, T * const * u)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt k = begin; k < end; k++)
+                for (psInt i = 0; i <= j; i++) u[i][k] = r[i][k] - beta * u[i][k];
+        });
+    }
+
+    /** \brief r_i -= alpha * u_{i+1} for i = 0..j and x += alpha * u_0 in one sweep. */
+    template <typename T>
+    void
+    ellResiduals(psInt n, psInt j, T alpha, T * const * r, T * const * u, T * x)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt k = begin; k < end; k++)
+            {
+                x[k] += alpha * u[0][k];
+                for (psInt i = 0; i <= j; i++) r[i][k] -= alpha * u[i + 1][k];
+            }
+        });
+    }
+
+    /** \brief Minimal residual update with gamma_1..gamma_ell in one sweep:
+     *         x += sum gamma_j r_{j-1}, r_0 -= sum gamma_j r_j, u_0 -= sum gamma_j u_j.
+     */
+    template <typename T>
+    void
+    ellPolynomial(psInt n, psInt ell, const T * gamma, T * const * r, T * const * u, T * x)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt k = begin; k < end; k++)
+            {
+                T dx = 0, dr = 0, du = 0;
+                for (psInt j = 1; j <= ell; j++)
+                {
+                    dx += gamma[j] * r[j - 1][k];
+                    dr += gamma[j] * r[j][k];
+                    du += gamma[j] * u[j][k];
+                }
+                x[k]    += dx;
+                r[0][k] -= dr;
+                u[0][k] -= du;
+            }
+        });
+    }
+
+    /** \brief Interleaved directionUpdate, column r with beta[r] and omega[r]. */
+    template <typename T>
+    void
+    blockDirectionUpdate(psInt n, psInt R, const T * beta, const T * omega, const T * r, const T * v, T * p)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++)
+                for (psInt c = 0; c < R; c++)
+                {
+                    size_t k = (size_t)i * R + c;
+                    p[k] = r[k] + beta[c] * (p[k] - omega[c] * v[k]);
+                }
+        });
+    }
+
+    /** \brief s = r - alpha * v, column r with alpha[r], in one sweep. */
+    template <typename T>
+    void
+    blockHalfStep(psInt n, psInt R, const T * alpha, const T * r, const T * v, T * s)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++)
+                for (psInt c = 0; c < R; c++)
+                {
+                    size_t k = (size_t)i * R + c;
+                    s[k] = r[k] - alpha[c] * v[k];
+                }
+        });
+    }
+
+    /** \brief Interleaved solutionUpdate, column r with alpha[r] and omega[r]. */
+    template <typename T>
+    void
+    blockSolutionUpdate(psInt n, psInt R, const T * alpha, const T * omega, const T * pHat, const T * sHat,
+                        const T * s, const T * t, T * x, T * r)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++)
+                for (psInt c = 0; c < R; c++)
+                {
+                    size_t k = (size_t)i * R + c;
+                    x[k] += alpha[c] * pHat[k] + omega[c] * sHat[k];
+                    r[k]  = s[k] - omega[c] * t[k];
+                }
+        });
+    }
+
+    /** \brief Solve the dense n x n system A y = b in place by elimination with partial
+     *         pivoting, A row major. Returns false for a singular system.
+     */
+    bool
+    solveDense(psInt n, std::vector<double>& A, std::vector<double>& b)
+    {
+        for (psInt c = 0; c < n; c++)
+        {
+            psInt pivot = c;
+            for (psInt i = c + 1; i < n; i++)
+                if (fabs(A[i * n + c]) > fabs(A[pivot * n + c])) pivot = i;
+            if (A[pivot * n + c] == 0.0) return false;
+            if (pivot != c)
+            {
+                for (psInt j = 0; j < n; j++) std::swap(A[c * n + j], A[pivot * n + j]);
+                std::swap(b[c], b[pivot]);
+            }
+            for (psInt i = c + 1; i < n; i++)
+            {
+                double f = A[i * n + c] / A[c * n + c];
+                for (psInt j = c; j < n; j++) A[i * n + j] -= f * A[c * n + j];
+                b[i] -= f * b[c];
+            }
+        }
+        for (psInt i = n - 1; i >= 0; i--)
+        {
+            for (psInt j = i + 1; j < n; j++) b[i] -= A[i * n + j] * b[j];
+            b[i] /= A[i * n + i];
+        }
+        return true;
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::biCGStabSolver<T>::biCGStabSolver(void) : krylovSolver<T>::krylovSolver(), ell_(1) { }
+
+template <typename T>
+porescale::biCGStabSolver<T>::biCGStabSolver(parameters<T> * par) : krylovSolver<T>::krylovSolver(par), ell_(1) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::biCGStabSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::biCGStabSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: biCGStabSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    const sparseMatrix<T>& A = *this->A_;
+    r_.buildLike(A);
+    rHat_.buildLike(A);
+    pHat_.buildLike(A);
+    if (ell_ == 1)
+    {
+        p_.buildLike(A);
+        v_.buildLike(A);
+        s_.buildLike(A);
+        sHat_.buildLike(A);
+        t_.buildLike(A);
+    }
+    else
+    {
+        rs_.resize(ell_ + 1);
+        us_.resize(ell_ + 1);
+        for (psInt j = 0; j <= ell_; j++)
+        {
+            rs_[j].buildLike(A);
+            us_[j].buildLike(A);
+        }
+        xHat_.buildLike(A);
+    }
+    this->built_ = true;
+}
+
+//--- Ell ---//
+template <typename T>
+void
+porescale::biCGStabSolver<T>::setEll(psInt ell)
+{
+    ell_         = std::max(ell, (psInt)1);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::biCGStabSolver<T>::ell(void) const { return ell_; }
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::biCGStabSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    if (ell_ == 1) solveBiCGStab_(b, x);
+    else solveEll_(b, x);
+}
+
+template <typename T>
+void
+porescale::biCGStabSolver<T>::applyOperator_(vector<T>& in, vector<T>& out)
+{
+    if (this->M_)
+    {
+        this->M_->apply(in, pHat_);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+        this->A_->apply(pHat_, out);
+    }
+    else this->A_->apply(in, out);
+    this->charge_(TELEMETRY_SPMV);
+}
+
+template <typename T>
+void
+porescale::biCGStabSolver<T>::solveBiCGStab_(vector<T>& b, vector<T>& x)
+{
+    const sparseMatrix<T>& A    = *this->A_;
+    solver<T>            * M    = this->M_;
+    vector<T>            & pHat = M ? pHat_ : p_;
+    vector<T>            & sHat = M ? sHat_ : s_;
+    psInt                  n    = r_.localRows();
+
+    // r = b - A x, x is staged through pHat_ for its halo.
+    this->beginTelemetry_();
+    pHat_.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(pHat_, v_);
+    this->charge_(TELEMETRY_SPMV);
+    r_.copy(v_);
+    T rNorm = r_.axpbyNorm(1, b, -1);
+    this->charge_(TELEMETRY_REDUCTION, 5);
+
+    this->iterations_      = 0;
+    this->initialResidual_ = rNorm;
+    this->currentResidual_ = rNorm;
+    this->commit_(0, rNorm);
+    if (rNorm == 0 || this->converged_(0, rNorm, rNorm)) return;
+
+    rHat_.copy(r_);
+    p_.set(0);
+    v_.set(0);
+    this->charge_(TELEMETRY_UPDATE, 4);
+    T rho = 1, alpha = 1, omega = 1;
+    T rhoNew = rNorm * rNorm;
+
+    // Reductions: (rHat, v), then (t, s), (t, t), (rHat, s), (rHat, t), (s, s) together,
+    // from which (rHat, r) and |r| of the next iterate follow without another one.
+    const vector<T> * left[5]  = { &t_, &t_, &rHat_, &rHat_, &s_ };
+    const vector<T> * right[5] = { &s_, &t_, &s_,    &t_,    &s_ };
+    for (psInt it = 1; it <= this->maxIterations_; it++)
+    {
+        if (rhoNew == 0)
+        {
+            std::cout << "\nPORESCALE Warning :: BiCGStab breakdown, (rHat, r) = 0 at iteration " << it << ".\n";
+            break;
+        }
+        T beta = (rhoNew / rho) * (alpha / omega);
+        directionUpdate(n, beta, omega, r_.valueArray(), v_.valueArray(), p_.valueArray());
+        this->charge_(TELEMETRY_UPDATE, 4);
+
+        if (M)
+        {
+            M->apply(p_, pHat_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+        }
+        A.apply(pHat, v_);
+        this->charge_(TELEMETRY_SPMV);
+        T rv = rHat_.dot(v_);
+        this->charge_(TELEMETRY_REDUCTION, 2);
+        if (rv == 0)
+        {
+            std::cout << "\nPORESCALE Warning :: BiCGStab breakdown, (rHat, v) = 0 at iteration " << it << ".\n";
+            break;
+        }
+        alpha = rhoNew / rv;
+        s_.waxpby(1, r_, -alpha, v_);
+        this->charge_(TELEMETRY_UPDATE, 3);
+
+        if (M)
+        {
+            M->apply(s_, sHat_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+        }
+        A.apply(sHat, t_);
+        this->charge_(TELEMETRY_SPMV);
+        T sums[5];
+        vector<T>::dots(5, left, right, sums);
+        this->charge_(TELEMETRY_REDUCTION, 3);
+        T ts = sums[0], tt = sums[1], ss = sums[4];
+
+        // A converged s finishes with the half step, omega = 0.
+        bool halfStep = tt == 0 || this->converged_(it, (T)sqrt(ss), this->initialResidual_);
+        omega = halfStep ? 0 : ts / tt;
+        solutionUpdate(n, alpha, omega, pHat.valueArray(), sHat.valueArray(), s_.valueArray(),
+                       t_.valueArray(), x.valueArray(), r_.valueArray());
+        this->charge_(TELEMETRY_UPDATE, 8);
+
+        rho    = rhoNew;
+        rhoNew = sums[2] - omega * sums[3];
+        rNorm  = (T)sqrt(std::max(ss - 2 * omega * ts + omega * omega * tt, (T)0));
+        this->iterations_      = it;
+        this->currentResidual_ = rNorm;
+        bool confirm           = halfStep || this->converged_(it, rNorm, this->initialResidual_);
+        if (confirm)
+        {
+            // The recurrence norm loses digits near convergence, confirm with the vector.
+            this->currentResidual_ = r_.norm2();
+            this->charge_(TELEMETRY_REDUCTION, 1);
+        }
+        this->commit_(it, this->currentResidual_);
+        if (confirm && (halfStep || this->converged_(it, this->currentResidual_, this->initialResidual_))) break;
+        if (omega == 0)
+        {
+            std::cout << "\nPORESCALE Warning :: BiCGStab breakdown, omega = 0 at iteration " << it << ".\n";
+            break;
+        }
+    }
+}
+
+template <typename T>
+void
+porescale::biCGStabSolver<T>::solveEll_(vector<T>& b, vector<T>& x)
+{
+    const sparseMatrix<T>& A   = *this->A_;
+    solver<T>            * M   = this->M_;
+    psInt                  ell = ell_;
+    psInt                  n   = rs_[0].localRows();
+    vector<T>            & X   = M ? xHat_ : x;
+
+    std::vector<T *> r(ell + 1), u(ell + 1);
+    for (psInt j = 0; j <= ell; j++)
+    {
+        r[j] = rs_[j].valueArray();
+        u[j] = us_[j].valueArray();
+    }
+
+    // r_0 = b - A x, x is staged through pHat_ for its halo.
+    this->beginTelemetry_();
+    pHat_.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(pHat_, rs_[1]);
+    this->charge_(TELEMETRY_SPMV);
+    rs_[0].copy(rs_[1]);
+    T rNorm = rs_[0].axpbyNorm(1, b, -1);
+    this->charge_(TELEMETRY_REDUCTION, 5);
+
+    this->iterations_      = 0;
+    this->initialResidual_ = rNorm;
+    this->currentResidual_ = rNorm;
+    this->commit_(0, rNorm);
+    if (rNorm == 0 || this->converged_(0, rNorm, rNorm)) return;
+
+    rHat_.copy(rs_[0]);
+    us_[0].set(0);
+    if (M) xHat_.set(0);
+    this->charge_(TELEMETRY_UPDATE, M ? 4 : 3);
+
+    // Gram matrix of r_0..r_ell and (r_j, rHat) in one reduction per cycle.
+    psInt nGram = (ell + 1) * (ell + 2) / 2;
+    std::vector<const vector<T> *> left, right;
+    for (psInt i = 0; i <= ell; i++)
+        for (psInt j = i; j <= ell; j++)
+        {
+            left.push_back(&rs_[i]);
+            right.push_back(&rs_[j]);
+        }
+    for (psInt j = 0; j <= ell; j++)
+    {
+        left.push_back(&rs_[j]);
+        right.push_back(&rHat_);
+    }
+    std::vector<T>      sums(left.size()), gamma(ell + 1);
+    std::vector<double> G((ell + 1) * (ell + 1)), lhs(ell * ell), rhs(ell);
+
+    T    rho0 = 1, rho1 = rNorm * rNorm, alpha = 0, omega = 1;
+    bool breakdown = false;
+    while (this->iterations_ < this->maxIterations_ && !breakdown)
+    {
+        // BiCG part, ell steps.
+        rho0 = -omega * rho0;
+        for (psInt j = 0; j < ell; j++)
+        {
+            if (j > 0)
+            {
+                rho1 = rs_[j].dot(rHat_);
+                this->charge_(TELEMETRY_REDUCTION, 2);
+            }
+            if (rho0 == 0)
+            {
+                breakdown = true;
+                break;
+            }
+            T beta = alpha * rho1 / rho0;
+            rho0   = rho1;
+            ellDirections(n, j, beta, r.data(), u.data());
+            this->charge_(TELEMETRY_UPDATE, 3 * (j + 1));
+            applyOperator_(us_[j], us_[j + 1]);
+
+            T g = us_[j + 1].dot(rHat_);
+            this->charge_(TELEMETRY_REDUCTION, 2);
+            if (g == 0)
+            {
+                breakdown = true;
+                break;
+            }
+            alpha = rho0 / g;
+            ellResiduals(n, j, alpha, r.data(), u.data(), X.valueArray());
+            this->charge_(TELEMETRY_UPDATE, 3 * (j + 2));
+            applyOperator_(rs_[j], rs_[j + 1]);
+        }
+        if (breakdown)
+        {
+            std::cout << "\nPORESCALE Warning :: BiCGStab(ell) breakdown at iteration " << this->iterations_ << ".\n";
+            break;
+        }
+
+        // Minimal residual part, normal equations of min |r_0 - sum gamma_j r_j|.
+        vector<T>::dots((psInt)left.size(), left.data(), right.data(), sums.data());
+        this->charge_(TELEMETRY_REDUCTION, ell + 2);
+        for (psInt i = 0, k = 0; i <= ell; i++)
+            for (psInt j = i; j <= ell; j++, k++) G[i * (ell + 1) + j] = G[j * (ell + 1) + i] = sums[k];
+        for (psInt i = 0; i < ell; i++)
+        {
+            rhs[i] = G[(i + 1) * (ell + 1)];
+            for (psInt j = 0; j < ell; j++) lhs[i * ell + j] = G[(i + 1) * (ell + 1) + j + 1];
+        }
+        if (!solveDense(ell, lhs, rhs))
+        {
+            std::cout << "\nPORESCALE Warning :: BiCGStab(ell) singular minimal residual system at iteration "
+                      << this->iterations_ << ".\n";
+            break;
+        }
+        gamma[0] = 0;
+        double r2 = G[0], h = sums[nGram];
+        for (psInt j = 1; j <= ell; j++)
+        {
+            gamma[j] = (T)rhs[j - 1];
+            r2      -= rhs[j - 1] * G[j * (ell + 1)];
+            h       -= rhs[j - 1] * sums[nGram + j];
+        }
+        omega = gamma[ell];
+        rho1  = (T)h;
+        ellPolynomial(n, ell, gamma.data(), r.data(), u.data(), X.valueArray());
+        this->charge_(TELEMETRY_UPDATE, 2 * ell + 6);
+
+        this->iterations_     += ell;
+        this->currentResidual_ = (T)sqrt(std::max(r2, 0.0));
+        bool confirm           = this->converged_(this->iterations_, this->currentResidual_, this->initialResidual_);
+        if (confirm)
+        {
+            // The normal equation norm loses digits near convergence, confirm with the vector.
+            this->currentResidual_ = rs_[0].norm2();
+            this->charge_(TELEMETRY_REDUCTION, 1);
+        }
+        this->commit_(this->iterations_, this->currentResidual_);
+        if (confirm && this->converged_(this->iterations_, this->currentResidual_, this->initialResidual_)) break;
+    }
+
+    if (M)
+    {
+        M->apply(xHat_, pHat_);
+        x.axpy(1, pHat_);
+    }
+}
+
+template <typename T>
+void
+porescale::biCGStabSolver<T>::solve(blockVector<T>& B, blockVector<T>& X)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: biCGStabSolver solve requires a matrix, call setMatrix first.\n";
+        return;
+    }
+
+    const sparseMatrix<T>& A    = *this->A_;
+    solver<T>            * M    = this->M_;
+    psInt                  nRhs = B.nRhs();
+    psInt                  n    = A.localRows();
+    if (R_.nRhs() != nRhs || R_.localRows() != A.localRows() || R_.globalRows() != A.globalRows())
+    {
+        R_.buildLike(A, nRhs);
+        RHat_.buildLike(A, nRhs);
+        P_.buildLike(A, nRhs);
+        PHat_.buildLike(A, nRhs);
+        V_.buildLike(A, nRhs);
+        S_.buildLike(A, nRhs);
+        SHat_.buildLike(A, nRhs);
+        T_.buildLike(A, nRhs);
+    }
+    blockVector<T>& PHat = M ? PHat_ : P_;
+    blockVector<T>& SHat = M ? SHat_ : S_;
+
+    std::vector<T> initial(nRhs), residual(nRhs), rho(nRhs, 1), rhoNew(nRhs), rv(nRhs);
+    std::vector<T> alpha(nRhs, 1), omega(nRhs, 1), beta(nRhs), minusOnes(nRhs, -1);
+    std::vector<T> sums(5 * nRhs);
+    std::vector<char> done(nRhs), halfStep(nRhs);
+
+    // R = B - A X, X is staged through PHat_ for its halo.
+    this->beginTelemetry_(nRhs);
+    PHat_.copy(X);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    A.apply(PHat_, V_);
+    this->charge_(TELEMETRY_SPMV);
+    R_.copy(B);
+    R_.axpy(minusOnes.data(), V_);
+    this->charge_(TELEMETRY_UPDATE, 5);
+    R_.columnNorms(initial.data());
+    this->charge_(TELEMETRY_REDUCTION, 1);
+
+    bool allDone = true;
+    for (psInt c = 0; c < nRhs; c++)
+    {
+        done[c]     = initial[c] == 0 || this->converged_(0, initial[c], initial[c]);
+        allDone    &= (bool)done[c];
+        residual[c] = initial[c];
+        rhoNew[c]   = initial[c] * initial[c];
+    }
+    this->iterations_      = 0;
+    this->initialResidual_ = *std::max_element(initial.begin(), initial.end());
+    this->currentResidual_ = this->initialResidual_;
+    this->commit_(0, this->currentResidual_);
+    if (allDone) return;
+
+    RHat_.copy(R_);
+    P_.set(0);
+    V_.set(0);
+    this->charge_(TELEMETRY_UPDATE, 4);
+
+    // Finished columns freeze with zero steps, the reductions are those of solveBiCGStab_.
+    const blockVector<T> * left[5]  = { &T_, &T_, &RHat_, &RHat_, &S_ };
+    const blockVector<T> * right[5] = { &S_, &T_, &S_,    &T_,    &S_ };
+    for (psInt it = 1; it <= this->maxIterations_; it++)
+    {
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            if (!done[c] && rhoNew[c] == 0)
+            {
+                std::cout << "\nPORESCALE Warning :: BiCGStab breakdown, (rHat, r) = 0 in column " << c
+                          << " at iteration " << it << ".\n";
+                done[c] = 1;
+            }
+            beta[c] = done[c] ? 0 : (rhoNew[c] / rho[c]) * (alpha[c] / omega[c]);
+        }
+        blockDirectionUpdate(n, nRhs, beta.data(), omega.data(), R_.valueArray(), V_.valueArray(), P_.valueArray());
+        this->charge_(TELEMETRY_UPDATE, 4);
+
+        if (M)
+        {
+            M->apply(P_, PHat_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+        }
+        A.apply(PHat, V_);
+        this->charge_(TELEMETRY_SPMV);
+        RHat_.columnDots(V_, rv.data());
+        this->charge_(TELEMETRY_REDUCTION, 2);
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            if (!done[c] && rv[c] == 0)
+            {
+                std::cout << "\nPORESCALE Warning :: BiCGStab breakdown, (rHat, v) = 0 in column " << c
+                          << " at iteration " << it << ".\n";
+                done[c] = 1;
+            }
+            alpha[c] = done[c] ? 0 : rhoNew[c] / rv[c];
+        }
+        blockHalfStep(n, nRhs, alpha.data(), R_.valueArray(), V_.valueArray(), S_.valueArray());
+        this->charge_(TELEMETRY_UPDATE, 3);
+
+        if (M)
+        {
+            M->apply(S_, SHat_);
+            this->charge_(TELEMETRY_PRECONDITIONER);
+        }
+        A.apply(SHat, T_);
+        this->charge_(TELEMETRY_SPMV);
+        blockVector<T>::dots(5, left, right, sums.data());
+        this->charge_(TELEMETRY_REDUCTION, 3);
+
+        // A converged s finishes with the half step, omega = 0.
+        bool confirm = false;
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            T ts = sums[c], tt = sums[nRhs + c], ss = sums[4 * nRhs + c];
+            halfStep[c] = !done[c] && (tt == 0 || this->converged_(it, (T)sqrt(ss), initial[c]));
+            omega[c]    = (done[c] || halfStep[c]) ? 0 : ts / tt;
+            if (done[c]) continue;
+            rho[c]      = rhoNew[c];
+            rhoNew[c]   = sums[2 * nRhs + c] - omega[c] * sums[3 * nRhs + c];
+            residual[c] = (T)sqrt(std::max(ss - 2 * omega[c] * ts + omega[c] * omega[c] * tt, (T)0));
+            confirm    |= halfStep[c] || this->converged_(it, residual[c], initial[c]);
+        }
+        blockSolutionUpdate(n, nRhs, alpha.data(), omega.data(), PHat.valueArray(), SHat.valueArray(),
+                            S_.valueArray(), T_.valueArray(), X.valueArray(), R_.valueArray());
+        this->charge_(TELEMETRY_UPDATE, 8);
+
+        // The recurrence norms lose digits near convergence, confirm with the vectors.
+        if (confirm)
+        {
+            std::vector<T> norms(nRhs);
+            R_.columnNorms(norms.data());
+            this->charge_(TELEMETRY_REDUCTION, 1);
+            for (psInt c = 0; c < nRhs; c++) if (!done[c]) residual[c] = norms[c];
+        }
+        allDone = true;
+        for (psInt c = 0; c < nRhs; c++)
+        {
+            if (!done[c] && (halfStep[c] || this->converged_(it, residual[c], initial[c]))) done[c] = 1;
+            else if (!done[c] && omega[c] == 0)
+            {
+                std::cout << "\nPORESCALE Warning :: BiCGStab breakdown, omega = 0 in column " << c
+                          << " at iteration " << it << ".\n";
+                done[c] = 1;
+            }
+            allDone &= (bool)done[c];
+        }
+        this->iterations_      = it;
+        this->currentResidual_ = *std::max_element(residual.begin(), residual.end());
+        this->commit_(it, this->currentResidual_);
+        if (allDone) break;
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::biCGStabSolver<float>;
+template class porescale::biCGStabSolver<double>;
@@ -0,0 +1,681 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for supernodal sparse direct solver class.
+ */
+
+#include <limits>
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Panels and schedule of a supernodal factor as raw pointers, for kernels run in parallel loops. */
+    template <typename T>
+    struct supernodalFactor
+    {
+        const psInt   * begin;          /**< First column of every supernode. */
+        const psInt   * structPtr;      /**< Offsets of the rows of every supernode. */
+        const psInt   * rows;           /**< Rows of every supernode, its columns first. */
+        const int64_t * panelPtr;       /**< Offset of every panel. */
+        T             * panels;         /**< Column major panels. */
+        const psInt   * updatePtr;      /**< Offsets of the updates of every supernode. */
+        const psInt   * updateNode;     /**< Updating descendant. */
+        const psInt   * updateBegin;    /**< First row position in the descendant. */
+        const psInt   * updateEnd;      /**< Row position in the descendant past the supernode. */
+        char          * null;           /**< Null pivot flags, 2 for a negative Cholesky pivot. */
+        bool            ldlt;           /**< Unit L with D on the diagonal, else Cholesky. */
+    };
+
+    /** \brief f(i) for i in [begin, end), in parallel when threaded. */
+    template <typename F>
+    inline void
+    nodeFor(bool threaded, psInt begin, psInt end, F f)
+    {
+        if (threaded) porescale::parallelFor(begin, end, f);
+        else for (psInt i = begin; i < end; i++) f(i);
+    }
+
+    /** \brief Sum of f(i) for i in [begin, end), in parallel when threaded. */
+    template <typename T, typename F>
+    inline T
+    nodeSum(bool threaded, psInt begin, psInt end, F f)
+    {
+        if (threaded) return porescale::parallelReduce(begin, end, (T)0, f);
+        T sum = 0;
+        for (psInt i = begin; i < end; i++) sum += f(i);
+        return sum;
+    }
+
+    /** \brief Factor supernode s: its lower entries of A, the updates of its descendants
+     *         and the dense factorization of its panel. position holds a row per row of the
+     *         widest supernode and work nWork buffers of workSize entries. Returns the null pivots.
+     */
+    template <typename T>
+    psInt
+    factorNode(const supernodalFactor<T>& F, psInt s, const psInt * lowerPtr, const psInt * lowerRows,
+               const psInt * lowerSource, const T * source, T tolerance, psInt * position,
+               T * work, psInt nWork, int64_t workSize, bool threaded)
+    {
+        const psInt   B     = PORESCALE_DIRECT_BLOCK;
+        psInt         first = F.begin[s], w = F.begin[s + 1] - first;
+        psInt         m     = F.structPtr[s + 1] - F.structPtr[s];
+        const psInt * rows  = F.rows + F.structPtr[s];
+        T           * panel = F.panels + F.panelPtr[s];
+        bool          ldlt  = F.ldlt;
+
+        nodeFor(threaded, (psInt)0, w, [=](psInt j)
+        {
+            T * column = panel + (int64_t)j * m;
+            for (psInt i = 0; i < m; i++) column[i] = 0;
+            for (psInt k = lowerPtr[first + j]; k < lowerPtr[first + j + 1]; k++)
+                column[std::lower_bound(rows, rows + m, lowerRows[k]) - rows] += source[lowerSource[k]];
+        });
+
+        // Rows [begin, end) of descendant d fall in the columns of s, the rows from begin
+        // on are a subset of the rows of s. Blocks of B target columns are formed densely
+        // in a work buffer, reading every column of d once, and scattered once.
+        for (psInt u = F.updatePtr[s]; u < F.updatePtr[s + 1]; u++)
+        {
+            psInt         d      = F.updateNode[u];
+            psInt         begin  = F.updateBegin[u], end = F.updateEnd[u];
+            psInt         wd     = F.begin[d + 1] - F.begin[d];
+            psInt         md     = F.structPtr[d + 1] - F.structPtr[d];
+            const psInt * dRows  = F.rows + F.structPtr[d];
+            const T     * dPanel = F.panels + F.panelPtr[d];
+            for (psInt i = begin, p = 0; i < md; i++)
+            {
+                while (rows[p] != dRows[i]) p++;
+                position[i - begin] = p;
+            }
+            psInt nBlocks = (end - begin + B - 1) / B;
+            nodeFor(threaded, (psInt)0, std::min(nBlocks, nWork), [=](psInt slot)
+            {
+                T * buffer = work + slot * workSize;
+                for (psInt b = slot; b < nBlocks; b += nWork)
+                {
+                    psInt c0 = begin + b * B, c1 = std::min(c0 + B, end), ld = md - c0;
+                    for (int64_t i = 0; i < (int64_t)ld * (c1 - c0); i++) buffer[i] = 0;
+                    for (psInt k = 0; k < wd; k++)
+                    {
+                        const T * column = dPanel + (int64_t)k * md;
+                        T         dk     = ldlt ? column[k] : 1;
+                        for (psInt c = c0; c < c1; c++)
+                        {
+                            T weight = column[c] * dk;
+                            if (weight == 0) continue;
+                            T * out = buffer + (int64_t)(c - c0) * ld;
+                            for (psInt i = c; i < md; i++) out[i - c0] += column[i] * weight;
+                        }
+                    }
+                    for (psInt c = c0; c < c1; c++)
+                    {
+                        T       * target = panel + (int64_t)(dRows[c] - first) * m;
+                        const T * in     = buffer + (int64_t)(c - c0) * ld;
+                        for (psInt i = c; i < md; i++) target[position[i - begin]] -= in[i - c0];
+                    }
+                }
+            });
+        }
+
+        // Left looking by blocks of B columns, every earlier column read once per block,
+        // then right looking within the block.
+        psInt nNull = 0;
+        for (psInt j0 = 0; j0 < w; j0 += B)
+        {
+            psInt j1     = std::min(j0 + B, w);
+            auto  update = [=](psInt j, psInt k)
+            {
+                const T * column = panel + (int64_t)k * m;
+                T         weight = column[j] * (ldlt ? column[k] : 1);
+                if (weight == 0) return;
+                T * target = panel + (int64_t)j * m;
+                for (psInt i = j; i < m; i++) target[i] -= column[i] * weight;
+            };
+            if (threaded) porescale::parallelFor(j0, j1, [=](psInt j) { for (psInt k = 0; k < j0; k++) update(j, k); });
+            else for (psInt k = 0; k < j0; k++) for (psInt j = j0; j < j1; j++) update(j, k);
+
+            for (psInt k = j0; k < j1; k++)
+            {
+                T * column = panel + (int64_t)k * m;
+                T   pivot  = column[k];
+                if (ldlt ? fabs(pivot) <= tolerance : pivot <= tolerance)
+                {
+                    F.null[first + k] = (!ldlt && pivot < -tolerance) ? 2 : 1;
+                    column[k]         = 1;
+                    for (psInt i = k + 1; i < m; i++) column[i] = 0;
+                    nNull++;
+                    continue;
+                }
+                F.null[first + k] = 0;
+                T diagonal = ldlt ? pivot : (T)sqrt(pivot);
+                T scale    = 1 / diagonal;
+                column[k]  = diagonal;
+                nodeFor(threaded, k + 1, m, [=](psInt i) { column[i] *= scale; });
+                nodeFor(threaded, k + 1, j1, [=](psInt j) { update(j, k); });
+            }
+        }
+        return nNull;
+    }
+
+    /** \brief L y = b on the columns of supernode s, the updates of its descendants first. */
+    template <typename T>
+    void
+    forwardNode(const supernodalFactor<T>& F, psInt s, T * y, bool threaded)
+    {
+        psInt     first = F.begin[s], w = F.begin[s + 1] - first;
+        psInt     m     = F.structPtr[s + 1] - F.structPtr[s];
+        const T * panel = F.panels + F.panelPtr[s];
+
+        for (psInt u = F.updatePtr[s]; u < F.updatePtr[s + 1]; u++)
+        {
+            psInt         d      = F.updateNode[u];
+            psInt         dFirst = F.begin[d], wd = F.begin[d + 1] - dFirst;
+            psInt         md     = F.structPtr[d + 1] - F.structPtr[d];
+            const psInt * dRows  = F.rows + F.structPtr[d];
+            const T     * dPanel = F.panels + F.panelPtr[d];
+            nodeFor(threaded, F.updateBegin[u], F.updateEnd[u], [=](psInt c)
+            {
+                T sum = 0;
+                for (psInt k = 0; k < wd; k++) sum += dPanel[(int64_t)k * md + c] * y[dFirst + k];
+                y[dRows[c]] -= sum;
+            });
+        }
+
+        for (psInt k = 0; k < w; k++)
+        {
+            if (F.null[first + k])
+            {
+                y[first + k] = 0;
+                continue;
+            }
+            const T * column = panel + (int64_t)k * m;
+            if (!F.ldlt) y[first + k] /= column[k];
+            T yk = y[first + k];
+            nodeFor(threaded, k + 1, w, [=](psInt i) { y[first + i] -= column[i] * yk; });
+        }
+    }
+
+    /** \brief D^{-1} then L^T x = y on the columns of supernode s, rows below it solved already. */
+    template <typename T>
+    void
+    backwardNode(const supernodalFactor<T>& F, psInt s, T * y, bool threaded)
+    {
+        psInt         first = F.begin[s], w = F.begin[s + 1] - first;
+        psInt         m     = F.structPtr[s + 1] - F.structPtr[s];
+        const psInt * rows  = F.rows + F.structPtr[s];
+        const T     * panel = F.panels + F.panelPtr[s];
+
+        for (psInt k = w - 1; k >= 0; k--)
+        {
+            if (F.null[first + k])
+            {
+                y[first + k] = 0;
+                continue;
+            }
+            const T * column = panel + (int64_t)k * m;
+            T sum = nodeSum<T>(threaded, k + 1, m, [=](psInt i) { return column[i] * y[rows[i]]; });
+            y[first + k] = F.ldlt ? y[first + k] / column[k] - sum : (y[first + k] - sum) / column[k];
+        }
+    }
+
+    /** \brief Nodes grouped by level, offsets in ptr. */
+    void
+    groupByLevel(const std::vector<psInt>& level, std::vector<psInt>& ptr, std::vector<psInt>& nodes)
+    {
+        psInt n       = (psInt)level.size();
+        psInt nLevels = (n > 0) ? 1 + *std::max_element(level.begin(), level.end()) : 0;
+        ptr.assign(nLevels + 1, 0);
+        for (psInt i = 0; i < n; i++) ptr[level[i] + 1]++;
+        for (psInt l = 0; l < nLevels; l++) ptr[l + 1] += ptr[l];
+        nodes.resize(n);
+        std::vector<psInt> cursor(ptr.begin(), ptr.end() - 1);
+        for (psInt i = 0; i < n; i++) nodes[cursor[level[i]]++] = i;
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::directSolver<T>::directSolver(void) : solver<T>::solver(),
+    factorization_(DIRECT_CHOLESKY), local_(false), analyzed_(false), nullPivots_(0) { }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::directSolver<T>::init(parameters<T> *) { }
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::directSolver<T>::setMatrix(sparseMatrix<T> * A)
+{
+    solver<T>::setMatrix(A);
+    analyzed_ = false;
+}
+
+template <typename T>
+void
+porescale::directSolver<T>::setFactorization(psDirectFactorization factorization)
+{
+    factorization_ = factorization;
+    this->built_   = false;
+}
+
+template <typename T>
+porescale::psDirectFactorization
+porescale::directSolver<T>::factorization(void) const { return factorization_; }
+
+template <typename T>
+void
+porescale::directSolver<T>::setLocal(bool local)
+{
+    local_       = local;
+    analyzed_    = false;
+    this->built_ = false;
+}
+
+template <typename T>
+bool
+porescale::directSolver<T>::local(void) const { return local_; }
+
+template <typename T>
+psInt
+porescale::directSolver<T>::supernodes(void) const { return nodeBegin_.empty() ? 0 : (psInt)nodeBegin_.size() - 1; }
+
+template <typename T>
+psInt
+porescale::directSolver<T>::treeLevels(void) const { return levelPtr_.empty() ? 0 : (psInt)levelPtr_.size() - 1; }
+
+template <typename T>
+int64_t
+porescale::directSolver<T>::factorNnz(void) const { return panelPtr_.empty() ? 0 : panelPtr_.back(); }
+
+template <typename T>
+psInt
+porescale::directSolver<T>::nullPivots(void) const { return nullPivots_; }
+
+template <typename T>
+porescale::sparseMatrix<T>&
+porescale::directSolver<T>::source_(void)
+{
+    return (local_ || this->A_->nPes() <= 1) ? *this->A_ : full_;
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::directSolver<T>::build(void)
+{
+    if (analyzed_)
+    {
+        buildNumeric();
+        return;
+    }
+    buildSymbolic();
+    if (analyzed_) factor_();
+}
+
+template <typename T>
+void
+porescale::directSolver<T>::buildSymbolic(void)
+{
+    analyzed_    = false;
+    this->built_ = false;
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: directSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: directSolver requires a CSR matrix.\n";
+        return;
+    }
+    if (!local_ && this->A_->nPes() > 1)
+    {
+        full_.gatherRows(*this->A_, 0, this->A_->globalRows());
+        bFull_.buildLike(*this->A_);
+        bFull_.setHalo(0, this->A_->globalRows());
+    }
+
+    sparseMatrix<T>& M     = source_();
+    psInt            n     = M.localRows();
+    psInt            first = M.firstRow();
+    const psInt    * aRow  = M.rowArray();
+    const psInt    * aCol  = M.columnArray();
+    auto             local = [=](psInt k) { return aCol[k] >= first && aCol[k] < first + n; };
+
+    // Elimination tree of the nested dissection ordering, Liu's algorithm with path compression.
+    std::vector<psInt> order(n), position(n), parent(n, -1), ancestor(n, -1);
+    if (n > 0) M.orderNestedDissection(order.data());
+    for (psInt i = 0; i < n; i++) position[order[i]] = i;
+    for (psInt i = 0; i < n; i++)
+        for (psInt k = aRow[order[i]]; k < aRow[order[i] + 1]; k++)
+        {
+            if (!local(k)) continue;
+            for (psInt j = position[aCol[k] - first], next; j != -1 && j < i; j = next)
+            {
+                next        = ancestor[j];
+                ancestor[j] = i;
+                if (next == -1) parent[j] = i;
+            }
+        }
+
+    // Postorder, children in increasing order, so every subtree and supernode is contiguous.
+    std::vector<psInt> head(n, -1), sibling(n, -1), post(n), stack;
+    for (psInt j = n - 1; j >= 0; j--)
+        if (parent[j] != -1)
+        {
+            sibling[j]      = head[parent[j]];
+            head[parent[j]] = j;
+        }
+    psInt visited = 0;
+    for (psInt j = 0; j < n; j++)
+    {
+        if (parent[j] != -1) continue;
+        stack.push_back(j);
+        while (!stack.empty())
+        {
+            psInt p = stack.back(), child = head[p];
+            if (child == -1)
+            {
+                stack.pop_back();
+                post[visited++] = p;
+            }
+            else
+            {
+                head[p] = sibling[child];
+                stack.push_back(child);
+            }
+        }
+    }
+    perm_.resize(n);
+    inverse_.resize(n);
+    for (psInt k = 0; k < n; k++) position[post[k]] = k;
+    for (psInt k = 0; k < n; k++)
+    {
+        perm_[k]           = order[post[k]];
+        inverse_[perm_[k]] = k;
+        ancestor[k]        = (parent[post[k]] == -1) ? -1 : position[parent[post[k]]];
+    }
+    parent.swap(ancestor);
+
+    // Column counts of L from the row subtrees, row i reaches every column on the tree
+    // path from its entries up to i.
+    std::vector<psInt> count(n, 1), mark(n, -1);
+    for (psInt i = 0; i < n; i++)
+    {
+        mark[i] = i;
+        for (psInt k = aRow[perm_[i]]; k < aRow[perm_[i] + 1]; k++)
+        {
+            if (!local(k)) continue;
+            for (psInt j = inverse_[aCol[k] - first]; j < i && mark[j] != i; j = parent[j])
+            {
+                mark[j] = i;
+                count[j]++;
+            }
+        }
+    }
+
+    // Lower triangle of P A P^T by columns, positions kept for refills.
+    lowerPtr_.assign(n + 1, 0);
+    for (psInt r = 0; r < n; r++)
+        for (psInt k = aRow[r]; k < aRow[r + 1]; k++)
+            if (local(k) && inverse_[r] >= inverse_[aCol[k] - first]) lowerPtr_[inverse_[aCol[k] - first] + 1]++;
+    for (psInt j = 0; j < n; j++) lowerPtr_[j + 1] += lowerPtr_[j];
+    lowerRows_.resize(lowerPtr_[n]);
+    lowerSource_.resize(lowerPtr_[n]);
+    std::vector<psInt> cursor(lowerPtr_.begin(), lowerPtr_.end() - 1);
+    for (psInt r = 0; r < n; r++)
+        for (psInt k = aRow[r]; k < aRow[r + 1]; k++)
+        {
+            if (!local(k)) continue;
+            psInt i = inverse_[r], j = inverse_[aCol[k] - first];
+            if (i < j) continue;
+            lowerRows_[cursor[j]]     = i;
+            lowerSource_[cursor[j]++] = k;
+        }
+
+    // Supernodes follow tree chains, j joins j - 1 if its structure is that of j - 1
+    // less the diagonal, or with padding while the supernode is narrow.
+    nodeBegin_.assign(1, 0);
+    for (psInt j = 1; j < n; j++)
+    {
+        bool chain = parent[j - 1] == j;
+        bool same  = count[j - 1] == count[j] + 1;
+        if (!chain || (!same && j - nodeBegin_.back() >= PORESCALE_DIRECT_RELAX)) nodeBegin_.push_back(j);
+    }
+    if (n > 0) nodeBegin_.push_back(n);
+    psInt nNodes = (psInt)nodeBegin_.size() - 1;
+    std::vector<psInt> nodeOf(n), nodeParent(nNodes, -1);
+    for (psInt s = 0; s < nNodes; s++)
+        for (psInt j = nodeBegin_[s]; j < nodeBegin_[s + 1]; j++) nodeOf[j] = s;
+    for (psInt s = 0; s < nNodes; s++)
+    {
+        psInt p = parent[nodeBegin_[s + 1] - 1];
+        nodeParent[s] = (p == -1) ? -1 : nodeOf[p];
+    }
+
+    // Rows of a supernode: its columns, rows of A below them and rows of its children below.
+    std::vector<psInt> childPtr(nNodes + 1, 0), children(nNodes);
+    for (psInt s = 0; s < nNodes; s++) if (nodeParent[s] != -1) childPtr[nodeParent[s] + 1]++;
+    for (psInt s = 0; s < nNodes; s++) childPtr[s + 1] += childPtr[s];
+    cursor.assign(childPtr.begin(), childPtr.end() - 1);
+    for (psInt s = 0; s < nNodes; s++) if (nodeParent[s] != -1) children[cursor[nodeParent[s]]++] = s;
+
+    structPtr_.assign(nNodes + 1, 0);
+    structRows_.clear();
+    panelPtr_.assign(nNodes + 1, 0);
+    std::fill(mark.begin(), mark.end(), -1);
+    psInt maxRows = 0;
+    for (psInt s = 0; s < nNodes; s++)
+    {
+        psInt begin = nodeBegin_[s], end = nodeBegin_[s + 1];
+        for (psInt j = begin; j < end; j++)
+        {
+            structRows_.push_back(j);
+            mark[j] = s;
+        }
+        auto add = [&](psInt i)
+        {
+            if (mark[i] == s) return;
+            mark[i] = s;
+            structRows_.push_back(i);
+        };
+        for (psInt j = begin; j < end; j++)
+            for (psInt k = lowerPtr_[j]; k < lowerPtr_[j + 1]; k++) add(lowerRows_[k]);
+        for (psInt c = childPtr[s]; c < childPtr[s + 1]; c++)
+        {
+            psInt child = children[c];
+            psInt width = nodeBegin_[child + 1] - nodeBegin_[child];
+            for (psInt k = structPtr_[child] + width; k < structPtr_[child + 1]; k++) add(structRows_[k]);
+        }
+        std::sort(structRows_.begin() + structPtr_[s] + (end - begin), structRows_.end());
+        structPtr_[s + 1] = (psInt)structRows_.size();
+        psInt m           = structPtr_[s + 1] - structPtr_[s];
+        panelPtr_[s + 1]  = panelPtr_[s] + (int64_t)m * (end - begin);
+        maxRows           = std::max(maxRows, m);
+    }
+    panels_.resize(panelPtr_[nNodes]);
+
+    // Descendant d updates every supernode its rows below its columns fall in.
+    std::vector<psInt> updates;
+    updatePtr_.assign(nNodes + 1, 0);
+    for (psInt d = 0; d < nNodes; d++)
+    {
+        const psInt * rows = structRows_.data() + structPtr_[d];
+        psInt         m    = structPtr_[d + 1] - structPtr_[d];
+        for (psInt p = nodeBegin_[d + 1] - nodeBegin_[d]; p < m; )
+        {
+            psInt s = nodeOf[rows[p]], begin = p;
+            while (p < m && nodeOf[rows[p]] == s) p++;
+            updates.insert(updates.end(), { s, d, begin, p });
+            updatePtr_[s + 1]++;
+        }
+    }
+    for (psInt s = 0; s < nNodes; s++) updatePtr_[s + 1] += updatePtr_[s];
+    updateNode_.resize(updatePtr_[nNodes]);
+    updateBegin_.resize(updatePtr_[nNodes]);
+    updateEnd_.resize(updatePtr_[nNodes]);
+    cursor.assign(updatePtr_.begin(), updatePtr_.end() - 1);
+    for (size_t u = 0; u < updates.size(); u += 4)
+    {
+        psInt slot         = cursor[updates[u]]++;
+        updateNode_[slot]  = updates[u + 1];
+        updateBegin_[slot] = updates[u + 2];
+        updateEnd_[slot]   = updates[u + 3];
+    }
+
+    // Levels of the supernodal tree, a supernode one above its highest child.
+    std::vector<psInt> level(nNodes, 0);
+    for (psInt s = 0; s < nNodes; s++)
+        if (nodeParent[s] != -1) level[nodeParent[s]] = std::max(level[nodeParent[s]], level[s] + 1);
+    groupByLevel(level, levelPtr_, levelNodes_);
+
+    scratch_.resize((size_t)parallelChunks() * std::max(maxRows, (psInt)1));
+    work_.resize((size_t)parallelChunks() * std::max(maxRows, (psInt)1) * PORESCALE_DIRECT_BLOCK);
+    null_.assign(n, 0);
+    y_.resize(n);
+    analyzed_ = true;
+}
+
+template <typename T>
+void
+porescale::directSolver<T>::buildNumeric(void)
+{
+    if (!analyzed_)
+    {
+        std::cout << "\nPORESCALE Error :: directSolver buildNumeric requires buildSymbolic first.\n";
+        return;
+    }
+    if (!local_ && this->A_->nPes() > 1) full_.gatherRows(*this->A_, 0, this->A_->globalRows());
+    factor_();
+}
+
+template <typename T>
+void
+porescale::directSolver<T>::factor_(void)
+{
+    const T     * source      = source_().valueArray();
+    const psInt * lowerPtr    = lowerPtr_.data();
+    const psInt * lowerRows   = lowerRows_.data();
+    const psInt * lowerSource = lowerSource_.data();
+    psInt         n           = (psInt)perm_.size();
+
+    supernodalFactor<T> F = { nodeBegin_.data(), structPtr_.data(), structRows_.data(), panelPtr_.data(),
+                              panels_.data(), updatePtr_.data(), updateNode_.data(), updateBegin_.data(),
+                              updateEnd_.data(), null_.data(), factorization_ == DIRECT_LDLT };
+
+    // Pivots up to round off of the largest diagonal entry are null.
+    T scale = parallelMax((psInt)0, n, (T)0, [=](psInt j)
+    {
+        T d = 0;
+        for (psInt k = lowerPtr[j]; k < lowerPtr[j + 1]; k++)
+            if (lowerRows[k] == j) d += source[lowerSource[k]];
+        return (T)fabs(d);
+    });
+    T tolerance = (T)1e4 * std::numeric_limits<T>::epsilon() * scale;
+
+    // Levels of many supernodes go cyclically to chunks with serial kernels, each chunk
+    // with its own row positions and work buffer, and levels of few run threaded kernels
+    // on each.
+    psInt         nChunks  = parallelChunks();
+    psInt         slice    = (psInt)(scratch_.size() / nChunks);
+    int64_t       workSize = (int64_t)work_.size() / nChunks;
+    psInt       * scratch  = scratch_.data();
+    T           * work     = work_.data();
+    const psInt * nodes    = levelNodes_.data();
+    psInt         nNull    = 0;
+    for (psInt l = 0; l + 1 < (psInt)levelPtr_.size(); l++)
+    {
+        psInt begin = levelPtr_[l], end = levelPtr_[l + 1];
+        if (end - begin < nChunks)
+        {
+            for (psInt k = begin; k < end; k++)
+                nNull += factorNode(F, nodes[k], lowerPtr, lowerRows, lowerSource, source, tolerance,
+                                    scratch, work, nChunks, workSize, true);
+            continue;
+        }
+        nNull += parallelReduce((psInt)0, nChunks, (psInt)0, [=](psInt c)
+        {
+            psInt sum = 0;
+            for (psInt k = begin + c; k < end; k += nChunks)
+                sum += factorNode(F, nodes[k], lowerPtr, lowerRows, lowerSource, source, tolerance,
+                                  scratch + (int64_t)c * slice, work + c * workSize, 1, workSize, false);
+            return sum;
+        });
+    }
+    nullPivots_ = nNull;
+
+    const char * null     = null_.data();
+    psInt        negative = parallelReduce((psInt)0, n, (psInt)0, [=](psInt j) { return (psInt)(null[j] == 2); });
+    if (negative > 0)
+        std::cout << "\nPORESCALE Warning :: directSolver Cholesky met " << negative << " negative pivots on pe "
+                  << this->A_->myPe() << ", the matrix is not positive definite, consider DIRECT_LDLT.\n";
+    this->built_ = true;
+}
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::directSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    bool      replicated = &source_() == &full_;
+    psInt     n          = (psInt)perm_.size();
+    const T * bp         = b.valueArray();
+    if (replicated)
+    {
+        bFull_.copy(b);
+        bFull_.exchangeHalo();
+        bp = bFull_.valueArray() - bFull_.haloLow();
+    }
+
+    T           * y       = y_.data();
+    const psInt * perm    = perm_.data();
+    const psInt * inverse = inverse_.data();
+    parallelFor((psInt)0, n, [=](psInt i) { y[i] = bp[perm[i]]; });
+
+    supernodalFactor<T> F = { nodeBegin_.data(), structPtr_.data(), structRows_.data(), panelPtr_.data(),
+                              panels_.data(), updatePtr_.data(), updateNode_.data(), updateBegin_.data(),
+                              updateEnd_.data(), null_.data(), factorization_ == DIRECT_LDLT };
+    psInt         nChunks = parallelChunks();
+    psInt         nLevels = (psInt)levelPtr_.size() - 1;
+    const psInt * nodes   = levelNodes_.data();
+    auto runLevel = [&](psInt l, bool forward)
+    {
+        psInt begin = levelPtr_[l], end = levelPtr_[l + 1];
+        if (end - begin < nChunks)
+        {
+            for (psInt k = begin; k < end; k++)
+            {
+                if (forward) forwardNode(F, nodes[k], y, true);
+                else backwardNode(F, nodes[k], y, true);
+            }
+            return;
+        }
+        parallelFor(begin, end, [=](psInt k)
+        {
+            if (forward) forwardNode(F, nodes[k], y, false);
+            else backwardNode(F, nodes[k], y, false);
+        });
+    };
+    for (psInt l = 0; l < nLevels; l++) runLevel(l, true);
+    for (psInt l = nLevels - 1; l >= 0; l--) runLevel(l, false);
+
+    T     * xp     = x.valueArray();
+    psInt   offset = replicated ? x.firstRow() : 0;
+    parallelFor((psInt)0, x.localRows(), [=](psInt i) { xp[i] = y[inverse[offset + i]]; });
+}
+
+//--- Apply ---//
+template <typename T>
+void
+porescale::directSolver<T>::apply(vector<T>& r, vector<T>& z) { solve(r, z); }
+
+//--- Explicit Instantiations ---//
+template class porescale::directSolver<float>;
+template class porescale::directSolver<double>;
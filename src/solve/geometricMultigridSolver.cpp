@@ -0,0 +1,352 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for geometric multigrid solver class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief True when voxel v of the grid is pore. */
+    inline bool
+    isPore(const porescale::voxelGrid& g, int64_t v)
+    {
+        return g.rank[v + 1] > g.rank[v];
+    }
+
+    /** \brief Voxel holding row r of the grid. */
+    inline int64_t
+    voxelOfRow(const porescale::voxelGrid& g, psInt r)
+    {
+        return std::upper_bound(g.rank.begin() + 1, g.rank.end(), r) - (g.rank.begin() + 1);
+    }
+
+    /** \brief Coarse cells and weights of fine index i along one direction, 1 or 2 of them.
+     *         The parent takes 3/4 and the coarse neighbor nearest to i 1/4, a direction
+     *         which was not coarsened or a missing neighbor leaves the parent alone.
+     */
+    inline psInt
+    axisWeights(psInt i, psInt nFine, psInt nCoarse, psInt * c, double * w)
+    {
+        c[0] = (nCoarse == nFine) ? i : i / 2;
+        w[0] = 1;
+        if (nCoarse == nFine) return 1;
+        psInt other = (i % 2 == 0) ? c[0] - 1 : c[0] + 1;
+        if (other < 0 || other >= nCoarse) return 1;
+        c[1] = other;
+        w[0] = 0.75;
+        w[1] = 0.25;
+        return 2;
+    }
+
+    /** \brief Fine voxels [lo, hi] along one direction which interpolate from coarse index i. */
+    inline void
+    axisWindow(psInt i, psInt nFine, psInt nCoarse, psInt& lo, psInt& hi)
+    {
+        if (nCoarse == nFine)
+        {
+            lo = hi = i;
+            return;
+        }
+        lo = std::max(2 * i - 1, (psInt)0);
+        hi = std::min(2 * i + 2, nFine - 1);
+    }
+
+    /** \brief Prolongation row of fine voxel v, coarse rows in increasing order and their
+     *         weights renormalized over pore coarse cells. Returns the entry count, at most 8.
+     */
+    psInt
+    interpolationRow(const porescale::voxelGrid& fine, const porescale::voxelGrid& coarse,
+                     int64_t v, psInt * cols, double * weights)
+    {
+        psInt  x = (psInt)(v % fine.nx);
+        psInt  y = (psInt)((v / fine.nx) % fine.ny);
+        psInt  z = (psInt)(v / ((int64_t)fine.nx * fine.ny));
+        psInt  cx[2], cy[2], cz[2];
+        double wx[2], wy[2], wz[2];
+        psInt  nxw = axisWeights(x, fine.nx, coarse.nx, cx, wx);
+        psInt  nyw = axisWeights(y, fine.ny, coarse.ny, cy, wy);
+        psInt  nzw = axisWeights(z, fine.nz, coarse.nz, cz, wz);
+
+        psInt  count = 0;
+        double sum   = 0;
+        for (psInt c = 0; c < nzw; c++)
+            for (psInt b = 0; b < nyw; b++)
+                for (psInt a = 0; a < nxw; a++)
+                {
+                    int64_t cv = cx[a] + (int64_t)coarse.nx * (cy[b] + (int64_t)coarse.ny * cz[c]);
+                    if (!isPore(coarse, cv)) continue;
+                    cols[count]    = coarse.rank[cv];
+                    weights[count] = wx[a] * wy[b] * wz[c];
+                    sum           += weights[count];
+                    count++;
+                }
+
+        // The parent is pore whenever v is, so sum is at least 27 / 64.
+        for (psInt k = 0; k < count; k++) weights[k] /= sum;
+        for (psInt k = 1; k < count; k++)
+            for (psInt j = k; j > 0 && cols[j - 1] > cols[j]; j--)
+            {
+                std::swap(cols[j - 1], cols[j]);
+                std::swap(weights[j - 1], weights[j]);
+            }
+        return count;
+    }
+
+    /** \brief CSR rows [rowBegin, rowEnd) of a transfer operator from a row function
+     *         f(row, cols, values) returning the entry count, at most 64.
+     */
+    template <typename T, typename F>
+    void
+    buildTransfer(psInt rowBegin, psInt rowEnd, psInt globalRows, psInt globalColumns, psInt myPe, psInt nPes, F f, porescale::sparseMatrix<T>& M)
+    {
+        psInt              n = std::max(rowEnd - rowBegin, (psInt)0);
+        std::vector<psInt> rowPtr(n + 1, 0);
+        psInt            * rowData = rowPtr.data();
+        porescale::parallelFor((psInt)0, n, [=](psInt r)
+        {
+            psInt cols[64];
+            T     values[64];
+            rowData[r] = f(rowBegin + r, cols, values);
+        });
+        psInt nnz = porescale::exclusiveScan(rowData, n);
+        rowPtr[n] = nnz;
+
+        std::vector<psInt> colArray(std::max(nnz, (psInt)1));
+        std::vector<T>     valueArray(std::max(nnz, (psInt)1));
+        psInt            * colData   = colArray.data();
+        T                * valueData = valueArray.data();
+        porescale::parallelFor((psInt)0, n, [=](psInt r)
+        {
+            f(rowBegin + r, colData + rowData[r], valueData + rowData[r]);
+        });
+
+        psInt   nP        = (nPes > 1) ? nPes : 1;
+        int64_t globalNnz = nnz;
+        porescale::globalSum(&globalNnz, 1, nPes);
+        psInt firstColumn = (psInt)(((int64_t)globalColumns * myPe) / nP);
+        psInt endColumn   = (psInt)(((int64_t)globalColumns * (myPe + 1)) / nP);
+        M.setPes(myPe, nPes);
+        M.setFirstRow(rowBegin);
+        M.setFirstColumn(firstColumn);
+        M.buildPar(n, globalRows, endColumn - firstColumn, globalColumns, nnz, (psInt)globalNnz,
+                   colData, rowData, valueData, porescale::CSR);
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::geometricMultigridSolver<T>::geometricMultigridSolver(void) : multigridSolver<T>::multigridSolver() { }
+
+template <typename T>
+porescale::geometricMultigridSolver<T>::geometricMultigridSolver(parameters<T> * par) :
+    multigridSolver<T>::multigridSolver(par)
+{
+    setGeometry(par->voxelGeometry(), par->nx(), par->ny(), (par->dimension() == 3) ? par->nz() : 1);
+}
+
+//--- Init ---//
+template <typename T>
+void
+porescale::geometricMultigridSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+    setGeometry(par->voxelGeometry(), par->nx(), par->ny(), (par->dimension() == 3) ? par->nz() : 1);
+}
+
+//--- Geometry ---//
+template <typename T>
+void
+porescale::geometricMultigridSolver<T>::setGeometry(const psUInt8 * voxels, psInt nx, psInt ny, psInt nz)
+{
+    this->built_ = false;
+    if (voxels == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: geometricMultigridSolver setGeometry requires a voxel geometry, none was given.\n";
+        grids_.clear();
+        return;
+    }
+
+    grids_.assign(1, voxelGrid());
+    voxelGrid& g = grids_[0];
+    g.nx = std::max(nx, (psInt)1);
+    g.ny = std::max(ny, (psInt)1);
+    g.nz = std::max(nz, (psInt)1);
+
+    int64_t n = (int64_t)g.nx * g.ny * g.nz;
+    g.rank.assign(n + 1, 0);
+    psInt * rank = g.rank.data();
+    parallelFor((int64_t)0, n, [=](int64_t v) { rank[v] = (voxels[v] != 1) ? 1 : 0; });
+    rank[n] = exclusiveScan(rank, n);
+}
+
+template <typename T>
+void
+porescale::geometricMultigridSolver<T>::coarsenGrid_(void)
+{
+    const voxelGrid& fine = grids_.back();
+    voxelGrid        coarse;
+    coarse.nx = (fine.nx > 1) ? (fine.nx + 1) / 2 : 1;
+    coarse.ny = (fine.ny > 1) ? (fine.ny + 1) / 2 : 1;
+    coarse.nz = (fine.nz > 1) ? (fine.nz + 1) / 2 : 1;
+
+    // A coarse voxel is pore when any of its children is.
+    int64_t n = (int64_t)coarse.nx * coarse.ny * coarse.nz;
+    coarse.rank.assign(n + 1, 0);
+    psInt           * rank = coarse.rank.data();
+    const voxelGrid * f    = &fine;
+    const voxelGrid * c    = &coarse;
+    parallelFor((int64_t)0, n, [=](int64_t v)
+    {
+        psInt X = (psInt)(v % c->nx);
+        psInt Y = (psInt)((v / c->nx) % c->ny);
+        psInt Z = (psInt)(v / ((int64_t)c->nx * c->ny));
+        psInt x0 = (c->nx == f->nx) ? X : 2 * X, x1 = (c->nx == f->nx) ? X : std::min(2 * X + 1, f->nx - 1);
+        psInt y0 = (c->ny == f->ny) ? Y : 2 * Y, y1 = (c->ny == f->ny) ? Y : std::min(2 * Y + 1, f->ny - 1);
+        psInt z0 = (c->nz == f->nz) ? Z : 2 * Z, z1 = (c->nz == f->nz) ? Z : std::min(2 * Z + 1, f->nz - 1);
+        psInt pore = 0;
+        for (psInt z = z0; z <= z1 && !pore; z++)
+            for (psInt y = y0; y <= y1 && !pore; y++)
+                for (psInt x = x0; x <= x1 && !pore; x++)
+                    pore = isPore(*f, x + (int64_t)f->nx * (y + (int64_t)f->ny * z));
+        rank[v] = pore;
+    });
+    rank[n] = exclusiveScan(rank, n);
+    grids_.push_back(std::move(coarse));
+}
+
+//--- Transfer operators ---//
+template <typename T>
+void
+porescale::geometricMultigridSolver<T>::buildProlongation_(psInt level, psInt rowBegin, psInt rowEnd,
+                                                            sparseMatrix<T>& P) const
+{
+    const voxelGrid * fine   = &grids_[level];
+    const voxelGrid * coarse = &grids_[level + 1];
+    buildTransfer<T>(rowBegin, rowEnd, fine->rank.back(), coarse->rank.back(),
+                     this->A_->myPe(), this->A_->nPes(),
+                     [=](psInt row, psInt * cols, T * values)
+    {
+        double weights[8];
+        psInt  count = interpolationRow(*fine, *coarse, voxelOfRow(*fine, row), cols, weights);
+        for (psInt k = 0; k < count; k++) values[k] = (T)weights[k];
+        return count;
+    }, P);
+}
+
+template <typename T>
+void
+porescale::geometricMultigridSolver<T>::buildRestriction_(psInt level, psInt rowBegin, psInt rowEnd,
+                                                           sparseMatrix<T>& R) const
+{
+    const voxelGrid * fine   = &grids_[level];
+    const voxelGrid * coarse = &grids_[level + 1];
+    buildTransfer<T>(rowBegin, rowEnd, coarse->rank.back(), fine->rank.back(),
+                     this->A_->myPe(), this->A_->nPes(),
+                     [=](psInt row, psInt * cols, T * values)
+    {
+        // Fine voxels near the coarse one in lexicographic order, so columns increase.
+        int64_t v = voxelOfRow(*coarse, row);
+        psInt   X = (psInt)(v % coarse->nx);
+        psInt   Y = (psInt)((v / coarse->nx) % coarse->ny);
+        psInt   Z = (psInt)(v / ((int64_t)coarse->nx * coarse->ny));
+        psInt   x0, x1, y0, y1, z0, z1;
+        axisWindow(X, fine->nx, coarse->nx, x0, x1);
+        axisWindow(Y, fine->ny, coarse->ny, y0, y1);
+        axisWindow(Z, fine->nz, coarse->nz, z0, z1);
+
+        psInt count = 0;
+        for (psInt z = z0; z <= z1; z++)
+            for (psInt y = y0; y <= y1; y++)
+                for (psInt x = x0; x <= x1; x++)
+                {
+                    int64_t fv = x + (int64_t)fine->nx * (y + (int64_t)fine->ny * z);
+                    if (!isPore(*fine, fv)) continue;
+                    psInt  pCols[8];
+                    double pWeights[8];
+                    psInt  nP = interpolationRow(*fine, *coarse, fv, pCols, pWeights);
+                    for (psInt k = 0; k < nP; k++)
+                    {
+                        if (pCols[k] != row) continue;
+                        cols[count]   = fine->rank[fv];
+                        values[count] = (T)pWeights[k];
+                        count++;
+                    }
+                }
+        return count;
+    }, R);
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::geometricMultigridSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: geometricMultigridSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (grids_.empty())
+    {
+        std::cout << "\nPORESCALE Error :: geometricMultigridSolver build requires a voxel geometry, call setGeometry first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: geometricMultigridSolver requires a CSR matrix.\n";
+        return;
+    }
+    if (grids_[0].rank.back() != this->A_->globalRows())
+    {
+        std::cout << "\nPORESCALE Error :: geometry has " << grids_[0].rank.back()
+                  << " pore voxels but the matrix has " << this->A_->globalRows() << " rows.\n";
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    this->clearLevels_();
+    grids_.resize(1);
+    this->levelA_.push_back(this->A_);
+
+    psInt myPe = this->A_->myPe();
+    psInt nP   = (this->A_->nPes() > 1) ? this->A_->nPes() : 1;
+    while ((psInt)this->levelA_.size() < this->maxLevels_ && this->levelA_.back()->globalRows() > this->coarseSize_)
+    {
+        const sparseMatrix<T>& Af = *this->levelA_.back();
+        psInt                  l  = (psInt)grids_.size() - 1;
+        if (grids_[l].nx == 1 && grids_[l].ny == 1 && grids_[l].nz == 1) break;
+        coarsenGrid_();
+        psInt nCoarse = grids_[l + 1].rank.back();
+        if (nCoarse == 0 || nCoarse >= Af.globalRows())
+        {
+            grids_.pop_back();
+            break;
+        }
+
+        // P on the fine rows of this pe, R on a uniform partition of the coarse rows.
+        sparseMatrix<T> * P = new sparseMatrix<T>();
+        sparseMatrix<T> * R = new sparseMatrix<T>();
+        buildProlongation_(l, Af.firstRow(), Af.firstRow() + Af.localRows(), *P);
+        buildRestriction_(l, (psInt)(((int64_t)nCoarse * myPe) / nP), (psInt)(((int64_t)nCoarse * (myPe + 1)) / nP), *R);
+
+        // Galerkin R A P from the fine rows R touches and the P rows their columns touch.
+        sparseMatrix<T> Aext, Pext, AP;
+        Aext.gatherRows(Af, R->columnBegin(), R->columnEnd());
+        buildProlongation_(l, Aext.columnBegin(), Aext.columnEnd(), Pext);
+        AP.multiply(Aext, Pext);
+        sparseMatrix<T> * Ac = new sparseMatrix<T>();
+        Ac->multiply(*R, AP);
+        this->addLevel_(Ac, P, R);
+    }
+
+    this->finishBuild_(start);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::geometricMultigridSolver<float>;
+template class porescale::geometricMultigridSolver<double>;
@@ -0,0 +1,274 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for mixed precision iterative refinement solver class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief dst[i] = scale * src[i] for n entries, converted to the type of dst. */
+    template <typename S, typename D>
+    void
+    convertRows(psInt n, S scale, const S * src, D * dst)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) dst[i] = (D)(scale * src[i]);
+        });
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::mixedPrecisionSolver<T>::mixedPrecisionSolver(void) : iterativeSolver<T>::iterativeSolver(),
+    innerTolerance_(1e-3f), innerMaxIterations_(100), stagnation_(0.5), innerIterations_(0), fellBack_(false),
+    inner_(NULL), innerM_(NULL), ownInner_(false), ownInnerM_(false), highM_(NULL) { }
+
+template <typename T>
+porescale::mixedPrecisionSolver<T>::mixedPrecisionSolver(parameters<T> * par) : iterativeSolver<T>::iterativeSolver(par),
+    innerTolerance_(1e-3f), innerMaxIterations_(100), stagnation_(0.5), innerIterations_(0), fellBack_(false),
+    inner_(NULL), innerM_(NULL), ownInner_(false), ownInnerM_(false), highM_(NULL) { }
+
+//--- Destructor ---//
+template <typename T>
+porescale::mixedPrecisionSolver<T>::~mixedPrecisionSolver(void)
+{
+    if (ownInner_) delete inner_;
+    if (ownInnerM_) delete innerM_;
+    delete highM_;
+}
+
+//--- Init ---//
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::init(parameters<T> * par)
+{
+    this->maxIterations_     = par->solverMaxIterations();
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+}
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::setInnerSolver(krylovSolver<float> * S)
+{
+    if (ownInner_) delete inner_;
+    inner_       = S;
+    ownInner_    = false;
+    this->built_ = false;
+}
+
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::setInnerPreconditioner(solver<float> * M)
+{
+    if (ownInnerM_) delete innerM_;
+    innerM_      = M;
+    ownInnerM_   = false;
+    this->built_ = false;
+}
+
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::setInnerTolerance(float tolerance) { innerTolerance_ = tolerance; }
+
+template <typename T>
+float
+porescale::mixedPrecisionSolver<T>::innerTolerance(void) const { return innerTolerance_; }
+
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::setInnerMaxIterations(psInt maxIterations) { innerMaxIterations_ = std::max(maxIterations, (psInt)1); }
+
+template <typename T>
+psInt
+porescale::mixedPrecisionSolver<T>::innerMaxIterations(void) const { return innerMaxIterations_; }
+
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::setStagnation(T ratio) { stagnation_ = ratio; }
+
+template <typename T>
+T
+porescale::mixedPrecisionSolver<T>::stagnation(void) const { return stagnation_; }
+
+template <typename T>
+psInt
+porescale::mixedPrecisionSolver<T>::innerIterations(void) const { return innerIterations_; }
+
+template <typename T>
+bool
+porescale::mixedPrecisionSolver<T>::fellBack(void) const { return fellBack_; }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: mixedPrecisionSolver build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: mixedPrecisionSolver requires a CSR matrix.\n";
+        return;
+    }
+
+    // Float copy with the partition of A, the pattern is shared in content only.
+    sparseMatrix<T>&   A   = *this->A_;
+    psInt              nnz = A.localNnz();
+    std::vector<float> values(std::max(nnz, (psInt)1));
+    convertRows(nnz, (T)1, A.valueArray(), values.data());
+    lowA_.setPes(A.myPe(), A.nPes());
+    lowA_.setFirstRow(A.firstRow());
+    lowA_.setFirstColumn(A.firstColumn());
+    lowA_.buildPar(A.localRows(), A.globalRows(), A.localColumns(), A.globalColumns(), nnz, A.globalNnz(),
+                   A.columnArray(), A.rowArray(), values.data(), CSR);
+    lowA_.setSpmvKernel(A.spmvKernel());
+
+    if (innerM_ == NULL)
+    {
+        AMGSolver<float> * amg = new AMGSolver<float>();
+        amg->setMaxIterations(1);
+        amg->setCheckResidual(false);
+        amg->setSmoother(SMOOTHER_GAUSS_SEIDEL);
+        innerM_    = amg;
+        ownInnerM_ = true;
+    }
+    innerM_->setMatrix(&lowA_);
+    innerM_->build();
+    if (inner_ == NULL)
+    {
+        inner_    = new FGMRESSolver<float>();
+        ownInner_ = true;
+    }
+    inner_->setMatrix(&lowA_);
+    inner_->setPreconditioner(innerM_);
+    inner_->build();
+
+    lowR_.buildLike(lowA_);
+    lowD_.buildLike(lowA_);
+    r_.buildLike(A);
+    xHalo_.buildLike(A);
+
+    // The fallback is built on use, from the values of A at that time.
+    delete highM_;
+    highM_       = NULL;
+    this->built_ = true;
+}
+
+//--- Solve ---//
+template <typename T>
+T
+porescale::mixedPrecisionSolver<T>::residual_(vector<T>& b, vector<T>& x)
+{
+    xHalo_.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+    this->A_->apply(xHalo_, r_);
+    this->charge_(TELEMETRY_SPMV);
+    T norm = r_.axpbyNorm(1, b, -1);
+    this->charge_(TELEMETRY_REDUCTION, 3);
+    return norm;
+}
+
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::fallBack_(vector<T>& b, vector<T>& x)
+{
+    if (highM_ == NULL)
+    {
+        highM_ = new AMGSolver<T>();
+        highM_->setMaxIterations(1);
+        highM_->setCheckResidual(false);
+        highM_->setSmoother(SMOOTHER_GAUSS_SEIDEL);
+        highM_->setMatrix(this->A_);
+        highM_->build();
+        high_.setMatrix(this->A_);
+        high_.setPreconditioner(highM_);
+        high_.build();
+    }
+
+    // The tolerances of this solve hold against its own initial residual.
+    high_.setRelativeTolerance(0);
+    high_.setAbsoluteTolerance(std::max(this->absoluteTolerance_, this->relativeTolerance_ * this->initialResidual_));
+    high_.setMaxIterations(std::max(this->maxIterations_ - this->iterations_, (psInt)1) * innerMaxIterations_);
+    high_.solve(b, x);
+    this->charge_(TELEMETRY_PRECONDITIONER);
+    fellBack_               = true;
+    innerIterations_       += high_.iterations();
+    this->iterations_      += 1;
+    this->currentResidual_  = high_.currentResidual();
+    this->commit_(this->iterations_, this->currentResidual_);
+}
+
+template <typename T>
+void
+porescale::mixedPrecisionSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    psInt   n  = this->A_->localRows();
+    T     * xp = x.valueArray();
+    float * dp = lowD_.valueArray();
+    double  lo = (double)sizeof(float) / sizeof(T); // Float vectors in units of T vectors.
+
+    this->iterations_      = 0;
+    innerIterations_       = 0;
+    fellBack_              = false;
+    this->beginTelemetry_();
+    T res                  = residual_(b, x);
+    this->initialResidual_ = res;
+    this->currentResidual_ = res;
+    this->commit_(0, res);
+    inner_->setRelativeTolerance(innerTolerance_);
+    inner_->setAbsoluteTolerance(0);
+    inner_->setMaxIterations(innerMaxIterations_);
+
+    psInt stalled = 0;
+    while (res > 0 && !this->converged_(this->iterations_, res, this->initialResidual_)
+           && this->iterations_ < this->maxIterations_)
+    {
+        // The residual scaled to unit norm, so float neither overflows nor underflows.
+        convertRows(n, 1 / res, r_.valueArray(), lowR_.valueArray());
+        lowD_.set(0);
+        this->charge_(TELEMETRY_UPDATE, 1 + 2 * lo);
+        inner_->solve(lowR_, lowD_);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+        innerIterations_ += inner_->iterations();
+        T correction      = lowD_.norm2();
+        this->charge_(TELEMETRY_REDUCTION, lo);
+        if (!std::isfinite(correction))
+        {
+            fallBack_(b, x);
+            return;
+        }
+
+        streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) xp[i] += res * (T)dp[i];
+        });
+        this->charge_(TELEMETRY_UPDATE, 2 + lo);
+        this->iterations_++;
+        T next                 = residual_(b, x);
+        stalled                = (next > stagnation_ * res) ? stalled + 1 : 0;
+        res                    = next;
+        this->currentResidual_ = res;
+        this->commit_(this->iterations_, res);
+        if (stalled >= 2)
+        {
+            fallBack_(b, x);
+            return;
+        }
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::mixedPrecisionSolver<float>;
+template class porescale::mixedPrecisionSolver<double>;
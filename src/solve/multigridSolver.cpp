@@ -0,0 +1,400 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for multigrid solver base class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Extend the window of v to cover the columns of M. */
+    template <typename T>
+    void
+    coverColumns(porescale::vector<T>& v, const porescale::sparseMatrix<T>& M)
+    {
+        if (M.columnEnd() <= M.columnBegin()) return;
+        psInt windowBegin = v.firstRow() - v.haloLow();
+        psInt windowEnd   = v.firstRow() + v.localRows() + v.haloHigh();
+        v.setHalo(std::min(windowBegin, M.columnBegin()), std::max(windowEnd, M.columnEnd()));
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::multigridSolver<T>::multigridSolver(void) : iterativeSolver<T>::iterativeSolver(),
+    cycle_(MG_V), smootherType_(SMOOTHER_JACOBI), preSweeps_(2), postSweeps_(2),
+    maxLevels_(20), coarseSize_(512), setupTime_(0), solveTime_(0), coarseDense_(false), coarseDirect_(NULL) { }
+
+template <typename T>
+porescale::multigridSolver<T>::multigridSolver(parameters<T> * par) : iterativeSolver<T>::iterativeSolver(par),
+    cycle_(MG_V), smootherType_(SMOOTHER_JACOBI), preSweeps_(2), postSweeps_(2),
+    maxLevels_(20), coarseSize_(512), setupTime_(0), solveTime_(0), coarseDense_(false), coarseDirect_(NULL) { }
+
+//--- Destructor ---//
+template <typename T>
+porescale::multigridSolver<T>::~multigridSolver(void) { clearLevels_(); }
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::multigridSolver<T>::setCycle(psMultigridCycle cycle) { cycle_ = cycle; }
+
+template <typename T>
+porescale::psMultigridCycle
+porescale::multigridSolver<T>::cycle(void) const { return cycle_; }
+
+template <typename T>
+void
+porescale::multigridSolver<T>::setSmoother(psSmootherType type)
+{
+    smootherType_ = type;
+    this->built_  = false;
+}
+
+template <typename T>
+porescale::psSmootherType
+porescale::multigridSolver<T>::smootherType(void) const { return smootherType_; }
+
+template <typename T>
+void
+porescale::multigridSolver<T>::setSweeps(psInt preSweeps, psInt postSweeps)
+{
+    preSweeps_  = std::max(preSweeps, (psInt)0);
+    postSweeps_ = std::max(postSweeps, (psInt)0);
+}
+
+template <typename T>
+psInt
+porescale::multigridSolver<T>::preSweeps(void) const { return preSweeps_; }
+
+template <typename T>
+psInt
+porescale::multigridSolver<T>::postSweeps(void) const { return postSweeps_; }
+
+template <typename T>
+void
+porescale::multigridSolver<T>::setMaxLevels(psInt maxLevels)
+{
+    maxLevels_   = std::max(maxLevels, (psInt)1);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::multigridSolver<T>::maxLevels(void) const { return maxLevels_; }
+
+template <typename T>
+void
+porescale::multigridSolver<T>::setCoarseSize(psInt coarseSize)
+{
+    coarseSize_  = std::max(coarseSize, (psInt)1);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::multigridSolver<T>::coarseSize(void) const { return coarseSize_; }
+
+template <typename T>
+psInt
+porescale::multigridSolver<T>::levels(void) const { return (psInt)levelA_.size(); }
+
+template <typename T>
+const porescale::sparseMatrix<T>&
+porescale::multigridSolver<T>::levelMatrix(psInt level) const { return *levelA_[level]; }
+
+template <typename T>
+double
+porescale::multigridSolver<T>::operatorComplexity(void) const
+{
+    if (levelA_.empty() || levelA_[0]->globalNnz() == 0) return 0;
+    double nnz = 0;
+    for (const sparseMatrix<T> * A : levelA_) nnz += A->globalNnz();
+    return nnz / levelA_[0]->globalNnz();
+}
+
+template <typename T>
+double
+porescale::multigridSolver<T>::setupTime(void) const { return setupTime_; }
+
+template <typename T>
+double
+porescale::multigridSolver<T>::solveTime(void) const { return solveTime_; }
+
+//--- Hierarchy ---//
+template <typename T>
+void
+porescale::multigridSolver<T>::clearLevels_(void)
+{
+    for (size_t l = 1; l < levelA_.size(); l++) delete levelA_[l];
+    for (sparseMatrix<T> * P : P_) delete P;
+    for (sparseMatrix<T> * R : R_) delete R;
+    for (smoother<T> * S : smoothers_) delete S;
+    for (vector<T> * v : x_) delete v;
+    for (vector<T> * v : b_) delete v;
+    for (vector<T> * v : r_) delete v;
+    levelA_.clear();
+    P_.clear();
+    R_.clear();
+    smoothers_.clear();
+    x_.clear();
+    b_.clear();
+    r_.clear();
+    coarseLU_.clear();
+    coarsePivots_.clear();
+    coarseNull_.clear();
+    coarseDense_ = false;
+    delete coarseDirect_;
+    coarseDirect_ = NULL;
+}
+
+template <typename T>
+void
+porescale::multigridSolver<T>::addLevel_(sparseMatrix<T> * Ac, sparseMatrix<T> * P, sparseMatrix<T> * R)
+{
+    levelA_.push_back(Ac);
+    P_.push_back(P);
+    R_.push_back(R);
+}
+
+template <typename T>
+porescale::smoother<T> *
+porescale::multigridSolver<T>::newSmoother_(void) const
+{
+    switch (smootherType_)
+    {
+        case SMOOTHER_GAUSS_SEIDEL: return new gaussSeidelSmoother<T>();
+        case SMOOTHER_CHEBYSHEV:    return new chebyshevSmoother<T>();
+        default:                    return new jacobiSmoother<T>();
+    }
+}
+
+template <typename T>
+void
+porescale::multigridSolver<T>::finishBuild_(std::chrono::steady_clock::time_point setupStart)
+{
+    auto finish = [&](void)
+    {
+        setupTime_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - setupStart).count();
+        globalMax(&setupTime_, 1, levelA_[0]->nPes());
+        solveTime_   = 0;
+        this->built_ = true;
+    };
+
+    psInt nLevels = (psInt)levelA_.size();
+    for (psInt l = 0; l < nLevels; l++)
+    {
+        const sparseMatrix<T>& A = *levelA_[l];
+        x_.push_back(new vector<T>());
+        b_.push_back(new vector<T>());
+        r_.push_back(new vector<T>());
+        x_[l]->buildLike(A);
+        r_[l]->buildLike(A);
+        if (l > 0)
+        {
+            b_[l]->buildLike(A);
+            coverColumns(*x_[l], *P_[l - 1]);
+        }
+        if (l < nLevels - 1) coverColumns(*r_[l], *R_[l]);
+    }
+
+    // The coarsest level is gathered and factored on every pe, densely when small
+    // enough and by a sparse LDL^T beyond.
+    sparseMatrix<T>& Ac = *levelA_[nLevels - 1];
+    psInt            n  = Ac.globalRows();
+    coarseDense_ = n <= PORESCALE_MG_DENSE;
+    bool direct  = !coarseDense_ && Ac.sparseFormat() == CSR;
+    for (psInt l = 0; l < nLevels; l++)
+    {
+        smoothers_.push_back(NULL);
+        if (l == nLevels - 1 && (coarseDense_ || direct)) break;
+        smoothers_[l] = newSmoother_();
+        smoothers_[l]->setMatrix(levelA_[l]);
+        smoothers_[l]->build();
+    }
+    if (direct)
+    {
+        coarseDirect_ = new directSolver<T>();
+        coarseDirect_->setFactorization(DIRECT_LDLT);
+        coarseDirect_->setMatrix(&Ac);
+        coarseDirect_->build();
+        finish();
+        return;
+    }
+    if (!coarseDense_)
+    {
+        if (Ac.myPe() == CONTROL_PE)
+            std::cout << "\nPORESCALE Warning :: multigrid coarsest level has " << n
+                      << " rows and is not CSR, it is smoothed rather than solved.\n";
+        finish();
+        return;
+    }
+
+    coarseFull_.buildLike(Ac);
+    coarseFull_.setHalo(0, n);
+
+    sparseMatrix<T> full;
+    full.gatherRows(Ac, 0, n);
+    coarseLU_.assign((size_t)n * n, 0.0);
+    const psInt * rowPtr = full.rowArray();
+    const psInt * colPtr = full.columnArray();
+    const T     * valPtr = full.valueArray();
+    double      * lu     = coarseLU_.data();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++) lu[(size_t)i * n + colPtr[k]] += valPtr[k];
+    });
+
+    // Partial pivoting, a pivot below round off of the largest entry marks a null direction.
+    double scale = 0;
+    for (size_t k = 0; k < coarseLU_.size(); k++) scale = std::max(scale, fabs(lu[k]));
+    coarsePivots_.assign(n, 0);
+    coarseNull_.assign(n, 0);
+    for (psInt c = 0; c < n; c++)
+    {
+        psInt pivot = c;
+        for (psInt i = c + 1; i < n; i++)
+            if (fabs(lu[(size_t)i * n + c]) > fabs(lu[(size_t)pivot * n + c])) pivot = i;
+        coarsePivots_[c] = pivot;
+        if (pivot != c)
+            for (psInt j = 0; j < n; j++) std::swap(lu[(size_t)c * n + j], lu[(size_t)pivot * n + j]);
+        double diag = lu[(size_t)c * n + c];
+        if (fabs(diag) <= 1e-12 * scale)
+        {
+            coarseNull_[c] = 1;
+            continue;
+        }
+        parallelFor(c + 1, n, [=](psInt i)
+        {
+            double f = lu[(size_t)i * n + c] / diag;
+            lu[(size_t)i * n + c] = f;
+            if (f == 0.0) return;
+            for (psInt j = c + 1; j < n; j++) lu[(size_t)i * n + j] -= f * lu[(size_t)c * n + j];
+        });
+    }
+    finish();
+}
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::multigridSolver<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    auto                   start = std::chrono::steady_clock::now();
+    const sparseMatrix<T>& A     = *levelA_[0];
+    vector<T>            & x0    = *x_[0];
+    vector<T>            & r0    = *r_[0];
+    this->beginTelemetry_();
+    x0.copy(x);
+    this->charge_(TELEMETRY_UPDATE, 2);
+
+    // The cycle is charged as preconditioner, records follow the residual checks.
+    this->iterations_ = 0;
+    for (psInt it = 0; ; it++)
+    {
+        if (this->checkResidual_)
+        {
+            A.apply(x0, r0);
+            this->charge_(TELEMETRY_SPMV);
+            T residual = r0.axpbyNorm(1, b, -1);
+            this->charge_(TELEMETRY_REDUCTION, 3);
+            if (it == 0) this->initialResidual_ = residual;
+            this->currentResidual_ = residual;
+            this->commit_(it, residual);
+            if (residual == 0 || this->converged_(it, residual, this->initialResidual_)) break;
+        }
+        if (it >= this->maxIterations_) break;
+        cycleLevel_(0, cycle_, b);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+        this->iterations_ = it + 1;
+    }
+    x.copy(x0);
+    solveTime_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename T>
+void
+porescale::multigridSolver<T>::cycleLevel_(psInt level, psMultigridCycle type, vector<T>& b)
+{
+    vector<T>& x = *x_[level];
+    if (level == (psInt)levelA_.size() - 1)
+    {
+        coarseSolve_(b, x);
+        return;
+    }
+
+    vector<T>& r       = *r_[level];
+    vector<T>& xCoarse = *x_[level + 1];
+    vector<T>& bCoarse = *b_[level + 1];
+    smoothers_[level]->smooth(b, x, preSweeps_);
+
+    levelA_[level]->apply(x, r);
+    r.axpby(1, b, -1);
+    R_[level]->apply(r, bCoarse);
+    xCoarse.set(0);
+
+    // V visits the coarser level once, W twice, F runs an F-cycle then a V-cycle there.
+    cycleLevel_(level + 1, type, bCoarse);
+    if (type == MG_W) cycleLevel_(level + 1, MG_W, bCoarse);
+    else if (type == MG_F) cycleLevel_(level + 1, MG_V, bCoarse);
+
+    P_[level]->apply(xCoarse, r);
+    x.axpy(1, r);
+    smoothers_[level]->smooth(b, x, postSweeps_);
+}
+
+template <typename T>
+void
+porescale::multigridSolver<T>::coarseSolve_(vector<T>& b, vector<T>& x)
+{
+    if (coarseDirect_)
+    {
+        coarseDirect_->solve(b, x);
+        return;
+    }
+    if (!coarseDense_)
+    {
+        smoothers_.back()->smooth(b, x, 4 * std::max(preSweeps_ + postSweeps_, (psInt)1));
+        return;
+    }
+
+    // All rows of b in the window of coarseFull_, then the replicated triangular solves.
+    coarseFull_.copy(b);
+    coarseFull_.exchangeHalo();
+    psInt               n     = (psInt)coarsePivots_.size();
+    const T           * full  = coarseFull_.valueArray() - coarseFull_.haloLow();
+    const double      * lu    = coarseLU_.data();
+    std::vector<double> y(full, full + n);
+
+    // Whole rows, multipliers included, were swapped in the factorization, so P b first.
+    for (psInt c = 0; c < n; c++) std::swap(y[c], y[coarsePivots_[c]]);
+    for (psInt c = 0; c < n; c++)
+    {
+        if (coarseNull_[c]) continue;
+        for (psInt i = c + 1; i < n; i++) y[i] -= lu[(size_t)i * n + c] * y[c];
+    }
+    for (psInt i = n - 1; i >= 0; i--)
+    {
+        if (coarseNull_[i])
+        {
+            y[i] = 0;
+            continue;
+        }
+        double sum = y[i];
+        for (psInt j = i + 1; j < n; j++) sum -= lu[(size_t)i * n + j] * y[j];
+        y[i] = sum / lu[(size_t)i * n + i];
+    }
+
+    T     * xp    = x.valueArray();
+    psInt   first = x.firstRow();
+    for (psInt i = 0; i < x.localRows(); i++) xp[i] = (T)y[first + i];
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::multigridSolver<float>;
+template class porescale::multigridSolver<double>;
@@ -0,0 +1,374 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for saddle point block preconditioner class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Extend the window of v to cover the columns of M. */
+    template <typename T>
+    void
+    coverColumns(porescale::vector<T>& v, const porescale::sparseMatrix<T>& M)
+    {
+        if (M.columnEnd() <= M.columnBegin()) return;
+        psInt windowBegin = v.firstRow() - v.haloLow();
+        psInt windowEnd   = v.firstRow() + v.localRows() + v.haloHigh();
+        v.setHalo(std::min(windowBegin, M.columnBegin()), std::max(windowEnd, M.columnEnd()));
+    }
+
+    /** \brief dst[i] = src[i] for n entries. */
+    template <typename T>
+    void
+    copyRows(psInt n, const T * src, T * dst)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) dst[i] = src[i];
+        });
+    }
+
+    /** \brief Owner of global row j from pe offsets with nPes + 1 entries. */
+    inline psInt
+    ownerOf(const int64_t * offsets, psInt nPes, psInt j)
+    {
+        return (psInt)(std::upper_bound(offsets, offsets + nPes, (int64_t)j) - offsets) - 1;
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::saddlePointPreconditioner<T>::saddlePointPreconditioner(void) : preconditioner<T>::preconditioner(),
+    form_(BLOCK_UPPER), schur_(SCHUR_PRESSURE_MASS), viscosity_(1), Au_(NULL), B_(NULL), Bt_(NULL), Mp_(NULL),
+    velocitySolver_(NULL), pressureSolver_(NULL), ownVelocity_(false), ownPressure_(false) { }
+
+//--- Destructor ---//
+template <typename T>
+porescale::saddlePointPreconditioner<T>::~saddlePointPreconditioner(void)
+{
+    if (ownVelocity_) delete velocitySolver_;
+    if (ownPressure_) delete pressureSolver_;
+}
+
+//--- Init ---//
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::init(parameters<T> *) { }
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setBlocks(sparseMatrix<T> * A, sparseMatrix<T> * B, sparseMatrix<T> * Bt)
+{
+    Au_          = A;
+    B_           = B;
+    Bt_          = Bt;
+    this->built_ = false;
+}
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setForm(psBlockForm form) { form_ = form; }
+
+template <typename T>
+porescale::psBlockForm
+porescale::saddlePointPreconditioner<T>::form(void) const { return form_; }
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setSchurApproximation(psSchurApproximation schur)
+{
+    schur_       = schur;
+    this->built_ = false;
+}
+
+template <typename T>
+porescale::psSchurApproximation
+porescale::saddlePointPreconditioner<T>::schurApproximation(void) const { return schur_; }
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setViscosity(T viscosity)
+{
+    viscosity_   = viscosity;
+    this->built_ = false;
+}
+
+template <typename T>
+T
+porescale::saddlePointPreconditioner<T>::viscosity(void) const { return viscosity_; }
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setPressureMass(sparseMatrix<T> * Mp)
+{
+    Mp_          = Mp;
+    this->built_ = false;
+}
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setVelocitySolver(solver<T> * S)
+{
+    if (ownVelocity_) delete velocitySolver_;
+    velocitySolver_ = S;
+    ownVelocity_    = false;
+    this->built_    = false;
+}
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::setPressureSolver(solver<T> * S)
+{
+    if (ownPressure_) delete pressureSolver_;
+    pressureSolver_ = S;
+    ownPressure_    = false;
+    this->built_    = false;
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::build(void)
+{
+    if (Au_ == NULL || B_ == NULL || Bt_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: saddlePointPreconditioner build requires the blocks, call setBlocks first.\n";
+        return;
+    }
+    if (Au_->sparseFormat() != CSR || B_->sparseFormat() != CSR || Bt_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: saddlePointPreconditioner requires CSR blocks.\n";
+        return;
+    }
+
+    // Velocity vectors are the x of A and B, pressure vectors the x of B^T.
+    ru_.buildLike(*Au_);
+    for (vector<T> * v : { &zu_, &wu_, &vu_ })
+    {
+        v->buildLike(*Au_);
+        coverColumns(*v, *B_);
+    }
+    for (vector<T> * v : { &rp_, &zp_, &wp_ })
+    {
+        v->buildLike(*B_);
+        v->setHalo(v->firstRow(), v->firstRow() + v->localRows());
+        coverColumns(*v, *Bt_);
+    }
+
+    invDiagonal_.buildLike(*Au_);
+    T * d = invDiagonal_.valueArray();
+    Au_->diagonal(d);
+    parallelFor((psInt)0, Au_->localRows(), [=](psInt i) { d[i] = (d[i] == 0) ? (T)1 : 1 / d[i]; });
+
+    if (velocitySolver_ == NULL)
+    {
+        AMGSolver<T> * amg = new AMGSolver<T>();
+        amg->setMaxIterations(1);
+        amg->setCheckResidual(false);
+        amg->setSmoother(SMOOTHER_GAUSS_SEIDEL);
+        velocitySolver_ = amg;
+        ownVelocity_    = true;
+    }
+    velocitySolver_->setMatrix(Au_);
+    velocitySolver_->build();
+
+    if (schur_ == SCHUR_PRESSURE_MASS)
+    {
+        // viscosity over the row sums of Mp, or over 1.
+        invMass_.buildLike(rp_);
+        T     * m  = invMass_.valueArray();
+        T       nu = viscosity_;
+        psInt   np = B_->localRows();
+        if (Mp_ == NULL) invMass_.set(nu);
+        else
+        {
+            const psInt * rowPtr = Mp_->rowArray();
+            const T     * valPtr = Mp_->valueArray();
+            parallelFor((psInt)0, np, [=](psInt i)
+            {
+                T sum = 0;
+                for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++) sum += valPtr[k];
+                m[i] = (sum == 0) ? nu : nu / sum;
+            });
+        }
+    }
+    else
+    {
+        // L = B (D^{-1} B^T), with the B^T rows B references gathered first.
+        sparseMatrix<T> scaled, gathered;
+        scaled.setPes(Bt_->myPe(), Bt_->nPes());
+        scaled.setFirstRow(Bt_->firstRow());
+        scaled.setFirstColumn(Bt_->firstColumn());
+        scaled.buildPar(Bt_->localRows(), Bt_->globalRows(), Bt_->localColumns(), Bt_->globalColumns(),
+                        Bt_->localNnz(), Bt_->globalNnz(), Bt_->columnArray(), Bt_->rowArray(), Bt_->valueArray(), CSR);
+        const psInt * rowPtr = scaled.rowArray();
+        T           * valPtr = scaled.valueArray();
+        parallelFor((psInt)0, scaled.localRows(), [=](psInt i)
+        {
+            for (psInt k = rowPtr[i]; k < rowPtr[i + 1]; k++) valPtr[k] *= d[i];
+        });
+        gathered.gatherRows(scaled, B_->columnBegin(), B_->columnEnd());
+        L_.multiply(*B_, gathered);
+
+        if (pressureSolver_ == NULL)
+        {
+            AMGSolver<T> * amg = new AMGSolver<T>();
+            amg->setMaxIterations(1);
+            amg->setCheckResidual(false);
+            amg->setSmoother(SMOOTHER_GAUSS_SEIDEL);
+            pressureSolver_ = amg;
+            ownPressure_    = true;
+        }
+        pressureSolver_->setMatrix(&L_);
+        pressureSolver_->build();
+    }
+    this->built_ = true;
+}
+
+//--- Assemble ---//
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::assemble(sparseMatrix<T>& K)
+{
+    if (Au_ == NULL || B_ == NULL || Bt_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: saddlePointPreconditioner assemble requires the blocks, call setBlocks first.\n";
+        return;
+    }
+
+    // Pe p holds its velocity rows then its pressure rows, so a velocity row j of p is
+    // j + pFirst[p] and a pressure row q of p is q + uFirst[p + 1].
+    psInt                myPe = Au_->myPe();
+    psInt                nPes = Au_->nPes();
+    psInt                nP   = (nPes > 1) ? nPes : 1;
+    std::vector<int64_t> uOffsets(nP + 1), pOffsets(nP + 1);
+    allGather(Au_->firstRow(), uOffsets.data(), myPe, nPes);
+    allGather(B_->firstRow(), pOffsets.data(), myPe, nPes);
+    uOffsets[nP] = Au_->globalRows();
+    pOffsets[nP] = B_->globalRows();
+    const int64_t * uOff = uOffsets.data();
+    const int64_t * pOff = pOffsets.data();
+
+    psInt nu = Au_->localRows();
+    psInt np = B_->localRows();
+    psInt n  = nu + np;
+    std::vector<psInt> rowArray(n + 1);
+    psInt            * rowPtr = rowArray.data();
+    const psInt      * aRow   = Au_->rowArray();
+    const psInt      * tRow   = Bt_->rowArray();
+    const psInt      * bRow   = B_->rowArray();
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        rowPtr[i] = (i < nu) ? (aRow[i + 1] - aRow[i]) + (tRow[i + 1] - tRow[i]) : bRow[i - nu + 1] - bRow[i - nu];
+    });
+    psInt nnz = exclusiveScan(rowPtr, n);
+    rowPtr[n] = nnz;
+
+    std::vector<psInt> colArray(std::max(nnz, (psInt)1));
+    std::vector<T>     valueArray(std::max(nnz, (psInt)1));
+    psInt            * colPtr = colArray.data();
+    T                * valPtr = valueArray.data();
+    const psInt      * aCol   = Au_->columnArray();
+    const T          * aVal   = Au_->valueArray();
+    const psInt      * tCol   = Bt_->columnArray();
+    const T          * tVal   = Bt_->valueArray();
+    const psInt      * bCol   = B_->columnArray();
+    const T          * bVal   = B_->valueArray();
+    auto velocity = [=](psInt j) { return (psInt)(j + pOff[ownerOf(uOff, nP, j)]); };
+    auto pressure = [=](psInt q) { return (psInt)(q + uOff[ownerOf(pOff, nP, q) + 1]); };
+    parallelFor((psInt)0, n, [=](psInt i)
+    {
+        std::vector<std::pair<psInt, T>> row;
+        if (i < nu)
+        {
+            for (psInt k = aRow[i]; k < aRow[i + 1]; k++) row.emplace_back(velocity(aCol[k]), aVal[k]);
+            for (psInt k = tRow[i]; k < tRow[i + 1]; k++) row.emplace_back(pressure(tCol[k]), tVal[k]);
+        }
+        else
+            for (psInt k = bRow[i - nu]; k < bRow[i - nu + 1]; k++) row.emplace_back(velocity(bCol[k]), bVal[k]);
+        std::sort(row.begin(), row.end(), [](const std::pair<psInt, T>& a, const std::pair<psInt, T>& b)
+                  { return a.first < b.first; });
+        for (size_t k = 0; k < row.size(); k++)
+        {
+            colPtr[rowPtr[i] + k] = row[k].first;
+            valPtr[rowPtr[i] + k] = row[k].second;
+        }
+    });
+
+    int64_t globalNnz = nnz;
+    globalSum(&globalNnz, 1, nPes);
+    psInt globalRows = Au_->globalRows() + B_->globalRows();
+    psInt first      = Au_->firstRow() + B_->firstRow();
+    K.setPes(myPe, nPes);
+    K.setFirstRow(first);
+    K.setFirstColumn(first);
+    K.buildPar(n, globalRows, n, globalRows, nnz, (psInt)globalNnz, colPtr, rowPtr, valPtr, CSR);
+}
+
+//--- Apply ---//
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::schurSolve_(vector<T>& r, vector<T>& z)
+{
+    if (schur_ == SCHUR_PRESSURE_MASS)
+    {
+        z.pointwiseMultiply(r, invMass_);
+        return;
+    }
+
+    // L^{-1} B D^{-1} A D^{-1} B^T L^{-1} r.
+    pressureSolver_->apply(r, wp_);
+    Bt_->apply(wp_, wu_);
+    wu_.pointwiseMultiply(wu_, invDiagonal_);
+    Au_->apply(wu_, vu_);
+    vu_.pointwiseMultiply(vu_, invDiagonal_);
+    B_->apply(vu_, wp_);
+    pressureSolver_->apply(wp_, z);
+}
+
+template <typename T>
+void
+porescale::saddlePointPreconditioner<T>::apply(vector<T>& r, vector<T>& z)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    psInt nu = Au_->localRows();
+    psInt np = B_->localRows();
+    copyRows(nu, r.valueArray(), ru_.valueArray());
+    copyRows(np, r.valueArray() + nu, rp_.valueArray());
+
+    switch (form_)
+    {
+        case BLOCK_DIAGONAL:
+            velocitySolver_->apply(ru_, zu_);
+            schurSolve_(rp_, zp_);
+            break;
+        case BLOCK_UPPER:
+            // zp = -S^{-1} rp, zu = A^{-1} (ru - B^T zp).
+            schurSolve_(rp_, zp_);
+            zp_.scale(-1);
+            Bt_->apply(zp_, wu_);
+            ru_.axpy(-1, wu_);
+            velocitySolver_->apply(ru_, zu_);
+            break;
+        case BLOCK_LOWER:
+            // zu = A^{-1} ru, zp = S^{-1} (B zu - rp).
+            velocitySolver_->apply(ru_, zu_);
+            B_->apply(zu_, wp_);
+            rp_.axpby(1, wp_, -1);
+            schurSolve_(rp_, zp_);
+            break;
+    }
+
+    copyRows(nu, (const T *)zu_.valueArray(), z.valueArray());
+    copyRows(np, (const T *)zp_.valueArray(), z.valueArray() + nu);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::saddlePointPreconditioner<float>;
+template class porescale::saddlePointPreconditioner<double>;
@@ -0,0 +1,383 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for restricted additive Schwarz preconditioner class.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    /** \brief Subdomain of global row j from offsets with nSubdomains + 1 entries. */
+    inline psInt
+    ownerOf(const int64_t * offsets, psInt nSubdomains, psInt j)
+    {
+        return (psInt)(std::upper_bound(offsets, offsets + nSubdomains, (int64_t)j) - offsets) - 1;
+    }
+
+    /** \brief Grow [begin, end) to the range its rows of G reach, within the rows of G. */
+    template <typename T>
+    void
+    reach(porescale::sparseMatrix<T>& G, psInt& begin, psInt& end)
+    {
+        const psInt * rowPtr = G.rowArray();
+        const psInt * colPtr = G.columnArray();
+        psInt         first  = G.firstRow();
+        psInt         lo     = porescale::parallelMin(begin, end, begin, [=](psInt i)
+        {
+            psInt m = i;
+            for (psInt k = rowPtr[i - first]; k < rowPtr[i - first + 1]; k++) m = std::min(m, colPtr[k]);
+            return m;
+        });
+        psInt         hi     = porescale::parallelMax(begin, end, end, [=](psInt i)
+        {
+            psInt m = i + 1;
+            for (psInt k = rowPtr[i - first]; k < rowPtr[i - first + 1]; k++) m = std::max(m, colPtr[k] + 1);
+            return m;
+        });
+        begin = std::max(lo, first);
+        end   = std::min(hi, first + G.localRows());
+    }
+
+    /** \brief dst[i] = src[i] for n entries. */
+    template <typename T>
+    void
+    copyRows(psInt n, const T * src, T * dst)
+    {
+        porescale::streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) dst[i] = src[i];
+        });
+    }
+}
+
+//--- Constructors ---//
+template <typename T>
+porescale::schwarzPreconditioner<T>::schwarzPreconditioner(void) : preconditioner<T>::preconditioner(),
+    overlap_(1), subdomains_(1), solverType_(SUBDOMAIN_ILU), cycles_(2), coarse_(true) { }
+
+//--- Destructor ---//
+template <typename T>
+porescale::schwarzPreconditioner<T>::~schwarzPreconditioner(void) { clear_(); }
+
+//--- Init ---//
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::init(parameters<T> *) { }
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::setOverlap(psInt overlap)
+{
+    overlap_     = std::max(overlap, (psInt)0);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::schwarzPreconditioner<T>::overlap(void) const { return overlap_; }
+
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::setSubdomains(psInt subdomains)
+{
+    subdomains_  = std::max(subdomains, (psInt)1);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::schwarzPreconditioner<T>::subdomains(void) const { return subdomains_; }
+
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::setSubdomainSolver(psSubdomainSolver type)
+{
+    solverType_  = type;
+    this->built_ = false;
+}
+
+template <typename T>
+porescale::psSubdomainSolver
+porescale::schwarzPreconditioner<T>::subdomainSolver(void) const { return solverType_; }
+
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::setCycles(psInt cycles)
+{
+    cycles_      = std::max(cycles, (psInt)1);
+    this->built_ = false;
+}
+
+template <typename T>
+psInt
+porescale::schwarzPreconditioner<T>::cycles(void) const { return cycles_; }
+
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::setCoarse(bool coarse)
+{
+    coarse_      = coarse;
+    this->built_ = false;
+}
+
+template <typename T>
+bool
+porescale::schwarzPreconditioner<T>::coarse(void) const { return coarse_; }
+
+template <typename T>
+psInt
+porescale::schwarzPreconditioner<T>::overlapRows(void) const
+{
+    psInt rows = 0;
+    for (size_t b = 0; b < windowBegin_.size(); b++) rows += windowEnd_[b] - windowBegin_[b];
+    return rows;
+}
+
+//--- Build ---//
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::clear_(void)
+{
+    for (sparseMatrix<T> * M : localA_) delete M;
+    for (solver<T> * S : localSolvers_) delete S;
+    for (vector<T> * v : localR_) delete v;
+    for (vector<T> * v : localZ_) delete v;
+    localA_.clear();
+    localSolvers_.clear();
+    localR_.clear();
+    localZ_.clear();
+    windowBegin_.clear();
+    windowEnd_.clear();
+}
+
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: schwarzPreconditioner build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: schwarzPreconditioner requires a CSR matrix.\n";
+        return;
+    }
+    clear_();
+
+    sparseMatrix<T>& A     = *this->A_;
+    psInt            nPes  = std::max(A.nPes(), (psInt)1);
+    psInt            first = A.firstRow();
+    psInt            n     = A.localRows();
+    psInt            nSub  = nPes * subdomains_;
+    psInt            base  = A.myPe() * subdomains_;
+
+    // Subdomains split the rows of every pe into equal contiguous blocks.
+    std::vector<int64_t> peFirst(nPes + 1);
+    allGather(first, peFirst.data(), A.myPe(), A.nPes());
+    peFirst[nPes] = A.globalRows();
+    offsets_.assign(nSub + 1, A.globalRows());
+    for (psInt p = 0; p < nPes; p++)
+        for (psInt b = 0; b < subdomains_; b++)
+            offsets_[p * subdomains_ + b] = peFirst[p] + chunkBegin(peFirst[p + 1] - peFirst[p], b, subdomains_);
+
+    // Overlap of the pe, every layer the range its gathered rows reach.
+    psInt           lo = first, hi = first + n;
+    sparseMatrix<T> G;
+    for (psInt layer = 0; layer < overlap_; layer++)
+    {
+        G.gatherRows(A, lo, hi);
+        if (G.columnEnd() <= G.columnBegin()) continue;
+        lo = std::min(lo, G.columnBegin());
+        hi = std::max(hi, G.columnEnd());
+    }
+    G.gatherRows(A, lo, hi);
+    window_.buildLike(A);
+    window_.setHalo(lo, hi);
+
+    const psInt * gRow = G.rowArray();
+    const psInt * gCol = G.columnArray();
+    const T     * gVal = G.valueArray();
+    for (psInt b = 0; b < subdomains_; b++)
+    {
+        psInt begin = (psInt)offsets_[base + b], end = (psInt)offsets_[base + b + 1];
+        for (psInt layer = 0; layer < overlap_; layer++) reach(G, begin, end);
+        windowBegin_.push_back(begin);
+        windowEnd_.push_back(end);
+
+        // The block of the window, renumbered from 0 and held by this pe alone.
+        psInt              m = end - begin;
+        std::vector<psInt> rowPtr(m + 1, 0);
+        psInt            * rowData = rowPtr.data();
+        parallelFor((psInt)0, m, [=](psInt i)
+        {
+            psInt count = 0;
+            for (psInt k = gRow[begin + i - lo]; k < gRow[begin + i - lo + 1]; k++)
+                count += (gCol[k] >= begin && gCol[k] < end);
+            rowData[i] = count;
+        });
+        psInt nnz = exclusiveScan(rowData, m);
+        rowData[m] = nnz;
+        std::vector<psInt> colArray(std::max(nnz, (psInt)1));
+        std::vector<T>     valArray(std::max(nnz, (psInt)1));
+        psInt            * colData = colArray.data();
+        T                * valData = valArray.data();
+        parallelFor((psInt)0, m, [=](psInt i)
+        {
+            psInt pos = rowData[i];
+            for (psInt k = gRow[begin + i - lo]; k < gRow[begin + i - lo + 1]; k++)
+            {
+                if (gCol[k] < begin || gCol[k] >= end) continue;
+                colData[pos]   = gCol[k] - begin;
+                valData[pos++] = gVal[k];
+            }
+        });
+        sparseMatrix<T> * Ai = new sparseMatrix<T>();
+        Ai->setPes(0, 1);
+        Ai->setFirstRow(0);
+        Ai->setFirstColumn(0);
+        Ai->buildPar(m, m, m, m, nnz, nnz, colData, rowData, valData, CSR);
+        localA_.push_back(Ai);
+
+        solver<T> * S;
+        switch (solverType_)
+        {
+            case SUBDOMAIN_DIRECT:
+            {
+                directSolver<T> * direct = new directSolver<T>();
+                direct->setFactorization(DIRECT_LDLT);
+                S = direct;
+                break;
+            }
+            case SUBDOMAIN_MULTIGRID:
+            {
+                AMGSolver<T> * amg = new AMGSolver<T>();
+                amg->setMaxIterations(cycles_);
+                amg->setCheckResidual(false);
+                S = amg;
+                break;
+            }
+            default: S = new ILUPreconditioner<T>();
+        }
+        S->setMatrix(Ai);
+        S->build();
+        localSolvers_.push_back(S);
+        localR_.push_back(new vector<T>());
+        localZ_.push_back(new vector<T>());
+        localR_.back()->buildLike(*Ai);
+        localZ_.back()->buildLike(*Ai);
+    }
+
+    if (coarse_)
+    {
+        // Galerkin operator of the subdomain constants, entry (a, b) the sum of A over
+        // rows of a and columns of b. Rows of the local subdomains are summed densely
+        // and replicated.
+        std::vector<double> dense((size_t)nSub * nSub, 0.0);
+        const psInt       * aRow    = A.rowArray();
+        const psInt       * aCol    = A.columnArray();
+        const T           * aVal    = A.valueArray();
+        const int64_t     * offsets = offsets_.data();
+        double            * densePtr = dense.data();
+        parallelFor((psInt)0, subdomains_, [=](psInt b)
+        {
+            double * row = densePtr + (size_t)(base + b) * nSub;
+            for (psInt i = (psInt)offsets[base + b] - first; i < (psInt)offsets[base + b + 1] - first; i++)
+                for (psInt k = aRow[i]; k < aRow[i + 1]; k++) row[ownerOf(offsets, nSub, aCol[k])] += aVal[k];
+        });
+        globalSum(densePtr, nSub * nSub, A.nPes());
+
+        std::vector<psInt> rowPtr(nSub + 1, 0), colArray;
+        std::vector<T>     valArray;
+        for (psInt a = 0; a < nSub; a++)
+        {
+            for (psInt b = 0; b < nSub; b++)
+            {
+                if (dense[(size_t)a * nSub + b] == 0) continue;
+                colArray.push_back(b);
+                valArray.push_back((T)dense[(size_t)a * nSub + b]);
+            }
+            rowPtr[a + 1] = (psInt)colArray.size();
+        }
+        psInt nnz = rowPtr[nSub];
+        coarseA_.setPes(0, 1);
+        coarseA_.setFirstRow(0);
+        coarseA_.setFirstColumn(0);
+        coarseA_.buildPar(nSub, nSub, nSub, nSub, nnz, nnz, colArray.data(), rowPtr.data(), valArray.data(), CSR);
+        coarseSolver_.setFactorization(DIRECT_LDLT);
+        coarseSolver_.setMatrix(&coarseA_);
+        coarseSolver_.build();
+        coarseR_.buildLike(coarseA_);
+        coarseZ_.buildLike(coarseA_);
+        zc_.buildLike(A);
+        residual_.buildLike(A);
+    }
+    this->built_ = true;
+}
+
+//--- Apply ---//
+template <typename T>
+void
+porescale::schwarzPreconditioner<T>::apply(vector<T>& r, vector<T>& z)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    sparseMatrix<T>& A      = *this->A_;
+    psInt            first  = A.firstRow();
+    psInt            base   = A.myPe() * subdomains_;
+    T              * zp     = z.valueArray();
+    vector<T>      * source = &r;
+    z.set(0);
+
+    if (coarse_)
+    {
+        // Sums of r over the subdomains, the replicated coarse solve, then r - A z.
+        psInt               nSub = (psInt)offsets_.size() - 1;
+        std::vector<double> sums(nSub, 0.0);
+        const T           * rp   = r.valueArray();
+        for (psInt b = 0; b < subdomains_; b++)
+            sums[base + b] = parallelReduce((psInt)offsets_[base + b] - first, (psInt)offsets_[base + b + 1] - first,
+                                            0.0, [=](psInt i) { return (double)rp[i]; });
+        globalSum(sums.data(), nSub, A.nPes());
+        T * cr = coarseR_.valueArray();
+        for (psInt s = 0; s < nSub; s++) cr[s] = (T)sums[s];
+        coarseSolver_.solve(coarseR_, coarseZ_);
+
+        const T * cz = coarseZ_.valueArray();
+        for (psInt b = 0; b < subdomains_; b++)
+        {
+            T value = cz[base + b];
+            parallelFor((psInt)offsets_[base + b] - first, (psInt)offsets_[base + b + 1] - first, [=](psInt i) { zp[i] = value; });
+        }
+        zc_.copy(z);
+        A.apply(zc_, residual_);
+        residual_.axpby(1, r, -1);
+        source = &residual_;
+    }
+
+    // One exchange brings the overlaps, the solves then touch data of this pe only and
+    // every subdomain adds its own rows.
+    window_.copy(*source);
+    window_.exchangeHalo();
+    const T * wp = window_.valueArray();
+    for (psInt b = 0; b < subdomains_; b++)
+    {
+        psInt begin = windowBegin_[b];
+        copyRows(windowEnd_[b] - begin, wp + (begin - first), localR_[b]->valueArray());
+        localSolvers_[b]->apply(*localR_[b], *localZ_[b]);
+
+        psInt     own = (psInt)offsets_[base + b];
+        const T * lz  = localZ_[b]->valueArray() + (own - begin);
+        T       * out = zp + (own - first);
+        parallelFor((psInt)0, (psInt)offsets_[base + b + 1] - own, [=](psInt i) { out[i] += lz[i]; });
+    }
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::schwarzPreconditioner<float>;
+template class porescale::schwarzPreconditioner<double>;
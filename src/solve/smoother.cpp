@@ -0,0 +1,486 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for multigrid smoother classes.
+ */
+
+#include "solve.hpp"
+#include "parallel.hpp"
+
+///// Smoother base class /////
+
+//--- Constructors ---//
+template <typename T>
+porescale::smoother<T>::smoother(void) : iterativeSolver<T>::iterativeSolver()
+{
+    this->maxIterations_ = 1;
+    this->checkResidual_ = false;
+}
+
+template <typename T>
+porescale::smoother<T>::smoother(parameters<T> * par) : iterativeSolver<T>::iterativeSolver(par)
+{
+    this->maxIterations_ = 1;
+    this->checkResidual_ = false;
+}
+
+//--- Init ---//
+template <typename T>
+void
+porescale::smoother<T>::init(parameters<T> * par)
+{
+    this->relativeTolerance_ = par->solverRelativeTolerance();
+    this->absoluteTolerance_ = par->solverAbsoluteTolerance();
+}
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::smoother<T>::solve(vector<T>& b, vector<T>& x)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    this->iterations_ = 0;
+    if (!this->checkResidual_)
+    {
+        smooth(b, x, this->maxIterations_);
+        this->iterations_ = this->maxIterations_;
+        return;
+    }
+
+    // Sweeps are charged as preconditioner, records follow the residual checks.
+    const sparseMatrix<T>& A = *this->A_;
+    this->beginTelemetry_();
+    for (psInt it = 0; ; it++)
+    {
+        A.apply(haloed_(x), r_);
+        this->charge_(TELEMETRY_SPMV);
+        T residual = r_.axpbyNorm(1, b, -1);
+        this->charge_(TELEMETRY_REDUCTION, 3);
+        if (it == 0) this->initialResidual_ = residual;
+        this->currentResidual_ = residual;
+        this->commit_(it, residual);
+        if (residual == 0 || it >= this->maxIterations_ || this->converged_(it, residual, this->initialResidual_)) break;
+        smooth(b, x, 1);
+        this->charge_(TELEMETRY_PRECONDITIONER);
+        this->iterations_ = it + 1;
+    }
+}
+
+//--- Workspace ---//
+template <typename T>
+void
+porescale::smoother<T>::buildWorkspace_(void)
+{
+    const sparseMatrix<T>& A = *this->A_;
+    invDiagonal_.buildLike(A);
+    r_.buildLike(A);
+    xHalo_.buildLike(A);
+
+    T * d = invDiagonal_.valueArray();
+    A.diagonal(d);
+    parallelFor((psInt)0, A.localRows(), [=](psInt i) { d[i] = (d[i] == 0) ? (T)1 : 1 / d[i]; });
+}
+
+template <typename T>
+porescale::vector<T>&
+porescale::smoother<T>::haloed_(vector<T>& x)
+{
+    const sparseMatrix<T>& A = *this->A_;
+    psInt windowBegin = x.firstRow() - x.haloLow();
+    psInt windowEnd   = x.firstRow() + x.localRows() + x.haloHigh();
+    if (A.columnEnd() <= A.columnBegin() || (A.columnBegin() >= windowBegin && A.columnEnd() <= windowEnd)) return x;
+
+    xHalo_.copy(x);
+    return xHalo_;
+}
+
+template <typename T>
+T
+porescale::smoother<T>::lambdaMaxBound_(void)
+{
+    // Gershgorin, every eigenvalue of D^{-1} A lies within max_i sum_j |a_ij| / |a_ii|.
+    sparseMatrix<T>& A      = *this->A_;
+    const psInt    * rowPtr = A.rowArray();
+    const T        * valPtr = A.valueArray();
+    const T        * dInv   = invDiagonal_.valueArray();
+    double bound = parallelMax((psInt)0, A.localRows(), 0.0, [=](psInt r)
+    {
+        double sum = 0;
+        for (psInt k = rowPtr[r]; k < rowPtr[r + 1]; k++) sum += fabs((double)valPtr[k]);
+        return sum * fabs((double)dInv[r]);
+    });
+    globalMax(&bound, 1, A.nPes());
+    return (T)bound;
+}
+
+template <typename T>
+T
+porescale::smoother<T>::estimateLambdaMax_(psInt steps)
+{
+    // Power iteration from a rough start, hashed from the global row so it is reproducible
+    // over pe counts. A smooth start carries little of the top of the spectrum.
+    const sparseMatrix<T>& A = *this->A_;
+    vector<T>            & v = xHalo_;
+    T                    * p = v.valueArray();
+    psInt              first = v.firstRow();
+    parallelFor((psInt)0, v.localRows(), [=](psInt i)
+    {
+        uint64_t h = (uint64_t)(first + i) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 32;
+        p[i] = (T)((double)(h >> 11) / 9007199254740992.0 - 0.5);
+    });
+    T norm = v.norm2();
+    if (norm == 0) return 0;
+    v.scale(1 / norm);
+
+    T lambda = 0;
+    for (psInt s = 0; s < steps; s++)
+    {
+        A.apply(v, r_);
+        r_.pointwiseMultiply(r_, invDiagonal_);
+        lambda = r_.norm2();
+        if (lambda == 0) break;
+        v.copy(r_);
+        v.scale(1 / lambda);
+    }
+    return lambda;
+}
+
+template <typename T>
+T
+porescale::smoother<T>::lambdaMaxEstimate_(void)
+{
+    // The power estimate approaches from below, the margin covers the rest of the top of
+    // the spectrum and Gershgorin caps it where the bound is already tight.
+    T estimate = (T)1.1 * estimateLambdaMax_(PORESCALE_POWER_STEPS);
+    T bound    = lambdaMaxBound_();
+    return (estimate > 0 && bound > 0) ? std::min(estimate, bound) : std::max(estimate, bound);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::smoother<float>;
+template class porescale::smoother<double>;
+
+///// Jacobi smoother class /////
+
+//--- Constructors ---//
+template <typename T>
+porescale::jacobiSmoother<T>::jacobiSmoother(void) : smoother<T>::smoother(), weight_(0), omega_(1) { }
+
+template <typename T>
+porescale::jacobiSmoother<T>::jacobiSmoother(parameters<T> * par) : smoother<T>::smoother(par), weight_(0), omega_(1) { }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::jacobiSmoother<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: jacobiSmoother build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: jacobiSmoother requires a CSR matrix.\n";
+        return;
+    }
+
+    this->buildWorkspace_();
+    omega_ = weight_;
+    if (omega_ <= 0)
+    {
+        T lambda = this->lambdaMaxEstimate_();
+        omega_   = (lambda > 0) ? (T)4 / (3 * lambda) : (T)2 / 3;
+    }
+    this->built_ = true;
+}
+
+//--- Weight ---//
+template <typename T>
+void
+porescale::jacobiSmoother<T>::setWeight(T weight)
+{
+    weight_      = weight;
+    this->built_ = false;
+}
+
+template <typename T>
+T
+porescale::jacobiSmoother<T>::weight(void) const { return omega_; }
+
+//--- Smooth ---//
+template <typename T>
+void
+porescale::jacobiSmoother<T>::smooth(vector<T>& b, vector<T>& x, psInt sweeps)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    const sparseMatrix<T>& A     = *this->A_;
+    vector<T>            & xh    = this->haloed_(x);
+    T                    * xp    = xh.valueArray();
+    const T              * bp    = b.valueArray();
+    const T              * rp    = this->r_.valueArray();
+    const T              * dp    = this->invDiagonal_.valueArray();
+    T                      omega = omega_;
+    for (psInt s = 0; s < sweeps; s++)
+    {
+        A.apply(xh, this->r_);
+        streamFor(A.localRows(), [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) xp[i] += omega * dp[i] * (bp[i] - rp[i]);
+        });
+    }
+    if (&xh != &x) x.copy(xh);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::jacobiSmoother<float>;
+template class porescale::jacobiSmoother<double>;
+
+///// Gauss-Seidel smoother class /////
+
+//--- Constructors ---//
+template <typename T>
+porescale::gaussSeidelSmoother<T>::gaussSeidelSmoother(void) : smoother<T>::smoother(), weight_(1), symmetric_(true) { }
+
+template <typename T>
+porescale::gaussSeidelSmoother<T>::gaussSeidelSmoother(parameters<T> * par) : smoother<T>::smoother(par), weight_(1), symmetric_(true) { }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::gaussSeidelSmoother<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: gaussSeidelSmoother build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: gaussSeidelSmoother requires a CSR matrix.\n";
+        return;
+    }
+
+    this->buildWorkspace_();
+
+    // Rows grouped by color, in row order within a color.
+    psInt              n = this->A_->localRows();
+    std::vector<psInt> colors(n);
+    psInt              nColors = this->A_->colorRows(colors.data());
+    colorPtr_.assign(nColors + 1, 0);
+    for (psInt i = 0; i < n; i++) colorPtr_[colors[i] + 1]++;
+    for (psInt c = 0; c < nColors; c++) colorPtr_[c + 1] += colorPtr_[c];
+    colorRows_.resize(n);
+    std::vector<psInt> cursor(colorPtr_.begin(), colorPtr_.end() - 1);
+    for (psInt i = 0; i < n; i++) colorRows_[cursor[colors[i]]++] = i;
+    this->built_ = true;
+}
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::gaussSeidelSmoother<T>::setWeight(T weight) { weight_ = weight; }
+
+template <typename T>
+T
+porescale::gaussSeidelSmoother<T>::weight(void) const { return weight_; }
+
+template <typename T>
+void
+porescale::gaussSeidelSmoother<T>::setSymmetric(bool symmetric) { symmetric_ = symmetric; }
+
+template <typename T>
+bool
+porescale::gaussSeidelSmoother<T>::symmetric(void) const { return symmetric_; }
+
+template <typename T>
+psInt
+porescale::gaussSeidelSmoother<T>::colors(void) const { return colorPtr_.empty() ? 0 : (psInt)colorPtr_.size() - 1; }
+
+//--- Smooth ---//
+template <typename T>
+void
+porescale::gaussSeidelSmoother<T>::relaxColor_(psInt color, const vector<T>& b, vector<T>& x)
+{
+    sparseMatrix<T>& A      = *this->A_;
+    psInt            first  = A.firstRow();
+    const psInt    * rows   = colorRows_.data();
+    const psInt    * rowPtr = A.rowArray();
+    const psInt    * colPtr = A.columnArray();
+    const T        * valPtr = A.valueArray();
+    const T        * bp     = b.valueArray();
+    T              * xp     = x.valueArray();
+    T                omega  = weight_;
+
+    // Rows of one color are not coupled, so x is updated in place. xp[j - first]
+    // reaches the halo for columns on other pes.
+    parallelFor(colorPtr_[color], colorPtr_[color + 1], [=](psInt k)
+    {
+        psInt i    = rows[k];
+        T     sum  = bp[i];
+        T     diag = 0;
+        for (psInt kk = rowPtr[i]; kk < rowPtr[i + 1]; kk++)
+        {
+            if (colPtr[kk] == first + i) diag += valPtr[kk];
+            else sum -= valPtr[kk] * xp[colPtr[kk] - first];
+        }
+        if (diag != 0) xp[i] = (1 - omega) * xp[i] + omega * sum / diag;
+    });
+}
+
+template <typename T>
+void
+porescale::gaussSeidelSmoother<T>::smooth(vector<T>& b, vector<T>& x, psInt sweeps)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    vector<T>& xh      = this->haloed_(x);
+    psInt      nColors = colors();
+    for (psInt s = 0; s < sweeps; s++)
+    {
+        xh.exchangeHalo();
+        for (psInt c = 0; c < nColors; c++) relaxColor_(c, b, xh);
+        if (!symmetric_) continue;
+        xh.exchangeHalo();
+        for (psInt c = nColors - 1; c >= 0; c--) relaxColor_(c, b, xh);
+    }
+    if (&xh != &x) x.copy(xh);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::gaussSeidelSmoother<float>;
+template class porescale::gaussSeidelSmoother<double>;
+
+///// Chebyshev smoother class /////
+
+//--- Constructors ---//
+template <typename T>
+porescale::chebyshevSmoother<T>::chebyshevSmoother(void) : smoother<T>::smoother(), degree_(2), eigenRatio_(4), lambdaMax_(1) { }
+
+template <typename T>
+porescale::chebyshevSmoother<T>::chebyshevSmoother(parameters<T> * par) : smoother<T>::smoother(par), degree_(2), eigenRatio_(4), lambdaMax_(1) { }
+
+//--- Build ---//
+template <typename T>
+void
+porescale::chebyshevSmoother<T>::build(void)
+{
+    if (this->A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: chebyshevSmoother build requires a matrix, call setMatrix first.\n";
+        return;
+    }
+    if (this->A_->sparseFormat() != CSR)
+    {
+        std::cout << "\nPORESCALE Error :: chebyshevSmoother requires a CSR matrix.\n";
+        return;
+    }
+
+    // Eigenvalues above the interval would be amplified by the polynomial, so the top is covered.
+    this->buildWorkspace_();
+    z_.buildLike(*this->A_);
+    d_.buildLike(*this->A_);
+    T lambda     = this->lambdaMaxEstimate_();
+    lambdaMax_   = (lambda > 0) ? lambda : (T)1;
+    this->built_ = true;
+}
+
+//--- Sets and gets ---//
+template <typename T>
+void
+porescale::chebyshevSmoother<T>::setDegree(psInt degree) { degree_ = std::max(degree, (psInt)1); }
+
+template <typename T>
+psInt
+porescale::chebyshevSmoother<T>::degree(void) const { return degree_; }
+
+template <typename T>
+void
+porescale::chebyshevSmoother<T>::setEigenRatio(T ratio)
+{
+    eigenRatio_  = std::max(ratio, (T)1.01);
+    this->built_ = false;
+}
+
+template <typename T>
+T
+porescale::chebyshevSmoother<T>::eigenRatio(void) const { return eigenRatio_; }
+
+template <typename T>
+T
+porescale::chebyshevSmoother<T>::lambdaMax(void) const { return lambdaMax_; }
+
+//--- Smooth ---//
+template <typename T>
+void
+porescale::chebyshevSmoother<T>::smooth(vector<T>& b, vector<T>& x, psInt sweeps)
+{
+    if (!this->built_) build();
+    if (!this->built_) return;
+
+    // Three term recurrence for the Chebyshev iteration on [lower, upper], Saad Alg. 12.1.
+    const sparseMatrix<T>& A     = *this->A_;
+    T                      upper = lambdaMax_;
+    T                      lower = lambdaMax_ / eigenRatio_;
+    T                      theta = (upper + lower) / 2;
+    T                      delta = (upper - lower) / 2;
+    T                      sigma = theta / delta;
+    vector<T>            & xh    = this->haloed_(x);
+    T                    * xp    = xh.valueArray();
+    const T              * bp    = b.valueArray();
+    const T              * rp    = this->r_.valueArray();
+    const T              * ip    = this->invDiagonal_.valueArray();
+    T                    * zp    = z_.valueArray();
+    T                    * dp    = d_.valueArray();
+    psInt                  n     = A.localRows();
+    for (psInt s = 0; s < sweeps; s++)
+    {
+        // z = D^{-1} (b - A x), d = z / theta.
+        A.apply(xh, this->r_);
+        streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++)
+            {
+                zp[i] = ip[i] * (bp[i] - rp[i]);
+                dp[i] = zp[i] / theta;
+            }
+        });
+
+        // x += d, z -= D^{-1} A d, d = rho' rho d + 2 rho' / delta z.
+        T rho = 1 / sigma;
+        for (psInt k = 1; k < degree_; k++)
+        {
+            A.apply(d_, this->r_);
+            T rhoNew = 1 / (2 * sigma - rho);
+            T a      = rhoNew * rho;
+            T c      = 2 * rhoNew / delta;
+            streamFor(n, [=](psInt begin, psInt end)
+            {
+                for (psInt i = begin; i < end; i++)
+                {
+                    xp[i] += dp[i];
+                    zp[i] -= ip[i] * rp[i];
+                    dp[i]  = a * dp[i] + c * zp[i];
+                }
+            });
+            rho = rhoNew;
+        }
+        streamFor(n, [=](psInt begin, psInt end)
+        {
+            for (psInt i = begin; i < end; i++) xp[i] += dp[i];
+        });
+    }
+    if (&xh != &x) x.copy(xh);
+}
+
+//--- Explicit Instantiations ---//
+template class porescale::chebyshevSmoother<float>;
+template class porescale::chebyshevSmoother<double>;
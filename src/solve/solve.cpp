@@ -10,7 +10,51 @@
 
 //--- Constructors ---//
 template <typename T>
-porescale::solver<T>::solver(void) : built_(false) { }
+porescale::solver<T>::solver(void) : built_(false), A_(NULL) { }
+
+//--- Destructor ---//
+template <typename T>
+porescale::solver<T>::~solver(void) { }
+
+//--- Operator ---//
+template <typename T>
+void
+porescale::solver<T>::setMatrix(sparseMatrix<T> * A)
+{
+    A_     = A;
+    built_ = false;
+}
+
+//--- Apply ---//
+template <typename T>
+void
+porescale::solver<T>::apply(vector<T>& r, vector<T>& z)
+{
+    z.set(0);
+    solve(r, z);
+}
+
+template <typename T>
+void
+porescale::solver<T>::apply(blockVector<T>& R, blockVector<T>& Z)
+{
+    if (A_ == NULL)
+    {
+        std::cout << "\nPORESCALE Error :: block apply requires the solver matrix to be set.\n";
+        return;
+    }
+    if (columnIn_.globalRows() != A_->globalRows() || columnIn_.localRows() != A_->localRows())
+    {
+        columnIn_.buildLike(*A_);
+        columnOut_.buildLike(*A_);
+    }
+    for (psInt c = 0; c < R.nRhs(); c++)
+    {
+        R.getColumn(c, columnIn_);
+        apply(columnIn_, columnOut_);
+        Z.setColumn(c, columnOut_);
+    }
+}
 
 //--- Explicit Instantiations ---//
 template class porescale::solver<float>;
@@ -19,15 +63,15 @@ template class porescale::solver<double>;
 ///// Iterative solver class /////
 template <typename T>
 porescale::iterativeSolver<T>::iterativeSolver(void) : solver<T>::solver(),
-    checkResidual_(true), minIterations_(0), maxIterations_(100),
+    iterations_(0), checkResidual_(true), minIterations_(0), maxIterations_(100),
     relativeTolerance_(1e-4), absoluteTolerance_(1e-8),
-    initialResidual_(-1), currentResidual_(-1)
+    initialResidual_(-1), currentResidual_(-1), telemetry_(NULL), spmvBytes_(0), vectorBytes_(0)
 { };
 
 template <typename T>
 porescale::iterativeSolver<T>::iterativeSolver(parameters<T> * par) : solver<T>::solver(),
-    checkResidual_(true), minIterations_(0),
-    initialResidual_(-1), currentResidual_(-1)
+    iterations_(0), checkResidual_(true), minIterations_(0),
+    initialResidual_(-1), currentResidual_(-1), telemetry_(NULL), spmvBytes_(0), vectorBytes_(0)
 {
     maxIterations_ = par->solverMaxIterations();
     relativeTolerance_ = par->solverRelativeTolerance();
@@ -35,6 +79,10 @@ porescale::iterativeSolver<T>::iterativeSolver(parameters<T> * par) : solver<T>:
 };
 
 /** Gets */
+template <typename T>
+psInt
+porescale::iterativeSolver<T>::iterations(void) const { return iterations_; }
+
 template <typename T>
 bool
 porescale::iterativeSolver<T>::checkResidual(void) const { return checkResidual_; }
@@ -84,7 +132,92 @@ template< typename T>
 void
 porescale::iterativeSolver<T>::setAbsoluteTolerance(T absoluteTolerance) { absoluteTolerance_ = absoluteTolerance; }
 
+template <typename T>
+void
+porescale::iterativeSolver<T>::setTelemetry(solverTelemetry * telemetry) { telemetry_ = telemetry; }
+
+template <typename T>
+porescale::solverTelemetry *
+porescale::iterativeSolver<T>::telemetry(void) const { return telemetry_; }
+
+/** Telemetry */
+template <typename T>
+void
+porescale::iterativeSolver<T>::beginTelemetry_(psInt nRhs)
+{
+    if (!telemetry_) return;
+
+    // CSR traffic as sparseMatrixReport, the matrix, the column window of x and y write
+    // allocated, the vectors once per right hand side.
+    const sparseMatrix<T>& A = *this->A_;
+    double iBytes = sizeof(psInt), vBytes = (double)sizeof(T) * nRhs;
+    spmvBytes_   = ((double)A.localRows() + 1) * iBytes + (double)A.localNnz() * (iBytes + sizeof(T))
+                 + ((double)A.columnEnd() - A.columnBegin()) * vBytes + 2.0 * A.localRows() * vBytes;
+    vectorBytes_ = (double)A.localRows() * vBytes;
+    telemetry_->beginSolve();
+}
+
+template <typename T>
+void
+porescale::iterativeSolver<T>::charge_(psTelemetryPhase phase, double count)
+{
+    if (!telemetry_) return;
+    double bytes = 0;
+    if (phase == TELEMETRY_SPMV) bytes = count * spmvBytes_;
+    else if (phase != TELEMETRY_PRECONDITIONER) bytes = count * vectorBytes_;
+    telemetry_->charge(phase, bytes);
+}
+
+template <typename T>
+void
+porescale::iterativeSolver<T>::commit_(psInt iteration, T residual)
+{
+    if (telemetry_) telemetry_->commit(iteration, (double)residual);
+}
+
+/** Convergence */
+template <typename T>
+bool
+porescale::iterativeSolver<T>::converged_(psInt iterations, T residual, T initial) const
+{
+    if (!checkResidual_ || iterations < minIterations_) return false;
+    return residual <= absoluteTolerance_ || residual <= relativeTolerance_ * initial;
+}
+
 //--- Explicit Instantiations ---//
 template class porescale::iterativeSolver<float>;
 template class porescale::iterativeSolver<double>;
 
+///// Krylov solver class /////
+
+//--- Constructors ---//
+template <typename T>
+porescale::krylovSolver<T>::krylovSolver(void) : iterativeSolver<T>::iterativeSolver(), M_(NULL) { }
+
+template <typename T>
+porescale::krylovSolver<T>::krylovSolver(parameters<T> * par) : iterativeSolver<T>::iterativeSolver(par), M_(NULL) { }
+
+//--- Preconditioner ---//
+template <typename T>
+void
+porescale::krylovSolver<T>::setPreconditioner(solver<T> * M) { M_ = M; }
+
+//--- Explicit Instantiations ---//
+template class porescale::krylovSolver<float>;
+template class porescale::krylovSolver<double>;
+
+///// Preconditioner class /////
+
+//--- Constructors ---//
+template <typename T>
+porescale::preconditioner<T>::preconditioner(void) : solver<T>::solver() { }
+
+//--- Solve ---//
+template <typename T>
+void
+porescale::preconditioner<T>::solve(vector<T>& b, vector<T>& x) { apply(b, x); }
+
+//--- Explicit Instantiations ---//
+template class porescale::preconditioner<float>;
+template class porescale::preconditioner<double>;
+
@@ -0,0 +1,239 @@
+/**
+ * \file
+ * \author Timothy B. Costa
+ * \brief Source for solver telemetry class.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "solve.hpp"
+
+namespace
+{
+    /** \brief Phase names of the exports. */
+    const char * phaseNames[porescale::TELEMETRY_PHASES] = { "spmv", "preconditioner", "reduction", "update" };
+
+    /** \brief JSON number, null when not finite. */
+    void
+    jsonNumber(std::ostream& os, double value)
+    {
+        if (std::isfinite(value)) os << value;
+        else os << "null";
+    }
+
+    /** \brief (last / first)^(1 / n), the mean reduction of n iterations. */
+    double
+    meanRate(double first, double last, psInt n)
+    {
+        if (n <= 0 || first <= 0) return std::numeric_limits<double>::quiet_NaN();
+        return pow(last / first, 1.0 / n);
+    }
+}
+
+//--- Constructors ---//
+porescale::solverTelemetry::solverTelemetry(psInt capacity) : head_(0), size_(0), solves_(0), current_()
+{
+    setCapacity(capacity);
+}
+
+//--- Buffer ---//
+void
+porescale::solverTelemetry::setCapacity(psInt capacity)
+{
+    ring_.assign(std::max(capacity, (psInt)1), record());
+    clear();
+}
+
+psInt
+porescale::solverTelemetry::capacity(void) const { return (psInt)ring_.size(); }
+
+psInt
+porescale::solverTelemetry::size(void) const { return size_; }
+
+const porescale::solverTelemetry::record&
+porescale::solverTelemetry::at(psInt i) const
+{
+    psInt n = (psInt)ring_.size();
+    return ring_[(head_ - size_ + i + n) % n];
+}
+
+void
+porescale::solverTelemetry::clear(void)
+{
+    head_    = 0;
+    size_    = 0;
+    solves_  = 0;
+    current_ = record();
+}
+
+//--- Recording ---//
+void
+porescale::solverTelemetry::beginSolve(void)
+{
+    solves_++;
+    current_ = record();
+    mark();
+}
+
+void
+porescale::solverTelemetry::mark(void) { mark_ = std::chrono::steady_clock::now(); }
+
+void
+porescale::solverTelemetry::charge(psTelemetryPhase phase, double bytes)
+{
+    auto now                 = std::chrono::steady_clock::now();
+    current_.seconds[phase] += std::chrono::duration<double>(now - mark_).count();
+    current_.bytes[phase]   += bytes;
+    mark_                    = now;
+}
+
+void
+porescale::solverTelemetry::commit(psInt iteration, double residual)
+{
+    current_.solve     = solves_;
+    current_.iteration = iteration;
+    current_.residual  = residual;
+    ring_[head_]       = current_;
+    head_              = (head_ + 1) % (psInt)ring_.size();
+    size_              = std::min(size_ + 1, (psInt)ring_.size());
+    current_           = record();
+    mark();
+}
+
+//--- Summary ---//
+void
+porescale::solverTelemetry::lastSolve_(psInt& begin, psInt& end) const
+{
+    end   = size_;
+    begin = end;
+    while (begin > 0 && at(begin - 1).solve == at(end - 1).solve) begin--;
+}
+
+double
+porescale::solverTelemetry::convergenceRate(void) const
+{
+    psInt begin, end;
+    lastSolve_(begin, end);
+    if (end - begin < 2) return std::numeric_limits<double>::quiet_NaN();
+    return meanRate(at(begin).residual, at(end - 1).residual, at(end - 1).iteration - at(begin).iteration);
+}
+
+double
+porescale::solverTelemetry::asymptoticRate(psInt window) const
+{
+    psInt begin, end;
+    lastSolve_(begin, end);
+    if (end - begin < 2) return std::numeric_limits<double>::quiet_NaN();
+    begin = std::max(begin, end - 1 - std::max(window, (psInt)1));
+    return meanRate(at(begin).residual, at(end - 1).residual, at(end - 1).iteration - at(begin).iteration);
+}
+
+std::string
+porescale::solverTelemetry::summary(void) const
+{
+    std::ostringstream os;
+    double             seconds[TELEMETRY_PHASES] = {}, bytes[TELEMETRY_PHASES] = {}, total = 0;
+    for (psInt i = 0; i < size_; i++)
+        for (psInt p = 0; p < TELEMETRY_PHASES; p++)
+        {
+            seconds[p] += at(i).seconds[p];
+            bytes[p]   += at(i).bytes[p];
+            total      += at(i).seconds[p];
+        }
+
+    os << std::setprecision(4);
+    os << "Solver telemetry, " << size_ << " records";
+    if (size_ == (psInt)ring_.size()) os << " (buffer full, oldest overwritten)";
+    os << "\n";
+    for (psInt i = 0; i < size_; )
+    {
+        psInt j = i;
+        while (j < size_ && at(j).solve == at(i).solve) j++;
+        psInt n = at(j - 1).iteration - at(i).iteration;
+        os << "  solve " << at(i).solve << ": " << n << " iterations, residual "
+           << at(i).residual << " -> " << at(j - 1).residual
+           << ", rate " << meanRate(at(i).residual, at(j - 1).residual, n) << "\n";
+        i = j;
+    }
+    os << "  last solve asymptotic rate " << asymptoticRate() << "\n";
+    for (psInt p = 0; p < TELEMETRY_PHASES; p++)
+    {
+        os << "  " << std::setw(15) << std::left << phaseNames[p] << std::right
+           << std::setw(10) << seconds[p] << " s " << std::setw(6) << ((total > 0) ? 100 * seconds[p] / total : 0) << " %";
+        if (bytes[p] > 0 && seconds[p] > 0) os << std::setw(10) << bytes[p] / seconds[p] * 1e-9 << " GB/s";
+        os << "\n";
+    }
+    return os.str();
+}
+
+std::string
+porescale::solverTelemetry::csv(void) const
+{
+    std::ostringstream os;
+    os << std::setprecision(17);
+    os << "solve,iteration,residual";
+    for (psInt p = 0; p < TELEMETRY_PHASES; p++) os << "," << phaseNames[p] << "Seconds";
+    for (psInt p = 0; p < TELEMETRY_PHASES; p++) os << "," << phaseNames[p] << "Bytes";
+    os << "\n";
+    for (psInt i = 0; i < size_; i++)
+    {
+        const record& r = at(i);
+        os << r.solve << "," << r.iteration << "," << r.residual;
+        for (psInt p = 0; p < TELEMETRY_PHASES; p++) os << "," << r.seconds[p];
+        for (psInt p = 0; p < TELEMETRY_PHASES; p++) os << "," << r.bytes[p];
+        os << "\n";
+    }
+    return os.str();
+}
+
+std::string
+porescale::solverTelemetry::json(void) const
+{
+    std::ostringstream os;
+    os << std::setprecision(17);
+    os << "{\n";
+    os << "  \"convergenceRate\": ";  jsonNumber(os, convergenceRate()); os << ",\n";
+    os << "  \"asymptoticRate\": ";   jsonNumber(os, asymptoticRate());  os << ",\n";
+    os << "  \"records\": [";
+    for (psInt i = 0; i < size_; i++)
+    {
+        const record& r = at(i);
+        os << (i ? ",\n" : "\n") << "    { \"solve\": " << r.solve << ", \"iteration\": " << r.iteration
+           << ", \"residual\": ";
+        jsonNumber(os, r.residual);
+        os << ", \"seconds\": {";
+        for (psInt p = 0; p < TELEMETRY_PHASES; p++) os << (p ? ", " : " ") << "\"" << phaseNames[p] << "\": " << r.seconds[p];
+        os << " }, \"bytes\": {";
+        for (psInt p = 0; p < TELEMETRY_PHASES; p++) os << (p ? ", " : " ") << "\"" << phaseNames[p] << "\": " << r.bytes[p];
+        os << " } }";
+    }
+    os << "\n  ]\n";
+    os << "}\n";
+    return os.str();
+}
+
+void
+porescale::solverTelemetry::writeCSV(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        std::cout << "\nPORESCALE Error :: solverTelemetry could not open " << fileName << "\n";
+        return;
+    }
+    file << csv();
+}
+
+void
+porescale::solverTelemetry::writeJSON(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        std::cout << "\nPORESCALE Error :: solverTelemetry could not open " << fileName << "\n";
+        return;
+    }
+    file << json();
+}